@@ -0,0 +1,93 @@
+//----------------------------------------------------------------------------------------------------------------------
+// The MIT License (MIT)
+//
+// Copyright (c) 2018 GRVC University of Seville
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+// documentation files (the "Software"), to deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies or substantial portions of the
+// Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+// WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS
+// OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+// OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//----------------------------------------------------------------------------------------------------------------------
+
+#include <cerrno>
+#include <cstdint>
+#include <cstdlib>
+#include <string>
+#include <unordered_map>
+
+#ifndef GAUSS_MSGS_ICAO_ADDRESS_H
+#define GAUSS_MSGS_ICAO_ADDRESS_H
+
+// ICAO addresses are uint32 in the MQTT messages and decimal strings in the database (Operation, ReadIcao). Nodes keep
+// them as integers and convert only where strings come in or go out
+
+// False if _icao_address is not a decimal uint32
+inline bool parseIcaoAddress(const std::string &_icao_address, uint32_t &_icao) {
+    if (_icao_address.empty()) return false;
+    char *end;
+    errno = 0;
+    unsigned long value = std::strtoul(_icao_address.c_str(), &end, 10);
+    if (errno != 0 || *end != '\0' || _icao_address[0] == '-' || value > UINT32_MAX) return false;
+    _icao = (uint32_t)value;
+    return true;
+}
+
+// Interning table of the string form of every icao, so each one is formatted once and then reused. Strings of icaos
+// that are gone are dropped with erase, or with sweep if nobody tells when they are gone. Not thread safe
+class IcaoAddressTable {
+   public:
+    // Parses the string and keeps it as the string of the icao. Interned strings are kept by sweep
+    bool intern(const std::string &_icao_address, uint32_t &_icao) {
+        if (!parseIcaoAddress(_icao_address, _icao)) return false;
+        Entry &entry = strings_[_icao];
+        entry.string = _icao_address;
+        entry.interned = true;
+        entry.used = true;
+        return true;
+    }
+
+    const std::string &toString(uint32_t _icao) {
+        auto it = strings_.find(_icao);
+        if (it == strings_.end()) it = strings_.emplace(_icao, Entry{std::to_string(_icao), false, false}).first;
+        it->second.used = true;
+        return it->second.string;
+    }
+
+    void erase(uint32_t _icao) { strings_.erase(_icao); }
+
+    // Drops the strings not interned and not used since the previous sweep. Returns how many
+    size_t sweep() {
+        size_t dropped = 0;
+        for (auto it = strings_.begin(); it != strings_.end();) {
+            if (!it->second.interned && !it->second.used) {
+                it = strings_.erase(it);
+                dropped++;
+            } else {
+                it->second.used = false;
+                ++it;
+            }
+        }
+        return dropped;
+    }
+
+    size_t size() const { return strings_.size(); }
+
+   private:
+    struct Entry {
+        std::string string;
+        bool interned;
+        bool used;
+    };
+
+    std::unordered_map<uint32_t, Entry> strings_;
+};
+
+#endif  // GAUSS_MSGS_ICAO_ADDRESS_H
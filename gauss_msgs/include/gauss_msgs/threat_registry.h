@@ -0,0 +1,188 @@
+//----------------------------------------------------------------------------------------------------------------------
+// The MIT License (MIT)
+//
+// Copyright (c) 2018 GRVC University of Seville
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+// documentation files (the "Software"), to deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies or substantial portions of the
+// Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+// WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS
+// OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+// OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//----------------------------------------------------------------------------------------------------------------------
+
+#include <gauss_msgs/NewThreat.h>
+#include <ros/time.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <map>
+#include <vector>
+
+#ifndef GAUSS_MSGS_THREAT_REGISTRY_H
+#define GAUSS_MSGS_THREAT_REGISTRY_H
+
+// What does not change while the same conflict is detected again: its type and who is involved
+struct ThreatKey {
+    uint8_t threat_type;
+    std::vector<int8_t> uav_ids, geofence_ids;  // Sorted
+
+    bool operator<(const ThreatKey &_other) const {
+        if (threat_type != _other.threat_type) return threat_type < _other.threat_type;
+        if (uav_ids != _other.uav_ids) return uav_ids < _other.uav_ids;
+        return geofence_ids < _other.geofence_ids;
+    }
+    bool operator==(const ThreatKey &_other) const { return threat_type == _other.threat_type && uav_ids == _other.uav_ids && geofence_ids == _other.geofence_ids; }
+};
+
+inline ThreatKey threatKey(const gauss_msgs::NewThreat &_threat) {
+    ThreatKey key;
+    key.threat_type = _threat.threat_type;
+    key.uav_ids = _threat.uav_ids;
+    key.geofence_ids = _threat.geofence_ids;
+    std::sort(key.uav_ids.begin(), key.uav_ids.end());
+    std::sort(key.geofence_ids.begin(), key.geofence_ids.end());
+    return key;
+}
+
+// Predicted start of the conflict [s], from the conflictive segments found by monitoring. False for threats that are
+// not predicted (jamming, battery...)
+inline bool predictedConflictTime(const gauss_msgs::NewThreat &_threat, double &_time) {
+    _time = std::numeric_limits<double>::max();
+    if (_threat.threat_type == _threat.LOSS_OF_SEPARATION) {
+        const gauss_msgs::LossConflictiveSegments &segments = _threat.loss_conflictive_segments;
+        // t_crossing_0 is nan if the uavs are already too close
+        if (std::isfinite(segments.t_crossing_0) && segments.t_crossing_0 > 0) _time = std::min(_time, segments.t_crossing_0);
+        if (std::isfinite(segments.t_min) && segments.t_min > 0) _time = std::min(_time, segments.t_min);
+    }
+    if (_threat.geofence_conflictive_segments.first_contiguous_segment.size() > 0) {
+        _time = std::min(_time, _threat.geofence_conflictive_segments.first_contiguous_segment.front().stamp.toSec());
+    }
+    return _time != std::numeric_limits<double>::max();
+}
+
+enum class ThreatTransition {
+    NEW,         // First detection of the conflict
+    SUPERSEDED,  // Detected again, but materially changed: the newer detection replaces the stored one
+    REPEATED,    // Detected again unchanged, but not sent for the resend period: sent again, so it is retried downstream
+    UNCHANGED    // Detected again, nothing to do
+};
+
+struct ThreatUpdate {
+    ThreatTransition transition;
+    int threat_id;  // Stable while the conflict is tracked, kept when superseded
+};
+
+// Conflicts tracked across detection cycles. Every detection is matched to a tracked conflict with the same key. If
+// the key has several conflicts (two losses of separation of the same uavs at different times), the one with the
+// closest predicted time is used. A detection is a material change if its predicted time moved more than
+// conflict_time_margin. Conflicts not detected again are resolved with resolveNotSeenSince. With a resend period, an
+// unchanged conflict is REPEATED every resend period, so consumers that dropped or failed it get it again
+class ThreatRegistry {
+   public:
+    ThreatRegistry(double _conflict_time_margin = 10.0, double _resend_period = 0.0)
+        : conflict_time_margin_(_conflict_time_margin), resend_period_(_resend_period), next_id_(0) {}
+
+    // 0 to never repeat unchanged conflicts
+    void setResendPeriod(double _resend_period) { resend_period_ = _resend_period; }
+
+    ThreatUpdate update(const gauss_msgs::NewThreat &_threat, const ros::Time &_now) {
+        ThreatKey key = threatKey(_threat);
+        double time;
+        bool predicted = predictedConflictTime(_threat, time);
+        auto range = entries_.equal_range(key);
+        auto match = entries_.end();
+        double match_distance = std::numeric_limits<double>::max();
+        for (auto it = range.first; it != range.second; ++it) {
+            // Already matched by another detection of this cycle
+            if (it->second.last_seen == _now) continue;
+            double distance = (predicted && it->second.predicted) ? std::abs(time - it->second.conflict_time) : 0.0;
+            if (distance < match_distance) {
+                match = it;
+                match_distance = distance;
+            }
+        }
+
+        ThreatUpdate out_update;
+        if (match == entries_.end()) {
+            Entry entry;
+            entry.threat_id = next_id_++;
+            match = entries_.insert(std::make_pair(key, entry));
+            out_update.transition = ThreatTransition::NEW;
+        } else if (predicted != match->second.predicted || match_distance > conflict_time_margin_) {
+            out_update.transition = ThreatTransition::SUPERSEDED;
+        } else if (resend_period_ > 0 && (_now - match->second.last_sent).toSec() >= resend_period_) {
+            out_update.transition = ThreatTransition::REPEATED;
+        } else {
+            out_update.transition = ThreatTransition::UNCHANGED;
+        }
+        match->second.last_seen = _now;
+        if (out_update.transition != ThreatTransition::UNCHANGED) match->second.last_sent = _now;
+        // Unchanged detections keep the stored time, so slow drifts are still noticed
+        if (out_update.transition == ThreatTransition::NEW || out_update.transition == ThreatTransition::SUPERSEDED) {
+            match->second.predicted = predicted;
+            match->second.conflict_time = time;
+        }
+        out_update.threat_id = match->second.threat_id;
+        return out_update;
+    }
+
+    // Resolve the conflicts not detected since _time. Returns how many
+    int resolveNotSeenSince(const ros::Time &_time) {
+        int resolved = 0;
+        for (auto it = entries_.begin(); it != entries_.end();) {
+            if (it->second.last_seen < _time) {
+                it = entries_.erase(it);
+                resolved++;
+            } else {
+                ++it;
+            }
+        }
+        return resolved;
+    }
+
+    // Forget the tracked conflict a threat was matched to, so its next detection is NEW again. False if not tracked
+    bool erase(const gauss_msgs::NewThreat &_threat) {
+        double time;
+        bool predicted = predictedConflictTime(_threat, time);
+        auto range = entries_.equal_range(threatKey(_threat));
+        auto match = entries_.end();
+        double match_distance = std::numeric_limits<double>::max();
+        for (auto it = range.first; it != range.second; ++it) {
+            double distance = (predicted && it->second.predicted) ? std::abs(time - it->second.conflict_time) : 0.0;
+            if (distance < match_distance) {
+                match = it;
+                match_distance = distance;
+            }
+        }
+        if (match == entries_.end()) return false;
+        entries_.erase(match);
+        return true;
+    }
+
+    size_t size() const { return entries_.size(); }
+
+   private:
+    struct Entry {
+        int threat_id;
+        bool predicted;
+        double conflict_time;
+        ros::Time last_seen;
+        ros::Time last_sent;
+    };
+
+    std::multimap<ThreatKey, Entry> entries_;
+    double conflict_time_margin_;
+    double resend_period_;
+    int next_id_;
+};
+
+#endif  // GAUSS_MSGS_THREAT_REGISTRY_H
@@ -1,6 +1,7 @@
 #include <gauss_light_sim/ChangeParam.h>
 #include <gauss_light_sim/ChangeFlightPlan.h>
 #include <gauss_msgs/ReadIcao.h>
+#include <gauss_msgs/icao_address.h>
 #include <gauss_msgs/ReadOperation.h>
 #include <gauss_msgs_mqtt/RPAStateInfo.h>
 #include <gauss_msgs_mqtt/RPSChangeFlightStatus.h>
@@ -10,6 +11,8 @@
 #include <tf2/LinearMath/Quaternion.h>
 #include <tf2_ros/transform_broadcaster.h>
 #include <geometry_msgs/TransformStamped.h>
+#include <tracking/segment_locator.h>
+#include <usp_manager/local_cartesian_batch.h>
 #include <yaml-cpp/yaml.h>
 
 #include <Eigen/Eigen>
@@ -21,6 +24,7 @@
 #define ARENOSILLO_LATITUDE 37.094784
 #define ARENOSILLO_LONGITUDE -6.735478
 #define ARENOSILLO_ELLIPSOIDAL_HEIGHT 0.0 // TODO: MEASURE IT 
+#define SEGMENT_SEARCH_TOLERANCE 1.0 // Simulated position is always on the flight plan
 
 /*
 gauss_msgs::Waypoint interpolate(const gauss_msgs::Waypoint& from, const gauss_msgs::Waypoint& to, const ros::Time& t) {
@@ -57,108 +61,6 @@ inline double distanceBetweenWaypoints(const gauss_msgs::Waypoint &waypoint_a, c
     return sqrt(pow(waypoint_a.x - waypoint_b.x,2) + pow(waypoint_a.y - waypoint_b.y, 2) + pow(waypoint_a.z - waypoint_b.z, 2));
 }
 
-void findSegmentWaypointsIndices(const gauss_msgs::Waypoint &current_position, const gauss_msgs::WaypointList &flight_plan, int &a_index, int &b_index, double &distance_to_segment, double &distance_to_point_a, double &distance_to_point_b)
-{
-    int first_index = 0;
-    int second_index = 0;
-    distance_to_segment = std::numeric_limits<double>::max();
-    double distance_to_waypoint_a = std::numeric_limits<double>::max();
-    bool flag_distance_to_waypoint_a = false;
-    bool flag_distance_to_waypoint_b = false;
-
-    for (int i=0; i < flight_plan.waypoints.size()-1; i++)
-    {
-        gauss_msgs::Waypoint waypoint_a = flight_plan.waypoints[i];
-        gauss_msgs::Waypoint waypoint_b = flight_plan.waypoints[i+1];
-        Eigen::Vector3d vector_u;
-        flag_distance_to_waypoint_a = false;
-        flag_distance_to_waypoint_b = false;
-        vector_u.x() = waypoint_b.x - waypoint_a.x;
-        vector_u.y() = waypoint_b.y - waypoint_a.y;
-        vector_u.z() = waypoint_b.z - waypoint_a.z;
-        /*
-            Solve this equation
-            |alpha_1|     | 1    0    0    u_1|^-1   | a_1 - x_0|
-            |alpha_2|     | 0    1    0    u_2|      | a_2 - y_0|
-            |alpha_3|  =  | 0    0    1    u_3|   *  | a_3 - z_0|
-            |    t  |     | u_1  u_2  u_3  0  |      |     0    |
-
-            b = A^-1*x
-        */
-        Eigen::Matrix4d A;
-        Eigen::Vector4d b;
-        Eigen::Vector4d x;
-
-        A = Eigen::Matrix4d::Identity();
-        A(3,3) = 0;
-        A(0,3) = vector_u.x();
-        A(1,3) = vector_u.y();
-        A(2,3) = vector_u.z();
-        A(3,0) = vector_u.x();
-        A(3,1) = vector_u.y();
-        A(3,2) = vector_u.z();
-
-        x.x() = current_position.x - waypoint_a.x;
-        x.y() = current_position.y - waypoint_a.y;
-        x.z() = current_position.z - waypoint_a.z;
-        x.w() = 0.0;
-
-        b = A.inverse()*x;
-
-        double distance;
-        if (b[3] >= 0 && b[3] <= 1)
-        {
-            distance = sqrt(b[0]*b[0] + b[1]*b[1] + b[2]*b[2]);
-        }
-        else
-        {
-            double distance_to_waypoint_a = distanceBetweenWaypoints(current_position, waypoint_a);
-            double distance_to_waypoint_b = distanceBetweenWaypoints(current_position, waypoint_b);
-
-            if (distance_to_waypoint_a < distance_to_waypoint_b)
-            {
-                distance = distance_to_waypoint_a;
-                flag_distance_to_waypoint_a = true;
-            }
-            else
-            {
-                distance = distance_to_waypoint_b;
-                flag_distance_to_waypoint_b = true;
-            }
-        }
-        // Then check the distance to the line that contains the segment
-        if (distance <= distance_to_segment)
-        {
-            distance_to_segment = distance;
-            if(flag_distance_to_waypoint_a)
-            {
-                first_index = i;
-                second_index = i;
-            }
-            else if(flag_distance_to_waypoint_b)
-            {
-                first_index = i+1;
-                second_index = i+1;                
-            }
-            else
-            {
-                first_index = i;
-                second_index = i+1;
-            }
-        }
-    }
-
-    a_index = first_index;
-    b_index = second_index;
-
-    gauss_msgs::Waypoint waypoint_a = flight_plan.waypoints[first_index];
-    gauss_msgs::Waypoint waypoint_b = flight_plan.waypoints[second_index];
-
-    distance_to_point_a = distanceBetweenWaypoints(waypoint_a, current_position);
-    distance_to_point_b = distanceBetweenWaypoints(waypoint_b, current_position);
-}
-
-// This is a trickier version of the previous function, as time-base issues must be addressed (TODO!)
 gauss_msgs::Waypoint interpolate(const gauss_msgs::Waypoint &from, const gauss_msgs::Waypoint &to, const ros::Duration &t, double* yaw = nullptr) {
     // Make sure that from.stamp < to.stamp
     if (from.stamp > to.stamp) {
@@ -285,7 +187,7 @@ class RPAStateInfoWrapper {
     geometry_msgs::TransformStamped tf;
 
     // Each function updates a subset of fields in data:
-    // uint32 icao                 - update
+    // uint32 icao                 - setIcao
     // float64 latitude            -------- updatePhysics4D
     // float64 longitude           -------- updatePhysics4D
     // float32 altitude            -------- updatePhysics4D
@@ -308,10 +210,12 @@ class RPAStateInfoWrapper {
     // float32 signal_noise_ratio  ---------------------- applyChange
     // float32 received_power      ---------------------- applyChange
 
-    bool update(const ros::Duration &elapsed, const gauss_msgs::Operation &operation, const std::map<std::string, double> &icao_to_speed_map, const double &sim_rate) {
-        // TODO: Solve icao string vs uint32 issue
-        data.icao = std::stoi(operation.icao_address);
+    void setIcao(uint32_t icao, const std::string &icao_address) {
+        data.icao = icao;
+        tf.child_frame_id = icao_address;
+    }
 
+    bool update(const ros::Duration &elapsed, const gauss_msgs::Operation &operation, const std::map<uint32_t, double> &icao_to_speed_map, const double &sim_rate) {
         // TODO: Solve timing issues
         data.timestamp = ros::Time::now().toNSec() / 1000000;
 
@@ -321,16 +225,14 @@ class RPAStateInfoWrapper {
             if (elapsed.toSec() > change.stamp.toSec()) {
                 try {
                     YAML::Node yaml_change = YAML::Load(change.yaml);
-                    auto icao = operation.icao_address.c_str();
                     if (!applyChange(yaml_change)) {
-                        ROS_ERROR("[Sim] RPA[%s] apply: %s", icao, change.yaml.c_str());
+                        ROS_ERROR("[Sim] RPA[%u] apply: %s", data.icao, change.yaml.c_str());
                     } else {
-                        ROS_INFO("[Sim] RPA[%s] apply: %s", icao, change.yaml.c_str());
+                        ROS_INFO("[Sim] RPA[%u] apply: %s", data.icao, change.yaml.c_str());
                     }
 
                 } catch (const std::runtime_error &error) {
-                    auto icao = operation.icao_address.c_str();
-                    ROS_ERROR("[Sim] RPA[%s] could not apply [%s]: %s", icao, change.yaml.c_str(), error.what());
+                    ROS_ERROR("[Sim] RPA[%u] could not apply [%s]: %s", data.icao, change.yaml.c_str(), error.what());
                 }
                 // And erase this change, keepin valid it
                 it = change_param_request_list.erase(it);
@@ -339,8 +241,9 @@ class RPAStateInfoWrapper {
             }
         }
 
-        if (!icao_to_speed_map.empty() && icao_to_speed_map.find(operation.icao_address)->second != 0.0) { // If cruising speed is 0 or map is empty, use updatePhysics4D
-            return updatePhysics3D(elapsed, operation.flight_plan, icao_to_speed_map.find(operation.icao_address)->second, sim_rate);
+        auto speed = icao_to_speed_map.find(data.icao);
+        if (speed != icao_to_speed_map.end() && speed->second != 0.0) { // If cruising speed is 0 or not set, use updatePhysics4D
+            return updatePhysics3D(elapsed, operation.flight_plan, speed->second, sim_rate);
         } else {
             return updatePhysics4D(elapsed, operation.flight_plan);
         }
@@ -391,7 +294,6 @@ class RPAStateInfoWrapper {
         // Update common tf data
         tf.header.stamp = ros::Time::now();
         tf.header.frame_id = "map";
-        tf.child_frame_id = std::to_string(data.icao);
 
         if (flight_plan.waypoints.size() == 0) {
             ROS_ERROR("[Sim] Flight plan is empty");
@@ -457,7 +359,6 @@ class RPAStateInfoWrapper {
         // Update common tf data
         tf.header.stamp = ros::Time::now();
         tf.header.frame_id = "map";
-        tf.child_frame_id = std::to_string(data.icao);
 
         if (flight_plan.waypoints.size() == 0) {
             ROS_ERROR("[Sim] Flight plan is empty");
@@ -479,7 +380,10 @@ class RPAStateInfoWrapper {
 
         int a_index, b_index;
         double dist_to_segment, dist_to_a, dist_to_b;
-        findSegmentWaypointsIndices(current_position, flight_plan, a_index, b_index, dist_to_segment, dist_to_a, dist_to_b);
+        if (!segment_locator.isBuiltFor(flight_plan)) {
+            segment_locator.reset(flight_plan);
+        }
+        segment_locator.find(current_position, SEGMENT_SEARCH_TOLERANCE, a_index, b_index, dist_to_segment, dist_to_a, dist_to_b);
         Eigen::Vector3f p_a, p_b, unit_vec;
         p_a = Eigen::Vector3f(current_position.x, current_position.y, current_position.z);
         p_b = Eigen::Vector3f(flight_plan.waypoints.at(b_index).x, flight_plan.waypoints.at(b_index).y, flight_plan.waypoints.at(b_index).z);
@@ -621,22 +525,34 @@ class RPAStateInfoWrapper {
         change_param_request_list.push_back(req);
     }
 
+    // The segment search restarts on a new flight plan, isBuiltFor does not tell plans with the same end apart
+    void changeFlightPlan(const gauss_msgs::WaypointList &flight_plan) {
+        segment_locator.reset(flight_plan);
+    }
+
    protected:
     std::vector<gauss_light_sim::ChangeParam::Request> change_param_request_list;
     GeographicLib::LocalCartesian proj;
+    SegmentLocator segment_locator;
 };
 
 class LightSim {
    public:
     LightSim(ros::NodeHandle &n, const std::vector<std::string> &icao_addresses, const GeographicLib::LocalCartesian &projection) : 
-                                                                                                          n(n), proj_(projection){
-        for (auto icao : icao_addresses) {
+                                                                                                          n(n), geodesy_(projection){
+        for (auto &icao_address : icao_addresses) {
+            uint32_t icao;
+            if (!parseIcaoAddress(icao_address, icao)) {
+                ROS_ERROR("[Sim] Can not simulate invalid icao [%s]", icao_address.c_str());
+                continue;
+            }
             icao_to_is_started_map[icao] = false;
             icao_to_time_zero_map[icao] = ros::Time(0);
             icao_to_operation_map[icao] = gauss_msgs::Operation();
             icao_to_state_info_map[icao] = RPAStateInfoWrapper();
             icao_to_state_info_map[icao].setProjection(projection);
-            ROS_INFO("[Sim] Ready to simulate icao [%s]", icao.c_str());
+            icao_to_state_info_map[icao].setIcao(icao, icao_address);
+            ROS_INFO("[Sim] Ready to simulate icao [%u]", icao);
         }
         change_param_service = n.advertiseService("gauss_light_sim/change_param", &LightSim::changeParamCallback, this);
         change_flight_plan_service = n.advertiseService("gauss_light_sim/change_flight_plan", &LightSim::changeFlightPlanCallback, this);
@@ -652,28 +568,33 @@ class LightSim {
     }
 
     void setOperations(const std::vector<gauss_msgs::Operation> &operations) {
-        for (auto operation : operations) {
+        for (auto &operation : operations) {
             // There should be one operation for each icao_address
-            icao_to_operation_map[operation.icao_address] = operation;
-            icao_to_current_position_map[operation.icao_address] = operation.flight_plan.waypoints.front();
-            icao_to_state_info_map[operation.icao_address].initPhysics(operation.flight_plan);
-            ROS_INFO("[Sim] Loaded operation for icao [%s]", operation.icao_address.c_str());
+            uint32_t icao;
+            if (!parseIcaoAddress(operation.icao_address, icao)) {
+                ROS_ERROR("[Sim] Discarding operation with invalid icao [%s]", operation.icao_address.c_str());
+                continue;
+            }
+            icao_to_operation_map[icao] = operation;
+            icao_to_current_position_map[icao] = operation.flight_plan.waypoints.front();
+            icao_to_state_info_map[icao].initPhysics(operation.flight_plan);
+            ROS_INFO("[Sim] Loaded operation for icao [%u]", icao);
         }
     }
 
-    void setAutoStart(const std::map<std::string, ros::Time> &icao_to_start_time_map) {
+    void setAutoStart(const std::map<uint32_t, ros::Time> &icao_to_start_time_map) {
         auto now = ros::Time::now();  // So it is the same for all operations
         for (auto const& auto_start : icao_to_start_time_map) {
             auto icao = auto_start.first;
             auto countdown = auto_start.second - now;
-            ROS_INFO("[Sim] Operation icao [%s] will auto start in [%lf] seconds", icao.c_str(), countdown.toSec());
+            ROS_INFO("[Sim] Operation icao [%u] will auto start in [%lf] seconds", icao, countdown.toSec());
 
             auto callback = [icao, countdown, this](const ros::TimerEvent& event) {
-                ROS_INFO("[Sim] Operation icao [%s] auto starting after [%lf] seconds", icao.c_str(), countdown.toSec());
+                ROS_INFO("[Sim] Operation icao [%u] auto starting after [%lf] seconds", icao, countdown.toSec());
                 // this->startOperation(icao);  // Possible loop here: start->callback->start...
                 // ...publish status instead:
                 gauss_msgs_mqtt::RPSChangeFlightStatus status_msg;
-                status_msg.icao = std::stoi(icao);
+                status_msg.icao = icao;
                 status_msg.status = "start";
                 this->status_pub.publish(status_msg);
             };
@@ -681,121 +602,130 @@ class LightSim {
         }
     }
     
-    void setCruisingSpeed(const std::map<std::string, double> &_icao_to_cruising_speed_map) {
+    void setCruisingSpeed(const std::map<uint32_t, double> &_icao_to_cruising_speed_map) {
         icao_to_cruising_speed_map = _icao_to_cruising_speed_map;
         for (auto const& cruising_speed_item : icao_to_cruising_speed_map) {
             auto icao = cruising_speed_item.first;
             auto speed = cruising_speed_item.second;
-            ROS_INFO("[Sim] Operation icao [%s] will be simulated at [%lf] meters per seconds", icao.c_str(), speed);
+            ROS_INFO("[Sim] Operation icao [%u] will be simulated at [%lf] meters per seconds", icao, speed);
         }
     }
 
 // protected:  // Leave it public to allow calling from main (TODO: add new public function?)
     bool changeParamCallback(gauss_light_sim::ChangeParam::Request &req, gauss_light_sim::ChangeParam::Response &res) {
-        if (icao_to_state_info_map.count(req.icao_address) == 0) {
+        uint32_t icao;
+        if (!parseIcaoAddress(req.icao_address, icao) || icao_to_state_info_map.count(icao) == 0) {
             ROS_WARN("[Sim] Discarding ChangeParam request for unknown RPA[%s]", req.icao_address.c_str());
             return false;
         }
 
-        ROS_INFO("[Sim] RPA[%s] at t = %lf will change: %s", req.icao_address.c_str(), req.stamp.toSec(), req.yaml.c_str());
-        icao_to_state_info_map[req.icao_address].addChangeParamRequest(req);
+        ROS_INFO("[Sim] RPA[%u] at t = %lf will change: %s", icao, req.stamp.toSec(), req.yaml.c_str());
+        icao_to_state_info_map[icao].addChangeParamRequest(req);
         return true;
     }
 
    protected:
     bool changeFlightPlanCallback(gauss_light_sim::ChangeFlightPlan::Request &req, gauss_light_sim::ChangeFlightPlan::Response &res) {
-        icao_to_operation_map[std::to_string(req.alternative.icao)].flight_plan.waypoints.clear();
-        for (auto geo_wp : req.alternative.new_flight_plan){
+        // Whole flight plan converted at once
+        size_t n_waypoints = req.alternative.new_flight_plan.size();
+        std::vector<double> latitude(n_waypoints), longitude(n_waypoints), altitude(n_waypoints), x(n_waypoints), y(n_waypoints), z(n_waypoints);
+        for (size_t i = 0; i < n_waypoints; i++) {
+            longitude[i] = req.alternative.new_flight_plan[i].waypoint_elements[0];
+            latitude[i] = req.alternative.new_flight_plan[i].waypoint_elements[1];
+            altitude[i] = req.alternative.new_flight_plan[i].waypoint_elements[2];
+        }
+        geodesy_.forward(n_waypoints, latitude.data(), longitude.data(), altitude.data(), x.data(), y.data(), z.data());
+        std::vector<gauss_msgs::Waypoint> &waypoints = icao_to_operation_map[req.alternative.icao].flight_plan.waypoints;
+        waypoints.clear();
+        for (size_t i = 0; i < n_waypoints; i++) {
             gauss_msgs::Waypoint temp_wp;
-            double longitude, latitude, altitude;
-            longitude = geo_wp.waypoint_elements[0];
-            latitude = geo_wp.waypoint_elements[1];
-            altitude = geo_wp.waypoint_elements[2];
-            temp_wp.stamp = ros::Time(geo_wp.waypoint_elements[3]);
-            proj_.Forward(latitude, longitude, altitude, temp_wp.x, temp_wp.y, temp_wp.z);
-            // std::cout << req.alternative.icao << ":" << temp_wp.x << " " << temp_wp.y << " " << temp_wp.z << " " << temp_wp.stamp.toNSec() << "\n";
-            icao_to_operation_map[std::to_string(req.alternative.icao)].flight_plan.waypoints.push_back(temp_wp);
+            temp_wp.x = x[i];
+            temp_wp.y = y[i];
+            temp_wp.z = z[i];
+            temp_wp.stamp = ros::Time(req.alternative.new_flight_plan[i].waypoint_elements[3]);
+            waypoints.push_back(temp_wp);
         }
+        auto state_info = icao_to_state_info_map.find(req.alternative.icao);
+        if (state_info != icao_to_state_info_map.end()) state_info->second.changeFlightPlan(icao_to_operation_map[req.alternative.icao].flight_plan);
         return true;
     }
 
     void flightStatusCallback(const gauss_msgs_mqtt::RPSChangeFlightStatus::ConstPtr &msg) {
-        // TODO: Decide if icao is a string or a uint32
-        std::string icao_address = std::to_string(msg->icao);
-        if (icao_to_is_started_map.count(icao_address) == 0) {
-            ROS_WARN("[Sim] Discarding RPSChangeFlightStatus for unknown RPA[%s]", icao_address.c_str());
+        if (icao_to_is_started_map.count(msg->icao) == 0) {
+            ROS_WARN("[Sim] Discarding RPSChangeFlightStatus for unknown RPA[%u]", msg->icao);
             return;
         }
 
         // TODO: Magic word for start?
         if (msg->status == "start") {
-            startOperation(icao_address);
+            startOperation(msg->icao);
         } else if (msg->status == "stop") {
-            stopOperation(icao_address);
+            stopOperation(msg->icao);
         }
     }
 
-    void startOperation(const std::string& icao_address) {
-        bool started = icao_to_is_started_map[icao_address];
+    void startOperation(uint32_t icao) {
+        bool started = icao_to_is_started_map[icao];
         if (started) {
-            ROS_WARN("[Sim] Operation icao [%s] already started", icao_address.c_str());
+            ROS_WARN("[Sim] Operation icao [%u] already started", icao);
         } else {
-            icao_to_time_zero_map[icao_address] = ros::Time::now();
-            icao_to_is_started_map[icao_address] = true;
+            icao_to_time_zero_map[icao] = ros::Time::now();
+            icao_to_is_started_map[icao] = true;
             // gauss_msgs_mqtt::RPSChangeFlightStatus status_msg;
-            // status_msg.icao = std::stoi(icao_address);
+            // status_msg.icao = icao;
             // status_msg.status = "start";
             // status_pub.publish(status_msg);  // Possible loop here: start->callback->start...
-            ROS_INFO("[Sim] RPA[%s] starting (t = %lf)", icao_address.c_str(), icao_to_time_zero_map[icao_address].toSec());
+            ROS_INFO("[Sim] RPA[%u] starting (t = %lf)", icao, icao_to_time_zero_map[icao].toSec());
         }
     }
 
-    void stopOperation(const std::string& icao_address) {
-        bool started = icao_to_is_started_map[icao_address];
+    void stopOperation(uint32_t icao) {
+        bool started = icao_to_is_started_map[icao];
         if (!started) {
-            ROS_WARN("[Sim] Operation icao [%s] not started yet", icao_address.c_str());
+            ROS_WARN("[Sim] Operation icao [%u] not started yet", icao);
         } else {
-            icao_to_is_started_map[icao_address] = false;
-            ROS_INFO("[Sim] RPA[%s] stopping (t = %lf)", icao_address.c_str(), ros::Time::now().toSec());
+            icao_to_is_started_map[icao] = false;
+            ROS_INFO("[Sim] RPA[%u] stopping (t = %lf)", icao, ros::Time::now().toSec());
         }
     }
 
     void updateCallback(const ros::TimerEvent &time) {
-        for (auto element : icao_to_is_started_map) {
-            auto icao = element.first;
+        for (auto &element : icao_to_is_started_map) {
+            uint32_t icao = element.first;
             bool is_started = element.second;
             if (is_started) {
                 // TODO: Fix base-time issues!
                 // ros::Duration elapsed = time.current_real - icao_to_time_zero_map[icao];
                 ros::Duration elapsed = time.current_real - ros::Time(0);
-                auto operation = icao_to_operation_map[icao];
-                if (!icao_to_state_info_map[icao].update(elapsed, operation, icao_to_cruising_speed_map, sim_rate)) {
+                RPAStateInfoWrapper &state_info = icao_to_state_info_map[icao];
+                if (!state_info.update(elapsed, icao_to_operation_map[icao], icao_to_cruising_speed_map, sim_rate)) {
                     // Operation is finished
-                    ROS_INFO("[Sim] RPA[%s] finished operation", icao.c_str());
+                    ROS_INFO("[Sim] RPA[%u] finished operation", icao);
                     // TODO: Check tracking, it stop instantly the update of the operation instead of wait for the next service call (writeTracking)
                     gauss_msgs_mqtt::RPSChangeFlightStatus status_msg;
-                    status_msg.icao = std::stoi(icao);
+                    status_msg.icao = icao;
                     status_msg.status = "stop";
                     status_pub.publish(status_msg);
                 }
-                rpa_state_info_pub.publish(icao_to_state_info_map[icao].data);
-                tf_broadcaster.sendTransform(icao_to_state_info_map[icao].tf);
+                rpa_state_info_pub.publish(state_info.data);
+                tf_broadcaster.sendTransform(state_info.tf);
             }
         }
     }
 
-    std::map<std::string, bool> icao_to_is_started_map;
-    std::map<std::string, ros::Time> icao_to_time_zero_map;
-    std::map<std::string, double> icao_to_cruising_speed_map;
-    std::map<std::string, gauss_msgs::Operation> icao_to_operation_map;
-    std::map<std::string, RPAStateInfoWrapper> icao_to_state_info_map;
-    std::map<std::string, gauss_msgs::Waypoint> icao_to_current_position_map;
+    // Keyed by the icao of the MQTT messages, database strings are parsed when loaded
+    std::map<uint32_t, bool> icao_to_is_started_map;
+    std::map<uint32_t, ros::Time> icao_to_time_zero_map;
+    std::map<uint32_t, double> icao_to_cruising_speed_map;
+    std::map<uint32_t, gauss_msgs::Operation> icao_to_operation_map;
+    std::map<uint32_t, RPAStateInfoWrapper> icao_to_state_info_map;
+    std::map<uint32_t, gauss_msgs::Waypoint> icao_to_current_position_map;
     // std::vector<geometry_msgs::TransformStamped> tf_vector;  // TODO?
 
     // Param
     double sim_rate = 10.0;
     // Auxiliary variable for cartesian to geographic conversion
-    GeographicLib::LocalCartesian proj_;
+    LocalCartesianBatch geodesy_;
 
     ros::NodeHandle n;
     ros::Timer timer;
@@ -893,11 +823,11 @@ int main(int argc, char **argv) {
     if (timing_yaml["simulation"]["auto_start"]) {
         // Load auto_start_map from config file
         auto auto_start_yaml = timing_yaml["simulation"]["auto_start"];
-        std::map<std::string, ros::Time> auto_start_map;
+        std::map<uint32_t, ros::Time> auto_start_map;
         ROS_INFO("[Sim] auto_start:");
         for (auto auto_start_item: auto_start_yaml) {
             ROS_INFO_STREAM("[Sim] - " << auto_start_item);
-            auto icao = auto_start_item["icao"].as<std::string>();
+            auto icao = auto_start_item["icao"].as<uint32_t>();
             auto delay = auto_start_item["delay"].as<float>();
             auto_start_map[icao] = init_time + ros::Duration(delay);
             // std::cout << icao << ": " << auto_start_map[icao] << '\n';
@@ -931,11 +861,11 @@ int main(int argc, char **argv) {
     if (timing_yaml["simulation"]["cruising_speed"]) {
         // Load auto_start_map from config file
         auto cruising_speed_yaml = timing_yaml["simulation"]["cruising_speed"];
-        std::map<std::string, double> cruising_speed_map;
+        std::map<uint32_t, double> cruising_speed_map;
         ROS_INFO("[Sim] cruising_speed:");
         for (auto cruising_speed_item: cruising_speed_yaml) {
             ROS_INFO_STREAM("[Sim] - " << cruising_speed_item);
-            auto icao = cruising_speed_item["icao"].as<std::string>();
+            auto icao = cruising_speed_item["icao"].as<uint32_t>();
             auto speed = cruising_speed_item["speed"].as<double>();
             cruising_speed_map[icao] = speed;
         }
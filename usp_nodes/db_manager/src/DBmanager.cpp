@@ -53,6 +53,7 @@ class DataBase {
     // Subscribers
 
     // Publisher
+    ros::Publisher geofence_updates_pub_;
 
     // Timer
 
@@ -95,6 +96,9 @@ DataBase::DataBase() : nh_(), pnh_("~") {
         dbsize_server_ = nh_.advertiseService("/gauss/db_size", &DataBase::returnDBsizeCB, this);
         write_tracking_server_ = nh_.advertiseService("/gauss/write_tracking", &DataBase::writeTrackingCB, this);
         write_plan_server_ = nh_.advertiseService("/gauss/write_plans", &DataBase::writePlansCB, this);
+        // Publish
+        // One update per geofence written, a bulk airspace write must not drop any
+        geofence_updates_pub_ = nh_.advertise<gauss_msgs::Geofence>("/gauss/geofence_updates", 1000);
     } else {
         if (!ok_json_geofences) ROS_ERROR("Geofences JSON does not exist!");
         if (!ok_json_operations) ROS_ERROR("Operations JSON does not exist!");
@@ -366,6 +370,8 @@ bool DataBase::writeGeofenceCB(gauss_msgs::WriteGeofences::Request &req, gauss_m
                 saved_geofences.insert(pair<int, gauss_msgs::Geofence>(req.geofences[i].id, req.geofences[i]));
             }
         }
+        // Nodes keeping geometry computed from geofences need to know they changed
+        geofence_updates_pub_.publish(req.geofences[i]);
     }
     res.success = true;
     size_plans = saved_geofences.size();
@@ -1,15 +1,52 @@
 #include <gauss_msgs/AirspaceUpdate.h>
-#include <gauss_msgs/NewDeconfliction.h>
+#include <gauss_msgs/AirspaceUpdateArray.h>
+#include <gauss_msgs/NewBatchDeconfliction.h>
 #include <gauss_msgs/NewThreat.h>
 #include <gauss_msgs/NewThreats.h>
 #include <gauss_msgs/Notifications.h>
 #include <gauss_msgs/PilotAnswer.h>
 #include <gauss_msgs/WriteGeofences.h>
+#include <gauss_msgs/threat_registry.h>
 #include <ros/ros.h>
 
 #include <Eigen/Eigen>
+#include <algorithm>
+#include <cctype>
+#include <condition_variable>
+#include <limits>
+#include <map>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <unordered_map>
+#include <vector>
 
-ros::ServiceClient tactical_client_, notification_client_, write_geofences_client_;
+ros::ServiceClient write_geofences_client_;
+// last_updated of every airspace written to the database, by airspace id
+std::unordered_map<std::string, uint64_t> written_airspaces_;
+// Threat waiting for the deconfliction workers, with the keys used to schedule it
+struct PendingThreat {
+    gauss_msgs::NewThreat threat;
+    double conflict_time;  // [s] When the conflict starts, the arrival time if unknown
+    int type_rank;         // Lower is more urgent for the same conflict time
+    int priority;          // Highest priority of the operations involved
+    uint64_t sequence;     // Arrival order
+    int conflict_id;       // Id of the conflict in deconflicted_threats_
+};
+std::vector<PendingThreat> pending_threats_;
+uint64_t pending_threats_sequence_ = 0;
+std::mutex pending_threats_mutex_;
+std::condition_variable pending_threats_cv_;
+bool shutting_down_ = false;
+size_t max_pending_threats_, max_threats_per_batch_;
+// Uavs of the batches being solved. Tactical solves every batch on its own, so a uav is only in one batch at a time
+// and two batches never get plans that conflict with each other. Guarded by pending_threats_mutex_
+std::set<int> busy_uavs_;
+// Threats queued or solved, so detections of the same conflict are not solved again. Threats dropped or not solved
+// are erased, so their next detection is deconflicted
+ThreatRegistry deconflicted_threats_;
+std::mutex deconflicted_threats_mutex_;
+double deconflicted_threat_timeout_;
 
 gauss_msgs::Threat translateToThreat(const gauss_msgs::NewThreat _threat) {
     gauss_msgs::Threat out_threat;
@@ -25,25 +62,16 @@ gauss_msgs::Threat translateToThreat(const gauss_msgs::NewThreat _threat) {
     return out_threat;
 }
 
-gauss_msgs::Notification selectBestSolution(const gauss_msgs::NewDeconfliction &_msg, const int &_uav_id) {
+gauss_msgs::Notification notificationFromPlan(const gauss_msgs::NewThreat &_threat, const gauss_msgs::DeconflictionPlan &_plan) {
     gauss_msgs::Notification out_solution;
-    double check_cost_risk = std::numeric_limits<double>::max();
-    for (auto possible_solution : _msg.response.deconfliction_plans) {
-        // If both UAV have the same priority, uav_id value is -1. We should check all the solutions.
-        // If not, just check solution for the UAV with less priority.
-        if ((possible_solution.uav_id == _uav_id || _uav_id == -1) && check_cost_risk >= (possible_solution.cost + possible_solution.riskiness)) {
-            out_solution.description = "";
-            out_solution.threat = translateToThreat(_msg.request.threat);
-            out_solution.uav_id = possible_solution.uav_id;
-            out_solution.action = possible_solution.maneuver_type;
-            out_solution.maneuver_type = possible_solution.maneuver_type;
-            out_solution.waypoints = possible_solution.waypoint_list;
-            out_solution.new_flight_plan.waypoints = possible_solution.waypoint_list;
-
-            check_cost_risk = possible_solution.cost + possible_solution.riskiness;
-        }
-    }
-    for (auto operation : _msg.request.threat.conflictive_operations) {
+    out_solution.description = "";
+    out_solution.threat = translateToThreat(_threat);
+    out_solution.uav_id = _plan.uav_id;
+    out_solution.action = _plan.maneuver_type;
+    out_solution.maneuver_type = _plan.maneuver_type;
+    out_solution.waypoints = _plan.waypoint_list;
+    out_solution.new_flight_plan.waypoints = _plan.waypoint_list;
+    for (auto operation : _threat.conflictive_operations) {
         if (operation.uav_id == out_solution.uav_id) {
             out_solution.actual_wp = operation.actual_wp;
             out_solution.current_wp = operation.current_wp;
@@ -54,23 +82,6 @@ gauss_msgs::Notification selectBestSolution(const gauss_msgs::NewDeconfliction &
     return out_solution;
 }
 
-int selectSmallerPriority(const gauss_msgs::NewThreat &_threat) {
-    int out_uav_id_priority;
-    int smaller_priority = std::numeric_limits<int>::max();
-    ROS_ERROR_COND(_threat.uav_ids.size() != _threat.priority_ops.size(), "[Emergency] Threat uav_ids size [%zd] should match priority_ops size [%zd]!", _threat.uav_ids.size(), _threat.priority_ops.size());
-    for (int idx = 0; idx < _threat.uav_ids.size(); idx++) {
-        if (smaller_priority > _threat.priority_ops.at(idx)) {
-            smaller_priority = _threat.priority_ops.at(idx);
-            out_uav_id_priority = _threat.uav_ids.at(idx);
-        } else if (smaller_priority == _threat.priority_ops.at(idx)) {
-            smaller_priority = _threat.priority_ops.at(idx);
-            out_uav_id_priority = -1;  // Both UAVs have the same priority, we should check all the posible solutions
-        }
-    }
-
-    return out_uav_id_priority;
-}
-
 gauss_msgs::Geofence geofenceFromThreat(const gauss_msgs::NewThreat &_threat) {
     gauss_msgs::Geofence out_geofence;
     out_geofence.circle.x_center = _threat.location.x;
@@ -86,60 +97,306 @@ gauss_msgs::Geofence geofenceFromThreat(const gauss_msgs::NewThreat &_threat) {
     return out_geofence;
 }
 
-void airspaceAlertCb(const gauss_msgs::AirspaceUpdate &_alert) {
-    gauss_msgs::Geofence aux_geofence;
+// False if the airspace id is not a whole number that fits a geofence id
+bool geofenceFromAirspace(const gauss_msgs::AirspaceUpdate &_alert, gauss_msgs::Geofence &_geofence) {
+    unsigned long id = 0;
+    size_t parsed = 0;
+    try {
+        id = std::stoul(_alert.id, &parsed);
+    } catch (const std::exception &error) {
+        parsed = 0;
+    }
+    // stoul also takes leading spaces and signs
+    if (parsed == 0 || parsed != _alert.id.size() || !std::isdigit(static_cast<unsigned char>(_alert.id.front())) || id > std::numeric_limits<uint8_t>::max()) {
+        ROS_WARN("[Emergency] Discarding airspace with invalid id [%s]", _alert.id.c_str());
+        return false;
+    }
+    _geofence.id = static_cast<uint8_t>(id);
+    _geofence.circle = _alert.circle;
+    _geofence.cylinder_shape = _alert.cylinder_shape;
+    _geofence.min_altitude = 0.0;
+    _geofence.max_altitude = 600.0;
+    _geofence.polygon = _alert.polygon;
+    _geofence.start_time.fromSec(_alert.date_effective / 1000);
+    _geofence.end_time.fromSec(_alert.last_updated / 1000 + 600);
+    return true;
+}
+
+// Only airspaces new or with a later last_updated than the one written are sent, all of them in a single
+// WriteGeofences. The database publishes the geofences written, so only those are recomputed downstream
+void writeAirspaces(const std::vector<gauss_msgs::AirspaceUpdate> &_alerts) {
+    // Latest version of every changed airspace in the set, by id
+    std::unordered_map<std::string, size_t> changed;
+    for (size_t i = 0; i < _alerts.size(); i++) {
+        auto written = written_airspaces_.find(_alerts[i].id);
+        if (written != written_airspaces_.end() && written->second >= _alerts[i].last_updated) continue;
+        auto it = changed.find(_alerts[i].id);
+        if (it == changed.end()) {
+            changed.emplace(_alerts[i].id, i);
+        } else if (_alerts[it->second].last_updated <= _alerts[i].last_updated) {
+            it->second = i;
+        }
+    }
+    if (changed.empty()) return;
+
+    // Different airspace ids can give the same geofence id ("7" and "07"), none of them is written
+    std::vector<std::pair<gauss_msgs::Geofence, const gauss_msgs::AirspaceUpdate *>> geofences;
+    std::map<uint8_t, int> geofence_id_count;
+    geofences.reserve(changed.size());
+    for (auto &item : changed) {
+        gauss_msgs::Geofence geofence;
+        if (!geofenceFromAirspace(_alerts[item.second], geofence)) continue;
+        geofence_id_count[geofence.id]++;
+        geofences.push_back(std::make_pair(geofence, &_alerts[item.second]));
+    }
+
     gauss_msgs::WriteGeofences write_geofences_msg;
-    aux_geofence.circle = _alert.circle;
-    aux_geofence.cylinder_shape = _alert.cylinder_shape;
-    aux_geofence.id = static_cast<uint8_t>(std::stoul(_alert.id));  // String -> int -> uint8_t
-    aux_geofence.min_altitude = 0.0;
-    aux_geofence.max_altitude = 600.0;
-    aux_geofence.polygon = _alert.polygon;
-    aux_geofence.start_time.fromSec(_alert.date_effective / 1000);
-    aux_geofence.end_time.fromSec(_alert.last_updated / 1000 + 600);
-    write_geofences_msg.request.geofence_ids.push_back(aux_geofence.id);
-    write_geofences_msg.request.geofences.push_back(aux_geofence);
+    std::vector<const gauss_msgs::AirspaceUpdate *> written_alerts;
+    write_geofences_msg.request.geofence_ids.reserve(geofences.size());
+    write_geofences_msg.request.geofences.reserve(geofences.size());
+    for (auto &item : geofences) {
+        if (geofence_id_count[item.first.id] > 1) {
+            ROS_WARN("[Emergency] Discarding airspace [%s], another airspace of the set is also geofence %d", item.second->id.c_str(), (int)item.first.id);
+            continue;
+        }
+        write_geofences_msg.request.geofence_ids.push_back(item.first.id);
+        write_geofences_msg.request.geofences.push_back(item.first);
+        written_alerts.push_back(item.second);
+    }
+    if (written_alerts.empty()) return;
 
-    if (!write_geofences_client_.call(write_geofences_msg)) ROS_WARN("[Emergency] Failed to call Database!");
+    if (!write_geofences_client_.call(write_geofences_msg) || !write_geofences_msg.response.success) {
+        ROS_WARN("[Emergency] Failed to call Database!");
+        return;
+    }
+    for (auto alert : written_alerts) written_airspaces_[alert->id] = alert->last_updated;
+    ROS_INFO("[Emergency] %zu of %zu airspaces written", written_alerts.size(), _alerts.size());
 }
 
-bool threatsCb(gauss_msgs::NewThreatsRequest &_req, gauss_msgs::NewThreatsResponse &_res) {
-    std::string cout_threats;
-    for (auto threat : _req.threats) {
-        cout_threats = cout_threats + " [" + std::to_string(threat.threat_id) + " " + std::to_string(threat.threat_type) + " |";
-        for (auto uav_id : threat.uav_ids) cout_threats = cout_threats + " " + std::to_string(uav_id);
-        cout_threats = cout_threats + "]";
+void airspaceAlertCb(const gauss_msgs::AirspaceUpdate &_alert) { writeAirspaces(std::vector<gauss_msgs::AirspaceUpdate>(1, _alert)); }
+
+void airspaceAlertsCb(const gauss_msgs::AirspaceUpdateArray &_alerts) { writeAirspaces(_alerts.updates); }
+
+double conflictTime(const gauss_msgs::NewThreat &_threat, double _now) {
+    double out_time;
+    predictedConflictTime(_threat, out_time);
+    for (auto time : _threat.times) out_time = std::min(out_time, time.toSec());
+    // Threats without times (jamming, battery, gnss...) are happening now
+    if (out_time == std::numeric_limits<double>::max()) out_time = _now;
+    return out_time;
+}
+
+int typeRank(const gauss_msgs::NewThreat &_threat) {
+    switch (_threat.threat_type) {
+        case gauss_msgs::NewThreat::JAMMING_ATTACK:
+        case gauss_msgs::NewThreat::SPOOFING_ATTACK:
+        case gauss_msgs::NewThreat::GEOFENCE_INTRUSION:
+        case gauss_msgs::NewThreat::LOSS_OF_SEPARATION:
+            return 0;
+        case gauss_msgs::NewThreat::LACK_OF_BATTERY:
+        case gauss_msgs::NewThreat::GNSS_DEGRADATION:
+            return 1;
+        case gauss_msgs::NewThreat::UAS_OUT_OV:
+            return 2;
+        default:
+            return 3;
     }
-    ROS_INFO_STREAM_COND(_req.threats.size() > 0, "[Emergency] Threats received: [id type | uav] " + cout_threats);
+}
+
+// Most urgent first: earliest conflict, then type, then operation priority, then arrival
+bool moreUrgent(const PendingThreat &_a, const PendingThreat &_b) {
+    if (_a.conflict_time != _b.conflict_time) return _a.conflict_time < _b.conflict_time;
+    if (_a.type_rank != _b.type_rank) return _a.type_rank < _b.type_rank;
+    if (_a.priority != _b.priority) return _a.priority > _b.priority;
+    return _a.sequence < _b.sequence;
+}
 
+void forgetThreats(const std::vector<gauss_msgs::NewThreat> &_threats) {
+    if (_threats.empty()) return;
+    std::lock_guard<std::mutex> lock(deconflicted_threats_mutex_);
+    for (auto threat : _threats) deconflicted_threats_.erase(threat);
+}
+
+// _conflict_ids are the ids given to the threats by deconflicted_threats_
+void enqueueThreats(const std::vector<gauss_msgs::NewThreat> &_threats, const std::vector<int> &_conflict_ids) {
+    double now = ros::Time::now().toSec();
+    std::unique_lock<std::mutex> lock(pending_threats_mutex_);
+    int superseded = 0;
+    for (size_t i = 0; i < _threats.size(); i++) {
+        const gauss_msgs::NewThreat &threat = _threats[i];
+        PendingThreat pending;
+        pending.threat = threat;
+        pending.conflict_time = conflictTime(threat, now);
+        pending.type_rank = typeRank(threat);
+        pending.priority = threat.priority_ops.empty() ? 0 : *std::max_element(threat.priority_ops.begin(), threat.priority_ops.end());
+        pending.sequence = pending_threats_sequence_++;
+        pending.conflict_id = _conflict_ids[i];
+        // A newer detection of the same conflict replaces the pending one, which is already stale. The registry tells
+        // apart conflicts with the same key (same uavs at different times), so its id is used instead of the key
+        auto it = std::find_if(pending_threats_.begin(), pending_threats_.end(), [&pending](const PendingThreat &_pending) { return _pending.conflict_id == pending.conflict_id; });
+        if (it != pending_threats_.end()) {
+            *it = pending;
+            superseded++;
+        } else {
+            pending_threats_.push_back(pending);
+        }
+    }
+    ROS_INFO_COND(superseded > 0, "[Emergency] %d pending threats superseded by newer detections", superseded);
+    // Keep the most urgent ones. The dropped ones are forgotten, so they are deconflicted if detected again
+    std::vector<gauss_msgs::NewThreat> dropped;
+    if (pending_threats_.size() > max_pending_threats_) {
+        std::sort(pending_threats_.begin(), pending_threats_.end(), moreUrgent);
+        for (size_t i = max_pending_threats_; i < pending_threats_.size(); i++) dropped.push_back(pending_threats_.at(i).threat);
+        pending_threats_.resize(max_pending_threats_);
+    }
+    ROS_WARN_COND(dropped.size() > 0, "[Emergency] Too many pending threats, %d least urgent dropped", (int)dropped.size());
+    pending_threats_cv_.notify_one();
+    lock.unlock();
+    forgetThreats(dropped);
+}
+
+// Must hold pending_threats_mutex_
+bool involvesBusyUav(const gauss_msgs::NewThreat &_threat) {
+    for (auto uav_id : _threat.uav_ids) {
+        if (busy_uavs_.count(uav_id) > 0) return true;
+    }
+    return false;
+}
+
+// Must hold pending_threats_mutex_
+bool anyThreatReady() {
+    return std::any_of(pending_threats_.begin(), pending_threats_.end(), [](const PendingThreat &_pending) { return !involvesBusyUav(_pending.threat); });
+}
+
+// Blocks until there are pending threats whose uavs are not in other batches, takes the most urgent ones up to
+// max_threats_per_batch_ and marks their uavs busy until releaseThreats. False on shutdown
+bool takeThreats(std::vector<gauss_msgs::NewThreat> &_threats) {
+    _threats.clear();
+    std::unique_lock<std::mutex> lock(pending_threats_mutex_);
+    pending_threats_cv_.wait(lock, [] { return shutting_down_ || anyThreatReady(); });
+    if (shutting_down_) return false;
+    std::sort(pending_threats_.begin(), pending_threats_.end(), moreUrgent);
+    std::vector<PendingThreat> waiting;
+    for (auto &pending : pending_threats_) {
+        if (_threats.size() < max_threats_per_batch_ && !involvesBusyUav(pending.threat)) {
+            _threats.push_back(pending.threat);
+        } else {
+            waiting.push_back(pending);
+        }
+    }
+    pending_threats_.swap(waiting);
+    // After the selection, threats sharing uavs with each other can go in the same batch
+    for (auto threat : _threats) busy_uavs_.insert(threat.uav_ids.begin(), threat.uav_ids.end());
+    // Wake another worker if some are ready
+    if (anyThreatReady()) pending_threats_cv_.notify_one();
+    return true;
+}
+
+// The batch is solved, its uavs can go in other batches
+void releaseThreats(const std::vector<gauss_msgs::NewThreat> &_threats) {
+    {
+        std::lock_guard<std::mutex> lock(pending_threats_mutex_);
+        for (auto threat : _threats) {
+            for (auto uav_id : threat.uav_ids) busy_uavs_.erase(uav_id);
+        }
+    }
+    // Threats waiting for these uavs may be ready now
+    pending_threats_cv_.notify_all();
+}
+
+void processThreats(const std::vector<gauss_msgs::NewThreat> &_threats, ros::ServiceClient &_tactical_client, ros::ServiceClient &_notification_client, ros::ServiceClient &_write_geofences_client) {
     gauss_msgs::Notifications notifications_msg;
     gauss_msgs::WriteGeofences write_geo_msg;
-    for (auto threat : _req.threats) {
+    gauss_msgs::NewBatchDeconfliction tactical_msg;
+    for (auto threat : _threats) {
         if (threat.threat_type == threat.GEOFENCE_CONFLICT || threat.threat_type == threat.GEOFENCE_INTRUSION ||
             threat.threat_type == threat.GNSS_DEGRADATION || threat.threat_type == threat.LACK_OF_BATTERY ||
             threat.threat_type == threat.LOSS_OF_SEPARATION || threat.threat_type == threat.UAS_OUT_OV) {
-            // Call tactical
-            gauss_msgs::NewDeconfliction tactical_msg;
-            tactical_msg.request.threat = threat;
-            if (tactical_client_.call(tactical_msg)) {
-                int uav_id_smaller_priority = threat.uav_ids.front();
-                if (threat.threat_type == threat.LOSS_OF_SEPARATION) uav_id_smaller_priority = selectSmallerPriority(threat);  // Get the UAV id with less priority
-                notifications_msg.request.notifications.push_back(selectBestSolution(tactical_msg, uav_id_smaller_priority));
-            } else {
-                ROS_WARN("[Emergency] Failed to call tactical deconfliction!");
-            }
+            tactical_msg.request.threats.push_back(threat);
         }
         if (threat.threat_type == threat.JAMMING_ATTACK || threat.threat_type == threat.SPOOFING_ATTACK) {
             write_geo_msg.request.geofence_ids.push_back(static_cast<uint8_t>(threat.threat_id));
             write_geo_msg.request.geofences.push_back(geofenceFromThreat(threat));
         }
     }
-    if (notifications_msg.request.notifications.size() > 0) {
-        if(!notification_client_.call(notifications_msg)) ROS_WARN("[Emergency] Failed to call USP manager!");
-    } 
+    // Threats not solved, forgotten so their next detection is deconflicted again
+    std::vector<gauss_msgs::NewThreat> unsolved;
+    // Geofences do not wait for the deconfliction
     if (write_geo_msg.request.geofences.size() > 0) {
-        if(!write_geofences_client_.call(write_geo_msg)) ROS_WARN("[Emergency] Failed to call Database!");
+        if (!_write_geofences_client.call(write_geo_msg)) {
+            ROS_WARN("[Emergency] Failed to call Database!");
+            for (auto threat : _threats) {
+                if (threat.threat_type == threat.JAMMING_ATTACK || threat.threat_type == threat.SPOOFING_ATTACK) unsolved.push_back(threat);
+            }
+        }
+    }
+    // Call tactical once for all the threats, so coupled threats get plans that do not conflict with each other
+    std::vector<bool> notified(tactical_msg.request.threats.size(), false);
+    if (tactical_msg.request.threats.size() > 0) {
+        if (_tactical_client.call(tactical_msg)) {
+            for (int i = 0; i < tactical_msg.response.deconfliction_plans.size(); i++) {
+                int threat_index = tactical_msg.response.threat_indexes.at(i);
+                const gauss_msgs::NewThreat &threat = tactical_msg.request.threats.at(threat_index);
+                notifications_msg.request.notifications.push_back(notificationFromPlan(threat, tactical_msg.response.deconfliction_plans.at(i)));
+                notified.at(threat_index) = true;
+            }
+        } else {
+            ROS_WARN("[Emergency] Failed to call tactical deconfliction!");
+        }
     }
+    if (notifications_msg.request.notifications.size() > 0) {
+        if (!_notification_client.call(notifications_msg)) {
+            ROS_WARN("[Emergency] Failed to call USP manager!");
+            notified.assign(notified.size(), false);
+        }
+    }
+    for (int i = 0; i < notified.size(); i++) {
+        if (!notified.at(i)) unsolved.push_back(tactical_msg.request.threats.at(i));
+    }
+    ROS_WARN_COND(unsolved.size() > 0, "[Emergency] %d threats not solved, they are deconflicted again if detected", (int)unsolved.size());
+    forgetThreats(unsolved);
+}
+
+void deconflictionWorker(const std::string &_tactical_url, const std::string &_notifications_url, const std::string &_write_geofences_url) {
+    // Each worker has its own clients, so their calls run concurrently
+    ros::NodeHandle nh;
+    ros::ServiceClient tactical_client = nh.serviceClient<gauss_msgs::NewBatchDeconfliction>(_tactical_url);
+    ros::ServiceClient notification_client = nh.serviceClient<gauss_msgs::Notifications>(_notifications_url);
+    ros::ServiceClient write_geofences_client = nh.serviceClient<gauss_msgs::WriteGeofences>(_write_geofences_url);
+    std::vector<gauss_msgs::NewThreat> threats;
+    while (takeThreats(threats)) {
+        processThreats(threats, tactical_client, notification_client, write_geofences_client);
+        releaseThreats(threats);
+    }
+}
+
+bool threatsCb(gauss_msgs::NewThreatsRequest &_req, gauss_msgs::NewThreatsResponse &_res) {
+    std::string cout_threats;
+    for (auto threat : _req.threats) {
+        cout_threats = cout_threats + " [" + std::to_string(threat.threat_id) + " " + std::to_string(threat.threat_type) + " |";
+        for (auto uav_id : threat.uav_ids) cout_threats = cout_threats + " " + std::to_string(uav_id);
+        cout_threats = cout_threats + "]";
+    }
+    ROS_INFO_STREAM_COND(_req.threats.size() > 0, "[Emergency] Threats received: [id type | uav] " + cout_threats);
+
+    // Only new or materially changed conflicts are deconflicted
+    std::vector<gauss_msgs::NewThreat> changed_threats;
+    std::vector<int> conflict_ids;
+    ros::Time now = ros::Time::now();
+    {
+        std::lock_guard<std::mutex> lock(deconflicted_threats_mutex_);
+        for (auto threat : _req.threats) {
+            ThreatUpdate update = deconflicted_threats_.update(threat, now);
+            if (update.transition == ThreatTransition::UNCHANGED) continue;
+            changed_threats.push_back(threat);
+            conflict_ids.push_back(update.threat_id);
+        }
+        deconflicted_threats_.resolveNotSeenSince(now - ros::Duration(deconflicted_threat_timeout_));
+    }
+    ROS_INFO_COND(changed_threats.size() < _req.threats.size(), "[Emergency] %d threats already deconflicted", (int)(_req.threats.size() - changed_threats.size()));
+
+    // Monitoring does not wait for the deconfliction, the workers solve the threats and notify the solutions
+    if (changed_threats.size() > 0) enqueueThreats(changed_threats, conflict_ids);
     _res.success = true;
     return _res.success;
 }
@@ -149,16 +406,26 @@ int main(int argc, char **argv) {
 
     ros::NodeHandle nh;
 
+    int deconfliction_workers;
+    nh.param("deconfliction_workers", deconfliction_workers, 2);
+    int max_pending_threats, max_threats_per_batch;
+    nh.param("max_pending_threats", max_pending_threats, 200);
+    nh.param("max_threats_per_batch", max_threats_per_batch, 20);
+    nh.param("deconflicted_threat_timeout", deconflicted_threat_timeout_, 10.0);
+    deconfliction_workers = std::max(deconfliction_workers, 1);
+    max_pending_threats_ = std::max(max_pending_threats, 1);
+    max_threats_per_batch_ = std::max(max_threats_per_batch, 1);
+
     auto threats_srv_url = "/gauss/new_threats";
     auto airspace_sub_url = "/gauss/airspace_alert";
+    auto airspaces_sub_url = "/gauss/airspace_alerts";
     auto notifications_clt_url = "/gauss/notifications";
-    auto tactical_clt_url = "/gauss/new_tactical_deconfliction";
+    auto tactical_clt_url = "/gauss/new_tactical_batch_deconfliction";
     auto write_geofences_clt_utl = "/gauss/write_geofences";
 
     ros::Subscriber airspace_sub = nh.subscribe(airspace_sub_url, 10, airspaceAlertCb);
+    ros::Subscriber airspaces_sub = nh.subscribe(airspaces_sub_url, 1, airspaceAlertsCb);
     ros::ServiceServer threats_server = nh.advertiseService(threats_srv_url, threatsCb);
-    notification_client_ = nh.serviceClient<gauss_msgs::Notifications>(notifications_clt_url);
-    tactical_client_ = nh.serviceClient<gauss_msgs::NewDeconfliction>(tactical_clt_url);
     write_geofences_client_ = nh.serviceClient<gauss_msgs::WriteGeofences>(write_geofences_clt_utl);
 
     ROS_INFO("[Emergency] Waiting for required services...");
@@ -167,12 +434,18 @@ int main(int argc, char **argv) {
     ros::service::waitForService(tactical_clt_url, -1);
     ROS_INFO("[Emergency] %s: ok", tactical_clt_url);
 
-    ros::Rate rate(1);  // [Hz]
-    while (ros::ok()) {
-        ros::spinOnce();
-        rate.sleep();
-    }
+    // Deconfliction requests in flight are bounded by the number of workers
+    std::vector<std::thread> workers;
+    for (int i = 0; i < deconfliction_workers; i++) workers.push_back(std::thread(deconflictionWorker, tactical_clt_url, notifications_clt_url, write_geofences_clt_utl));
 
+    // Threats are only queued here, so the service answers as soon as it is called
     ros::spin();
+
+    {
+        std::lock_guard<std::mutex> lock(pending_threats_mutex_);
+        shutting_down_ = true;
+    }
+    pending_threats_cv_.notify_all();
+    for (auto &worker : workers) worker.join();
     return 0;
 }
@@ -4,6 +4,7 @@
 #include <gauss_msgs/ReadOperation.h>
 #include <gauss_msgs/ReadGeofences.h>
 #include <gauss_msgs/Waypoint.h>
+#include <gauss_msgs/threat_registry.h>
 #include <geometry_msgs/Vector3.h>
 #include <ros/ros.h>
 #include <visualization_msgs/Marker.h>
@@ -446,14 +447,6 @@ struct LossResult {
     int second_trajectory_index;
     std::vector<LossConflictiveSegments> loss_conflictive_segments;
 
-    bool isEqual(const LossResult& other) {
-        const float check_time_margin = 10.0;  // [s]
-        return (first_trajectory_index == other.first_trajectory_index && second_trajectory_index == other.second_trajectory_index) &&
-               (std::abs(loss_conflictive_segments.front().t_crossing_0 - other.loss_conflictive_segments.front().t_crossing_0) <= check_time_margin ||
-                std::abs(loss_conflictive_segments.front().t_crossing_1 - other.loss_conflictive_segments.front().t_crossing_1) <= check_time_margin ||
-                std::abs(loss_conflictive_segments.back().t_crossing_0 - other.loss_conflictive_segments.back().t_crossing_0) <= check_time_margin ||
-                std::abs(loss_conflictive_segments.back().t_crossing_1 - other.loss_conflictive_segments.back().t_crossing_1) <= check_time_margin);
-    }
     gauss_msgs::NewThreat convertToThreat(const std::map<int, gauss_msgs::Operation>& _index_to_operation_map, double& count_id) {
         gauss_msgs::NewThreat out_threat;
         out_threat.threat_id = count_id++;
@@ -486,14 +479,6 @@ struct GeoConflictiveTrajectory {
     int trajectory_index;
     std::vector<Segment> geofence_conflictive_segments;
     gauss_msgs::Waypoint closest_exit_wp;  // Use the mandatory field as intrusion flag
-
-    bool isEqual(const GeoConflictiveTrajectory& other) {
-        const double check_time_margin = 10.0;
-        return (trajectory_index == other.trajectory_index &&
-                closest_exit_wp.mandatory == other.closest_exit_wp.mandatory &&
-               (geofence_conflictive_segments.front().t_A - other.geofence_conflictive_segments.front().t_A <= check_time_margin ||
-                geofence_conflictive_segments.back().t_B - other.geofence_conflictive_segments.back().t_B <= check_time_margin));
-    }
 };
 
 struct GeofenceResult {
@@ -501,18 +486,6 @@ struct GeofenceResult {
     int geofence_id;
     std::vector<GeoConflictiveTrajectory> geo_conflictive_trajectories;
     
-    bool isEqual(const GeofenceResult& other) {
-        const float check_time_margin = 10.0;  // [s]
-        if (geofence_id != other.geofence_id) {
-            return false;
-        } else {
-            for (auto geo_trajectory : geo_conflictive_trajectories) {
-                std::vector<GeoConflictiveTrajectory>::const_iterator traj_it = std::find_if(other.geo_conflictive_trajectories.begin(), other.geo_conflictive_trajectories.end(),
-                                                                                             [geo_trajectory](GeoConflictiveTrajectory _traj) { return _traj.isEqual(geo_trajectory);});
-                return (traj_it != other.geo_conflictive_trajectories.end());
-            }
-        }
-    }
     std::vector<gauss_msgs::NewThreat> convertToThreat(const std::map<int, gauss_msgs::Operation>& _index_to_operation_map, const std::map<int, gauss_msgs::Geofence>& _index_to_geofence_map, double& count_id) {
         std::vector<gauss_msgs::NewThreat> out_threats;
         for (auto geo_conflictive_trajectory : geo_conflictive_trajectories) {
@@ -666,71 +639,28 @@ bool happensBefore(const LossResult& a, const LossResult& b) {
     return a.loss_conflictive_segments[0].t_crossing_0 < b.loss_conflictive_segments[0].t_crossing_0;
 }
 
-void cleanStoredList(std::vector<LossResult>& _stored_loss_result_list, std::vector<GeofenceResult>& _stored_geofence_result_list, const std::vector<LossResult>& _actual_loss_result_list, const std::vector<GeofenceResult>& _actual_geofence_result_list, const double& _check_time_margin) {
-    if (_actual_loss_result_list.size() == 0) {
-        _stored_loss_result_list.clear();
-    } else {
-        for (auto _stored_result = _stored_loss_result_list.begin(); _stored_result != _stored_loss_result_list.end();) {
-            std::vector<LossResult>::const_iterator actual_it = std::find_if(_actual_loss_result_list.begin(), _actual_loss_result_list.end(),
-                                                                             [_stored_result](LossResult _actual_result) { return _actual_result.isEqual(*_stored_result); });
-            bool do_erase = (actual_it == _actual_loss_result_list.end());
-            if (do_erase) {
-                _stored_result = _stored_loss_result_list.erase(_stored_result);
-            } else {
-                _stored_result++;
-            }
-        }
-    }
-}
-
-gauss_msgs::NewThreats manageResultList(std::vector<LossResult>& _loss_result_list, std::vector<GeofenceResult>& _geofence_result_list, const std::map<int, gauss_msgs::Operation>& _index_to_operation_map, const std::map<int, gauss_msgs::Geofence>& _index_to_geofence_map) {
-    double check_time_margin = 10.0;
-    static double threat_count_id = 0;
-    static double stored_loss_id_count = 0;
-    static double stored_geofence_id_count = 0;
+// Only conflicts not sent before, or materially changed, are sent again, but for a resend of the unchanged ones every
+// _resend_period. Conflicts not found in this cycle are solved
+gauss_msgs::NewThreats manageResultList(std::vector<LossResult>& _loss_result_list, std::vector<GeofenceResult>& _geofence_result_list, const std::map<int, gauss_msgs::Operation>& _index_to_operation_map, const std::map<int, gauss_msgs::Geofence>& _index_to_geofence_map, double _resend_period) {
+    static ThreatRegistry threat_registry;
+    threat_registry.setResendPeriod(_resend_period);
+    static double threat_count_id = 0;  // Replaced by the id of the tracked conflict
     gauss_msgs::NewThreats out_threats;
-    static std::vector<LossResult> stored_loss_result_list;
-    static std::vector<GeofenceResult> stored_geofence_result_list;
-
-    if (stored_loss_result_list.size() > 0 || stored_geofence_result_list.size() > 0) cleanStoredList(stored_loss_result_list, stored_geofence_result_list, _loss_result_list, _geofence_result_list, check_time_margin);
-    if (_loss_result_list.size() > 0) {
-        if (stored_loss_result_list.size() == 0) {
-            stored_loss_result_list.push_back(_loss_result_list.front());
-            out_threats.request.threats.push_back(_loss_result_list[0].convertToThreat(_index_to_operation_map, threat_count_id));
-        } else {
-            for (auto _loss_result : _loss_result_list) {
-                bool save_loss_result = false;
-                // Using lambda, check if both trajectory index of _loss_result are in stored_loss_result_list
-                std::vector<LossResult>::iterator stored_it = std::find_if(stored_loss_result_list.begin(), stored_loss_result_list.end(),
-                                                                           [_loss_result](LossResult stored_loss_result) { return stored_loss_result.isEqual(_loss_result); });
-                save_loss_result = (stored_it == stored_loss_result_list.end());
-                if (save_loss_result) {
-                    stored_loss_result_list.push_back(_loss_result);
-                    out_threats.request.threats.push_back(_loss_result.convertToThreat(_index_to_operation_map, threat_count_id));
-                }
-            }
-        }
+    std::vector<gauss_msgs::NewThreat> detected_threats;
+    for (auto loss_result : _loss_result_list) detected_threats.push_back(loss_result.convertToThreat(_index_to_operation_map, threat_count_id));
+    for (auto geofence_result : _geofence_result_list) {
+        std::vector<gauss_msgs::NewThreat> aux_vec = geofence_result.convertToThreat(_index_to_operation_map, _index_to_geofence_map, threat_count_id);
+        detected_threats.insert(detected_threats.end(), aux_vec.begin(), aux_vec.end());
     }
-    if (_geofence_result_list.size() > 0) {
-        if (stored_geofence_result_list.size() == 0) {
-            stored_geofence_result_list.push_back(_geofence_result_list.front());
-            std::vector<gauss_msgs::NewThreat> aux_vec = _geofence_result_list[0].convertToThreat(_index_to_operation_map, _index_to_geofence_map, threat_count_id);
-            out_threats.request.threats.insert(out_threats.request.threats.end(), aux_vec.begin(), aux_vec.end());
-        } else {
-            for (auto _geofence_result : _geofence_result_list) {
-                bool save_geofence_result = false;
-                // Using lambda, check if both trajectory index of _geofence_result are in stored_geofence_result_list
-                std::vector<GeofenceResult>::iterator stored_it = std::find_if(stored_geofence_result_list.begin(), stored_geofence_result_list.end(),
-                                                                               [_geofence_result](GeofenceResult stored_loss_result) { return stored_loss_result.isEqual(_geofence_result); });
-                save_geofence_result = (stored_it == stored_geofence_result_list.end());
-                if (save_geofence_result) {
-                    stored_geofence_result_list.push_back(_geofence_result);
-                    std::vector<gauss_msgs::NewThreat> aux_vec = _geofence_result.convertToThreat(_index_to_operation_map, _index_to_geofence_map, threat_count_id);
-                    out_threats.request.threats.insert(out_threats.request.threats.end(), aux_vec.begin(), aux_vec.end());
-                }
-            }
-        }
+
+    ros::Time now = ros::Time::now();
+    for (auto threat : detected_threats) {
+        ThreatUpdate update = threat_registry.update(threat, now);
+        if (update.transition == ThreatTransition::UNCHANGED) continue;
+        threat.threat_id = update.threat_id;
+        out_threats.request.threats.push_back(threat);
     }
+    threat_registry.resolveNotSeenSince(now);
 
     return out_threats;
 }
@@ -946,6 +876,9 @@ int main(int argc, char** argv) {
     bool just_one_threat;
     n.param("safetyDistance", safety_distance, 10.0);
     n.param("just_one_threat", just_one_threat, false);
+    // Threats still detected are sent again after this time, so emergency management retries the ones it could not solve [s]
+    double threat_resend_period;
+    n.param("threat_resend_period", threat_resend_period, 5.0);
     double safety_distance_sq = pow(safety_distance, 2);
 
     auto read_icao_srv_url = "/gauss/read_icao";
@@ -1085,7 +1018,7 @@ int main(int argc, char** argv) {
         std::sort(loss_results_list.begin(), loss_results_list.end(), happensBefore);
         gauss_msgs::NewThreats threats_msg;
         if (just_one_threat && (loss_results_list.size() > 0 || geofence_results_list.size() > 0)) {
-            threats_msg = manageResultList(loss_results_list, geofence_results_list, index_to_operation_map, index_to_geofence_map);
+            threats_msg = manageResultList(loss_results_list, geofence_results_list, index_to_operation_map, index_to_geofence_map, threat_resend_period);
             just_one_threat = false;
         }
         if (threats_msg.request.threats.size() > 0) {
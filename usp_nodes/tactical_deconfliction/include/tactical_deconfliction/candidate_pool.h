@@ -0,0 +1,84 @@
+//----------------------------------------------------------------------------------------------------------------------
+// The MIT License (MIT)
+//
+// Copyright (c) 2018 GRVC University of Seville
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+// documentation files (the "Software"), to deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies or substantial portions of the
+// Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+// WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS
+// OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+// OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//----------------------------------------------------------------------------------------------------------------------
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#ifndef CANDIDATE_POOL_H
+#define CANDIDATE_POOL_H
+
+// Fixed number of workers building deconfliction candidates. A task not started before its deadline is discarded
+// without running, nobody waits for its result anymore. Destroying the pool waits for the tasks running
+class CandidatePool {
+   public:
+    CandidatePool(size_t _workers) : stopping_(false) {
+        if (_workers == 0) _workers = 1;
+        for (size_t i = 0; i < _workers; i++) workers_.push_back(std::thread(&CandidatePool::work, this));
+    }
+
+    ~CandidatePool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stopping_ = true;
+        }
+        cv_.notify_all();
+        for (auto &worker : workers_) worker.join();
+    }
+
+    void submit(std::function<void()> _task, std::chrono::steady_clock::time_point _deadline) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            tasks_.push_back(Task{_task, _deadline});
+        }
+        cv_.notify_one();
+    }
+
+   private:
+    struct Task {
+        std::function<void()> run;
+        std::chrono::steady_clock::time_point deadline;
+    };
+
+    void work() {
+        while (true) {
+            Task task;
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                cv_.wait(lock, [this] { return stopping_ || !tasks_.empty(); });
+                if (stopping_) return;
+                task = tasks_.front();
+                tasks_.pop_front();
+            }
+            if (std::chrono::steady_clock::now() < task.deadline) task.run();
+        }
+    }
+
+    std::vector<std::thread> workers_;
+    std::deque<Task> tasks_;
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    bool stopping_;
+};
+
+#endif  // CANDIDATE_POOL_H
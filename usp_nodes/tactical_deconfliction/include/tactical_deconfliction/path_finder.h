@@ -22,12 +22,17 @@
 #include <nav_msgs/Path.h>
 #include <ros/ros.h>
 #include <path_planner.h>
+#include <tactical_deconfliction/path_repair_cache.h>
+#include <tactical_deconfliction/planner_grid_cache.h>
 
 #include <Eigen/Eigen>
+#include <chrono>
 
 #ifndef PATH_FINDER_H
 #define PATH_FINDER_H
 
+#define MAX_GENERATED_WPS 10000  // Default cap of the number of waypoints of generatePath
+
 class PathFinder {
    public:
     PathFinder();
@@ -35,15 +40,25 @@ class PathFinder {
     ~PathFinder();
 
     nav_msgs::Path findNewPath();
+    // Reuse the planner grids of _grid_cache in findNewPath. The polygon is the geofence _geofence_id inflated by _inflation
+    void setGridCache(PlannerGridCache *_grid_cache, int _geofence_id, double _inflation);
+    // Repair the previous solution of _uav_id for the same geofence (set with setGridCache) instead of searching again
+    void setRepairCache(PathRepairCache *_repair_cache, int _uav_id);
+    // findNewPath gives up, returning an empty path, if the deadline is reached before rasterizing the grid or while
+    // waiting for a cached planner busy with another search
+    void setDeadline(const std::chrono::steady_clock::time_point &_deadline) { deadline_ = _deadline; }
     int nearestNeighbourIndex(std::vector<double> &_x, double &_value);
     std::vector<double> interpWaypointList(std::vector<double> &_list_pose_axis, int _amount_of_points);
     std::vector<double> linealInterp1(std::vector<double> &_x, std::vector<double> &_y, std::vector<double> &_x_new);
-    nav_msgs::Path generatePath(nav_msgs::Path &_init_path, int _generator_mode = 0, double _d_between_wps = 0.01);
+    // Resample a path every _d_between_wps meters along its length. If that gives more than _max_wps waypoints,
+    // the distance between them is increased to keep _max_wps waypoints (a non positive _max_wps means no cap)
+    nav_msgs::Path generatePath(nav_msgs::Path &_init_path, int _generator_mode = 0, double _d_between_wps = 0.01, int _max_wps = MAX_GENERATED_WPS);
 
 
    private:
     // Callbacks
     // Methods
+    std::shared_ptr<grvc::PathPlanner> createPlanner(int _max_grid_side);
     nav_msgs::Path createPathFromPlanner(std::vector<geometry_msgs::Point> &_in_path, geometry_msgs::Point _init_p, double _path_height);
     // Node handlers
     ros::NodeHandle nh_, pnh_;
@@ -51,10 +66,16 @@ class PathFinder {
     // Publishers
     // Services
     // Variables
-    nav_msgs::Path init_path_, target_path_, a_star_path_;
+    nav_msgs::Path init_path_, a_star_path_;
     geometry_msgs::Point init_astar_point_, goal_astar_point_;
     geometry_msgs::Polygon polygon_;
     double x_min_, y_min_, x_max_, y_max_;
+    PlannerGridCache *grid_cache_;
+    PathRepairCache *repair_cache_;
+    int uav_id_;
+    int geofence_id_;
+    double inflation_;
+    std::chrono::steady_clock::time_point deadline_;
     // Params
 };
 
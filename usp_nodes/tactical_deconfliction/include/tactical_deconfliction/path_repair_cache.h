@@ -0,0 +1,204 @@
+//----------------------------------------------------------------------------------------------------------------------
+// The MIT License (MIT)
+//
+// Copyright (c) 2018 GRVC University of Seville
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+// documentation files (the "Software"), to deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies or substantial portions of the
+// Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+// WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS
+// OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+// OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//----------------------------------------------------------------------------------------------------------------------
+
+#include <geometry_msgs/Point.h>
+#include <geometry_msgs/Polygon.h>
+#include <tactical_deconfliction/planner_grid_cache.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <map>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#ifndef PATH_REPAIR_CACHE_H
+#define PATH_REPAIR_CACHE_H
+
+// Last A* solution of each (uav, geofence) pair. When the same threat is deconflicted again the uav has usually
+// advanced a few meters along the previous alternative, so instead of searching again the previous solution is
+// repaired: the uav joins it at the point closest to its new position and the goal is moved to the new one. The
+// repair is only accepted if the obstacle is the same and the new connections do not cross it, otherwise a new search
+// is needed. Solutions of a geofence written again are discarded, and only the max_entries used last are kept.
+class PathRepairCache {
+   public:
+    PathRepairCache(double _max_repair_distance = 20.0, size_t _max_entries = 64)
+        : max_repair_distance_(_max_repair_distance), max_entries_(_max_entries), use_counter_(0), repairs_(0), searches_(0) {}
+
+    void setMaxRepairDistance(double _max_repair_distance) { max_repair_distance_ = _max_repair_distance; }
+
+    // Repair the stored solution for a new start and goal. Returns false if a new search is needed
+    bool repair(int _uav_id, int _geofence_id, const geometry_msgs::Polygon &_obstacle, const geometry_msgs::Point &_start,
+                const geometry_msgs::Point &_goal, std::vector<geometry_msgs::Point> &_path) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = solutions_.find(std::make_pair(_uav_id, _geofence_id));
+        if (it == solutions_.end() || !samePolygon(it->second.obstacle, _obstacle) || it->second.path.size() < 2 ||
+            distance2D(it->second.goal, _goal) > max_repair_distance_) {
+            searches_++;
+            return false;
+        }
+        it->second.last_use = ++use_counter_;
+        const std::vector<geometry_msgs::Point> &previous_path = it->second.path;
+
+        // Closest point of the previous path to the new start. Not checked to be ahead of the uav: the path starts at
+        // the previous start, and a join point behind it is just a short detour back to the path
+        double min_distance = std::numeric_limits<double>::max();
+        size_t join_segment = 0;
+        geometry_msgs::Point join_point;
+        for (size_t i = 0; i + 1 < previous_path.size(); i++) {
+            geometry_msgs::Point projection = projectOnSegment(_start, previous_path[i], previous_path[i + 1]);
+            double distance = distance2D(_start, projection);
+            if (distance < min_distance) {
+                min_distance = distance;
+                join_segment = i;
+                join_point = projection;
+            }
+        }
+        if (min_distance > max_repair_distance_) {
+            searches_++;
+            return false;
+        }
+
+        // Same format as the planner output: the start is not included, the goal is the last point
+        std::vector<geometry_msgs::Point> repaired_path;
+        if (distance2D(_start, join_point) > 0) repaired_path.push_back(join_point);
+        for (size_t i = join_segment + 1; i + 1 < previous_path.size(); i++) repaired_path.push_back(previous_path[i]);
+        if (!repaired_path.empty() && distance2D(repaired_path.back(), _goal) == 0) repaired_path.pop_back();
+        const geometry_msgs::Point &before_goal = repaired_path.empty() ? _start : repaired_path.back();
+        if (segmentCrossesPolygon(_start, repaired_path.empty() ? _goal : repaired_path.front(), _obstacle) ||
+            segmentCrossesPolygon(before_goal, _goal, _obstacle)) {
+            searches_++;
+            return false;
+        }
+        repaired_path.push_back(_goal);
+        _path = repaired_path;
+        it->second.goal = _goal;
+        it->second.path = _path;
+        it->second.path.insert(it->second.path.begin(), _start);
+        repairs_++;
+        return true;
+    }
+
+    // Store a new solution, as given by the planner (without the start)
+    void store(int _uav_id, int _geofence_id, const geometry_msgs::Polygon &_obstacle, const geometry_msgs::Point &_start,
+               const geometry_msgs::Point &_goal, const std::vector<geometry_msgs::Point> &_path) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        Solution &solution = solutions_[std::make_pair(_uav_id, _geofence_id)];
+        solution.obstacle = _obstacle;
+        solution.goal = _goal;
+        solution.path.clear();
+        solution.path.push_back(_start);
+        solution.path.insert(solution.path.end(), _path.begin(), _path.end());
+        solution.last_use = ++use_counter_;
+        if (solutions_.size() > max_entries_) {
+            // Drop the least recently used solution, its uav is likely not in conflict anymore
+            auto oldest = solutions_.begin();
+            for (auto it = solutions_.begin(); it != solutions_.end(); ++it) {
+                if (it->second.last_use < oldest->second.last_use) oldest = it;
+            }
+            solutions_.erase(oldest);
+        }
+    }
+
+    // Discard the solutions around a geofence, e.g. when it is written again
+    void invalidate(int _geofence_id) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (auto it = solutions_.begin(); it != solutions_.end();) {
+            if (it->first.second == _geofence_id) {
+                it = solutions_.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+
+    size_t size() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return solutions_.size();
+    }
+
+    uint64_t repairs() const { return repairs_; }
+    uint64_t searches() const { return searches_; }
+
+   private:
+    struct Solution {
+        geometry_msgs::Polygon obstacle;
+        geometry_msgs::Point goal;
+        std::vector<geometry_msgs::Point> path;  // Starting at the start point
+        uint64_t last_use;
+    };
+
+    static double distance2D(const geometry_msgs::Point &_a, const geometry_msgs::Point &_b) {
+        return sqrt(pow(_a.x - _b.x, 2) + pow(_a.y - _b.y, 2));
+    }
+
+    static geometry_msgs::Point projectOnSegment(const geometry_msgs::Point &_p, const geometry_msgs::Point &_a, const geometry_msgs::Point &_b) {
+        double dx = _b.x - _a.x;
+        double dy = _b.y - _a.y;
+        double squared_length = dx * dx + dy * dy;
+        double t = squared_length > 0 ? ((_p.x - _a.x) * dx + (_p.y - _a.y) * dy) / squared_length : 0.0;
+        t = std::min(std::max(t, 0.0), 1.0);
+        geometry_msgs::Point projection = _a;
+        projection.x = _a.x + t * dx;
+        projection.y = _a.y + t * dy;
+        return projection;
+    }
+
+    static double cross(double _ax, double _ay, double _bx, double _by, double _cx, double _cy) {
+        return (_bx - _ax) * (_cy - _ay) - (_by - _ay) * (_cx - _ax);
+    }
+
+    static bool segmentCrossesPolygon(const geometry_msgs::Point &_a, const geometry_msgs::Point &_b, const geometry_msgs::Polygon &_polygon) {
+        int n = _polygon.points.size();
+        if (n < 3) return false;
+        // Any end inside the polygon
+        for (const geometry_msgs::Point *p : {&_a, &_b}) {
+            bool inside = false;
+            for (int i = 0, j = n - 1; i < n; j = i++) {
+                const geometry_msgs::Point32 &vi = _polygon.points[i];
+                const geometry_msgs::Point32 &vj = _polygon.points[j];
+                if (((vi.y > p->y) != (vj.y > p->y)) && (p->x < (vj.x - vi.x) * (p->y - vi.y) / (vj.y - vi.y) + vi.x)) inside = !inside;
+            }
+            if (inside) return true;
+        }
+        // Any edge crossed
+        for (int i = 0, j = n - 1; i < n; j = i++) {
+            const geometry_msgs::Point32 &c = _polygon.points[j];
+            const geometry_msgs::Point32 &d = _polygon.points[i];
+            double d1 = cross(c.x, c.y, d.x, d.y, _a.x, _a.y);
+            double d2 = cross(c.x, c.y, d.x, d.y, _b.x, _b.y);
+            double d3 = cross(_a.x, _a.y, _b.x, _b.y, c.x, c.y);
+            double d4 = cross(_a.x, _a.y, _b.x, _b.y, d.x, d.y);
+            if (((d1 > 0 && d2 < 0) || (d1 < 0 && d2 > 0)) && ((d3 > 0 && d4 < 0) || (d3 < 0 && d4 > 0))) return true;
+        }
+        return false;
+    }
+
+
+    std::map<std::pair<int, int>, Solution> solutions_;
+    std::mutex mutex_;
+    double max_repair_distance_;
+    size_t max_entries_;
+    uint64_t use_counter_;
+    uint64_t repairs_, searches_;
+};
+
+#endif  // PATH_REPAIR_CACHE_H
@@ -0,0 +1,150 @@
+//----------------------------------------------------------------------------------------------------------------------
+// The MIT License (MIT)
+//
+// Copyright (c) 2018 GRVC University of Seville
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+// documentation files (the "Software"), to deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies or substantial portions of the
+// Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+// WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS
+// OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+// OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//----------------------------------------------------------------------------------------------------------------------
+
+#include <geometry_msgs/Polygon.h>
+#include <path_planner.h>
+
+#include <chrono>
+#include <cstdint>
+#include <limits>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <tuple>
+#include <vector>
+
+#ifndef PLANNER_GRID_CACHE_H
+#define PLANNER_GRID_CACHE_H
+
+inline bool samePolygon(const geometry_msgs::Polygon &_p, const geometry_msgs::Polygon &_q) {
+    if (_p.points.size() != _q.points.size()) return false;
+    for (size_t i = 0; i < _p.points.size(); i++) {
+        if (_p.points[i].x != _q.points[i].x || _p.points[i].y != _q.points[i].y) return false;
+    }
+    return true;
+}
+
+// Planners (rasterized grids) kept for reuse. Same geofence, inflation, grid bounds and resolution give the same grid.
+// A planner found for a geofence whose inflated polygon is not the one it was built with means the geofence has been
+// written again in the database, so every planner of that geofence is discarded.
+class PlannerGridCache {
+   public:
+    // A planner keeps the state of its search, so concurrent searches on the same cached planner are serialized. A
+    // search waiting for the planner gives up at its deadline. A search running can not be stopped, the planner has no
+    // way to cancel it
+    struct SharedPlanner {
+        explicit SharedPlanner(std::shared_ptr<grvc::PathPlanner> _planner) : planner(_planner) {}
+
+        // False if the planner is still busy with another search at _deadline (max to wait without limit)
+        bool getPath(geometry_msgs::Point _init, geometry_msgs::Point _goal, std::chrono::steady_clock::time_point _deadline,
+                     std::vector<geometry_msgs::Point> &_path) {
+            std::unique_lock<std::timed_mutex> lock(mutex, std::defer_lock);
+            if (_deadline == std::chrono::steady_clock::time_point::max()) {
+                lock.lock();
+            } else if (!lock.try_lock_until(_deadline)) {
+                return false;
+            }
+            _path = planner->getPath(_init, _goal);
+            return true;
+        }
+
+        std::shared_ptr<grvc::PathPlanner> planner;
+        std::timed_mutex mutex;
+    };
+
+    struct Key {
+        int geofence_id;
+        double inflation;
+        double x_min, y_min, x_max, y_max;
+        int resolution;
+
+        bool operator<(const Key &_other) const {
+            return std::tie(geofence_id, inflation, x_min, y_min, x_max, y_max, resolution) <
+                   std::tie(_other.geofence_id, _other.inflation, _other.x_min, _other.y_min, _other.x_max, _other.y_max, _other.resolution);
+        }
+    };
+
+    PlannerGridCache(size_t _max_entries = 32) : max_entries_(_max_entries), use_counter_(0), hits_(0), misses_(0) {}
+
+    // Returns the cached planner, or nullptr if there is none for this key and obstacle
+    std::shared_ptr<SharedPlanner> find(const Key &_key, const geometry_msgs::Polygon &_obstacle) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = entries_.find(_key);
+        if (it != entries_.end() && !samePolygon(it->second.obstacle, _obstacle)) {
+            invalidateLocked(_key.geofence_id);
+            it = entries_.end();
+        }
+        if (it == entries_.end()) {
+            misses_++;
+            return nullptr;
+        }
+        hits_++;
+        it->second.last_use = ++use_counter_;
+        return it->second.planner;
+    }
+
+    void insert(const Key &_key, const geometry_msgs::Polygon &_obstacle, std::shared_ptr<SharedPlanner> _planner) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        Entry &entry = entries_[_key];
+        entry.obstacle = _obstacle;
+        entry.planner = _planner;
+        entry.last_use = ++use_counter_;
+        if (entries_.size() > max_entries_) {
+            // Drop the least recently used planner
+            auto oldest = entries_.begin();
+            for (auto it = entries_.begin(); it != entries_.end(); ++it) {
+                if (it->second.last_use < oldest->second.last_use) oldest = it;
+            }
+            entries_.erase(oldest);
+        }
+    }
+
+    // Discard every planner of a geofence
+    void invalidate(int _geofence_id) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        invalidateLocked(_geofence_id);
+    }
+
+    size_t size() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return entries_.size();
+    }
+    uint64_t hits() const { return hits_; }
+    uint64_t misses() const { return misses_; }
+
+   private:
+    struct Entry {
+        geometry_msgs::Polygon obstacle;
+        std::shared_ptr<SharedPlanner> planner;
+        uint64_t last_use;
+    };
+
+    void invalidateLocked(int _geofence_id) {
+        auto it = entries_.lower_bound(Key{_geofence_id, -std::numeric_limits<double>::max(), 0, 0, 0, 0, 0});
+        while (it != entries_.end() && it->first.geofence_id == _geofence_id) it = entries_.erase(it);
+    }
+
+    std::map<Key, Entry> entries_;
+    std::mutex mutex_;
+    size_t max_entries_;
+    uint64_t use_counter_;
+    uint64_t hits_, misses_;
+};
+
+#endif  // PLANNER_GRID_CACHE_H
@@ -0,0 +1,280 @@
+//----------------------------------------------------------------------------------------------------------------------
+// The MIT License (MIT)
+//
+// Copyright (c) 2018 GRVC University of Seville
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+// documentation files (the "Software"), to deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies or substantial portions of the
+// Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+// WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS
+// OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+// OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//----------------------------------------------------------------------------------------------------------------------
+
+#include <gauss_msgs/Geofence.h>
+#include <geometry_msgs/Polygon.h>
+
+#include <Eigen/Eigen>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#ifndef PREPARED_GEOFENCE_CACHE_H
+#define PREPARED_GEOFENCE_CACHE_H
+
+// The first and last vertices are the same point, as in every polygon made by circleToPolygon
+inline geometry_msgs::Polygon circleToPolygon(double _x, double _y, double _radius, int _nVertices = 9) {
+    geometry_msgs::Polygon out_polygon;
+    Eigen::Vector2d centerToVertex(_radius, 0.0), centerToVertexTemp;
+    for (int i = 0; i < _nVertices; i++) {
+        double theta = i * 2 * M_PI / (_nVertices - 1);
+        Eigen::Rotation2D<double> rot2d(theta);
+        centerToVertexTemp = rot2d.toRotationMatrix() * centerToVertex;
+        geometry_msgs::Point32 temp_point;
+        temp_point.x = _x + centerToVertexTemp[0];
+        temp_point.y = _y + centerToVertexTemp[1];
+        out_polygon.points.push_back(temp_point);
+    }
+
+    return out_polygon;
+}
+
+// nvert        - Number of vertices in the polygon. Repeating the first vertex at the end makes no difference.
+// vertx, verty	- Arrays containing the x- and y-coordinates of the polygon's vertices.
+// testx, testy	- X&Y coordinate of the test point.
+// [https://wrf.ecse.rpi.edu/Research/Short_Notes/pnpoly.html]
+inline int pointInPolygon(int nvert, const float *vertx, const float *verty, float testx, float testy) {
+    int i, j, c = 0;
+    for (i = 0, j = nvert - 1; i < nvert; j = i++) {
+        if (((verty[i] > testy) != (verty[j] > testy)) &&
+            (testx < (vertx[j] - vertx[i]) * (testy - verty[i]) / (verty[j] - verty[i]) + vertx[i]))
+            c = !c;
+    }
+    return c;
+}
+
+inline double signedArea(const geometry_msgs::Polygon &p) {
+    double A = 0;
+    //========================================================//
+    // Assumes:                                               //
+    //    N+1 vertices:   p[0], p[1], ... , p[N-1], p[N]      //
+    //    Closed polygon: p[0] = p[N]                         //
+    // Returns:                                               //
+    //    Signed area: +ve if anticlockwise, -ve if clockwise //
+    //========================================================//
+    int N = p.points.size() - 1;
+    for (int i = 0; i < N; i++) A += p.points.at(i).x * p.points.at(i + 1).y - p.points.at(i + 1).x * p.points.at(i).y;
+    A *= 0.5;
+    return A;
+}
+
+inline geometry_msgs::Polygon decreasePolygon(const geometry_msgs::Polygon &p, double thickness) {
+    //=====================================================//
+    // Assumes:                                            //
+    //    N+1 vertices:   p[0], p[1], ... , p[N-1], p[N]   //
+    //    Closed polygon: p[0] = p[N]                      //
+    //    No zero-length sides                             //
+    // Returns:                                            //
+    //    Internal poly:  q[0], q[1], ... , q[N-1], q[N]   //
+    //=====================================================//
+    geometry_msgs::Polygon q;
+    int N = p.points.size() - 1;
+    q.points.resize(N + 1);
+    double a, b, A, B, d, cross;
+    double displacement = thickness;
+    if (signedArea(p) < 0) displacement = -displacement;  // Detects clockwise order
+    // Unit vector (a,b) along last edge
+    a = p.points.at(N).x - p.points.at(N - 1).x;
+    b = p.points.at(N).y - p.points.at(N - 1).y;
+    d = sqrt(a * a + b * b);
+    a /= d;
+    b /= d;
+    for (int i = 0; i < N; i++) {  // Loop round the polygon, dealing with successive intersections of lines
+        // Unit vector (A,B) along previous edge
+        A = a;
+        B = b;
+        // Unit vector (a,b) along next edge
+        a = p.points.at(i + 1).x - p.points.at(i).x;
+        b = p.points.at(i + 1).y - p.points.at(i).y;
+        d = sqrt(a * a + b * b);
+        a /= d;
+        b /= d;
+        // New vertex
+        cross = A * b - a * B;
+        const double SMALL = 1.0e-10;
+        if (std::abs(cross) < SMALL) {  // Degenerate cases: 0 or 180 degrees at vertex
+            q.points.at(i).x = p.points.at(i).x - displacement * b;
+            q.points.at(i).y = p.points.at(i).y + displacement * a;
+        } else {  // Usual case
+            q.points.at(i).x = p.points.at(i).x + displacement * (a - A) / cross;
+            q.points.at(i).y = p.points.at(i).y + displacement * (b - B) / cross;
+        }
+    }
+    // Close the inside polygon
+    q.points.at(N) = q.points.at(0);
+
+    return q;
+}
+
+// Polygon with its bounding box and its vertices as float arrays, ready for point in polygon queries
+struct PreparedPolygon {
+    // Vertices as the planners expect them: closed for cylinders (circleToPolygon), open for polygon geofences
+    geometry_msgs::Polygon polygon;
+    // Closed, x[size - 1] == x[0]
+    std::vector<float> x, y;
+    float min_x, min_y, max_x, max_y;
+
+    void set(const geometry_msgs::Polygon &_polygon) {
+        polygon = _polygon;
+        x.clear();
+        y.clear();
+        for (auto point : polygon.points) {
+            x.push_back(point.x);
+            y.push_back(point.y);
+        }
+        if (x.empty()) {
+            min_x = min_y = max_x = max_y = 0;
+            return;
+        }
+        x.push_back(x.front());
+        y.push_back(y.front());
+        min_x = *std::min_element(x.begin(), x.end());
+        min_y = *std::min_element(y.begin(), y.end());
+        max_x = *std::max_element(x.begin(), x.end());
+        max_y = *std::max_element(y.begin(), y.end());
+    }
+
+    bool contains(double _x, double _y) const {
+        if (x.empty() || _x < min_x || _x > max_x || _y < min_y || _y > max_y) return false;
+        return pointInPolygon(x.size(), x.data(), y.data(), _x, _y);
+    }
+};
+
+// Geometry of a geofence that every deconfliction of it needs. Inflated and deflated by the same distance
+struct PreparedGeofence {
+    gauss_msgs::Geofence geofence;
+    double inflation;
+    PreparedPolygon shape, inflated, deflated;
+};
+
+inline bool sameGeofenceShape(const gauss_msgs::Geofence &_a, const gauss_msgs::Geofence &_b) {
+    if (_a.cylinder_shape != _b.cylinder_shape) return false;
+    if (_a.cylinder_shape) return _a.circle.x_center == _b.circle.x_center && _a.circle.y_center == _b.circle.y_center && _a.circle.radius == _b.circle.radius;
+    return _a.polygon.x == _b.polygon.x && _a.polygon.y == _b.polygon.y;
+}
+
+// Prepared geofences kept for reuse, by geofence id and inflation. Geofences written again in the database must be
+// invalidated. A geofence found with another shape than the cached one is prepared again anyway
+class PreparedGeofenceCache {
+   public:
+    PreparedGeofenceCache(size_t _max_entries = 64) : max_entries_(_max_entries), use_counter_(0), hits_(0), misses_(0) {}
+
+    std::shared_ptr<const PreparedGeofence> get(const gauss_msgs::Geofence &_geofence, double _inflation) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto key = std::make_pair((int)_geofence.id, _inflation);
+        auto it = entries_.find(key);
+        if (it != entries_.end() && !sameGeofenceShape(it->second.prepared->geofence, _geofence)) {
+            invalidateLocked(_geofence.id);
+            it = entries_.end();
+        }
+        if (it != entries_.end()) {
+            hits_++;
+            it->second.last_use = ++use_counter_;
+            return it->second.prepared;
+        }
+        misses_++;
+        Entry &entry = entries_[key];
+        entry.prepared = prepare(_geofence, _inflation);
+        entry.last_use = ++use_counter_;
+        std::shared_ptr<const PreparedGeofence> out = entry.prepared;
+        if (entries_.size() > max_entries_) {
+            // Drop the least recently used geofence
+            auto oldest = entries_.begin();
+            for (auto it = entries_.begin(); it != entries_.end(); ++it) {
+                if (it->second.last_use < oldest->second.last_use) oldest = it;
+            }
+            entries_.erase(oldest);
+        }
+        return out;
+    }
+
+    // Discard every prepared version of a geofence
+    void invalidate(int _geofence_id) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        invalidateLocked(_geofence_id);
+    }
+
+    size_t size() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return entries_.size();
+    }
+    uint64_t hits() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return hits_;
+    }
+    uint64_t misses() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return misses_;
+    }
+
+   private:
+    struct Entry {
+        std::shared_ptr<const PreparedGeofence> prepared;
+        uint64_t last_use;
+    };
+
+    static std::shared_ptr<const PreparedGeofence> prepare(const gauss_msgs::Geofence &_geofence, double _inflation) {
+        std::shared_ptr<PreparedGeofence> prepared = std::make_shared<PreparedGeofence>();
+        prepared->geofence = _geofence;
+        prepared->inflation = _inflation;
+        geometry_msgs::Polygon polygon;
+        if (_geofence.cylinder_shape) {
+            polygon = circleToPolygon(_geofence.circle.x_center, _geofence.circle.y_center, _geofence.circle.radius);
+        } else {
+            for (size_t i = 0; i < _geofence.polygon.x.size() && i < _geofence.polygon.y.size(); i++) {
+                geometry_msgs::Point32 temp_point;
+                temp_point.x = _geofence.polygon.x.at(i);
+                temp_point.y = _geofence.polygon.y.at(i);
+                polygon.points.push_back(temp_point);
+            }
+        }
+        prepared->shape.set(polygon);
+        // decreasePolygon needs a closed polygon, the result is returned open again for polygon geofences
+        if (polygon.points.size() < 3) return prepared;
+        if (!_geofence.cylinder_shape) polygon.points.push_back(polygon.points.front());
+        geometry_msgs::Polygon inflated = decreasePolygon(polygon, -_inflation);
+        geometry_msgs::Polygon deflated = decreasePolygon(polygon, _inflation);
+        if (!_geofence.cylinder_shape) {
+            inflated.points.pop_back();
+            deflated.points.pop_back();
+        }
+        prepared->inflated.set(inflated);
+        prepared->deflated.set(deflated);
+        return prepared;
+    }
+
+    void invalidateLocked(int _geofence_id) {
+        auto it = entries_.lower_bound(std::make_pair(_geofence_id, -std::numeric_limits<double>::max()));
+        while (it != entries_.end() && it->first.first == _geofence_id) it = entries_.erase(it);
+    }
+
+    std::map<std::pair<int, double>, Entry> entries_;
+    std::mutex mutex_;
+    size_t max_entries_;
+    uint64_t use_counter_;
+    uint64_t hits_, misses_;
+};
+
+#endif  // PREPARED_GEOFENCE_CACHE_H
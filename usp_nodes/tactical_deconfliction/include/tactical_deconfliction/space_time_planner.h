@@ -0,0 +1,69 @@
+//----------------------------------------------------------------------------------------------------------------------
+// The MIT License (MIT)
+//
+// Copyright (c) 2018 GRVC University of Seville
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+// documentation files (the "Software"), to deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies or substantial portions of the
+// Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+// WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS
+// OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+// OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//----------------------------------------------------------------------------------------------------------------------
+
+#include <gauss_msgs/Waypoint.h>
+#include <tactical_deconfliction/trajectory_index.h>
+
+#include <Eigen/Eigen>
+#include <chrono>
+#include <vector>
+
+#ifndef SPACE_TIME_PLANNER_H
+#define SPACE_TIME_PLANNER_H
+
+// 4D planner around the estimated trajectories of other operations. The uav flies at constant speed, so the time at
+// each point is given by the length flown. A* runs over a 3D lattice centered at the start with the arrival time as
+// cost, and every edge is checked against the moving tubes of the traffic returned by the TrajectoryIndex for that
+// edge and time window. Separation already lost at the start of an edge is only accepted while it does not decrease.
+class SpaceTimePlanner {
+   public:
+    SpaceTimePlanner(const TrajectoryIndex &_index);
+    ~SpaceTimePlanner();
+
+    // Lattice step. It is increased if the search box would need more than _max_cells_per_axis cells per axis
+    void setResolution(double _resolution, int _max_cells_per_axis = 40);
+    void setMaxExpansions(int _max_expansions);
+    // The search gives up when the deadline is reached. If it is reached while shortcutting, the path found is kept
+    void setDeadline(const std::chrono::steady_clock::time_point &_deadline);
+    void setAltitudeLimits(double _min_z, double _max_z);
+    // Separation to the traffic is max(_min_separation, _radius + radius of the other uav)
+    void setSeparation(double _radius, double _min_separation);
+
+    // Path from _start to _goal (both included) at _speed, leaving at the start stamp. Trajectories of _uav_id are
+    // ignored. Returns false if no path is found within the lattice, the expansion budget and the deadline
+    bool findPath(int _uav_id, const gauss_msgs::Waypoint &_start, const gauss_msgs::Waypoint &_goal, double _speed, std::vector<gauss_msgs::Waypoint> &_path);
+    // True if a timed path of _uav_id keeps the separation to the traffic, with the same rules as the planned edges
+    bool pathFree(int _uav_id, const std::vector<gauss_msgs::Waypoint> &_path);
+
+   private:
+    bool edgeFree(const Eigen::Vector3d &_p0, double _t0, const Eigen::Vector3d &_p1, double _t1) const;
+    void simplifyPath(std::vector<Eigen::Vector3d> &_points, std::vector<double> &_times, double _speed) const;
+
+    const TrajectoryIndex &index_;
+    double resolution_;
+    int max_cells_per_axis_;
+    int max_expansions_;
+    std::chrono::steady_clock::time_point deadline_;
+    double min_z_, max_z_;
+    double radius_, min_separation_;
+    int uav_id_;
+    mutable std::vector<int> candidates_;
+};
+
+#endif  // SPACE_TIME_PLANNER_H
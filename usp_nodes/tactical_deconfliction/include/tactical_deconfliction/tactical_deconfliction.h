@@ -0,0 +1,62 @@
+//----------------------------------------------------------------------------------------------------------------------
+// The MIT License (MIT)
+//
+// Copyright (c) 2018 GRVC University of Seville
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+// documentation files (the "Software"), to deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies or substantial portions of the
+// Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+// WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS
+// OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+// OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//----------------------------------------------------------------------------------------------------------------------
+
+#include <gauss_msgs/DeconflictionPlan.h>
+#include <gauss_msgs/Geofence.h>
+#include <gauss_msgs/NewBatchDeconfliction.h>
+#include <gauss_msgs/NewDeconfliction.h>
+#include <gauss_msgs/NewThreat.h>
+#include <ros/ros.h>
+#include <tactical_deconfliction/trajectory_index.h>
+
+#include <chrono>
+#include <vector>
+
+#ifndef TACTICAL_DECONFLICTION_H
+#define TACTICAL_DECONFLICTION_H
+
+// Time budget of a deconfliction request, shared by all its planners
+struct DeconflictionBudget {
+    std::chrono::steady_clock::time_point start, deadline;
+    bool reached;
+
+    DeconflictionBudget(double _seconds) : start(std::chrono::steady_clock::now()), reached(false) {
+        deadline = start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(_seconds));
+    }
+    bool expired() {
+        if (std::chrono::steady_clock::now() >= deadline) reached = true;
+        return reached;
+    }
+    double elapsed() const { return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count(); }
+};
+
+// Read the parameters and connect to the database and visualization. Without it (offline) the defaults are used and
+// only the conflictive operations of each threat are known as traffic
+void initTacticalDeconfliction(ros::NodeHandle &_nh);
+
+// Planners are stopped or skipped once the budget is over, keeping the plans found until then. Returns false if none
+// was found and _plans only holds the fallback maneuvers. Traffic is read from the database if no index is given
+bool deconflictThreat(gauss_msgs::NewThreat &_threat, DeconflictionBudget &_budget, std::vector<gauss_msgs::DeconflictionPlan> &_plans, std::vector<double> &_plan_times, const TrajectoryIndex *_traffic_index = nullptr);
+
+// ROS interface of the tactical_deconfliction node
+void geofenceUpdateCB(const gauss_msgs::Geofence::ConstPtr &_geofence);
+bool deconflictCB(gauss_msgs::NewDeconfliction::Request &req, gauss_msgs::NewDeconfliction::Response &res);
+bool batchDeconflictCB(gauss_msgs::NewBatchDeconfliction::Request &req, gauss_msgs::NewBatchDeconfliction::Response &res);
+
+#endif  // TACTICAL_DECONFLICTION_H
@@ -0,0 +1,126 @@
+//----------------------------------------------------------------------------------------------------------------------
+// The MIT License (MIT)
+//
+// Copyright (c) 2018 GRVC University of Seville
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+// documentation files (the "Software"), to deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies or substantial portions of the
+// Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+// WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS
+// OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+// OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//----------------------------------------------------------------------------------------------------------------------
+
+#include <gauss_msgs/WaypointList.h>
+
+#include <Eigen/Eigen>
+#include <cmath>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#ifndef TRAJECTORY_INDEX_H
+#define TRAJECTORY_INDEX_H
+
+// Estimated trajectories of the operations, stored as timed segments in a uniform horizontal grid. A segment is in
+// every cell touched by its bounding box inflated by its radius (the operational volume), so a query only returns
+// the traffic near the queried box and time window. Queries are not thread safe.
+class TrajectoryIndex {
+   public:
+    struct Segment {
+        int uav_id;
+        Eigen::Vector3d p0, p1;
+        double t0, t1;
+        double radius;
+        bool removed;
+    };
+
+    TrajectoryIndex(double _cell_size = 100.0) : cell_size_(_cell_size), query_stamp_(0) {}
+
+    void clear() {
+        segments_.clear();
+        cells_.clear();
+        visited_.clear();
+    }
+
+    // Waypoints must be sorted by stamp. Nothing is known of the uav before the first or after the last one
+    void addTrajectory(int _uav_id, const gauss_msgs::WaypointList &_trajectory, double _radius) {
+        const std::vector<gauss_msgs::Waypoint> &wps = _trajectory.waypoints;
+        for (size_t i = 0; i < wps.size(); i++) {
+            // A single waypoint is a segment of zero length and duration
+            if (i + 1 == wps.size() && wps.size() > 1) break;
+            const gauss_msgs::Waypoint &a = wps[i];
+            const gauss_msgs::Waypoint &b = wps.size() > 1 ? wps[i + 1] : wps[i];
+            Segment segment;
+            segment.uav_id = _uav_id;
+            segment.p0 = Eigen::Vector3d(a.x, a.y, a.z);
+            segment.p1 = Eigen::Vector3d(b.x, b.y, b.z);
+            segment.t0 = a.stamp.toSec();
+            segment.t1 = b.stamp.toSec();
+            segment.radius = _radius;
+            segment.removed = false;
+            if (segment.t1 < segment.t0) continue;
+            int id = segments_.size();
+            segments_.push_back(segment);
+            visited_.push_back(0);
+            int x0 = cell(std::min(a.x, b.x) - _radius), x1 = cell(std::max(a.x, b.x) + _radius);
+            int y0 = cell(std::min(a.y, b.y) - _radius), y1 = cell(std::max(a.y, b.y) + _radius);
+            for (int x = x0; x <= x1; x++) {
+                for (int y = y0; y <= y1; y++) cells_[key(x, y)].push_back(id);
+            }
+        }
+    }
+
+    // Forget the trajectory of an uav, e.g. before adding a new plan for it
+    void removeTrajectory(int _uav_id) {
+        for (auto &segment : segments_) {
+            if (segment.uav_id == _uav_id) segment.removed = true;
+        }
+    }
+
+    // Segments of other uavs that may be closer than _margin to the box, during [_t0, _t1]
+    void query(const Eigen::Vector3d &_min, const Eigen::Vector3d &_max, double _t0, double _t1, double _margin, int _excluded_uav_id,
+               std::vector<int> &_segment_ids) const {
+        _segment_ids.clear();
+        query_stamp_++;
+        int x0 = cell(_min.x() - _margin), x1 = cell(_max.x() + _margin);
+        int y0 = cell(_min.y() - _margin), y1 = cell(_max.y() + _margin);
+        for (int x = x0; x <= x1; x++) {
+            for (int y = y0; y <= y1; y++) {
+                auto it = cells_.find(key(x, y));
+                if (it == cells_.end()) continue;
+                for (int id : it->second) {
+                    if (visited_[id] == query_stamp_) continue;
+                    visited_[id] = query_stamp_;
+                    const Segment &segment = segments_[id];
+                    if (segment.removed || segment.uav_id == _excluded_uav_id || segment.t1 < _t0 || segment.t0 > _t1) continue;
+                    double margin = _margin + segment.radius;
+                    if (std::min(segment.p0.z(), segment.p1.z()) - margin > _max.z() ||
+                        std::max(segment.p0.z(), segment.p1.z()) + margin < _min.z()) continue;
+                    _segment_ids.push_back(id);
+                }
+            }
+        }
+    }
+
+    const Segment &segment(int _id) const { return segments_[_id]; }
+    size_t size() const { return segments_.size(); }
+
+   private:
+    int cell(double _coordinate) const { return static_cast<int>(std::floor(_coordinate / cell_size_)); }
+    static int64_t key(int _x, int _y) { return (static_cast<int64_t>(_x) << 32) ^ static_cast<uint32_t>(_y); }
+
+    double cell_size_;
+    std::vector<Segment> segments_;
+    std::unordered_map<int64_t, std::vector<int>> cells_;
+    mutable std::vector<uint32_t> visited_;
+    mutable uint32_t query_stamp_;
+};
+
+#endif  // TRAJECTORY_INDEX_H
@@ -0,0 +1,57 @@
+//----------------------------------------------------------------------------------------------------------------------
+// The MIT License (MIT)
+//
+// Copyright (c) 2018 GRVC University of Seville
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+// documentation files (the "Software"), to deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies or substantial portions of the
+// Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+// WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS
+// OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+// OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//----------------------------------------------------------------------------------------------------------------------
+
+#include <geometry_msgs/Point.h>
+#include <geometry_msgs/Polygon.h>
+
+#include <Eigen/Eigen>
+#include <chrono>
+#include <vector>
+
+#ifndef VISIBILITY_GRAPH_PLANNER_H
+#define VISIBILITY_GRAPH_PLANNER_H
+
+// Any-angle 2D planner around polygonal obstacles. The shortest path only turns at obstacle vertices, so A* is run
+// over the graph of mutually visible vertices (plus start and goal). Visibility is only checked for the vertices that
+// A* expands, and the cost depends on the number of vertices instead of the area or a grid resolution.
+// Obstacles must be already inflated with the clearance the path needs, as the path touches their vertices.
+class VisibilityGraphPlanner {
+   public:
+    VisibilityGraphPlanner();
+    ~VisibilityGraphPlanner();
+
+    // Add an obstacle. The first vertex must not be repeated at the end
+    void addObstacle(const geometry_msgs::Polygon &_polygon);
+    void clearObstacles();
+    // findPath gives up when the deadline is reached
+    void setDeadline(const std::chrono::steady_clock::time_point &_deadline) { deadline_ = _deadline; }
+    // Shortest path from _start to _goal, both included. Obstacles that contain the start or the goal are ignored on the
+    // legs leaving the start or reaching the goal, so a path out of an obstacle can be found. Returns false if there is no
+    // path or the deadline is reached before finding it
+    bool findPath(const geometry_msgs::Point &_start, const geometry_msgs::Point &_goal, std::vector<geometry_msgs::Point> &_path);
+
+   private:
+    bool insideObstacle(const Eigen::Vector2d &_point, int _obstacle) const;
+    bool visible(const Eigen::Vector2d &_a, const Eigen::Vector2d &_b, int _ignored_a, int _ignored_b) const;
+
+    std::vector<std::vector<Eigen::Vector2d>> obstacles_;
+    std::chrono::steady_clock::time_point deadline_;
+};
+
+#endif  // VISIBILITY_GRAPH_PLANNER_H
@@ -2,11 +2,20 @@
 #include <gauss_msgs/ConflictiveOperation.h>
 #include <gauss_msgs/Deconfliction.h>
 #include <gauss_msgs/DeconflictionPlan.h>
+#include <gauss_msgs/Geofence.h>
 #include <gauss_msgs/Threat.h>
 #include <gauss_msgs/Waypoint.h>
 #include <ros/ros.h>
+#include <tactical_deconfliction/candidate_pool.h>
 #include <tactical_deconfliction/path_finder.h>
+#include <tactical_deconfliction/prepared_geofence_cache.h>
 #include <Eigen/Eigen>
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <future>
+#include <limits>
+#include <memory>
 
 using namespace std;
 
@@ -17,32 +26,39 @@ class ConflictSolver {
 
    private:
     // Topic Callbacks
+    void geofenceUpdateCB(const gauss_msgs::Geofence::ConstPtr &_geofence);
 
     // Service Callbacks
     bool deconflictCB(gauss_msgs::Deconfliction::Request &req, gauss_msgs::Deconfliction::Response &res);
 
     // Auxilary methods
-    geometry_msgs::Point findInitAStarPoint(geometry_msgs::Polygon &_polygon, nav_msgs::Path &_path, int &_init_astar_pos);
-    geometry_msgs::Point findGoalAStarPoint(geometry_msgs::Polygon &_polygon, nav_msgs::Path &_path, int &_goal_astar_pos);
-    int pnpoly(int nvert, std::vector<float> &vertx, std::vector<float> &verty, float testx, float testy);
-    std::vector<double> findGridBorders(geometry_msgs::Polygon &_polygon, nav_msgs::Path &_path, geometry_msgs::Point _init_point, geometry_msgs::Point _goal_point);
-    geometry_msgs::Polygon circleToPolygon(double &_x, double &_y, double &_radius, double _nVertices = 9);
+    geometry_msgs::Point findInitAStarPoint(const PreparedPolygon &_polygon, nav_msgs::Path &_path, int &_init_astar_pos);
+    geometry_msgs::Point findGoalAStarPoint(const PreparedPolygon &_polygon, nav_msgs::Path &_path, int &_goal_astar_pos);
+    std::vector<double> findGridBorders(const PreparedPolygon &_polygon, nav_msgs::Path &_path, geometry_msgs::Point _init_point, geometry_msgs::Point _goal_point);
     gauss_msgs::Waypoint intersectingPoint(gauss_msgs::Waypoint &_p1, gauss_msgs::Waypoint &_p2, geometry_msgs::Polygon &_polygon);
     std::pair<std::vector<double>, double> getCoordinatesAndDistance(double _x0, double _y0, double _x1, double _y1, double _x2, double _y2);
     double pathDistance(gauss_msgs::DeconflictionPlan &_wp_list);
     double pointsDistance(gauss_msgs::Waypoint &_p1, gauss_msgs::Waypoint &_p2);
     double minDistanceToGeofence(std::vector<gauss_msgs::Waypoint> &_wp_list, geometry_msgs::Polygon &_polygon);
     double calculateRiskiness(gauss_msgs::DeconflictionPlan newplan);
-    void decreasePolygon(const geometry_msgs::Polygon &p, double thickness, geometry_msgs::Polygon &q);
-    double signedArea(const geometry_msgs::Polygon &p);
+    std::future<gauss_msgs::DeconflictionPlan> launchCandidate(std::function<gauss_msgs::DeconflictionPlan()> _build, std::chrono::steady_clock::time_point _deadline);
+    std::future<gauss_msgs::DeconflictionPlan> scoreCandidate(const gauss_msgs::DeconflictionPlan &_plan, std::chrono::steady_clock::time_point _deadline);
+    int collectCandidates(std::vector<std::future<gauss_msgs::DeconflictionPlan>> &_candidates, std::chrono::steady_clock::time_point _start,
+                          std::chrono::steady_clock::time_point _deadline, std::vector<gauss_msgs::DeconflictionPlan> &_plans, std::vector<double> &_plan_times);
+    gauss_msgs::DeconflictionPlan fallbackPlan(gauss_msgs::ConflictiveOperation &_operation);
 
     // Auxilary variables
     double rate_;
     double minDist_, dT_;
     double minX_, maxX_, minY_, maxY_, minZ_, maxZ_;
+    double deconfliction_deadline_;
+    PlannerGridCache planner_grid_cache_;
+    PreparedGeofenceCache prepared_geofence_cache_;
+    PathRepairCache path_repair_cache_;
     ros::NodeHandle nh_;
 
     // Subscribers
+    ros::Subscriber geofence_update_sub_;
 
     // Publisher
     ros::Publisher pub_sol_1_;
@@ -61,6 +77,9 @@ class ConflictSolver {
 
     // Clients
     ros::ServiceClient check_client_;
+
+    // Last member, so its workers are joined before the rest of the solver used by the candidates is destroyed
+    std::unique_ptr<CandidatePool> candidate_pool_;
 };
 
 // TacticalDeconfliction Constructor
@@ -74,6 +93,13 @@ ConflictSolver::ConflictSolver() {
     nh_.param("maxX", maxX_, 0.0);
     nh_.param("maxY", maxY_, 400.0);
     nh_.param("maxZ", maxZ_, 300.0);
+    double max_path_repair_distance;
+    nh_.param("max_path_repair_distance", max_path_repair_distance, 20.0);
+    path_repair_cache_.setMaxRepairDistance(max_path_repair_distance);
+    nh_.param("deconfliction_deadline", deconfliction_deadline_, 2.0);
+    int candidate_workers;
+    nh_.param("candidate_workers", candidate_workers, 4);
+    candidate_pool_.reset(new CandidatePool(std::max(candidate_workers, 1)));
 
 
     // Initialization
@@ -90,6 +116,7 @@ ConflictSolver::ConflictSolver() {
     pub_sol_8_ = nh_.advertise<nav_msgs::Path>("/sol8", 1);
 
     // Subscribe
+    geofence_update_sub_ = nh_.subscribe("/gauss/geofence_updates", 1000, &ConflictSolver::geofenceUpdateCB, this);
 
     // Server
     deconflict_server_ = nh_.advertiseService("/gauss/tactical_deconfliction", &ConflictSolver::deconflictCB, this);
@@ -100,87 +127,17 @@ ConflictSolver::ConflictSolver() {
     ROS_INFO("[Tactical] Started Tactical Deconfliction node!");
 }
 
-int ConflictSolver::pnpoly(int nvert, std::vector<float> &vertx, std::vector<float> &verty, float testx, float testy) {
-    int i, j, c = 0;
-    for (i = 0, j = nvert - 1; i < nvert; j = i++) {
-        if (((verty.at(i) > testy) != (verty.at(j) > testy)) &&
-            (testx < (vertx.at(j) - vertx.at(i)) * (testy - verty.at(i)) / (verty.at(j) - verty.at(i)) + vertx.at(i)))
-            c = !c;
-    }
-    return c;
-}
-
-double ConflictSolver::signedArea(const geometry_msgs::Polygon &p) {
-    double A = 0;
-    //========================================================//
-    // Assumes:                                               //
-    //    N+1 vertices:   p[0], p[1], ... , p[N-1], p[N]      //
-    //    Closed polygon: p[0] = p[N]                         //
-    // Returns:                                               //
-    //    Signed area: +ve if anticlockwise, -ve if clockwise //
-    //========================================================//
-    int N = p.points.size() - 1;
-    for (int i = 0; i < N; i++) A += p.points.at(i).x * p.points.at(i + 1).y - p.points.at(i + 1).x * p.points.at(i).y;
-    A *= 0.5;
-    return A;
-}
-
-void ConflictSolver::decreasePolygon(const geometry_msgs::Polygon &p, double thickness, geometry_msgs::Polygon &q) {
-    //=====================================================//
-    // Assumes:                                            //
-    //    N+1 vertices:   p[0], p[1], ... , p[N-1], p[N]   //
-    //    Closed polygon: p[0] = p[N]                      //
-    //    No zero-length sides                             //
-    // Returns (by reference, as a parameter):             //
-    //    Internal poly:  q[0], q[1], ... , q[N-1], q[N]   //
-    //=====================================================//
-    int N = p.points.size() - 1;
-    q.points.resize(N + 1);
-    double a, b, A, B, d, cross;
-    double displacement = thickness;
-    if (signedArea(p) < 0) displacement = -displacement;  // Detects clockwise order
-    // Unit vector (a,b) along last edge
-    a = p.points.at(N).x - p.points.at(N - 1).x;
-    b = p.points.at(N).y - p.points.at(N - 1).y;
-    d = sqrt(a * a + b * b);
-    a /= d;
-    b /= d;
-    for (int i = 0; i < N; i++) {  // Loop round the polygon, dealing with successive intersections of lines
-        // Unit vector (A,B) along previous edge
-        A = a;
-        B = b;
-        // Unit vector (a,b) along next edge
-        a = p.points.at(i + 1).x - p.points.at(i).x;
-        b = p.points.at(i + 1).y - p.points.at(i).y;
-        d = sqrt(a * a + b * b);
-        a /= d;
-        b /= d;
-        // New vertex
-        cross = A * b - a * B;
-        const double SMALL = 1.0e-10;
-        if (abs(cross) < SMALL) {  // Degenerate cases: 0 or 180 degrees at vertex
-            q.points.at(i).x = p.points.at(i).x - displacement * b;
-            q.points.at(i).y = p.points.at(i).y + displacement * a;
-        } else {  // Usual case
-            q.points.at(i).x = p.points.at(i).x + displacement * (a - A) / cross;
-            q.points.at(i).y = p.points.at(i).y + displacement * (b - B) / cross;
-        }
-    }
-    // Close the inside polygon
-    q.points.at(N) = q.points.at(0);
+void ConflictSolver::geofenceUpdateCB(const gauss_msgs::Geofence::ConstPtr &_geofence) {
+    // Geometry prepared for the previous version of the geofence is no longer valid
+    prepared_geofence_cache_.invalidate(_geofence->id);
+    planner_grid_cache_.invalidate(_geofence->id);
+    path_repair_cache_.invalidate(_geofence->id);
 }
 
-geometry_msgs::Point ConflictSolver::findInitAStarPoint(geometry_msgs::Polygon &_polygon, nav_msgs::Path &_path, int &_init_astar_pos) {
+geometry_msgs::Point ConflictSolver::findInitAStarPoint(const PreparedPolygon &_polygon, nav_msgs::Path &_path, int &_init_astar_pos) {
     geometry_msgs::Point out_point;
-    std::vector<float> vert_x, vert_y;
-    for (int i = 0; i < _polygon.points.size(); i++) {
-        vert_x.push_back(_polygon.points.at(i).x);
-        vert_y.push_back(_polygon.points.at(i).y);
-    }
-    vert_x.push_back(_polygon.points.front().x);
-    vert_y.push_back(_polygon.points.front().y);
     for (int i = 0; i < _path.poses.size(); i++) {
-        if (pnpoly(vert_x.size(), vert_x, vert_y, _path.poses.at(i).pose.position.x, _path.poses.at(i).pose.position.y)) {
+        if (_polygon.contains(_path.poses.at(i).pose.position.x, _path.poses.at(i).pose.position.y)) {
             out_point.x = _path.poses.at(i - 1).pose.position.x;
             out_point.y = _path.poses.at(i - 1).pose.position.y;
             out_point.z = _path.poses.at(i - 1).pose.position.z;
@@ -191,19 +148,12 @@ geometry_msgs::Point ConflictSolver::findInitAStarPoint(geometry_msgs::Polygon &
     return out_point;
 }
 
-geometry_msgs::Point ConflictSolver::findGoalAStarPoint(geometry_msgs::Polygon &_polygon, nav_msgs::Path &_path, int &_goal_astar_pos) {
+geometry_msgs::Point ConflictSolver::findGoalAStarPoint(const PreparedPolygon &_polygon, nav_msgs::Path &_path, int &_goal_astar_pos) {
     bool flag1 = false;
     bool flag2 = false;
     geometry_msgs::Point out_point;
-    std::vector<float> vert_x, vert_y;
-    for (int i = 0; i < _polygon.points.size(); i++) {
-        vert_x.push_back(_polygon.points.at(i).x);
-        vert_y.push_back(_polygon.points.at(i).y);
-    }
-    vert_x.push_back(_polygon.points.front().x);
-    vert_y.push_back(_polygon.points.front().y);
     for (int i = 0; i < _path.poses.size(); i++) {
-        bool in_obstacle = pnpoly(vert_x.size(), vert_x, vert_y, _path.poses.at(i).pose.position.x, _path.poses.at(i).pose.position.y);
+        bool in_obstacle = _polygon.contains(_path.poses.at(i).pose.position.x, _path.poses.at(i).pose.position.y);
         if (in_obstacle && !flag1 && !flag2) flag1 = true;
         if (!in_obstacle && flag1 && !flag2) flag2 = true;
         if (!in_obstacle && flag1 && flag2) {
@@ -224,19 +174,12 @@ geometry_msgs::Point ConflictSolver::findGoalAStarPoint(geometry_msgs::Polygon &
     return out_point;
 }
 
-std::vector<double> ConflictSolver::findGridBorders(geometry_msgs::Polygon &_polygon, nav_msgs::Path &_path, geometry_msgs::Point _init_point, geometry_msgs::Point _goal_point) {
+std::vector<double> ConflictSolver::findGridBorders(const PreparedPolygon &_polygon, nav_msgs::Path &_path, geometry_msgs::Point _init_point, geometry_msgs::Point _goal_point) {
     geometry_msgs::Point obs_min, obs_max, out_point;
-    std::vector<float> vert_x, vert_y;
-    for (int i = 0; i < _polygon.points.size(); i++) {
-        vert_x.push_back(_polygon.points.at(i).x);
-        vert_y.push_back(_polygon.points.at(i).y);
-    }
-    vert_x.push_back(_polygon.points.front().x);
-    vert_y.push_back(_polygon.points.front().y);
-    obs_min.x = *std::min_element(vert_x.begin(), vert_x.end());
-    obs_min.y = *std::min_element(vert_y.begin(), vert_y.end());
-    obs_max.x = *std::max_element(vert_x.begin(), vert_x.end());
-    obs_max.y = *std::max_element(vert_y.begin(), vert_y.end());
+    obs_min.x = _polygon.min_x;
+    obs_min.y = _polygon.min_y;
+    obs_max.x = _polygon.max_x;
+    obs_max.y = _polygon.max_y;
 
     std::vector<double> out_grid_borders, temp_x, temp_y;
     temp_x.push_back(_init_point.x);
@@ -263,22 +206,6 @@ std::vector<double> ConflictSolver::findGridBorders(geometry_msgs::Polygon &_pol
     return out_grid_borders;
 }
 
-geometry_msgs::Polygon ConflictSolver::circleToPolygon(double &_x, double &_y, double &_radius, double _nVertices) {
-    geometry_msgs::Polygon out_polygon;
-    Eigen::Vector2d centerToVertex(_radius, 0.0), centerToVertexTemp;
-    for (int i = 0; i < _nVertices; i++) {
-        double theta = i * 2 * M_PI / (_nVertices - 1);
-        Eigen::Rotation2D<double> rot2d(theta);
-        centerToVertexTemp = rot2d.toRotationMatrix() * centerToVertex;
-        geometry_msgs::Point32 temp_point;
-        temp_point.x = _x + centerToVertexTemp[0];
-        temp_point.y = _y + centerToVertexTemp[1];
-        out_polygon.points.push_back(temp_point);
-    }
-
-    return out_polygon;
-}
-
 template <typename KeyType, typename ValueType>
 std::pair<KeyType, ValueType> get_min(const std::map<KeyType, ValueType> &x) {
     using pairtype = std::pair<KeyType, ValueType>;
@@ -451,12 +378,86 @@ double ConflictSolver::calculateRiskiness(gauss_msgs::DeconflictionPlan _newplan
     return 100 * check_conflict.response.threats.size() / interp_path.poses.size();
 }
 
+std::future<gauss_msgs::DeconflictionPlan> ConflictSolver::launchCandidate(std::function<gauss_msgs::DeconflictionPlan()> _build, std::chrono::steady_clock::time_point _deadline) {
+    // Pool instead of std::async, whose future would block on destruction if the candidate misses the deadline. A
+    // candidate still queued at the deadline is discarded, its future is never waited for
+    auto task = std::make_shared<std::packaged_task<gauss_msgs::DeconflictionPlan()>>(_build);
+    std::future<gauss_msgs::DeconflictionPlan> result = task->get_future();
+    candidate_pool_->submit([task]() { (*task)(); }, _deadline);
+    return result;
+}
+
+std::future<gauss_msgs::DeconflictionPlan> ConflictSolver::scoreCandidate(const gauss_msgs::DeconflictionPlan &_plan, std::chrono::steady_clock::time_point _deadline) {
+    return launchCandidate([this, _plan]() {
+        gauss_msgs::DeconflictionPlan plan = _plan;
+        plan.riskiness = calculateRiskiness(plan);
+        return plan;
+    }, _deadline);
+}
+
+int ConflictSolver::collectCandidates(std::vector<std::future<gauss_msgs::DeconflictionPlan>> &_candidates, std::chrono::steady_clock::time_point _start,
+                                      std::chrono::steady_clock::time_point _deadline, std::vector<gauss_msgs::DeconflictionPlan> &_plans, std::vector<double> &_plan_times) {
+    int dropped = 0;
+    for (auto &candidate : _candidates) {
+        if (candidate.wait_until(_deadline) != std::future_status::ready) {
+            dropped++;
+            continue;
+        }
+        try {
+            gauss_msgs::DeconflictionPlan plan = candidate.get();
+            // Gave up at the deadline
+            if (plan.waypoint_list.empty()) {
+                dropped++;
+                continue;
+            }
+            _plans.push_back(plan);
+            _plan_times.push_back(std::chrono::duration<double>(std::chrono::steady_clock::now() - _start).count());
+        } catch (const std::future_error &e) {
+            // Broken promise, the pool discarded the candidate at the deadline without building it
+            dropped++;
+        } catch (const std::exception &e) {
+            ROS_ERROR("[Tactical] Failed building a candidate: %s", e.what());
+        }
+    }
+    if (dropped > 0) ROS_WARN("[Tactical] %d of %zu candidates dropped, not ready before the deadline", dropped, _candidates.size());
+    return dropped;
+}
+
+gauss_msgs::DeconflictionPlan ConflictSolver::fallbackPlan(gauss_msgs::ConflictiveOperation &_operation) {
+    // Land at the nearest landing spot, or hold the position if the operation has none
+    gauss_msgs::DeconflictionPlan plan;
+    plan.uav_id = _operation.uav_id;
+    plan.waypoint_list.push_back(_operation.estimated_trajectory.waypoints.front());
+    double min_distance = std::numeric_limits<double>::max();
+    for (auto wp_land : _operation.landing_spots.waypoints) {
+        double distance = pointsDistance(_operation.estimated_trajectory.waypoints.front(), wp_land);
+        if (distance < min_distance) {
+            min_distance = distance;
+            if (plan.waypoint_list.size() > 1) plan.waypoint_list.pop_back();
+            plan.waypoint_list.push_back(wp_land);
+        }
+    }
+    if (plan.waypoint_list.size() > 1) {
+        plan.maneuver_type = 5;
+    } else {
+        plan.maneuver_type = 4;  // Hold, not used by any other maneuver
+        gauss_msgs::Waypoint hold_wp = plan.waypoint_list.front();
+        hold_wp.stamp = ros::Time(hold_wp.stamp.toSec() + 60.0);
+        plan.waypoint_list.push_back(hold_wp);
+    }
+    plan.cost = pathDistance(plan);
+    plan.riskiness = 0.0;
+    return plan;
+}
+
 // deconflictCB callback
 bool ConflictSolver::deconflictCB(gauss_msgs::Deconfliction::Request &req, gauss_msgs::Deconfliction::Response &res) {
     ROS_INFO("[Tactical] Threat to solve [%d, %d]", req.threat.threat_id, req.threat.threat_type);
     //Deconfliction
     if (req.tactical) {
-        double start_computational_time = ros::Time::now().toSec();
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        std::chrono::steady_clock::time_point deadline = start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(deconfliction_deadline_));
+        std::vector<std::future<gauss_msgs::DeconflictionPlan>> candidates;
         gauss_msgs::Threat conflict;
         conflict = req.threat;
         std::vector<gauss_msgs::ConflictiveOperation> conflictive_operations;
@@ -507,8 +508,7 @@ bool ConflictSolver::deconflictCB(gauss_msgs::Deconfliction::Request &req, gauss
                         newplan.waypoint_list.push_back(traj2.waypoints.at(k + 1));
                     }
                     newplan.cost = pathDistance(newplan);
-                    newplan.riskiness = calculateRiskiness(newplan);
-                    res.deconfliction_plans.push_back(newplan);
+                    candidates.push_back(scoreCandidate(newplan, deadline));
                 }
                 //Below
                 newplan.waypoint_list.clear();
@@ -522,8 +522,7 @@ bool ConflictSolver::deconflictCB(gauss_msgs::Deconfliction::Request &req, gauss
                         newplan.waypoint_list.push_back(traj2.waypoints.at(k + 1));
                     }
                     newplan.cost = pathDistance(newplan);
-                    newplan.riskiness = calculateRiskiness(newplan);
-                    res.deconfliction_plans.push_back(newplan);
+                    candidates.push_back(scoreCandidate(newplan, deadline));
                 }
                 //On the right
                 newplan.waypoint_list.clear();
@@ -543,8 +542,7 @@ bool ConflictSolver::deconflictCB(gauss_msgs::Deconfliction::Request &req, gauss
                         newplan.waypoint_list.push_back(traj2.waypoints.at(k + 1));
                     }
                     newplan.cost = pathDistance(newplan);
-                    newplan.riskiness = calculateRiskiness(newplan);
-                    res.deconfliction_plans.push_back(newplan);
+                    candidates.push_back(scoreCandidate(newplan, deadline));
                 }
                 //On the left
                 newplan.waypoint_list.clear();
@@ -564,8 +562,7 @@ bool ConflictSolver::deconflictCB(gauss_msgs::Deconfliction::Request &req, gauss
                         newplan.waypoint_list.push_back(traj2.waypoints.at(k + 1));
                     }
                     newplan.cost = pathDistance(newplan);
-                    newplan.riskiness = calculateRiskiness(newplan);
-                    res.deconfliction_plans.push_back(newplan);
+                    candidates.push_back(scoreCandidate(newplan, deadline));
                 }
             }
             if (req.threat.priority_ops.back() >= req.threat.priority_ops.front()) {
@@ -582,8 +579,7 @@ bool ConflictSolver::deconflictCB(gauss_msgs::Deconfliction::Request &req, gauss
                         newplan.waypoint_list.push_back(traj1.waypoints.at(j + 1));
                     }
                     newplan.cost = pathDistance(newplan);
-                    newplan.riskiness = calculateRiskiness(newplan);
-                    res.deconfliction_plans.push_back(newplan);
+                    candidates.push_back(scoreCandidate(newplan, deadline));
                 }
                 //Below
                 newplan.waypoint_list.clear();
@@ -597,8 +593,7 @@ bool ConflictSolver::deconflictCB(gauss_msgs::Deconfliction::Request &req, gauss
                         newplan.waypoint_list.push_back(traj1.waypoints.at(j + 1));
                     }
                     newplan.cost = pathDistance(newplan);
-                    newplan.riskiness = calculateRiskiness(newplan);
-                    res.deconfliction_plans.push_back(newplan);
+                    candidates.push_back(scoreCandidate(newplan, deadline));
                 }
                 //On the right
                 newplan.waypoint_list.clear();
@@ -618,8 +613,7 @@ bool ConflictSolver::deconflictCB(gauss_msgs::Deconfliction::Request &req, gauss
                         newplan.waypoint_list.push_back(traj1.waypoints.at(j + 1));
                     }
                     newplan.cost = pathDistance(newplan);
-                    newplan.riskiness = calculateRiskiness(newplan);
-                    res.deconfliction_plans.push_back(newplan);
+                    candidates.push_back(scoreCandidate(newplan, deadline));
                 }
                 //On the left
                 newplan.waypoint_list.clear();
@@ -639,8 +633,7 @@ bool ConflictSolver::deconflictCB(gauss_msgs::Deconfliction::Request &req, gauss
                         newplan.waypoint_list.push_back(traj1.waypoints.at(j + 1));
                     }
                     newplan.cost = pathDistance(newplan);
-                    newplan.riskiness = calculateRiskiness(newplan);
-                    res.deconfliction_plans.push_back(newplan);
+                    candidates.push_back(scoreCandidate(newplan, deadline));
                 }
             }
             res.message = "Conflict solved";
@@ -664,60 +657,55 @@ bool ConflictSolver::deconflictCB(gauss_msgs::Deconfliction::Request &req, gauss
                     }
                 }
             }
-            geometry_msgs::Polygon res_polygon;
-            if (geofences.front().cylinder_shape) {
-                res_polygon = circleToPolygon(geofences.front().circle.x_center,
-                                              geofences.front().circle.y_center,
-                                              geofences.front().circle.radius);
-            } else {
-                for (int i = 0; i < geofences.front().polygon.x.size(); i++) {
-                    geometry_msgs::Point32 temp_points;
-                    temp_points.x = geofences.front().polygon.x.at(i);
-                    temp_points.y = geofences.front().polygon.y.at(i);
-                    res_polygon.points.push_back(temp_points);
-                }
-            }
+            // Geofence polygon, and inflated to take operational volume into account
+            std::shared_ptr<const PreparedGeofence> prepared_geofence = prepared_geofence_cache_.get(geofences.front(), conflictive_operations.front().operational_volume * 1.1);
+            geometry_msgs::Polygon res_polygon = prepared_geofence->shape.polygon;
             // [1] Ruta a mi destino evitando una geofence
             geometry_msgs::Point init_astar_point, goal_astar_point, min_grid_point, max_grid_point;
             int init_astar_pos, goal_astar_pos;
-            geometry_msgs::Polygon polygon_test_input = res_polygon;
-            if (!geofences.front().cylinder_shape) {
-                polygon_test_input.points.push_back(polygon_test_input.points.front());
-            }
-            geometry_msgs::Polygon polygon_test_output;
-            decreasePolygon(polygon_test_input, -conflictive_operations.front().operational_volume*1.1, polygon_test_output); 
-            if (!geofences.front().cylinder_shape) {
-                polygon_test_output.points.pop_back();
-            }
-            init_astar_point = findInitAStarPoint(polygon_test_output, res_path, init_astar_pos);
-            goal_astar_point = findGoalAStarPoint(polygon_test_output, res_path, goal_astar_pos);
-            std::vector<double> grid_borders = findGridBorders(polygon_test_output, res_path, init_astar_point, goal_astar_point);
+            geometry_msgs::Polygon polygon_test_output = prepared_geofence->inflated.polygon;
+            init_astar_point = findInitAStarPoint(prepared_geofence->inflated, res_path, init_astar_pos);
+            goal_astar_point = findGoalAStarPoint(prepared_geofence->inflated, res_path, goal_astar_pos);
+            std::vector<double> grid_borders = findGridBorders(prepared_geofence->inflated, res_path, init_astar_point, goal_astar_point);
             min_grid_point.x = minX_;
             min_grid_point.y = minY_;
             max_grid_point.x = maxX_;
             max_grid_point.y = maxY_;
-            PathFinder path_finder(res_path, init_astar_point, goal_astar_point, polygon_test_output, min_grid_point, max_grid_point);
-            nav_msgs::Path a_star_path_res = path_finder.findNewPath();
-            std::vector<double> interp_times, a_star_times_res;
-            interp_times.push_back(res_times.at(init_astar_pos));
-            interp_times.push_back(res_times.at(goal_astar_pos));
-            a_star_times_res = path_finder.interpWaypointList(interp_times, a_star_path_res.poses.size() - 1);
-            a_star_times_res.push_back(res_times.at(goal_astar_pos));
-            // Solutions of conflict solver are a_star_path_res and a_star_times_res
-            gauss_msgs::Waypoint temp_wp;
-            gauss_msgs::DeconflictionPlan temp_wp_list;
-            for (int i = 0; i < a_star_path_res.poses.size(); i++) {
-                temp_wp.x = a_star_path_res.poses.at(i).pose.position.x;
-                temp_wp.y = a_star_path_res.poses.at(i).pose.position.y;
-                temp_wp.z = a_star_path_res.poses.at(i).pose.position.z;
-                temp_wp.stamp = ros::Time(a_star_times_res.at(i));
-                temp_wp_list.waypoint_list.push_back(temp_wp);
-            }
-            temp_wp_list.maneuver_type = 1;
-            temp_wp_list.cost = pathDistance(temp_wp_list);
-            temp_wp_list.riskiness = minDistanceToGeofence(temp_wp_list.waypoint_list, res_polygon);
-            temp_wp_list.uav_id = req.threat.uav_ids.front();
-            res.deconfliction_plans.push_back(temp_wp_list);
+            int geofence_id = geofences.front().id;
+            double inflation = conflictive_operations.front().operational_volume * 1.1;
+            int uav_id = req.threat.uav_ids.front();
+            double init_astar_time = res_times.at(init_astar_pos);
+            double goal_astar_time = res_times.at(goal_astar_pos);
+            // The A* search is the slowest candidate, it runs in its own task
+            candidates.push_back(launchCandidate([=]() mutable {
+                PathFinder path_finder(res_path, init_astar_point, goal_astar_point, polygon_test_output, min_grid_point, max_grid_point);
+                path_finder.setGridCache(&planner_grid_cache_, geofence_id, inflation);
+                path_finder.setRepairCache(&path_repair_cache_, uav_id);
+                path_finder.setDeadline(deadline);
+                nav_msgs::Path a_star_path_res = path_finder.findNewPath();
+                // Deadline reached before searching, an empty plan is dropped
+                if (a_star_path_res.poses.empty()) return gauss_msgs::DeconflictionPlan();
+                std::vector<double> interp_times, a_star_times_res;
+                interp_times.push_back(init_astar_time);
+                interp_times.push_back(goal_astar_time);
+                a_star_times_res = path_finder.interpWaypointList(interp_times, a_star_path_res.poses.size() - 1);
+                a_star_times_res.push_back(goal_astar_time);
+                // Solutions of conflict solver are a_star_path_res and a_star_times_res
+                gauss_msgs::Waypoint temp_wp;
+                gauss_msgs::DeconflictionPlan temp_wp_list;
+                for (int i = 0; i < a_star_path_res.poses.size(); i++) {
+                    temp_wp.x = a_star_path_res.poses.at(i).pose.position.x;
+                    temp_wp.y = a_star_path_res.poses.at(i).pose.position.y;
+                    temp_wp.z = a_star_path_res.poses.at(i).pose.position.z;
+                    temp_wp.stamp = ros::Time(a_star_times_res.at(i));
+                    temp_wp_list.waypoint_list.push_back(temp_wp);
+                }
+                temp_wp_list.maneuver_type = 1;
+                temp_wp_list.cost = pathDistance(temp_wp_list);
+                temp_wp_list.riskiness = minDistanceToGeofence(temp_wp_list.waypoint_list, res_polygon);
+                temp_wp_list.uav_id = uav_id;
+                return temp_wp_list;
+            }, deadline));
             // [3] Ruta que me manda devuelta a casa
             // temp_wp_list.waypoint_list.clear();
             // temp_wp.x = conflictive_operations.front().estimated_trajectory.waypoints.front().x;
@@ -756,19 +744,7 @@ bool ConflictSolver::deconflictCB(gauss_msgs::Deconfliction::Request &req, gauss
                     }
                 }
             }
-            geometry_msgs::Polygon res_polygon;
-            if (geofences.front().cylinder_shape) {
-                res_polygon = circleToPolygon(geofences.front().circle.x_center,
-                                              geofences.front().circle.y_center,
-                                              geofences.front().circle.radius);
-            } else {
-                for (int i = 0; i < geofences.front().polygon.x.size(); i++) {
-                    geometry_msgs::Point32 temp_points;
-                    temp_points.x = geofences.front().polygon.x.at(i);
-                    temp_points.y = geofences.front().polygon.y.at(i);
-                    res_polygon.points.push_back(temp_points);
-                }
-            }
+            geometry_msgs::Polygon res_polygon = prepared_geofence_cache_.get(geofences.front(), 0.0)->shape.polygon;
             // [6] Ruta a mi destino saliendo lo antes posible de la geofence
             // Get min distance to polygon border
             // gauss_msgs::Waypoint conflict_point;
@@ -955,9 +931,8 @@ bool ConflictSolver::deconflictCB(gauss_msgs::Deconfliction::Request &req, gauss
                 double distance = pointsDistance(conflictive_operations.front().estimated_trajectory.waypoints.front(), wp_land);
                 temp_wp_list.cost = distance;
                 temp_wp_list.waypoint_list.push_back(wp_land);
-                temp_wp_list.riskiness = calculateRiskiness(temp_wp_list);
                 temp_wp_list.uav_id = req.threat.uav_ids.front();
-                res.deconfliction_plans.push_back(temp_wp_list);
+                candidates.push_back(scoreCandidate(temp_wp_list, deadline));
             }
             // [5] Ruta que aterrice en un landing spot
             gauss_msgs::Waypoint temp_wp;
@@ -968,9 +943,8 @@ bool ConflictSolver::deconflictCB(gauss_msgs::Deconfliction::Request &req, gauss
             double distance = pointsDistance(conflictive_operations.front().estimated_trajectory.waypoints.front(), temp_wp);
             temp_wp_list.cost = distance;
             temp_wp_list.waypoint_list.push_back(temp_wp);
-            temp_wp_list.riskiness = calculateRiskiness(temp_wp_list);
             temp_wp_list.uav_id = req.threat.uav_ids.front();
-            res.deconfliction_plans.push_back(temp_wp_list);
+            candidates.push_back(scoreCandidate(temp_wp_list, deadline));
 
             res.message = "Conflict solved";
             res.success = true;
@@ -984,9 +958,8 @@ bool ConflictSolver::deconflictCB(gauss_msgs::Deconfliction::Request &req, gauss
                 double distance = pointsDistance(conflictive_operations.front().estimated_trajectory.waypoints.front(), wp_land);
                 temp_wp_list.cost = distance;
                 temp_wp_list.waypoint_list.push_back(wp_land);
-                temp_wp_list.riskiness = calculateRiskiness(temp_wp_list);
                 temp_wp_list.uav_id = req.threat.uav_ids.front();
-                res.deconfliction_plans.push_back(temp_wp_list);
+                candidates.push_back(scoreCandidate(temp_wp_list, deadline));
             }
             // [5] Ruta que aterrice en un landing spot
             gauss_msgs::Waypoint temp_wp;
@@ -997,14 +970,36 @@ bool ConflictSolver::deconflictCB(gauss_msgs::Deconfliction::Request &req, gauss
             double distance = pointsDistance(conflictive_operations.front().estimated_trajectory.waypoints.front(), temp_wp);
             temp_wp_list.cost = distance;
             temp_wp_list.waypoint_list.push_back(temp_wp);
-            temp_wp_list.riskiness = calculateRiskiness(temp_wp_list);
             temp_wp_list.uav_id = req.threat.uav_ids.front();
-            res.deconfliction_plans.push_back(temp_wp_list);
+            candidates.push_back(scoreCandidate(temp_wp_list, deadline));
 
             res.message = "Conflict solved";
             res.success = true;
         }
-        // ROS_INFO("[Tactical] Computational time: %0.4f", ros::Time::now().toSec() - start_computational_time);
+        // Plans not built as candidates are ready now
+        res.plan_times.assign(res.deconfliction_plans.size(), std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+        int dropped = collectCandidates(candidates, start, deadline, res.deconfliction_plans, res.plan_times);
+        res.deadline_reached = dropped > 0;
+        if (res.deconfliction_plans.empty() && !conflictive_operations.empty()) {
+            ROS_WARN("[Tactical] No plan found for threat [%d, %d], using the fallback maneuver", req.threat.threat_id, req.threat.threat_type);
+            res.deconfliction_plans.push_back(fallbackPlan(conflictive_operations.front()));
+            res.plan_times.push_back(std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+            res.fallback = true;
+            res.message = "Fallback maneuver";
+            res.success = true;
+        }
+        std::vector<int> order(res.deconfliction_plans.size());
+        for (size_t i = 0; i < order.size(); i++) order[i] = i;
+        std::stable_sort(order.begin(), order.end(), [&](int a, int b) { return res.deconfliction_plans[a].cost < res.deconfliction_plans[b].cost; });
+        std::vector<gauss_msgs::DeconflictionPlan> sorted_plans;
+        std::vector<double> sorted_times;
+        for (int i : order) {
+            sorted_plans.push_back(res.deconfliction_plans[i]);
+            sorted_times.push_back(res.plan_times[i]);
+        }
+        res.deconfliction_plans = sorted_plans;
+        res.plan_times = sorted_times;
+        res.computation_time = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
     }
     int cont = 1;
     for (auto plan : res.deconfliction_plans){
@@ -0,0 +1,383 @@
+#include <gauss_msgs/NewThreat.h>
+#include <ros/console.h>
+#include <ros/ros.h>
+#include <rosbag/bag.h>
+#include <rosbag/view.h>
+#include <tactical_deconfliction/prepared_geofence_cache.h>
+#include <tactical_deconfliction/tactical_deconfliction.h>
+
+#include <Eigen/Eigen>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <limits>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+
+// Offline benchmark of the tactical deconfliction. Threats recorded by tactical_deconfliction (threat_record_bag
+// param), or synthetic ones, are solved in this process without ROS master nor database, so the traffic is only the
+// conflictive operations of each threat.
+
+struct ThreatStats {
+    std::vector<double> latencies;
+    int fallbacks = 0;
+    int deadlines = 0;
+};
+
+struct ManeuverStats {
+    std::vector<double> plan_times;
+    double length = 0;
+    double mean_deviation = 0;
+    double max_deviation = 0;
+    double riskiness = 0;
+};
+
+const double START_TIME = 1000.0;  // [s] Stamp of the synthetic scenarios
+
+gauss_msgs::Waypoint waypoint(const Eigen::Vector3d &_p, double _t) {
+    gauss_msgs::Waypoint wp;
+    wp.x = _p.x();
+    wp.y = _p.y();
+    wp.z = _p.z();
+    wp.stamp.fromSec(_t);
+    return wp;
+}
+
+Eigen::Vector3d position(const gauss_msgs::Waypoint &_wp) {
+    return Eigen::Vector3d(_wp.x, _wp.y, _wp.z);
+}
+
+// Straight flight plan with a waypoint every 50 meters
+gauss_msgs::ConflictiveOperation straightOperation(int _uav_id, const Eigen::Vector3d &_from, const Eigen::Vector3d &_to, double _speed, double _operational_volume) {
+    const double step = 50.0;
+    gauss_msgs::ConflictiveOperation operation;
+    operation.uav_id = _uav_id;
+    operation.operational_volume = _operational_volume;
+    operation.current_wp = 0;
+    double length = (_to - _from).norm();
+    int count = std::max(1, (int)std::ceil(length / step));
+    for (int i = 0; i <= count; i++) {
+        double alpha = (double)i / count;
+        operation.flight_plan.waypoints.push_back(waypoint(_from + alpha * (_to - _from), START_TIME + alpha * length / _speed));
+    }
+    operation.flight_plan_updated = operation.flight_plan;
+    operation.estimated_trajectory = operation.flight_plan;
+    operation.actual_wp = operation.flight_plan.waypoints.front();
+    operation.landing_spots.waypoints.push_back(waypoint(Eigen::Vector3d(_from.x(), _from.y() + 50.0, 0.0), START_TIME));
+    return operation;
+}
+
+// Operation flying from the waypoint _first of its plan
+void advanceOperation(gauss_msgs::ConflictiveOperation &_operation, int _first) {
+    _operation.current_wp = _first;
+    _operation.actual_wp = _operation.flight_plan.waypoints.at(_first);
+    _operation.estimated_trajectory.waypoints.assign(_operation.flight_plan.waypoints.begin() + _first, _operation.flight_plan.waypoints.end());
+}
+
+gauss_msgs::Geofence syntheticGeofence(int _id, bool _cylinder, double _size, double _angle) {
+    gauss_msgs::Geofence geofence;
+    geofence.id = _id;
+    geofence.cylinder_shape = _cylinder;
+    geofence.min_altitude = 0.0;
+    geofence.max_altitude = 120.0;
+    if (_cylinder) {
+        geofence.circle.x_center = geofence.circle.y_center = 0.0;
+        geofence.circle.radius = _size;
+    } else {
+        // Square, open polygon as read from the database
+        for (int i = 0; i < 4; i++) {
+            geofence.polygon.x.push_back(_size * cos(_angle + i * M_PI / 2));
+            geofence.polygon.y.push_back(_size * sin(_angle + i * M_PI / 2));
+        }
+    }
+    return geofence;
+}
+
+gauss_msgs::NewThreat syntheticGeofenceThreat(int _id, bool _intrusion, bool _cylinder, std::mt19937 &_generator) {
+    std::uniform_real_distribution<double> size_distribution(40.0, 120.0), offset_distribution(-0.6, 0.6), angle_distribution(0.0, M_PI / 2), volume_distribution(5.0, 15.0);
+    double size = size_distribution(_generator);
+    double operational_volume = volume_distribution(_generator);
+    double y = offset_distribution(_generator) * size;
+    gauss_msgs::Geofence geofence = syntheticGeofence(_id % 100, _cylinder, size, angle_distribution(_generator));
+    gauss_msgs::ConflictiveOperation operation = straightOperation(_id % 100, Eigen::Vector3d(-400, y, 30), Eigen::Vector3d(400, y, 30), 10.0, operational_volume);
+    // Half chord of the circle around the geofence, waypoints further than it and the margin are out of the geofence
+    double bounding_radius = _cylinder ? size : size * sqrt(2.0);
+    double half_chord = sqrt(std::max(bounding_radius * bounding_radius - y * y, 0.0));
+    double margin = 3.0 * operational_volume;
+    std::vector<gauss_msgs::Waypoint> &plan = operation.flight_plan.waypoints;
+
+    gauss_msgs::NewThreat threat;
+    threat.threat_id = _id;
+    threat.uav_ids.push_back(operation.uav_id);
+    threat.geofence_ids.push_back(geofence.id);
+    threat.conflictive_geofences.push_back(geofence);
+    threat.geofence_conflictive_segments.crossing_0_out_vector.x = -half_chord;
+    threat.geofence_conflictive_segments.crossing_0_out_vector.y = y;
+    threat.geofence_conflictive_segments.crossing_1_out_vector.x = half_chord;
+    threat.geofence_conflictive_segments.crossing_1_out_vector.y = y;
+    int last = plan.size() - 1;
+    while (last > 0 && plan[last - 1].x > half_chord + margin) last--;
+    if (!_intrusion) {
+        threat.threat_type = gauss_msgs::NewThreat::GEOFENCE_CONFLICT;
+        size_t first = 0;
+        while (first + 1 < plan.size() && plan[first + 1].x < -half_chord - margin) first++;
+        threat.geofence_conflictive_segments.first_contiguous_segment.assign(plan.begin() + first, plan.begin() + last + 1);
+        threat.geofence_conflictive_segments.all_segments = threat.geofence_conflictive_segments.first_contiguous_segment;
+    } else {
+        // Inside the geofence, the exit is the closest point of its border
+        threat.threat_type = gauss_msgs::NewThreat::GEOFENCE_INTRUSION;
+        size_t inside = 0;
+        while (inside + 1 < plan.size() && plan[inside].x < -0.5 * half_chord) inside++;
+        advanceOperation(operation, inside);
+        geometry_msgs::Polygon border = _cylinder ? circleToPolygon(0.0, 0.0, size, 33) : geometry_msgs::Polygon();
+        for (size_t i = 0; !_cylinder && i < geofence.polygon.x.size(); i++) {
+            geometry_msgs::Point32 vertex;
+            vertex.x = geofence.polygon.x[i];
+            vertex.y = geofence.polygon.y[i];
+            border.points.push_back(vertex);
+        }
+        Eigen::Vector2d actual(operation.actual_wp.x, operation.actual_wp.y), closest = actual;
+        double min_distance = std::numeric_limits<double>::max();
+        for (size_t i = 0, j = border.points.size() - 1; i < border.points.size(); j = i++) {
+            Eigen::Vector2d a(border.points[j].x, border.points[j].y), b(border.points[i].x, border.points[i].y);
+            double t = (b - a).squaredNorm() > 0 ? std::min(std::max((actual - a).dot(b - a) / (b - a).squaredNorm(), 0.0), 1.0) : 0.0;
+            Eigen::Vector2d candidate = a + t * (b - a);
+            if ((candidate - actual).norm() < min_distance) {
+                min_distance = (candidate - actual).norm();
+                closest = candidate;
+            }
+        }
+        gauss_msgs::Waypoint exit_wp = operation.actual_wp;
+        exit_wp.x = closest.x();
+        exit_wp.y = closest.y();
+        threat.geofence_conflictive_segments.closest_exit_wp = exit_wp;
+        threat.geofence_conflictive_segments.closest_exit_out_vector.x = closest.x();
+        threat.geofence_conflictive_segments.closest_exit_out_vector.y = closest.y();
+        threat.geofence_conflictive_segments.all_segments.assign(plan.begin() + inside, plan.begin() + last + 1);
+        threat.geofence_conflictive_segments.first_contiguous_segment = threat.geofence_conflictive_segments.all_segments;
+    }
+    threat.conflictive_operations.push_back(operation);
+    threat.location = operation.actual_wp;
+    threat.times.push_back(operation.actual_wp.stamp);
+    return threat;
+}
+
+gauss_msgs::NewThreat syntheticLossOfSeparationThreat(int _id, std::mt19937 &_generator) {
+    std::uniform_real_distribution<double> angle_distribution(M_PI / 4, 3 * M_PI / 4), height_distribution(-5.0, 5.0), volume_distribution(5.0, 10.0);
+    std::uniform_int_distribution<int> priority_distribution(1, 2);
+    const double speed = 10.0;
+    const double half_length = 300.0;
+    // Both uavs reach the origin at the same time
+    double angle = angle_distribution(_generator);
+    Eigen::Vector3d first_direction(1, 0, 0), second_direction(cos(angle), sin(angle), 0);
+    Eigen::Vector3d first_center(0, 0, 30), second_center(0, 0, 30 + height_distribution(_generator));
+    std::vector<gauss_msgs::ConflictiveOperation> operations;
+    operations.push_back(straightOperation((2 * _id) % 100, first_center - half_length * first_direction, first_center + half_length * first_direction, speed, volume_distribution(_generator)));
+    operations.push_back(straightOperation((2 * _id + 1) % 100, second_center - half_length * second_direction, second_center + half_length * second_direction, speed, volume_distribution(_generator)));
+    double t_min = START_TIME + half_length / speed;
+
+    gauss_msgs::NewThreat threat;
+    threat.threat_type = gauss_msgs::NewThreat::LOSS_OF_SEPARATION;
+    threat.threat_id = _id;
+    std::vector<std::vector<gauss_msgs::Waypoint>> segments(2);
+    for (int i = 0; i < 2; i++) {
+        advanceOperation(operations[i], 2);
+        for (auto wp : operations[i].estimated_trajectory.waypoints) {
+            if (std::fabs(wp.stamp.toSec() - t_min) <= 10.0) segments[i].push_back(wp);
+        }
+        threat.uav_ids.push_back(operations[i].uav_id);
+        threat.priority_ops.push_back(priority_distribution(_generator));
+        threat.times.push_back(ros::Time(t_min));
+        threat.conflictive_operations.push_back(operations[i]);
+    }
+    threat.loss_conflictive_segments.segment_first = segments[0];
+    threat.loss_conflictive_segments.segment_second = segments[1];
+    threat.loss_conflictive_segments.point_at_t_min_segment_first = waypoint(first_center, t_min);
+    threat.loss_conflictive_segments.point_at_t_min_segment_second = waypoint(second_center, t_min);
+    threat.loss_conflictive_segments.t_min = t_min;
+    threat.location = threat.loss_conflictive_segments.point_at_t_min_segment_first;
+    return threat;
+}
+
+std::vector<gauss_msgs::NewThreat> syntheticThreats(int _count, int _seed) {
+    std::mt19937 generator(_seed);
+    std::vector<gauss_msgs::NewThreat> threats;
+    for (int i = 0; i < _count; i++) {
+        switch (i % 4) {
+            case 0: threats.push_back(syntheticGeofenceThreat(i, false, true, generator)); break;
+            case 1: threats.push_back(syntheticGeofenceThreat(i, false, false, generator)); break;
+            case 2: threats.push_back(syntheticGeofenceThreat(i, true, true, generator)); break;
+            default: threats.push_back(syntheticLossOfSeparationThreat(i, generator)); break;
+        }
+    }
+    return threats;
+}
+
+bool readThreats(const std::string &_file_name, std::vector<gauss_msgs::NewThreat> &_threats) {
+    // Every NewThreat of the bag, whatever its topic
+    try {
+        rosbag::Bag bag;
+        bag.open(_file_name, rosbag::bagmode::Read);
+        rosbag::View view(bag);
+        for (const rosbag::MessageInstance &message : view) {
+            boost::shared_ptr<gauss_msgs::NewThreat> threat = message.instantiate<gauss_msgs::NewThreat>();
+            if (threat) _threats.push_back(*threat);
+        }
+        bag.close();
+    } catch (rosbag::BagException &e) {
+        ROS_ERROR("[Benchmark] Failed reading %s: %s", _file_name.c_str(), e.what());
+        return false;
+    }
+    return true;
+}
+
+double pathLength(const std::vector<gauss_msgs::Waypoint> &_path) {
+    double length = 0;
+    for (size_t i = 1; i < _path.size(); i++) length += (position(_path[i]) - position(_path[i - 1])).norm();
+    return length;
+}
+
+double distanceToPath(const Eigen::Vector3d &_point, const std::vector<gauss_msgs::Waypoint> &_path) {
+    if (_path.empty()) return 0;
+    double min_distance = (_point - position(_path.front())).norm();
+    for (size_t i = 1; i < _path.size(); i++) {
+        Eigen::Vector3d a = position(_path[i - 1]), b = position(_path[i]);
+        double t = (b - a).squaredNorm() > 0 ? std::min(std::max((_point - a).dot(b - a) / (b - a).squaredNorm(), 0.0), 1.0) : 0.0;
+        min_distance = std::min(min_distance, (_point - (a + t * (b - a))).norm());
+    }
+    return min_distance;
+}
+
+double percentile(std::vector<double> _values, double _p) {
+    // Nearest rank
+    if (_values.empty()) return 0;
+    std::sort(_values.begin(), _values.end());
+    int rank = std::max(0, (int)std::ceil(_p * _values.size()) - 1);
+    return _values[std::min(rank, (int)_values.size() - 1)];
+}
+
+std::string threatName(int _threat_type) {
+    switch (_threat_type) {
+        case gauss_msgs::NewThreat::LOSS_OF_SEPARATION: return "LOSS_OF_SEPARATION";
+        case gauss_msgs::NewThreat::GEOFENCE_INTRUSION: return "GEOFENCE_INTRUSION";
+        case gauss_msgs::NewThreat::UAS_OUT_OV: return "UAS_OUT_OV";
+        case gauss_msgs::NewThreat::GEOFENCE_CONFLICT: return "GEOFENCE_CONFLICT";
+        case gauss_msgs::NewThreat::LACK_OF_BATTERY: return "LACK_OF_BATTERY";
+        case gauss_msgs::NewThreat::GNSS_DEGRADATION: return "GNSS_DEGRADATION";
+        default: return "THREAT_" + std::to_string(_threat_type);
+    }
+}
+
+void printUsage() {
+    printf("Usage: deconfliction_benchmark [options]\n");
+    printf("  --bag <file>        Threats recorded by tactical_deconfliction, or any bag with gauss_msgs/NewThreat\n");
+    printf("  --synthetic <n>     Add n synthetic threats (100 if no bag is given)\n");
+    printf("  --seed <s>          Seed of the synthetic threats (0)\n");
+    printf("  --deadline <s>      Deconfliction deadline of each threat (2.0)\n");
+    printf("  --repeat <n>        Solve every threat n times (1)\n");
+    printf("  --max-p99 <ms>      Fail if the p99 latency over all the threats is larger\n");
+}
+
+int main(int argc, char **argv) {
+    std::string bag_file;
+    int synthetic_count = -1, seed = 0, repeat = 1;
+    double deadline = 2.0, max_p99 = -1;
+    for (int i = 1; i < argc; i++) {
+        std::string option = argv[i];
+        if (option == "--help" || option == "-h") {
+            printUsage();
+            return 0;
+        }
+        if (i + 1 >= argc) {
+            printUsage();
+            return 2;
+        }
+        std::string value = argv[++i];
+        if (option == "--bag") bag_file = value;
+        else if (option == "--synthetic") synthetic_count = std::atoi(value.c_str());
+        else if (option == "--seed") seed = std::atoi(value.c_str());
+        else if (option == "--deadline") deadline = std::atof(value.c_str());
+        else if (option == "--repeat") repeat = std::max(1, std::atoi(value.c_str()));
+        else if (option == "--max-p99") max_p99 = std::atof(value.c_str());
+        else {
+            printUsage();
+            return 2;
+        }
+    }
+    ros::Time::init();
+    if (ros::console::set_logger_level(ROSCONSOLE_DEFAULT_NAME, ros::console::levels::Error)) ros::console::notifyLoggerLevelsChanged();
+
+    std::vector<gauss_msgs::NewThreat> threats;
+    if (!bag_file.empty() && !readThreats(bag_file, threats)) return 2;
+    if (synthetic_count < 0) synthetic_count = bag_file.empty() ? 100 : 0;
+    std::vector<gauss_msgs::NewThreat> synthetic_threats = syntheticThreats(synthetic_count, seed);
+    threats.insert(threats.end(), synthetic_threats.begin(), synthetic_threats.end());
+    if (threats.empty()) {
+        printf("No threats to solve\n");
+        return 2;
+    }
+
+    std::map<int, ThreatStats> threat_stats;
+    std::map<int, ManeuverStats> maneuver_stats;
+    std::vector<double> all_latencies;
+    for (int run = 0; run < repeat; run++) {
+        for (auto recorded_threat : threats) {
+            gauss_msgs::NewThreat threat = recorded_threat;  // Deconfliction modifies its threat
+            std::vector<gauss_msgs::DeconflictionPlan> plans;
+            std::vector<double> plan_times;
+            DeconflictionBudget budget(deadline);
+            bool solved = deconflictThreat(threat, budget, plans, plan_times);
+            double latency = budget.elapsed();
+            ThreatStats &stats = threat_stats[threat.threat_type];
+            stats.latencies.push_back(latency);
+            all_latencies.push_back(latency);
+            if (!solved) stats.fallbacks++;
+            if (budget.reached) stats.deadlines++;
+            for (size_t i = 0; i < plans.size(); i++) {
+                // Deviation of every waypoint from the original flight plan of the uav
+                std::vector<gauss_msgs::Waypoint> flight_plan;
+                for (auto operation : recorded_threat.conflictive_operations) {
+                    if (operation.uav_id == plans[i].uav_id) flight_plan = operation.flight_plan.waypoints;
+                }
+                double deviation_sum = 0, max_deviation = 0;
+                for (auto wp : plans[i].waypoint_list) {
+                    double deviation = distanceToPath(position(wp), flight_plan);
+                    deviation_sum += deviation;
+                    max_deviation = std::max(max_deviation, deviation);
+                }
+                ManeuverStats &maneuver = maneuver_stats[plans[i].maneuver_type];
+                maneuver.plan_times.push_back(i < plan_times.size() ? plan_times[i] : latency);
+                maneuver.length += pathLength(plans[i].waypoint_list);
+                maneuver.mean_deviation += plans[i].waypoint_list.empty() ? 0.0 : deviation_sum / plans[i].waypoint_list.size();
+                maneuver.max_deviation = std::max(maneuver.max_deviation, max_deviation);
+                maneuver.riskiness += plans[i].riskiness;
+            }
+        }
+    }
+
+    printf("%zu threats, %d runs, deadline %.3f s\n\n", threats.size(), repeat, deadline);
+    printf("%-20s %7s %10s %10s %10s %9s %9s\n", "threat", "count", "p50 [ms]", "p99 [ms]", "max [ms]", "fallback", "deadline");
+    for (auto &item : threat_stats) {
+        const ThreatStats &stats = item.second;
+        printf("%-20s %7zu %10.3f %10.3f %10.3f %9d %9d\n", threatName(item.first).c_str(), stats.latencies.size(), 1e3 * percentile(stats.latencies, 0.5),
+               1e3 * percentile(stats.latencies, 0.99), 1e3 * percentile(stats.latencies, 1.0), stats.fallbacks, stats.deadlines);
+    }
+    printf("%-20s %7zu %10.3f %10.3f %10.3f\n\n", "all", all_latencies.size(), 1e3 * percentile(all_latencies, 0.5), 1e3 * percentile(all_latencies, 0.99), 1e3 * percentile(all_latencies, 1.0));
+    printf("%-9s %7s %14s %12s %15s %15s %10s\n", "maneuver", "count", "p50 plan [ms]", "length [m]", "deviation [m]", "max dev. [m]", "riskiness");
+    for (auto &item : maneuver_stats) {
+        const ManeuverStats &stats = item.second;
+        int count = stats.plan_times.size();
+        printf("%-9d %7d %14.3f %12.1f %15.1f %15.1f %10.2f\n", item.first, count, 1e3 * percentile(stats.plan_times, 0.5), stats.length / count,
+               stats.mean_deviation / count, stats.max_deviation, stats.riskiness / count);
+    }
+
+    double p99 = 1e3 * percentile(all_latencies, 0.99);
+    if (max_p99 >= 0 && p99 > max_p99) {
+        printf("\nFAILED: p99 latency %.3f ms is larger than %.3f ms\n", p99, max_p99);
+        return 1;
+    }
+    return 0;
+}
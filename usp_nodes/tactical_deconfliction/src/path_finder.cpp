@@ -19,9 +19,9 @@
 
 #include <tactical_deconfliction/path_finder.h>
 
-PathFinder::PathFinder(nav_msgs::Path &_init_path, geometry_msgs::Point &_init_astar_point, geometry_msgs::Point &_goal_astar_point, geometry_msgs::Polygon &_polygon, geometry_msgs::Point &_min_grid_point, geometry_msgs::Point &_max_grid_point) {
+PathFinder::PathFinder(nav_msgs::Path &_init_path, geometry_msgs::Point &_init_astar_point, geometry_msgs::Point &_goal_astar_point, geometry_msgs::Polygon &_polygon, geometry_msgs::Point &_min_grid_point, geometry_msgs::Point &_max_grid_point)
+    : grid_cache_(nullptr), repair_cache_(nullptr), uav_id_(-1), geofence_id_(-1), inflation_(0.0), deadline_(std::chrono::steady_clock::time_point::max()) {
     init_path_ = _init_path;
-    target_path_ = generatePath(init_path_);
     init_astar_point_ = _init_astar_point;
     goal_astar_point_ = _goal_astar_point;
     polygon_ = _polygon;
@@ -31,7 +31,18 @@ PathFinder::PathFinder(nav_msgs::Path &_init_path, geometry_msgs::Point &_init_a
     y_max_ = std::max(_min_grid_point.y, _max_grid_point.y);
 }
 
-PathFinder::PathFinder(){
+PathFinder::PathFinder() : grid_cache_(nullptr), repair_cache_(nullptr), uav_id_(-1), geofence_id_(-1), inflation_(0.0), deadline_(std::chrono::steady_clock::time_point::max()) {
+}
+
+void PathFinder::setGridCache(PlannerGridCache *_grid_cache, int _geofence_id, double _inflation) {
+    grid_cache_ = _grid_cache;
+    geofence_id_ = _geofence_id;
+    inflation_ = _inflation;
+}
+
+void PathFinder::setRepairCache(PathRepairCache *_repair_cache, int _uav_id) {
+    repair_cache_ = _repair_cache;
+    uav_id_ = _uav_id;
 }
 
 PathFinder::~PathFinder() {
@@ -72,68 +83,73 @@ int PathFinder::nearestNeighbourIndex(std::vector<double> &_x, double &_value) {
 
 std::vector<double> PathFinder::linealInterp1(std::vector<double> &_x, std::vector<double> &_y, std::vector<double> &_x_new) {
     std::vector<double> y_new;
-    double dx, dy, m, b;
-    size_t x_max_idx = _x.size() - 1;
     size_t x_new_size = _x_new.size();
-
     y_new.reserve(x_new_size);
+    if (_x.size() < 2) {
+        y_new.assign(x_new_size, _x.empty() ? 0.0 : _y.front());
+        return y_new;
+    }
 
+    // _x is sorted, so the segment of each new point is found walking from the segment of the previous one.
+    // If _x_new is sorted too, the whole interpolation is a single pass over both vectors
+    size_t idx = 0;
+    size_t last_segment = _x.size() - 2;
     for (size_t i = 0; i < x_new_size; ++i) {
-        size_t idx = nearestNeighbourIndex(_x, _x_new[i]);
-
-        if (_x[idx] > _x_new[i]) {
-            dx = idx > 0 ? (_x[idx] - _x[idx - 1]) : (_x[idx + 1] - _x[idx]);
-            dy = idx > 0 ? (_y[idx] - _y[idx - 1]) : (_y[idx + 1] - _y[idx]);
-        } else {
-            dx = idx < x_max_idx ? (_x[idx + 1] - _x[idx]) : (_x[idx] - _x[idx - 1]);
-            dy = idx < x_max_idx ? (_y[idx + 1] - _y[idx]) : (_y[idx] - _y[idx - 1]);
-        }
-
-        m = dy / dx;
-        b = _y[idx] - _x[idx] * m;
+        while (idx < last_segment && _x[idx + 1] <= _x_new[i]) idx++;
+        while (idx > 0 && _x[idx] > _x_new[i]) idx--;
 
-        y_new.push_back(_x_new[i] * m + b);
+        // Points out of _x are extrapolated with the first or last segment
+        double m = (_y[idx + 1] - _y[idx]) / (_x[idx + 1] - _x[idx]);
+        y_new.push_back(_y[idx] + (_x_new[i] - _x[idx]) * m);
     }
 
     return y_new;
 }
 
-nav_msgs::Path PathFinder::generatePath(nav_msgs::Path &_init_path, int _generator_mode, double _d_between_wps) {
-    std::vector<double> list_pose_x, list_pose_y, list_pose_z, list_pose_t;
-    for (int i = 0; i < _init_path.poses.size(); i++) {
-        list_pose_x.push_back(_init_path.poses.at(i).pose.position.x);
-        list_pose_y.push_back(_init_path.poses.at(i).pose.position.y);
-        list_pose_z.push_back(_init_path.poses.at(i).pose.position.z);
-        list_pose_t.push_back(_init_path.poses.at(i).header.stamp.toSec());
-    }
-    int total_distance = 0;
-
-    for (int i = 0; i < _init_path.poses.size() - 1; i++) {
-        Eigen::Vector3f point_1, point_2;
-        point_1 = Eigen::Vector3f(list_pose_x[i], list_pose_y[i], list_pose_z[i]);
-        point_2 = Eigen::Vector3f(list_pose_x[i + 1], list_pose_y[i + 1], list_pose_z[i + 1]);
-        total_distance = total_distance + (point_2 - point_1).norm();
-    }
-    int interp1_final_size_ = total_distance / _d_between_wps;
-    // CreatePathInterp1
-    std::vector<double> interp1_list_x, interp1_list_y, interp1_list_z, interp1_list_t;
-    interp1_list_x = interpWaypointList(list_pose_x, interp1_final_size_);
-    interp1_list_y = interpWaypointList(list_pose_y, interp1_final_size_);
-    interp1_list_z = interpWaypointList(list_pose_z, interp1_final_size_);
-    interp1_list_t = interpWaypointList(list_pose_t, interp1_final_size_);
+nav_msgs::Path PathFinder::generatePath(nav_msgs::Path &_init_path, int _generator_mode, double _d_between_wps, int _max_wps) {
     nav_msgs::Path out_path_;
-    std::vector<geometry_msgs::PoseStamped> poses(interp1_final_size_);
-    for (int i = 0; i < interp1_list_x.size(); i++) {
-        poses.at(i).pose.position.x = interp1_list_x[i];
-        poses.at(i).pose.position.y = interp1_list_y[i];
-        poses.at(i).pose.position.z = interp1_list_z[i];
-        poses.at(i).pose.orientation.x = 0;
-        poses.at(i).pose.orientation.y = 0;
-        poses.at(i).pose.orientation.z = 0;
-        poses.at(i).pose.orientation.w = 1;
-        poses.at(i).header.stamp.fromSec(interp1_list_t[i]);
+    int init_size = _init_path.poses.size();
+    if (init_size == 0) return out_path_;
+
+    // Length of the path up to each waypoint
+    std::vector<double> arc_length(init_size, 0.0);
+    for (int i = 1; i < init_size; i++) {
+        const geometry_msgs::Point &point_1 = _init_path.poses[i - 1].pose.position;
+        const geometry_msgs::Point &point_2 = _init_path.poses[i].pose.position;
+        arc_length[i] = arc_length[i - 1] + Eigen::Vector3d(point_2.x - point_1.x, point_2.y - point_1.y, point_2.z - point_1.z).norm();
+    }
+    double total_distance = arc_length.back();
+    int final_size = _d_between_wps > 0 ? total_distance / _d_between_wps : 0;
+    if (_max_wps > 0 && final_size > _max_wps) final_size = _max_wps;
+    if (final_size < 1) final_size = 1;
+    double step = total_distance / final_size;
+
+    // Waypoints are generated walking the init path once, all axes and time at the same time
+    out_path_.poses.resize(final_size);
+    int segment = 0;
+    for (int i = 0; i < final_size; i++) {
+        double distance = i * step;
+        while (segment < init_size - 2 && arc_length[segment + 1] < distance) segment++;
+        geometry_msgs::PoseStamped &pose = out_path_.poses[i];
+        const geometry_msgs::PoseStamped &pose_a = _init_path.poses[segment];
+        if (init_size == 1) {
+            pose.pose.position = pose_a.pose.position;
+            pose.header.stamp = pose_a.header.stamp;
+        } else {
+            const geometry_msgs::PoseStamped &pose_b = _init_path.poses[segment + 1];
+            double segment_length = arc_length[segment + 1] - arc_length[segment];
+            double alpha = segment_length > 0 ? (distance - arc_length[segment]) / segment_length : 0.0;
+            pose.pose.position.x = pose_a.pose.position.x + alpha * (pose_b.pose.position.x - pose_a.pose.position.x);
+            pose.pose.position.y = pose_a.pose.position.y + alpha * (pose_b.pose.position.y - pose_a.pose.position.y);
+            pose.pose.position.z = pose_a.pose.position.z + alpha * (pose_b.pose.position.z - pose_a.pose.position.z);
+            double stamp_a = pose_a.header.stamp.toSec();
+            pose.header.stamp.fromSec(stamp_a + alpha * (pose_b.header.stamp.toSec() - stamp_a));
+        }
+        pose.pose.orientation.x = 0;
+        pose.pose.orientation.y = 0;
+        pose.pose.orientation.z = 0;
+        pose.pose.orientation.w = 1;
     }
-    out_path_.poses = poses;
 
     return out_path_;
 }
@@ -156,6 +172,39 @@ nav_msgs::Path PathFinder::createPathFromPlanner(std::vector<geometry_msgs::Poin
 }
 
 nav_msgs::Path PathFinder::findNewPath() {
+    std::vector<geometry_msgs::Point> a_star_getpath;
+    // A persisting threat is solved repairing the previous solution if possible, searching again only if it is not valid
+    if (!repair_cache_ || !repair_cache_->repair(uav_id_, geofence_id_, polygon_, init_astar_point_, goal_astar_point_, a_star_getpath)) {
+        int max_grid_side;
+        if (x_max_ - x_min_ >= y_max_ - y_min_) max_grid_side = x_max_ - x_min_;
+        else max_grid_side = y_max_ - y_min_;
+        // Rasterizing the grid is skipped if the same geofence has already been deconflicted with this grid
+        std::shared_ptr<PlannerGridCache::SharedPlanner> path_planner;
+        PlannerGridCache::Key grid_key = {geofence_id_, inflation_, x_min_, y_min_, x_max_, y_max_, max_grid_side};
+        if (grid_cache_) path_planner = grid_cache_->find(grid_key, polygon_);
+        if (!path_planner) {
+            if (std::chrono::steady_clock::now() >= deadline_) return nav_msgs::Path();
+            path_planner = std::make_shared<PlannerGridCache::SharedPlanner>(createPlanner(max_grid_side));
+            if (grid_cache_) grid_cache_->insert(grid_key, polygon_, path_planner);
+        }
+        if (!path_planner->getPath(init_astar_point_, goal_astar_point_, deadline_, a_star_getpath)) return nav_msgs::Path();
+        if (repair_cache_ && !a_star_getpath.empty()) repair_cache_->store(uav_id_, geofence_id_, polygon_, init_astar_point_, goal_astar_point_, a_star_getpath);
+    }
+    nav_msgs::Path a_star_path_res = createPathFromPlanner(a_star_getpath, init_astar_point_, init_path_.poses.front().pose.position.z);
+    // Linear interpolation for Z axis
+    std::vector<double> default_z, interp1_z;
+    default_z.push_back(init_astar_point_.z);
+    default_z.push_back(goal_astar_point_.z);
+    interp1_z = interpWaypointList(default_z, a_star_path_res.poses.size() - 1);
+    for (int i = 0; i < interp1_z.size(); i++) {
+        a_star_path_res.poses.at(i).pose.position.z = interp1_z.at(i);
+    }
+    a_star_path_res.poses.back().pose.position.z = goal_astar_point_.z;
+
+    return a_star_path_res;
+}
+
+std::shared_ptr<grvc::PathPlanner> PathFinder::createPlanner(int _max_grid_side) {
     std::vector<geometry_msgs::Polygon> vec_obstacles;
     vec_obstacles.push_back(polygon_);
     geometry_msgs::Polygon grid_borders;
@@ -180,22 +229,5 @@ nav_msgs::Path PathFinder::findNewPath() {
     temp_point.y = y_min_;
     grid_borders.points.push_back(temp_point);
     grid_borders.points.push_back(temp_point);
-    // Call path planner A*
-    int max_grid_side;
-    if (x_max_ - x_min_ >= y_max_ - y_min_) max_grid_side = x_max_ - x_min_;
-    else max_grid_side = y_max_ - y_min_;
-    grvc::PathPlanner path_planner(vec_obstacles, grid_borders, max_grid_side);
-    std::vector<geometry_msgs::Point> a_star_getpath = path_planner.getPath(init_astar_point_, goal_astar_point_);
-    nav_msgs::Path a_star_path_res = createPathFromPlanner(a_star_getpath, init_astar_point_, target_path_.poses.front().pose.position.z);
-    // Linear interpolation for Z axis
-    std::vector<double> default_z, interp1_z;
-    default_z.push_back(init_astar_point_.z);
-    default_z.push_back(goal_astar_point_.z);
-    interp1_z = interpWaypointList(default_z, a_star_path_res.poses.size() - 1);
-    for (int i = 0; i < interp1_z.size(); i++) {
-        a_star_path_res.poses.at(i).pose.position.z = interp1_z.at(i);
-    }
-    a_star_path_res.poses.back().pose.position.z = goal_astar_point_.z;
-
-    return a_star_path_res;
+    return std::make_shared<grvc::PathPlanner>(vec_obstacles, grid_borders, _max_grid_side);
 }
\ No newline at end of file
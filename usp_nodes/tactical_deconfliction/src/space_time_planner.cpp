@@ -0,0 +1,229 @@
+//----------------------------------------------------------------------------------------------------------------------
+// The MIT License (MIT)
+//
+// Copyright (c) 2018 GRVC University of Seville
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+// documentation files (the "Software"), to deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies or substantial portions of the
+// Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+// WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS
+// OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+// OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//----------------------------------------------------------------------------------------------------------------------
+
+#include <tactical_deconfliction/space_time_planner.h>
+
+#include <algorithm>
+#include <functional>
+#include <limits>
+#include <queue>
+
+SpaceTimePlanner::SpaceTimePlanner(const TrajectoryIndex &_index)
+    : index_(_index), resolution_(10.0), max_cells_per_axis_(40), max_expansions_(20000), deadline_(std::chrono::steady_clock::time_point::max()), min_z_(-std::numeric_limits<double>::max()),
+      max_z_(std::numeric_limits<double>::max()), radius_(0.0), min_separation_(0.0), uav_id_(-1) {
+}
+
+SpaceTimePlanner::~SpaceTimePlanner() {
+}
+
+void SpaceTimePlanner::setResolution(double _resolution, int _max_cells_per_axis) {
+    resolution_ = _resolution;
+    max_cells_per_axis_ = std::max(_max_cells_per_axis, 2);
+}
+
+void SpaceTimePlanner::setMaxExpansions(int _max_expansions) {
+    max_expansions_ = _max_expansions;
+}
+
+void SpaceTimePlanner::setDeadline(const std::chrono::steady_clock::time_point &_deadline) {
+    deadline_ = _deadline;
+}
+
+void SpaceTimePlanner::setAltitudeLimits(double _min_z, double _max_z) {
+    min_z_ = _min_z;
+    max_z_ = _max_z;
+}
+
+void SpaceTimePlanner::setSeparation(double _radius, double _min_separation) {
+    radius_ = _radius;
+    min_separation_ = _min_separation;
+}
+
+bool SpaceTimePlanner::edgeFree(const Eigen::Vector3d &_p0, double _t0, const Eigen::Vector3d &_p1, double _t1) const {
+    index_.query(_p0.cwiseMin(_p1), _p0.cwiseMax(_p1), _t0, _t1, std::max(min_separation_, radius_), uav_id_, candidates_);
+    Eigen::Vector3d velocity = _t1 > _t0 ? Eigen::Vector3d((_p1 - _p0) / (_t1 - _t0)) : Eigen::Vector3d::Zero();
+    for (int id : candidates_) {
+        const TrajectoryIndex::Segment &segment = index_.segment(id);
+        double a = std::max(_t0, segment.t0);
+        double b = std::min(_t1, segment.t1);
+        if (a > b) continue;
+        Eigen::Vector3d other_velocity = segment.t1 > segment.t0 ? Eigen::Vector3d((segment.p1 - segment.p0) / (segment.t1 - segment.t0)) : Eigen::Vector3d::Zero();
+        // Relative position is linear in time during the overlap [a, b], get its minimum norm
+        Eigen::Vector3d relative = (_p0 + velocity * (a - _t0)) - (segment.p0 + other_velocity * (a - segment.t0));
+        Eigen::Vector3d relative_velocity = velocity - other_velocity;
+        double tau = 0.0;
+        if (relative_velocity.squaredNorm() > 0) tau = std::min(std::max(-relative.dot(relative_velocity) / relative_velocity.squaredNorm(), 0.0), b - a);
+        double required = std::max(min_separation_, radius_ + segment.radius);
+        if ((relative + relative_velocity * tau).norm() >= required) continue;
+        // Already too close when the edge starts, accepted if the edge moves away
+        if (a == _t0 && tau == 0.0) continue;
+        return false;
+    }
+    return true;
+}
+
+void SpaceTimePlanner::simplifyPath(std::vector<Eigen::Vector3d> &_points, std::vector<double> &_times, double _speed) const {
+    // Points in the middle of a straight leg do not change the timing
+    std::vector<Eigen::Vector3d> points;
+    std::vector<double> times;
+    for (size_t i = 0; i < _points.size(); i++) {
+        if (i > 0 && _points[i] == points.back()) continue;
+        if (i > 0 && i + 1 < _points.size()) {
+            Eigen::Vector3d in = _points[i] - _points[i - 1];
+            Eigen::Vector3d out = _points[i + 1] - _points[i];
+            if (in.cross(out).norm() <= 1e-9 * in.norm() * out.norm() && in.dot(out) > 0) continue;
+        }
+        points.push_back(_points[i]);
+        times.push_back(_times[i]);
+    }
+    _points = points;
+    _times = times;
+    if (_points.size() < 3) return;
+
+    // Shortcuts arrive earlier, so every leg after one is checked again with its new times. If any fails the lattice
+    // path is kept
+    std::vector<Eigen::Vector3d> shortcut_points(1, _points.front());
+    std::vector<double> shortcut_times(1, _times.front());
+    size_t current = 0;
+    while (current + 1 < _points.size()) {
+        if (std::chrono::steady_clock::now() >= deadline_) return;
+        // Points after current only, 0 if none is reachable
+        size_t next = 0;
+        double next_time = 0;
+        for (size_t j = _points.size() - 1; j > current && next == 0; j--) {
+            double time = shortcut_times.back() + (_points[j] - shortcut_points.back()).norm() / _speed;
+            if (edgeFree(shortcut_points.back(), shortcut_times.back(), _points[j], time)) {
+                next = j;
+                next_time = time;
+            }
+        }
+        if (next == 0) return;
+        shortcut_points.push_back(_points[next]);
+        shortcut_times.push_back(next_time);
+        current = next;
+    }
+    _points = shortcut_points;
+    _times = shortcut_times;
+}
+
+bool SpaceTimePlanner::pathFree(int _uav_id, const std::vector<gauss_msgs::Waypoint> &_path) {
+    uav_id_ = _uav_id;
+    for (size_t i = 0; i + 1 < _path.size(); i++) {
+        double t0 = _path[i].stamp.toSec();
+        double t1 = _path[i + 1].stamp.toSec();
+        if (t1 < t0) continue;
+        if (!edgeFree(Eigen::Vector3d(_path[i].x, _path[i].y, _path[i].z), t0, Eigen::Vector3d(_path[i + 1].x, _path[i + 1].y, _path[i + 1].z), t1)) return false;
+    }
+    return true;
+}
+
+bool SpaceTimePlanner::findPath(int _uav_id, const gauss_msgs::Waypoint &_start, const gauss_msgs::Waypoint &_goal, double _speed, std::vector<gauss_msgs::Waypoint> &_path) {
+    _path.clear();
+    if (_speed <= 0) return false;
+    uav_id_ = _uav_id;
+    Eigen::Vector3d start(_start.x, _start.y, _start.z);
+    Eigen::Vector3d goal(_goal.x, _goal.y, _goal.z);
+    double start_time = _start.stamp.toSec();
+
+    // Lattice around start and goal, with room to go around the traffic
+    double margin = 3.0 * std::max(min_separation_, 2.0 * radius_) + resolution_;
+    Eigen::Vector3d box_min = start.cwiseMin(goal) - Eigen::Vector3d::Constant(margin);
+    Eigen::Vector3d box_max = start.cwiseMax(goal) + Eigen::Vector3d::Constant(margin);
+    box_min.z() = std::max(box_min.z(), min_z_);
+    box_max.z() = std::min(box_max.z(), max_z_);
+    double step = std::max(resolution_, (box_max - box_min).maxCoeff() / max_cells_per_axis_);
+    int i_min = std::min(0, (int)std::ceil((box_min.x() - start.x()) / step)), i_max = std::max(0, (int)std::floor((box_max.x() - start.x()) / step));
+    int j_min = std::min(0, (int)std::ceil((box_min.y() - start.y()) / step)), j_max = std::max(0, (int)std::floor((box_max.y() - start.y()) / step));
+    int k_min = std::min(0, (int)std::ceil((box_min.z() - start.z()) / step)), k_max = std::max(0, (int)std::floor((box_max.z() - start.z()) / step));
+    int nx = i_max - i_min + 1, ny = j_max - j_min + 1, nz = k_max - k_min + 1;
+    const int GOAL = nx * ny * nz;
+    auto node = [&](int i, int j, int k) { return ((i - i_min) * ny + (j - j_min)) * nz + (k - k_min); };
+    auto position = [&](int id) {
+        if (id == GOAL) return goal;
+        int k = id % nz + k_min;
+        int j = (id / nz) % ny + j_min;
+        int i = id / (nz * ny) + i_min;
+        return Eigen::Vector3d(start + step * Eigen::Vector3d(i, j, k));
+    };
+
+    // A* with the arrival time as cost
+    std::vector<double> time(GOAL + 1, std::numeric_limits<double>::max());
+    std::vector<int> parent(GOAL + 1, -1);
+    std::vector<bool> closed(GOAL + 1, false);
+    typedef std::pair<double, int> QueueItem;
+    std::priority_queue<QueueItem, std::vector<QueueItem>, std::greater<QueueItem>> open;
+    int start_node = node(0, 0, 0);
+    time[start_node] = start_time;
+    open.push(std::make_pair(start_time + (goal - start).norm() / _speed, start_node));
+    int expansions = 0;
+    while (!open.empty() && expansions < max_expansions_) {
+        int current = open.top().second;
+        open.pop();
+        if (closed[current]) continue;
+        closed[current] = true;
+        if (current == GOAL) break;
+        if (++expansions % 16 == 0 && std::chrono::steady_clock::now() >= deadline_) break;
+        Eigen::Vector3d current_position = position(current);
+        auto relax = [&](int next) {
+            if (closed[next]) return;
+            Eigen::Vector3d next_position = position(next);
+            double next_time = time[current] + (next_position - current_position).norm() / _speed;
+            if (next_time >= time[next]) return;
+            if (!edgeFree(current_position, time[current], next_position, next_time)) return;
+            time[next] = next_time;
+            parent[next] = current;
+            open.push(std::make_pair(next_time + (goal - next_position).norm() / _speed, next));
+        };
+        if ((goal - current_position).norm() <= 2.0 * step) relax(GOAL);
+        int k_current = current % nz + k_min;
+        int j_current = (current / nz) % ny + j_min;
+        int i_current = current / (nz * ny) + i_min;
+        for (int di = -1; di <= 1; di++) {
+            for (int dj = -1; dj <= 1; dj++) {
+                for (int dk = -1; dk <= 1; dk++) {
+                    int i = i_current + di, j = j_current + dj, k = k_current + dk;
+                    if ((di == 0 && dj == 0 && dk == 0) || i < i_min || i > i_max || j < j_min || j > j_max || k < k_min || k > k_max) continue;
+                    relax(node(i, j, k));
+                }
+            }
+        }
+    }
+    if (!closed[GOAL]) return false;
+
+    std::vector<Eigen::Vector3d> points;
+    std::vector<double> times;
+    for (int id = GOAL; id >= 0; id = parent[id]) {
+        points.push_back(position(id));
+        times.push_back(time[id]);
+    }
+    std::reverse(points.begin(), points.end());
+    std::reverse(times.begin(), times.end());
+    simplifyPath(points, times, _speed);
+    for (size_t i = 0; i < points.size(); i++) {
+        gauss_msgs::Waypoint wp;
+        wp.x = points[i].x();
+        wp.y = points[i].y();
+        wp.z = points[i].z();
+        wp.stamp.fromSec(times[i]);
+        _path.push_back(wp);
+    }
+    _path.front().stamp = _start.stamp;
+
+    return true;
+}
@@ -1,5 +1,7 @@
 #include <gauss_msgs/CheckConflicts.h>
 #include <gauss_msgs/Circle.h>
+#include <gauss_msgs/Geofence.h>
+#include <gauss_msgs/NewBatchDeconfliction.h>
 #include <gauss_msgs/NewDeconfliction.h>
 #include <gauss_msgs/ReadIcao.h>
 #include <gauss_msgs/ReadOperation.h>
@@ -7,15 +9,35 @@
 #include <geometry_msgs/Polygon.h>
 #include <geometry_msgs/Vector3.h>
 #include <ros/ros.h>
-#include <tactical_deconfliction/path_finder.h>
+#include <rosbag/bag.h>
+#include <tactical_deconfliction/prepared_geofence_cache.h>
+#include <tactical_deconfliction/space_time_planner.h>
+#include <tactical_deconfliction/tactical_deconfliction.h>
+#include <tactical_deconfliction/trajectory_index.h>
+#include <tactical_deconfliction/visibility_graph_planner.h>
 #include <visualization_msgs/Marker.h>
 #include <visualization_msgs/MarkerArray.h>
 
 #include <Eigen/Eigen>
-
-double safety_distance_;
-bool actual_wp_on_merge_;
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <limits>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+
+double safety_distance_ = 10.0;
+bool actual_wp_on_merge_ = true;
 ros::Publisher visualization_pub_;
+PreparedGeofenceCache prepared_geofence_cache_;
+ros::ServiceClient read_icao_client_, read_operation_client_;
+double space_time_resolution_ = 10.0;
+int space_time_max_expansions_ = 20000;
+double deconfliction_deadline_ = 2.0;
+rosbag::Bag threat_record_bag_;
+std::mutex threat_record_bag_mutex_;  // Threats are recorded from several spinner threads
 
 std::vector<Eigen::Vector3f> perpendicularSeparationVector(const gauss_msgs::Waypoint &_pA, const gauss_msgs::Waypoint &_pB, const double &_op_vol_A, const double &_op_vol_B) {
     std::vector<Eigen::Vector3f> out_avoid_vector;
@@ -70,99 +92,6 @@ void checkGroundCollision(const std::vector<gauss_msgs::Waypoint> &_solution, co
     }
 }
 
-geometry_msgs::Polygon circleToPolygon(double &_x, double &_y, double &_radius, double _nVertices = 9) {
-    geometry_msgs::Polygon out_polygon;
-    Eigen::Vector2d centerToVertex(_radius, 0.0), centerToVertexTemp;
-    for (int i = 0; i < _nVertices; i++) {
-        double theta = i * 2 * M_PI / (_nVertices - 1);
-        Eigen::Rotation2D<double> rot2d(theta);
-        centerToVertexTemp = rot2d.toRotationMatrix() * centerToVertex;
-        geometry_msgs::Point32 temp_point;
-        temp_point.x = _x + centerToVertexTemp[0];
-        temp_point.y = _y + centerToVertexTemp[1];
-        out_polygon.points.push_back(temp_point);
-    }
-
-    return out_polygon;
-}
-
-// nvert        - Number of vertices in the polygon. Whether to repeat the first vertex at the end is discussed below.
-// vertx, verty	- Arrays containing the x- and y-coordinates of the polygon's vertices.
-// testx, testy	- X&Y coordinate of the test point.
-// [https://wrf.ecse.rpi.edu/Research/Short_Notes/pnpoly.html]
-int pointInPolygon(int nvert, std::vector<float> &vertx, std::vector<float> &verty, float testx, float testy) {
-    int i, j, c = 0;
-    for (i = 0, j = nvert - 1; i < nvert; j = i++) {
-        if (((verty.at(i) > testy) != (verty.at(j) > testy)) &&
-            (testx < (vertx.at(j) - vertx.at(i)) * (testy - verty.at(i)) / (verty.at(j) - verty.at(i)) + vertx.at(i)))
-            c = !c;
-    }
-    return c;
-}
-
-double signedArea(const geometry_msgs::Polygon &p) {
-    double A = 0;
-    //========================================================//
-    // Assumes:                                               //
-    //    N+1 vertices:   p[0], p[1], ... , p[N-1], p[N]      //
-    //    Closed polygon: p[0] = p[N]                         //
-    // Returns:                                               //
-    //    Signed area: +ve if anticlockwise, -ve if clockwise //
-    //========================================================//
-    int N = p.points.size() - 1;
-    for (int i = 0; i < N; i++) A += p.points.at(i).x * p.points.at(i + 1).y - p.points.at(i + 1).x * p.points.at(i).y;
-    A *= 0.5;
-    return A;
-}
-
-geometry_msgs::Polygon decreasePolygon(const geometry_msgs::Polygon &p, double thickness) {
-    //=====================================================//
-    // Assumes:                                            //
-    //    N+1 vertices:   p[0], p[1], ... , p[N-1], p[N]   //
-    //    Closed polygon: p[0] = p[N]                      //
-    //    No zero-length sides                             //
-    // Returns (by reference, as a parameter):             //
-    //    Internal poly:  q[0], q[1], ... , q[N-1], q[N]   //
-    //=====================================================//
-    geometry_msgs::Polygon q;
-    int N = p.points.size() - 1;
-    q.points.resize(N + 1);
-    double a, b, A, B, d, cross;
-    double displacement = thickness;
-    if (signedArea(p) < 0) displacement = -displacement;  // Detects clockwise order
-    // Unit vector (a,b) along last edge
-    a = p.points.at(N).x - p.points.at(N - 1).x;
-    b = p.points.at(N).y - p.points.at(N - 1).y;
-    d = sqrt(a * a + b * b);
-    a /= d;
-    b /= d;
-    for (int i = 0; i < N; i++) {  // Loop round the polygon, dealing with successive intersections of lines
-        // Unit vector (A,B) along previous edge
-        A = a;
-        B = b;
-        // Unit vector (a,b) along next edge
-        a = p.points.at(i + 1).x - p.points.at(i).x;
-        b = p.points.at(i + 1).y - p.points.at(i).y;
-        d = sqrt(a * a + b * b);
-        a /= d;
-        b /= d;
-        // New vertex
-        cross = A * b - a * B;
-        const double SMALL = 1.0e-10;
-        if (abs(cross) < SMALL) {  // Degenerate cases: 0 or 180 degrees at vertex
-            q.points.at(i).x = p.points.at(i).x - displacement * b;
-            q.points.at(i).y = p.points.at(i).y + displacement * a;
-        } else {  // Usual case
-            q.points.at(i).x = p.points.at(i).x + displacement * (a - A) / cross;
-            q.points.at(i).y = p.points.at(i).y + displacement * (b - B) / cross;
-        }
-    }
-    // Close the inside polygon
-    q.points.at(N) = q.points.at(0);
-
-    return q;
-}
-
 bool pointInCircle(const geometry_msgs::Point &_point, const gauss_msgs::Geofence &_geofence) {
     if (!_geofence.cylinder_shape) {
         ROS_ERROR("[Tactical] pointInCircle function: This is not a cylinder!");
@@ -175,30 +104,9 @@ bool pointInCircle(const geometry_msgs::Point &_point, const gauss_msgs::Geofenc
     }
 }
 
-std::vector<double> findGridBorders(geometry_msgs::Polygon &_polygon, geometry_msgs::Point _init_point, geometry_msgs::Point _goal_point, double _operational_volume) {
-    geometry_msgs::Point obs_min, obs_max, out_point;
-    std::vector<float> vert_x, vert_y;
-    for (int i = 0; i < _polygon.points.size(); i++) {
-        vert_x.push_back(_polygon.points.at(i).x);
-        vert_y.push_back(_polygon.points.at(i).y);
-    }
-    vert_x.push_back(_init_point.x);
-    vert_y.push_back(_init_point.y);
-    vert_x.push_back(_goal_point.x);
-    vert_y.push_back(_goal_point.y);
-
-    obs_min.x = *std::min_element(vert_x.begin(), vert_x.end());
-    obs_min.y = *std::min_element(vert_y.begin(), vert_y.end());
-    obs_max.x = *std::max_element(vert_x.begin(), vert_x.end());
-    obs_max.y = *std::max_element(vert_y.begin(), vert_y.end());
-
-    std::vector<double> out_grid_borders;
-    out_grid_borders.push_back(obs_min.x - 5 * _operational_volume);
-    out_grid_borders.push_back(obs_min.y - 5 * _operational_volume);
-    out_grid_borders.push_back(obs_max.x + 5 * _operational_volume);
-    out_grid_borders.push_back(obs_max.y + 5 * _operational_volume);
-
-    return out_grid_borders;
+bool pointInGeofence(const geometry_msgs::Point &_point, const gauss_msgs::Geofence &_geofence) {
+    if (_geofence.cylinder_shape) return pointInCircle(_point, _geofence);
+    return prepared_geofence_cache_.get(_geofence, 0.0)->shape.contains(_point.x, _point.y);
 }
 
 geometry_msgs::Point translateToPoint(const gauss_msgs::Waypoint &wp) {
@@ -209,33 +117,6 @@ geometry_msgs::Point translateToPoint(const gauss_msgs::Waypoint &wp) {
     return p;
 }
 
-nav_msgs::Path translateToPath(const gauss_msgs::WaypointList &_wp_list) {
-    nav_msgs::Path out_path;
-    for (auto wp : _wp_list.waypoints) {
-        geometry_msgs::PoseStamped temp_wp;
-        temp_wp.pose.position.x = wp.x;
-        temp_wp.pose.position.y = wp.y;
-        temp_wp.pose.position.z = wp.z;
-        temp_wp.header.stamp = wp.stamp;
-        out_path.poses.push_back(temp_wp);
-    }
-    return out_path;
-}
-
-std::vector<gauss_msgs::Waypoint> pathAStartToWPVector(const nav_msgs::Path &_path, const std::vector<double> &_times) {
-    std::vector<gauss_msgs::Waypoint> out_wp_vector;
-    ROS_ERROR_COND(_path.poses.size() != _times.size(), "[Tactical] A Start solution must have the same amount of waypoints (space[%d] and time[%d])!", _path.poses.size(), _times.size());
-    for (int i = 0; i < _path.poses.size(); i++) {
-        gauss_msgs::Waypoint temp_wp;
-        temp_wp.x = _path.poses.at(i).pose.position.x;
-        temp_wp.y = _path.poses.at(i).pose.position.y;
-        temp_wp.z = _path.poses.at(i).pose.position.z;
-        temp_wp.stamp = ros::Time(_times.at(i));  // !Careful
-        out_wp_vector.push_back(temp_wp);
-    }
-    return out_wp_vector;
-}
-
 std::vector<gauss_msgs::Waypoint> findAlternativePathRadial(gauss_msgs::Waypoint &_p_init, gauss_msgs::Waypoint &_p_end, gauss_msgs::Geofence &_geofence, gauss_msgs::ConflictiveOperation &_conflictive_operation, const geometry_msgs::Vector3 &_init_vector, const geometry_msgs::Vector3 &_final_vector, double _safety_margin) {
     std::vector<gauss_msgs::Waypoint> out;
     auto init_angle = atan2(_init_vector.y, _init_vector.x);
@@ -266,59 +147,114 @@ std::vector<gauss_msgs::Waypoint> findAlternativePathRadial(gauss_msgs::Waypoint
     return out;
 }
 
-std::vector<gauss_msgs::Waypoint> findAlternativePathAStar(geometry_msgs::Point &_p_init, geometry_msgs::Point &_p_end, ros::Time &_t_init, ros::Time &_t_end, gauss_msgs::Geofence &_geofence, gauss_msgs::ConflictiveOperation &_conflictive_operation) {
-    // Setup polygon geofence according on its shape
-    geometry_msgs::Polygon polygon_geofence;
+std::vector<gauss_msgs::Waypoint> findAlternativePathVisibility(const gauss_msgs::Waypoint &_p_init, const gauss_msgs::Waypoint &_p_end, const gauss_msgs::Geofence &_geofence, double _safety_margin, DeconflictionBudget &_budget) {
+    std::vector<gauss_msgs::Waypoint> out;
+    // Inflate the geofence by the safety margin, the path goes through the vertices of the inflated polygon
+    geometry_msgs::Polygon inflated_geofence;
     if (_geofence.cylinder_shape) {
-        polygon_geofence = circleToPolygon(_geofence.circle.x_center, _geofence.circle.y_center, _geofence.circle.radius);
-    } else {
-        for (int i = 0; i < _geofence.polygon.x.size(); i++) {
-            geometry_msgs::Point32 temp_points;
-            temp_points.x = _geofence.polygon.x.at(i);
-            temp_points.y = _geofence.polygon.y.at(i);
-            polygon_geofence.points.push_back(temp_points);
+        // Circumscribed polygon, so its sides do not cut the inflated circle
+        const int vertex_count = 16;
+        double radius = (_geofence.circle.radius + _safety_margin) / cos(M_PI / vertex_count);
+        for (int i = 0; i < vertex_count; i++) {
+            geometry_msgs::Point32 temp_point;
+            temp_point.x = _geofence.circle.x_center + radius * cos(i * 2 * M_PI / vertex_count);
+            temp_point.y = _geofence.circle.y_center + radius * sin(i * 2 * M_PI / vertex_count);
+            inflated_geofence.points.push_back(temp_point);
         }
+    } else {
+        inflated_geofence = prepared_geofence_cache_.get(_geofence, _safety_margin)->inflated.polygon;
     }
-    // Inflate polygon to take operational volume into account
-    if (!_geofence.cylinder_shape) polygon_geofence.points.push_back(polygon_geofence.points.front());
-    geometry_msgs::Polygon inflated_geofence = decreasePolygon(polygon_geofence, -_conflictive_operation.operational_volume * 1.5);
-    if (!_geofence.cylinder_shape) inflated_geofence.points.pop_back();
-    // Get borders of a local greed for the A* path finder
-    geometry_msgs::Point p_min_local_grid, p_max_local_grid;
-    std::vector<double> grid_borders = findGridBorders(inflated_geofence, _p_init, _p_end, _conflictive_operation.operational_volume);
-    p_min_local_grid.x = grid_borders[0];
-    p_min_local_grid.y = grid_borders[1];
-    p_max_local_grid.x = grid_borders[2];
-    p_max_local_grid.y = grid_borders[3];
-    nav_msgs::Path estimated_traj_path = translateToPath(_conflictive_operation.estimated_trajectory);
-    // Use A* path finder to get an alternative path
-    PathFinder path_finder(estimated_traj_path, _p_init, _p_end, inflated_geofence, p_min_local_grid, p_max_local_grid);
-    nav_msgs::Path a_star_path = path_finder.findNewPath();
-    // Fix times
-    std::vector<double> interp_times, a_star_times;
-    interp_times.push_back(_t_init.toSec());
-    interp_times.push_back(_t_end.toSec());
-    a_star_times = path_finder.interpWaypointList(interp_times, a_star_path.poses.size() - 1);
-    a_star_times.push_back(_t_end.toSec());
-
-    return pathAStartToWPVector(a_star_path, a_star_times);
+    VisibilityGraphPlanner visibility_planner;
+    visibility_planner.addObstacle(inflated_geofence);
+    visibility_planner.setDeadline(_budget.deadline);
+    std::vector<geometry_msgs::Point> path;
+    if (!visibility_planner.findPath(translateToPoint(_p_init), translateToPoint(_p_end), path)) {
+        ROS_WARN("[Tactical] Visibility graph planner could not find a path around geofence [%d]%s", _geofence.id, _budget.expired() ? " before the deadline" : "");
+        return out;
+    }
+    // Height and time are interpolated along the path length
+    std::vector<double> path_length(path.size(), 0.0);
+    for (size_t i = 1; i < path.size(); i++) path_length[i] = path_length[i - 1] + sqrt(pow(path[i].x - path[i - 1].x, 2) + pow(path[i].y - path[i - 1].y, 2));
+    for (size_t i = 0; i < path.size(); i++) {
+        double alpha = path_length.back() > 0 ? path_length[i] / path_length.back() : 0.0;
+        gauss_msgs::Waypoint wp;
+        wp.x = path[i].x;
+        wp.y = path[i].y;
+        wp.z = _p_init.z + alpha * (_p_end.z - _p_init.z);
+        wp.stamp.fromSec(_p_init.stamp.toSec() + alpha * (_p_end.stamp.toSec() - _p_init.stamp.toSec()));
+        out.push_back(wp);
+    }
+
+    return out;
 }
 
-std::vector<gauss_msgs::Waypoint> mergeSolutionWithFlightPlan(std::vector<gauss_msgs::Waypoint> &_solution, gauss_msgs::WaypointList &_flight_plan, gauss_msgs::Waypoint &_actual_wp, const uint8_t &_threat_type) {
+void buildTrafficIndex(const std::vector<gauss_msgs::ConflictiveOperation> &_conflictive_operations, TrajectoryIndex &_traffic_index) {
+    // Conflictive operations come with the threats, the rest of the traffic is read from the database
+    std::set<int> indexed_uavs;
+    for (auto operation : _conflictive_operations) {
+        if (indexed_uavs.count(operation.uav_id)) continue;
+        _traffic_index.addTrajectory(operation.uav_id, operation.estimated_trajectory, operation.operational_volume);
+        indexed_uavs.insert(operation.uav_id);
+    }
+    if (!read_icao_client_ || !read_operation_client_) return;
+    gauss_msgs::ReadIcao read_icao;
+    gauss_msgs::ReadOperation read_operation;
+    if (!read_icao_client_.call(read_icao) || !read_icao.response.success) {
+        ROS_WARN("[Tactical] Failed reading icao addresses, only conflictive operations are avoided");
+        return;
+    }
+    read_operation.request.uav_ids = read_icao.response.uav_id;
+    if (!read_operation_client_.call(read_operation) || !read_operation.response.success) {
+        ROS_WARN("[Tactical] Failed reading operations, only conflictive operations are avoided");
+        return;
+    }
+    for (auto operation : read_operation.response.operation) {
+        if (indexed_uavs.count(operation.uav_id)) continue;
+        _traffic_index.addTrajectory(operation.uav_id, operation.estimated_trajectory, operation.operational_volume);
+        indexed_uavs.insert(operation.uav_id);
+    }
+}
+
+std::vector<gauss_msgs::Waypoint> findAlternativePathSpaceTime(const std::vector<gauss_msgs::Waypoint> &_segment, const gauss_msgs::ConflictiveOperation &_conflictive_operation, const TrajectoryIndex &_traffic_index, DeconflictionBudget &_budget) {
+    std::vector<gauss_msgs::Waypoint> out;
+    if (_segment.size() < 2) return out;
+    // Keep the speed the uav had on the conflictive segment
+    double length = 0;
+    for (size_t i = 1; i < _segment.size(); i++) length += sqrt(pow(_segment[i].x - _segment[i - 1].x, 2) + pow(_segment[i].y - _segment[i - 1].y, 2) + pow(_segment[i].z - _segment[i - 1].z, 2));
+    double duration = _segment.back().stamp.toSec() - _segment.front().stamp.toSec();
+    if (length <= 0 || duration <= 0) return out;
+    SpaceTimePlanner space_time_planner(_traffic_index);
+    space_time_planner.setResolution(space_time_resolution_);
+    space_time_planner.setMaxExpansions(space_time_max_expansions_);
+    space_time_planner.setDeadline(_budget.deadline);
+    space_time_planner.setAltitudeLimits(_conflictive_operation.operational_volume, std::numeric_limits<double>::max());
+    space_time_planner.setSeparation(_conflictive_operation.operational_volume, safety_distance_);
+    if (!space_time_planner.findPath(_conflictive_operation.uav_id, _segment.front(), _segment.back(), length / duration, out))
+        ROS_WARN("[Tactical] Space-time planner could not find a path clear of traffic for uav [%d]%s", _conflictive_operation.uav_id, _budget.expired() ? " before the deadline" : "");
+    return out;
+}
+
+// A solution arriving _arrival_delay seconds later than the flight plan at the point where it joins it again delays
+// the remaining flight plan by the same time
+std::vector<gauss_msgs::Waypoint> mergeSolutionWithFlightPlan(std::vector<gauss_msgs::Waypoint> &_solution, gauss_msgs::WaypointList &_flight_plan, gauss_msgs::Waypoint &_actual_wp, const uint8_t &_threat_type, double _arrival_delay = 0.0) {
     std::vector<gauss_msgs::Waypoint> out_merged_solution;
     bool do_once = true;
+    // Stamp of the flight plan where the solution joins it again
+    ros::Time join_stamp = ros::Time(_solution.back().stamp.toSec() - _arrival_delay);
     if (actual_wp_on_merge_) out_merged_solution.push_back(_actual_wp);  // Insert the actual wp
     for (auto fp_wp : _flight_plan.waypoints) {
         if (_flight_plan.waypoints.front().stamp <= fp_wp.stamp) {              // Do nothing before current wp. Current wp (it is refered to flight plan) is equal than flight_plan_updated[0]
             if (fp_wp.stamp <= _solution.front().stamp && _threat_type != 5) {  // Between current wp and first wp of the solution if threat type is not GEOFENCE INTRUSION
                 out_merged_solution.push_back(fp_wp);
-            } else if (do_once && _solution.back().stamp < fp_wp.stamp) {  // Insert all the solution wps
+            } else if (do_once && join_stamp < fp_wp.stamp) {  // Insert all the solution wps
                 for (auto solution_wp : _solution) {
                     out_merged_solution.push_back(solution_wp);
                 }
+                fp_wp.stamp.fromSec(fp_wp.stamp.toSec() + _arrival_delay);
                 out_merged_solution.push_back(fp_wp);  // Insert the wp after the solution
                 do_once = false;
-            } else if (_solution.back().stamp < fp_wp.stamp) {  // Insert the remaining wps of the flight plan
+            } else if (join_stamp < fp_wp.stamp) {  // Insert the remaining wps of the flight plan
+                fp_wp.stamp.fromSec(fp_wp.stamp.toSec() + _arrival_delay);
                 out_merged_solution.push_back(fp_wp);
             }
         }
@@ -384,13 +320,12 @@ visualization_msgs::Marker createMarkerLines(const std::vector<gauss_msgs::Waypo
     std_msgs::ColorRGBA blue;
     blue.b = 1.0;
     blue.a = 1.0;
-    static int sol_count = 0;
+    static std::atomic<int> sol_count(0);
 
     visualization_msgs::Marker marker_lines;
     marker_lines.header.stamp = ros::Time::now();
     marker_lines.header.frame_id = "map";
-    marker_lines.ns = "lines_" + std::to_string(sol_count);
-    sol_count++;
+    marker_lines.ns = "lines_" + std::to_string(sol_count++);
     marker_lines.id = 1;
     marker_lines.type = visualization_msgs::Marker::LINE_STRIP;
     marker_lines.action = visualization_msgs::Marker::ADD;
@@ -406,32 +341,64 @@ visualization_msgs::Marker createMarkerLines(const std::vector<gauss_msgs::Waypo
     return marker_lines;
 }
 
-bool deconflictCB(gauss_msgs::NewDeconfliction::Request &req, gauss_msgs::NewDeconfliction::Response &res) {
-    ROS_INFO("[Tactical] Threat to solve [%d, %d]", req.threat.threat_id, req.threat.threat_type);
-    switch (req.threat.threat_type) {
-        case req.threat.LOSS_OF_SEPARATION: {
+gauss_msgs::DeconflictionPlan fallbackPlan(const gauss_msgs::ConflictiveOperation &_conflictive_operation) {
+    // Land at the nearest landing spot, or hold the actual position if the operation has none
+    const double fallback_value = 10.0;
+    const double hold_time = 60.0;
+    gauss_msgs::DeconflictionPlan out_plan;
+    out_plan.uav_id = _conflictive_operation.uav_id;
+    out_plan.cost = out_plan.riskiness = fallback_value;
+    out_plan.waypoint_list.push_back(_conflictive_operation.actual_wp);
+    double min_distance = std::numeric_limits<double>::max();
+    for (auto landing_wp : _conflictive_operation.landing_spots.waypoints) {
+        double distance = sqrt(pow(landing_wp.x - _conflictive_operation.actual_wp.x, 2) + pow(landing_wp.y - _conflictive_operation.actual_wp.y, 2) + pow(landing_wp.z - _conflictive_operation.actual_wp.z, 2));
+        if (distance < min_distance) {
+            min_distance = distance;
+            if (out_plan.waypoint_list.size() > 1) out_plan.waypoint_list.pop_back();
+            out_plan.waypoint_list.push_back(landing_wp);
+        }
+    }
+    if (out_plan.waypoint_list.size() > 1) {
+        out_plan.maneuver_type = 5;
+    } else {
+        out_plan.maneuver_type = 4;  // Hold, not used by any other maneuver
+        gauss_msgs::Waypoint hold_wp = _conflictive_operation.actual_wp;
+        hold_wp.stamp.fromSec(hold_wp.stamp.toSec() + hold_time);
+        out_plan.waypoint_list.push_back(hold_wp);
+    }
+    return out_plan;
+}
+
+bool deconflictThreat(gauss_msgs::NewThreat &_threat, DeconflictionBudget &_budget, std::vector<gauss_msgs::DeconflictionPlan> &_plans, std::vector<double> &_plan_times, const TrajectoryIndex *_traffic_index) {
+    ROS_INFO("[Tactical] Threat to solve [%d, %d]", _threat.threat_id, _threat.threat_type);
+    auto addPlan = [&](const gauss_msgs::DeconflictionPlan &_plan) {
+        _plans.push_back(_plan);
+        _plan_times.push_back(_budget.elapsed());
+    };
+    switch (_threat.threat_type) {
+        case gauss_msgs::NewThreat::LOSS_OF_SEPARATION: {
             std::vector<std::vector<gauss_msgs::Waypoint>> segments_first_second;
-            segments_first_second.push_back(req.threat.loss_conflictive_segments.segment_first);
-            segments_first_second.push_back(req.threat.loss_conflictive_segments.segment_second);
+            segments_first_second.push_back(_threat.loss_conflictive_segments.segment_first);
+            segments_first_second.push_back(_threat.loss_conflictive_segments.segment_second);
             std::vector<gauss_msgs::Waypoint> points_at_t_min;
-            points_at_t_min.push_back(req.threat.loss_conflictive_segments.point_at_t_min_segment_first);
-            points_at_t_min.push_back(req.threat.loss_conflictive_segments.point_at_t_min_segment_second);
-            ROS_ERROR_COND(req.threat.conflictive_operations.size() != 2, "[Tactical] Deconflictive server should receive 2 conflictive operations to solve LOSS OF SEPARATION!");
+            points_at_t_min.push_back(_threat.loss_conflictive_segments.point_at_t_min_segment_first);
+            points_at_t_min.push_back(_threat.loss_conflictive_segments.point_at_t_min_segment_second);
+            ROS_ERROR_COND(_threat.conflictive_operations.size() != 2, "[Tactical] Deconflictive server should receive 2 conflictive operations to solve LOSS OF SEPARATION!");
             // Calculate a vector to separate perpendiculary one trajectory
-            std::vector<Eigen::Vector3f> avoid_vectors = perpendicularSeparationVector(points_at_t_min.front(), points_at_t_min.back(), req.threat.conflictive_operations.front().operational_volume, req.threat.conflictive_operations.back().operational_volume);
+            std::vector<Eigen::Vector3f> avoid_vectors = perpendicularSeparationVector(points_at_t_min.front(), points_at_t_min.back(), _threat.conflictive_operations.front().operational_volume, _threat.conflictive_operations.back().operational_volume);
             // Solution applying separation to one operation
             double fake_value = 1.0;
             for (int i = 0; i < 2; i++) {
                 gauss_msgs::DeconflictionPlan possible_solution;
                 possible_solution.maneuver_type = 8;
                 possible_solution.cost = possible_solution.riskiness = fake_value;
-                possible_solution.uav_id = req.threat.conflictive_operations.at(i).uav_id;
+                possible_solution.uav_id = _threat.conflictive_operations.at(i).uav_id;
                 std::vector<gauss_msgs::Waypoint> temp_solution = applySeparation(avoid_vectors.at(i), segments_first_second.at(i));
                 // TODO: Should another alternative be proposed if the current one hits the ground?
-                checkGroundCollision(temp_solution, req.threat.conflictive_operations.at(i).operational_volume);
+                checkGroundCollision(temp_solution, _threat.conflictive_operations.at(i).operational_volume);
                 // TODO: Who should do the merge?
-                possible_solution.waypoint_list = mergeSolutionWithFlightPlan(temp_solution, req.threat.conflictive_operations.at(i).flight_plan_updated, req.threat.conflictive_operations.at(i).actual_wp, req.threat.threat_type);
-                res.deconfliction_plans.push_back(possible_solution);
+                possible_solution.waypoint_list = mergeSolutionWithFlightPlan(temp_solution, _threat.conflictive_operations.at(i).flight_plan_updated, _threat.conflictive_operations.at(i).actual_wp, _threat.threat_type);
+                addPlan(possible_solution);
             }
             // !Solution delaying one operation
             fake_value = 5.0;
@@ -439,182 +406,350 @@ bool deconflictCB(gauss_msgs::NewDeconfliction::Request &req, gauss_msgs::NewDec
                 gauss_msgs::DeconflictionPlan possible_solution;
                 possible_solution.maneuver_type = 8;  // !Should be another maneuver type?
                 possible_solution.cost = possible_solution.riskiness = fake_value;
-                possible_solution.uav_id = req.threat.conflictive_operations.at(i).uav_id;
+                possible_solution.uav_id = _threat.conflictive_operations.at(i).uav_id;
                 std::vector<gauss_msgs::Waypoint> temp_solution = segments_first_second.at(i);
-                possible_solution.waypoint_list = delayFlightPlan(segments_first_second.at(i), req.threat.conflictive_operations.at(i).flight_plan_updated, req.threat.conflictive_operations.at(i).actual_wp);
-                res.deconfliction_plans.push_back(possible_solution);
+                possible_solution.waypoint_list = delayFlightPlan(segments_first_second.at(i), _threat.conflictive_operations.at(i).flight_plan_updated, _threat.conflictive_operations.at(i).actual_wp);
+                addPlan(possible_solution);
+            }
+            // Solution planned in space and time around the estimated trajectories of all the traffic, so it does not
+            // cause new conflicts. Preferred over the ones above, which only move away from the other conflictive uav
+            TrajectoryIndex local_traffic_index;
+            if (!_traffic_index && !_budget.expired()) {
+                buildTrafficIndex(_threat.conflictive_operations, local_traffic_index);
+                _traffic_index = &local_traffic_index;
+            }
+            fake_value = 0.5;
+            for (int i = 0; i < 2 && _traffic_index && !_budget.expired(); i++) {
+                std::vector<gauss_msgs::Waypoint> temp_solution = findAlternativePathSpaceTime(segments_first_second.at(i), _threat.conflictive_operations.at(i), *_traffic_index, _budget);
+                if (temp_solution.empty()) continue;
+                gauss_msgs::DeconflictionPlan possible_solution;
+                possible_solution.maneuver_type = 8;
+                possible_solution.cost = possible_solution.riskiness = fake_value;
+                possible_solution.uav_id = _threat.conflictive_operations.at(i).uav_id;
+                // The path around the traffic may be longer or wait, the rest of the flight plan is delayed as much
+                double arrival_delay = std::max(temp_solution.back().stamp.toSec() - segments_first_second.at(i).back().stamp.toSec(), 0.0);
+                possible_solution.waypoint_list = mergeSolutionWithFlightPlan(temp_solution, _threat.conflictive_operations.at(i).flight_plan_updated, _threat.conflictive_operations.at(i).actual_wp, _threat.threat_type, arrival_delay);
+                addPlan(possible_solution);
             }
             // Visualize "space" results
             visualization_msgs::MarkerArray marker_array;
-            visualization_msgs::Marker marker_spheres = createMarkerSpheres(req.threat.loss_conflictive_segments.point_at_t_min_segment_first, req.threat.loss_conflictive_segments.point_at_t_min_segment_second);
+            visualization_msgs::Marker marker_spheres = createMarkerSpheres(_threat.loss_conflictive_segments.point_at_t_min_segment_first, _threat.loss_conflictive_segments.point_at_t_min_segment_second);
             marker_array.markers.push_back(marker_spheres);
-            for (int i = 0; i < 2; i++) marker_array.markers.push_back(createMarkerLines(res.deconfliction_plans[i].waypoint_list));
-            visualization_pub_.publish(marker_array);
+            for (int i = 0; i < 2; i++) marker_array.markers.push_back(createMarkerLines(_plans[i].waypoint_list));
+            if (visualization_pub_) visualization_pub_.publish(marker_array);
         } break;
-        case req.threat.GEOFENCE_CONFLICT: {
-            ROS_ERROR_COND(req.threat.conflictive_geofences.size() != 1, "[Tactical] Deconflictive server should receive 1 geofence to solve GEOFENCE CONFLICT!");
+        case gauss_msgs::NewThreat::GEOFENCE_CONFLICT: {
+            ROS_ERROR_COND(_threat.conflictive_geofences.size() != 1, "[Tactical] Deconflictive server should receive 1 geofence to solve GEOFENCE CONFLICT!");
             // * Assume inputs from monitoring
             // // TODO: Check if init and end points have to be further apart from the geofence!
             geometry_msgs::Point p_init_conflict, p_end_conflict;
-            p_init_conflict.x = req.threat.geofence_conflictive_segments.first_contiguous_segment.front().x;
-            p_init_conflict.y = req.threat.geofence_conflictive_segments.first_contiguous_segment.front().y;
-            p_init_conflict.z = req.threat.geofence_conflictive_segments.first_contiguous_segment.front().z;
-            p_end_conflict.x = req.threat.geofence_conflictive_segments.first_contiguous_segment.back().x;
-            p_end_conflict.y = req.threat.geofence_conflictive_segments.first_contiguous_segment.back().y;
-            p_end_conflict.z = req.threat.geofence_conflictive_segments.first_contiguous_segment.back().z;
-            ros::Time t_init_conflict = req.threat.geofence_conflictive_segments.first_contiguous_segment.front().stamp;
-            ros::Time t_end_conflict = req.threat.geofence_conflictive_segments.first_contiguous_segment.back().stamp;
-            const double safety_margin = req.threat.conflictive_operations.front().operational_volume * 2.0;
+            p_init_conflict.x = _threat.geofence_conflictive_segments.first_contiguous_segment.front().x;
+            p_init_conflict.y = _threat.geofence_conflictive_segments.first_contiguous_segment.front().y;
+            p_init_conflict.z = _threat.geofence_conflictive_segments.first_contiguous_segment.front().z;
+            p_end_conflict.x = _threat.geofence_conflictive_segments.first_contiguous_segment.back().x;
+            p_end_conflict.y = _threat.geofence_conflictive_segments.first_contiguous_segment.back().y;
+            p_end_conflict.z = _threat.geofence_conflictive_segments.first_contiguous_segment.back().z;
+            ros::Time t_init_conflict = _threat.geofence_conflictive_segments.first_contiguous_segment.front().stamp;
+            ros::Time t_end_conflict = _threat.geofence_conflictive_segments.first_contiguous_segment.back().stamp;
+            const double safety_margin = _threat.conflictive_operations.front().operational_volume * 2.0;
 
             double fake_value = 1.0;
             gauss_msgs::DeconflictionPlan possible_solution;
+            // [1] Ruta a mi destino evitando una geofence, por el grafo de visibilidad (cualquier forma de geofence)
+            if (!_budget.expired() && !pointInGeofence(p_end_conflict, _threat.conflictive_geofences.front())) {
+                std::vector<gauss_msgs::Waypoint> temp_solution = findAlternativePathVisibility(_threat.geofence_conflictive_segments.first_contiguous_segment.front(), _threat.geofence_conflictive_segments.first_contiguous_segment.back(), _threat.conflictive_geofences.front(), safety_margin, _budget);
+                if (!temp_solution.empty()) {
+                    possible_solution.maneuver_type = 1;
+                    possible_solution.uav_id = _threat.uav_ids.front();
+                    possible_solution.cost = possible_solution.riskiness = fake_value;
+                    possible_solution.waypoint_list = mergeSolutionWithFlightPlan(temp_solution, _threat.conflictive_operations.front().flight_plan_updated, _threat.conflictive_operations.front().actual_wp, _threat.threat_type);
+                    addPlan(possible_solution);
+                }
+            }
             // [1] Ruta a mi destino evitando una geofence
             // Just do it if end point is outside the geofence
-            if (!pointInCircle(p_end_conflict, req.threat.conflictive_geofences.front())) {
+            if (_threat.conflictive_geofences.front().cylinder_shape && !pointInCircle(p_end_conflict, _threat.conflictive_geofences.front())) {
                 possible_solution.maneuver_type = 1;
-                possible_solution.uav_id = req.threat.uav_ids.front();
+                possible_solution.uav_id = _threat.uav_ids.front();
                 possible_solution.cost = possible_solution.riskiness = fake_value;
-                // std::vector<gauss_msgs::Waypoint> temp_solution = findAlternativePathAStar(p_init_conflict, p_end_conflict, t_init_conflict, t_end_conflict, req.threat.conflictive_geofences.front(), req.threat.conflictive_operations.front());
-                std::vector<gauss_msgs::Waypoint> temp_solution = findAlternativePathRadial(req.threat.geofence_conflictive_segments.first_contiguous_segment.front(), req.threat.geofence_conflictive_segments.first_contiguous_segment.back(), req.threat.conflictive_geofences.front(), req.threat.conflictive_operations.front(), req.threat.geofence_conflictive_segments.crossing_0_out_vector, req.threat.geofence_conflictive_segments.crossing_1_out_vector, safety_margin);
-                possible_solution.waypoint_list = mergeSolutionWithFlightPlan(temp_solution, req.threat.conflictive_operations.front().flight_plan_updated, req.threat.conflictive_operations.front().actual_wp, req.threat.threat_type);
-                res.deconfliction_plans.push_back(possible_solution);
+                std::vector<gauss_msgs::Waypoint> temp_solution = findAlternativePathRadial(_threat.geofence_conflictive_segments.first_contiguous_segment.front(), _threat.geofence_conflictive_segments.first_contiguous_segment.back(), _threat.conflictive_geofences.front(), _threat.conflictive_operations.front(), _threat.geofence_conflictive_segments.crossing_0_out_vector, _threat.geofence_conflictive_segments.crossing_1_out_vector, safety_margin);
+                possible_solution.waypoint_list = mergeSolutionWithFlightPlan(temp_solution, _threat.conflictive_operations.front().flight_plan_updated, _threat.conflictive_operations.front().actual_wp, _threat.threat_type);
+                addPlan(possible_solution);
             }
             // [3] Ruta que me manda devuelta a casa
             possible_solution.maneuver_type = 3;
             possible_solution.waypoint_list.clear();
-            possible_solution.uav_id = req.threat.uav_ids.front();
+            possible_solution.uav_id = _threat.uav_ids.front();
             possible_solution.cost = possible_solution.riskiness = fake_value * 2;
-            possible_solution.waypoint_list.push_back(req.threat.conflictive_operations.front().estimated_trajectory.waypoints.front());
-            possible_solution.waypoint_list.push_back(req.threat.conflictive_operations.front().flight_plan.waypoints.front());
-            res.deconfliction_plans.push_back(possible_solution);
+            possible_solution.waypoint_list.push_back(_threat.conflictive_operations.front().estimated_trajectory.waypoints.front());
+            possible_solution.waypoint_list.push_back(_threat.conflictive_operations.front().flight_plan.waypoints.front());
+            addPlan(possible_solution);
         } break;
-        case req.threat.GEOFENCE_INTRUSION: {
-            ROS_ERROR_COND(req.threat.conflictive_geofences.size() != 1, "[Tactical] Deconflictive server should receive 1 geofence to solve GEOFENCE INTRUSION!");
+        case gauss_msgs::NewThreat::GEOFENCE_INTRUSION: {
+            ROS_ERROR_COND(_threat.conflictive_geofences.size() != 1, "[Tactical] Deconflictive server should receive 1 geofence to solve GEOFENCE INTRUSION!");
             // * Assume inputs from monitoring
             // // TODO: Check if init and end points have to be further apart from the geofence!
             geometry_msgs::Point p_init_conflict, p_end_conflict;
-            const double safety_margin = req.threat.conflictive_operations.front().operational_volume * 2.0;
-            p_init_conflict.x = req.threat.geofence_conflictive_segments.closest_exit_wp.x;
-            p_init_conflict.y = req.threat.geofence_conflictive_segments.closest_exit_wp.y;
-            p_init_conflict.z = req.threat.geofence_conflictive_segments.closest_exit_wp.z;
-            p_end_conflict.x = req.threat.geofence_conflictive_segments.all_segments.back().x;
-            p_end_conflict.y = req.threat.geofence_conflictive_segments.all_segments.back().y;
-            p_end_conflict.z = req.threat.geofence_conflictive_segments.all_segments.back().z;
-            ros::Time t_init_conflict = req.threat.geofence_conflictive_segments.closest_exit_wp.stamp;
-            ros::Time t_end_conflict = req.threat.geofence_conflictive_segments.all_segments.back().stamp;
+            const double safety_margin = _threat.conflictive_operations.front().operational_volume * 2.0;
+            p_init_conflict.x = _threat.geofence_conflictive_segments.closest_exit_wp.x;
+            p_init_conflict.y = _threat.geofence_conflictive_segments.closest_exit_wp.y;
+            p_init_conflict.z = _threat.geofence_conflictive_segments.closest_exit_wp.z;
+            p_end_conflict.x = _threat.geofence_conflictive_segments.all_segments.back().x;
+            p_end_conflict.y = _threat.geofence_conflictive_segments.all_segments.back().y;
+            p_end_conflict.z = _threat.geofence_conflictive_segments.all_segments.back().z;
+            ros::Time t_init_conflict = _threat.geofence_conflictive_segments.closest_exit_wp.stamp;
+            ros::Time t_end_conflict = _threat.geofence_conflictive_segments.all_segments.back().stamp;
 
             double fake_value = 0.0;
             gauss_msgs::DeconflictionPlan possible_solution;
-            possible_solution.uav_id = req.threat.conflictive_operations.front().uav_id;
+            possible_solution.uav_id = _threat.conflictive_operations.front().uav_id;
+            // [6] Ruta a mi destino saliendo lo antes posible de la geofence, por el grafo de visibilidad (cualquier forma de geofence)
+            if (!_budget.expired() && !pointInGeofence(p_end_conflict, _threat.conflictive_geofences.front())) {
+                gauss_msgs::Waypoint exit_wp = _threat.geofence_conflictive_segments.closest_exit_wp;
+                exit_wp.stamp = _threat.conflictive_operations.front().actual_wp.stamp;
+                std::vector<gauss_msgs::Waypoint> temp_solution = findAlternativePathVisibility(exit_wp, _threat.geofence_conflictive_segments.all_segments.back(), _threat.conflictive_geofences.front(), safety_margin, _budget);
+                if (!temp_solution.empty()) {
+                    possible_solution.maneuver_type = 1;
+                    possible_solution.uav_id = _threat.uav_ids.front();
+                    possible_solution.cost = possible_solution.riskiness = fake_value;
+                    possible_solution.waypoint_list = mergeSolutionWithFlightPlan(temp_solution, _threat.conflictive_operations.front().flight_plan_updated, _threat.conflictive_operations.front().actual_wp, _threat.threat_type);
+                    addPlan(possible_solution);
+                }
+            }
             // [6] Ruta a mi destino saliendo lo antes posible de la geofence
             // Just do it if end point is outside the geofence
-            if (!pointInCircle(p_end_conflict, req.threat.conflictive_geofences.front())) {
+            if (_threat.conflictive_geofences.front().cylinder_shape && !pointInCircle(p_end_conflict, _threat.conflictive_geofences.front())) {
                 possible_solution.maneuver_type = 1;
-                possible_solution.uav_id = req.threat.uav_ids.front();
+                possible_solution.uav_id = _threat.uav_ids.front();
                 possible_solution.cost = possible_solution.riskiness = fake_value;
-                // std::vector<gauss_msgs::Waypoint> temp_solution = findAlternativePathAStar(p_init_conflict, p_end_conflict, t_init_conflict, t_end_conflict, req.threat.conflictive_geofences.front(), req.threat.conflictive_operations.front());
-                req.threat.geofence_conflictive_segments.closest_exit_wp.stamp = req.threat.conflictive_operations.front().actual_wp.stamp;
-                std::vector<gauss_msgs::Waypoint> temp_solution = findAlternativePathRadial(req.threat.geofence_conflictive_segments.closest_exit_wp, req.threat.geofence_conflictive_segments.all_segments.back(), req.threat.conflictive_geofences.front(), req.threat.conflictive_operations.front(), req.threat.geofence_conflictive_segments.crossing_0_out_vector, req.threat.geofence_conflictive_segments.crossing_1_out_vector, safety_margin);
-                possible_solution.waypoint_list = mergeSolutionWithFlightPlan(temp_solution, req.threat.conflictive_operations.front().flight_plan_updated, req.threat.conflictive_operations.front().actual_wp, req.threat.threat_type);
-                res.deconfliction_plans.push_back(possible_solution);
+                _threat.geofence_conflictive_segments.closest_exit_wp.stamp = _threat.conflictive_operations.front().actual_wp.stamp;
+                std::vector<gauss_msgs::Waypoint> temp_solution = findAlternativePathRadial(_threat.geofence_conflictive_segments.closest_exit_wp, _threat.geofence_conflictive_segments.all_segments.back(), _threat.conflictive_geofences.front(), _threat.conflictive_operations.front(), _threat.geofence_conflictive_segments.crossing_0_out_vector, _threat.geofence_conflictive_segments.crossing_1_out_vector, safety_margin);
+                possible_solution.waypoint_list = mergeSolutionWithFlightPlan(temp_solution, _threat.conflictive_operations.front().flight_plan_updated, _threat.conflictive_operations.front().actual_wp, _threat.threat_type);
+                addPlan(possible_solution);
             }
             // [2] Ruta a mi destino por el camino mas corto
             possible_solution.maneuver_type = 2;
             possible_solution.waypoint_list.clear();
-            possible_solution.uav_id = req.threat.uav_ids.front();
+            possible_solution.uav_id = _threat.uav_ids.front();
             possible_solution.cost = possible_solution.riskiness = fake_value * 2;
-            possible_solution.waypoint_list.push_back(req.threat.conflictive_operations.front().estimated_trajectory.waypoints.front());
-            possible_solution.waypoint_list.push_back(req.threat.conflictive_operations.front().flight_plan.waypoints.back());
-            res.deconfliction_plans.push_back(possible_solution);
+            possible_solution.waypoint_list.push_back(_threat.conflictive_operations.front().estimated_trajectory.waypoints.front());
+            possible_solution.waypoint_list.push_back(_threat.conflictive_operations.front().flight_plan.waypoints.back());
+            addPlan(possible_solution);
             // [3] Ruta que me manda de vuelta a casa
             possible_solution.maneuver_type = 3;
             possible_solution.waypoint_list.clear();
-            possible_solution.uav_id = req.threat.uav_ids.front();
+            possible_solution.uav_id = _threat.uav_ids.front();
             possible_solution.cost = possible_solution.riskiness = fake_value * 3;
-            possible_solution.waypoint_list.push_back(req.threat.conflictive_operations.front().estimated_trajectory.waypoints.front());
-            possible_solution.waypoint_list.push_back(req.threat.conflictive_operations.front().flight_plan.waypoints.front());
-            res.deconfliction_plans.push_back(possible_solution);
+            possible_solution.waypoint_list.push_back(_threat.conflictive_operations.front().estimated_trajectory.waypoints.front());
+            possible_solution.waypoint_list.push_back(_threat.conflictive_operations.front().flight_plan.waypoints.front());
+            addPlan(possible_solution);
             // [?] Ruta a un landing spot
             possible_solution.maneuver_type = 3;
             possible_solution.waypoint_list.clear();
-            possible_solution.uav_id = req.threat.uav_ids.front();
+            possible_solution.uav_id = _threat.uav_ids.front();
             possible_solution.cost = possible_solution.riskiness = fake_value * 1;  // ! Forcing this solution to be selected
-            possible_solution.waypoint_list.push_back(req.threat.conflictive_operations.front().estimated_trajectory.waypoints.front());
-            req.threat.conflictive_operations.front().landing_spots.waypoints.front().stamp.fromSec(ros::Time::now().toSec() + 360.0);
-            possible_solution.waypoint_list.push_back(req.threat.conflictive_operations.front().landing_spots.waypoints.front());
-            res.deconfliction_plans.push_back(possible_solution);
+            possible_solution.waypoint_list.push_back(_threat.conflictive_operations.front().estimated_trajectory.waypoints.front());
+            _threat.conflictive_operations.front().landing_spots.waypoints.front().stamp.fromSec(ros::Time::now().toSec() + 360.0);
+            possible_solution.waypoint_list.push_back(_threat.conflictive_operations.front().landing_spots.waypoints.front());
+            addPlan(possible_solution);
             visualization_msgs::MarkerArray marker_array;
-            for (auto i : res.deconfliction_plans) marker_array.markers.push_back(createMarkerLines(i.waypoint_list));
-            visualization_pub_.publish(marker_array);
+            for (auto i : _plans) marker_array.markers.push_back(createMarkerLines(i.waypoint_list));
+            if (visualization_pub_) visualization_pub_.publish(marker_array);
         } break;
-        case req.threat.UAS_OUT_OV: {
-            ROS_ERROR_COND(req.threat.conflictive_operations.size() != 1, "[Tactical] Deconflictive server should receive 1 conflictive operations to solve UAS OUT OV!");
+        case gauss_msgs::NewThreat::UAS_OUT_OV: {
+            ROS_ERROR_COND(_threat.conflictive_operations.size() != 1, "[Tactical] Deconflictive server should receive 1 conflictive operations to solve UAS OUT OV!");
             gauss_msgs::DeconflictionPlan possible_solution;
-            possible_solution.uav_id = req.threat.conflictive_operations.front().uav_id;
+            possible_solution.uav_id = _threat.conflictive_operations.front().uav_id;
             // [9] Ruta para volver lo antes posible al flight geometry y seguir el plan de vuelo.
             // TODO: Should we use the same strategy described in ConflictSolver.cpp?
 
             // [10] Ruta para seguir con el plan de vuelo, da igual que esté más tiempo fuera del Operational Volume.
             possible_solution.maneuver_type = 10;
             possible_solution.waypoint_list.clear();
-            possible_solution.waypoint_list.push_back(req.threat.conflictive_operations.front().estimated_trajectory.waypoints.back());
+            possible_solution.waypoint_list.push_back(_threat.conflictive_operations.front().estimated_trajectory.waypoints.back());
             // ! current wp + 1 or just current wp?
-            possible_solution.waypoint_list.push_back(req.threat.conflictive_operations.front().flight_plan.waypoints.at(req.threat.conflictive_operations.front().current_wp + 1));
-            res.deconfliction_plans.push_back(possible_solution);
+            possible_solution.waypoint_list.push_back(_threat.conflictive_operations.front().flight_plan.waypoints.at(_threat.conflictive_operations.front().current_wp + 1));
+            addPlan(possible_solution);
         } break;
-        case req.threat.GNSS_DEGRADATION: {
-            ROS_ERROR_COND(req.threat.conflictive_operations.size() != 1, "[Tactical] Deconflictive server should receive 1 conflictive operations to solve GNSS DEGRADATION!");
+        case gauss_msgs::NewThreat::GNSS_DEGRADATION: {
+            ROS_ERROR_COND(_threat.conflictive_operations.size() != 1, "[Tactical] Deconflictive server should receive 1 conflictive operations to solve GNSS DEGRADATION!");
             // [5] Ruta que aterrice en un landing spot
-            for (auto landing_wp : req.threat.conflictive_operations.front().landing_spots.waypoints) {
+            for (auto landing_wp : _threat.conflictive_operations.front().landing_spots.waypoints) {
                 gauss_msgs::DeconflictionPlan possible_solution;
-                possible_solution.uav_id = req.threat.conflictive_operations.front().uav_id;
+                possible_solution.uav_id = _threat.conflictive_operations.front().uav_id;
                 possible_solution.maneuver_type = 5;
-                possible_solution.waypoint_list.push_back(req.threat.conflictive_operations.front().estimated_trajectory.waypoints.front());
+                possible_solution.waypoint_list.push_back(_threat.conflictive_operations.front().estimated_trajectory.waypoints.front());
                 possible_solution.waypoint_list.push_back(landing_wp);
-                res.deconfliction_plans.push_back(possible_solution);
+                addPlan(possible_solution);
             }
         } break;
-        case req.threat.LACK_OF_BATTERY: {
-            ROS_ERROR_COND(req.threat.conflictive_operations.size() != 1, "[Tactical] Deconflictive server should receive 1 conflictive operations to solve LACK OF BATTERY!");
+        case gauss_msgs::NewThreat::LACK_OF_BATTERY: {
+            ROS_ERROR_COND(_threat.conflictive_operations.size() != 1, "[Tactical] Deconflictive server should receive 1 conflictive operations to solve LACK OF BATTERY!");
             // [5] Ruta que aterrice en un landing spot
-            for (auto landing_wp : req.threat.conflictive_operations.front().landing_spots.waypoints) {
+            for (auto landing_wp : _threat.conflictive_operations.front().landing_spots.waypoints) {
                 gauss_msgs::DeconflictionPlan possible_solution;
-                possible_solution.uav_id = req.threat.conflictive_operations.front().uav_id;
+                possible_solution.uav_id = _threat.conflictive_operations.front().uav_id;
                 possible_solution.maneuver_type = 5;
-                possible_solution.waypoint_list.push_back(req.threat.conflictive_operations.front().estimated_trajectory.waypoints.front());
+                possible_solution.waypoint_list.push_back(_threat.conflictive_operations.front().estimated_trajectory.waypoints.front());
                 possible_solution.waypoint_list.push_back(landing_wp);
-                res.deconfliction_plans.push_back(possible_solution);
+                addPlan(possible_solution);
             }
         } break;
         default:
             break;
     }
+    if (!_plans.empty()) return true;
 
-    res.message = "Conflict solved";
+    ROS_WARN("[Tactical] No plan found for threat [%d, %d], using the fallback maneuver", _threat.threat_id, _threat.threat_type);
+    for (auto operation : _threat.conflictive_operations) addPlan(fallbackPlan(operation));
+    return false;
+}
+
+void geofenceUpdateCB(const gauss_msgs::Geofence::ConstPtr &_geofence) {
+    // Geometry prepared for the previous version of the geofence is no longer valid
+    prepared_geofence_cache_.invalidate(_geofence->id);
+}
+
+void recordThreat(const gauss_msgs::NewThreat &_threat) {
+    // Threats as received, to be replayed offline by deconfliction_benchmark
+    std::lock_guard<std::mutex> lock(threat_record_bag_mutex_);
+    if (!threat_record_bag_.isOpen()) return;
+    try {
+        threat_record_bag_.write("threat", ros::Time::now(), _threat);
+    } catch (rosbag::BagException &e) {
+        ROS_WARN("[Tactical] Failed recording threat [%d, %d]: %s", _threat.threat_id, _threat.threat_type, e.what());
+    }
+}
+
+bool deconflictCB(gauss_msgs::NewDeconfliction::Request &req, gauss_msgs::NewDeconfliction::Response &res) {
+    recordThreat(req.threat);
+    DeconflictionBudget budget(deconfliction_deadline_);
+    res.fallback = !deconflictThreat(req.threat, budget, res.deconfliction_plans, res.plan_times);
+    res.computation_time = budget.elapsed();
+    res.deadline_reached = budget.reached;
+    res.message = res.fallback ? "Fallback maneuver" : "Conflict solved";
     res.success = true;
     return res.success;
 }
 
-int main(int argc, char **argv) {
-    ros::init(argc, argv, "tactical_deconfliction");
-
-    ros::NodeHandle nh;
-    nh.param("safetyDistance", safety_distance_, 10.0);
-    nh.param("actual_wp_on_merge", actual_wp_on_merge_, true);
+int maneuveringUav(const gauss_msgs::NewThreat &_threat) {
+    // In a loss of separation only the uav with less priority maneuvers, -1 if both have the same priority
+    if (_threat.threat_type != gauss_msgs::NewThreat::LOSS_OF_SEPARATION || _threat.uav_ids.size() != _threat.priority_ops.size()) return _threat.uav_ids.front();
+    int out_uav_id = _threat.uav_ids.front();
+    int smaller_priority = std::numeric_limits<int>::max();
+    for (size_t idx = 0; idx < _threat.uav_ids.size(); idx++) {
+        if (smaller_priority > _threat.priority_ops.at(idx)) {
+            smaller_priority = _threat.priority_ops.at(idx);
+            out_uav_id = _threat.uav_ids.at(idx);
+        } else if (smaller_priority == _threat.priority_ops.at(idx)) {
+            out_uav_id = -1;
+        }
+    }
+    return out_uav_id;
+}
 
-    ros::ServiceServer deconflict_server = nh.advertiseService("/gauss/new_tactical_deconfliction", deconflictCB);
-    ros::ServiceClient check_client = nh.serviceClient<gauss_msgs::CheckConflicts>("/gauss/check_conflicts");
+int threatPriority(const gauss_msgs::NewThreat &_threat) {
+    // Priority of the uav that maneuvers, threats without priorities go last
+    int uav_id = maneuveringUav(_threat);
+    int out_priority = std::numeric_limits<int>::min();
+    for (size_t idx = 0; idx < _threat.uav_ids.size() && idx < _threat.priority_ops.size(); idx++) {
+        if (uav_id == -1 || _threat.uav_ids.at(idx) == uav_id) out_priority = std::max(out_priority, (int)_threat.priority_ops.at(idx));
+    }
+    return out_priority;
+}
 
-    auto visualization_topic_url = "/gauss/visualize_tactical";
+bool batchDeconflictCB(gauss_msgs::NewBatchDeconfliction::Request &req, gauss_msgs::NewBatchDeconfliction::Response &res) {
+    ROS_INFO("[Tactical] Batch of %zu threats to solve", req.threats.size());
+    for (auto threat : req.threats) recordThreat(threat);
+    DeconflictionBudget budget(deconfliction_deadline_);
+    // One scene for all the threats. Threats are solved in order of priority and each selected plan replaces the
+    // estimated trajectory of its uav in the scene, so the threats solved later plan around it
+    std::vector<gauss_msgs::ConflictiveOperation> conflictive_operations;
+    for (auto threat : req.threats) conflictive_operations.insert(conflictive_operations.end(), threat.conflictive_operations.begin(), threat.conflictive_operations.end());
+    TrajectoryIndex traffic_index;
+    buildTrafficIndex(conflictive_operations, traffic_index);
+    SpaceTimePlanner plan_checker(traffic_index);
+    std::vector<int> order(req.threats.size());
+    for (size_t i = 0; i < order.size(); i++) order[i] = i;
+    std::stable_sort(order.begin(), order.end(), [&](int a, int b) { return threatPriority(req.threats[a]) > threatPriority(req.threats[b]); });
+
+    std::map<int, std::vector<gauss_msgs::Waypoint>> selected_plans;
+    for (int index : order) {
+        gauss_msgs::NewThreat threat = req.threats[index];
+        if (threat.uav_ids.empty() || threat.conflictive_operations.empty()) continue;
+        // A threat of an uav that already has a plan is solved on top of that plan
+        for (auto &operation : threat.conflictive_operations) {
+            auto selected_plan = selected_plans.find(operation.uav_id);
+            if (selected_plan != selected_plans.end()) operation.flight_plan_updated.waypoints = selected_plan->second;
+        }
+        std::vector<gauss_msgs::DeconflictionPlan> plans;
+        std::vector<double> plan_times;
+        deconflictThreat(threat, budget, plans, plan_times, &traffic_index);
+        // Same choice as for a single threat, but among the plans clear of the rest of the scene if there is any
+        int uav_id = maneuveringUav(threat);
+        int best = -1, best_clear = -1;
+        double best_value = std::numeric_limits<double>::max(), best_clear_value = std::numeric_limits<double>::max();
+        std::vector<double> operational_volumes(plans.size(), 0.0);
+        for (int i = 0; i < (int)plans.size(); i++) {
+            if (uav_id != -1 && plans[i].uav_id != uav_id) continue;
+            for (auto operation : threat.conflictive_operations) {
+                if (operation.uav_id == plans[i].uav_id) operational_volumes[i] = operation.operational_volume;
+            }
+            double value = plans[i].cost + plans[i].riskiness;
+            if (best_value >= value) {
+                best = i;
+                best_value = value;
+            }
+            plan_checker.setSeparation(operational_volumes[i], safety_distance_);
+            if (best_clear_value >= value && plan_checker.pathFree(plans[i].uav_id, plans[i].waypoint_list)) {
+                best_clear = i;
+                best_clear_value = value;
+            }
+        }
+        if (best < 0) {
+            ROS_WARN("[Tactical] No plan found for threat [%d, %d]", threat.threat_id, threat.threat_type);
+            continue;
+        }
+        ROS_WARN_COND(best_clear < 0, "[Tactical] No plan for threat [%d, %d] is clear of the other plans of the batch", threat.threat_id, threat.threat_type);
+        gauss_msgs::DeconflictionPlan &selected = plans[best_clear >= 0 ? best_clear : best];
+        gauss_msgs::WaypointList selected_trajectory;
+        selected_trajectory.waypoints = selected.waypoint_list;
+        traffic_index.removeTrajectory(selected.uav_id);
+        traffic_index.addTrajectory(selected.uav_id, selected_trajectory, operational_volumes[best_clear >= 0 ? best_clear : best]);
+        selected_plans[selected.uav_id] = selected.waypoint_list;
+        res.threat_indexes.push_back(index);
+        res.deconfliction_plans.push_back(selected);
+        res.plan_times.push_back(budget.elapsed());
+    }
 
-    visualization_pub_ = nh.advertise<visualization_msgs::MarkerArray>(visualization_topic_url, 1);
+    res.computation_time = budget.elapsed();
+    res.deadline_reached = budget.reached;
+    res.message = std::to_string(res.deconfliction_plans.size()) + " of " + std::to_string(req.threats.size()) + " threats solved";
+    res.success = true;
+    return res.success;
+}
 
-    ros::Rate rate(1);  // [Hz]
-    while (ros::ok()) {
-        ros::spinOnce();
-        rate.sleep();
+void initTacticalDeconfliction(ros::NodeHandle &_nh) {
+    _nh.param("safetyDistance", safety_distance_, 10.0);
+    _nh.param("actual_wp_on_merge", actual_wp_on_merge_, true);
+    _nh.param("space_time_resolution", space_time_resolution_, 10.0);
+    _nh.param("space_time_max_expansions", space_time_max_expansions_, 20000);
+    _nh.param("deconfliction_deadline", deconfliction_deadline_, 2.0);
+    std::string threat_record_bag;
+    _nh.param("threat_record_bag", threat_record_bag, std::string(""));
+    if (!threat_record_bag.empty()) {
+        try {
+            threat_record_bag_.open(threat_record_bag, rosbag::bagmode::Write);
+            ROS_INFO("[Tactical] Recording threats on %s", threat_record_bag.c_str());
+        } catch (rosbag::BagException &e) {
+            ROS_ERROR("[Tactical] Failed opening %s: %s", threat_record_bag.c_str(), e.what());
+        }
     }
 
-    ros::spin();
-    return 0;
+    read_icao_client_ = _nh.serviceClient<gauss_msgs::ReadIcao>("/gauss/read_icao");
+    read_operation_client_ = _nh.serviceClient<gauss_msgs::ReadOperation>("/gauss/read_operation");
+
+    auto visualization_topic_url = "/gauss/visualize_tactical";
+
+    visualization_pub_ = _nh.advertise<visualization_msgs::MarkerArray>(visualization_topic_url, 1);
 }
@@ -0,0 +1,25 @@
+#include <gauss_msgs/CheckConflicts.h>
+#include <ros/ros.h>
+#include <tactical_deconfliction/tactical_deconfliction.h>
+
+#include <algorithm>
+
+int main(int argc, char **argv) {
+    ros::init(argc, argv, "tactical_deconfliction");
+
+    ros::NodeHandle nh;
+    initTacticalDeconfliction(nh);
+
+    ros::ServiceServer deconflict_server = nh.advertiseService("/gauss/new_tactical_deconfliction", deconflictCB);
+    ros::ServiceServer batch_deconflict_server = nh.advertiseService("/gauss/new_tactical_batch_deconfliction", batchDeconflictCB);
+    ros::ServiceClient check_client = nh.serviceClient<gauss_msgs::CheckConflicts>("/gauss/check_conflicts");
+    ros::Subscriber geofence_update_sub = nh.subscribe("/gauss/geofence_updates", 1000, geofenceUpdateCB);
+
+    // Deconfliction requests are served concurrently, one per spinner thread
+    int deconfliction_threads;
+    nh.param("deconfliction_threads", deconfliction_threads, 2);
+    ros::AsyncSpinner spinner(std::max(deconfliction_threads, 1));
+    spinner.start();
+    ros::waitForShutdown();
+    return 0;
+}
@@ -0,0 +1,159 @@
+//----------------------------------------------------------------------------------------------------------------------
+// The MIT License (MIT)
+//
+// Copyright (c) 2018 GRVC University of Seville
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+// documentation files (the "Software"), to deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies or substantial portions of the
+// Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+// WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS
+// OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+// OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//----------------------------------------------------------------------------------------------------------------------
+
+#include <tactical_deconfliction/visibility_graph_planner.h>
+
+#include <functional>
+#include <limits>
+#include <queue>
+
+namespace {
+const double EPSILON = 1.0e-9;
+
+double cross(const Eigen::Vector2d &_o, const Eigen::Vector2d &_a, const Eigen::Vector2d &_b) {
+    return (_a.x() - _o.x()) * (_b.y() - _o.y()) - (_a.y() - _o.y()) * (_b.x() - _o.x());
+}
+
+// True if segments ab and cd cross at a point interior to both. Touching at an end or overlapping is not crossing
+bool segmentsCross(const Eigen::Vector2d &_a, const Eigen::Vector2d &_b, const Eigen::Vector2d &_c, const Eigen::Vector2d &_d) {
+    double d1 = cross(_c, _d, _a);
+    double d2 = cross(_c, _d, _b);
+    double d3 = cross(_a, _b, _c);
+    double d4 = cross(_a, _b, _d);
+    return ((d1 > EPSILON && d2 < -EPSILON) || (d1 < -EPSILON && d2 > EPSILON)) &&
+           ((d3 > EPSILON && d4 < -EPSILON) || (d3 < -EPSILON && d4 > EPSILON));
+}
+}  // namespace
+
+VisibilityGraphPlanner::VisibilityGraphPlanner() : deadline_(std::chrono::steady_clock::time_point::max()) {
+}
+
+VisibilityGraphPlanner::~VisibilityGraphPlanner() {
+}
+
+void VisibilityGraphPlanner::addObstacle(const geometry_msgs::Polygon &_polygon) {
+    std::vector<Eigen::Vector2d> obstacle;
+    for (auto point : _polygon.points) obstacle.push_back(Eigen::Vector2d(point.x, point.y));
+    if (obstacle.size() > 1 && (obstacle.front() - obstacle.back()).norm() < EPSILON) obstacle.pop_back();
+    if (obstacle.size() >= 3) obstacles_.push_back(obstacle);
+}
+
+void VisibilityGraphPlanner::clearObstacles() {
+    obstacles_.clear();
+}
+
+bool VisibilityGraphPlanner::insideObstacle(const Eigen::Vector2d &_point, int _obstacle) const {
+    // Points on the border are not inside
+    const std::vector<Eigen::Vector2d> &polygon = obstacles_[_obstacle];
+    bool inside = false;
+    for (size_t i = 0, j = polygon.size() - 1; i < polygon.size(); j = i++) {
+        const Eigen::Vector2d &vi = polygon[i];
+        const Eigen::Vector2d &vj = polygon[j];
+        Eigen::Vector2d edge = vi - vj;
+        if (std::abs(cross(vj, vi, _point)) <= EPSILON * std::max(1.0, edge.norm()) &&
+            (_point - vj).dot(_point - vi) <= EPSILON) return false;
+        if (((vi.y() > _point.y()) != (vj.y() > _point.y())) &&
+            (_point.x() < (vj.x() - vi.x()) * (_point.y() - vi.y()) / (vj.y() - vi.y()) + vi.x()))
+            inside = !inside;
+    }
+    return inside;
+}
+
+bool VisibilityGraphPlanner::visible(const Eigen::Vector2d &_a, const Eigen::Vector2d &_b, int _ignored_a, int _ignored_b) const {
+    for (int k = 0; k < (int)obstacles_.size(); k++) {
+        if (k == _ignored_a || k == _ignored_b) continue;
+        const std::vector<Eigen::Vector2d> &polygon = obstacles_[k];
+        for (size_t i = 0, j = polygon.size() - 1; i < polygon.size(); j = i++) {
+            if (segmentsCross(_a, _b, polygon[j], polygon[i])) return false;
+        }
+        // Segments between vertices may go through the obstacle without crossing any edge (diagonals, touching vertices)
+        for (double t : {0.25, 0.5, 0.75}) {
+            if (insideObstacle(_a + t * (_b - _a), k)) return false;
+        }
+    }
+    return true;
+}
+
+bool VisibilityGraphPlanner::findPath(const geometry_msgs::Point &_start, const geometry_msgs::Point &_goal, std::vector<geometry_msgs::Point> &_path) {
+    _path.clear();
+    Eigen::Vector2d start(_start.x, _start.y);
+    Eigen::Vector2d goal(_goal.x, _goal.y);
+    int start_obstacle = -1, goal_obstacle = -1;
+    for (int k = 0; k < (int)obstacles_.size(); k++) {
+        if (start_obstacle < 0 && insideObstacle(start, k)) start_obstacle = k;
+        if (goal_obstacle < 0 && insideObstacle(goal, k)) goal_obstacle = k;
+    }
+
+    // Graph nodes: start, goal and every obstacle vertex not inside another obstacle
+    std::vector<Eigen::Vector2d> nodes;
+    nodes.push_back(start);
+    nodes.push_back(goal);
+    for (size_t k = 0; k < obstacles_.size(); k++) {
+        for (auto vertex : obstacles_[k]) {
+            bool covered = false;
+            for (size_t l = 0; l < obstacles_.size() && !covered; l++) covered = l != k && insideObstacle(vertex, l);
+            if (!covered) nodes.push_back(vertex);
+        }
+    }
+    const int START = 0, GOAL = 1;
+
+    // A*, visibility of the neighbours is computed when a node is expanded
+    std::vector<double> cost(nodes.size(), std::numeric_limits<double>::max());
+    std::vector<int> parent(nodes.size(), -1);
+    std::vector<bool> closed(nodes.size(), false);
+    typedef std::pair<double, int> QueueItem;
+    std::priority_queue<QueueItem, std::vector<QueueItem>, std::greater<QueueItem>> open;
+    cost[START] = 0;
+    open.push(std::make_pair((goal - start).norm(), START));
+    int expansions = 0;
+    while (!open.empty()) {
+        int current = open.top().second;
+        open.pop();
+        if (closed[current]) continue;
+        closed[current] = true;
+        if (current == GOAL) break;
+        if (++expansions % 16 == 0 && std::chrono::steady_clock::now() >= deadline_) return false;
+        for (int next = 1; next < (int)nodes.size(); next++) {
+            if (closed[next]) continue;
+            double next_cost = cost[current] + (nodes[next] - nodes[current]).norm();
+            if (next_cost >= cost[next]) continue;
+            int ignored_a = current == START ? start_obstacle : -1;
+            int ignored_b = next == GOAL ? goal_obstacle : -1;
+            if (!visible(nodes[current], nodes[next], ignored_a, ignored_b)) continue;
+            cost[next] = next_cost;
+            parent[next] = current;
+            open.push(std::make_pair(next_cost + (goal - nodes[next]).norm(), next));
+        }
+    }
+    if (!closed[GOAL]) return false;
+
+    std::vector<int> reversed_path;
+    for (int node = GOAL; node >= 0; node = parent[node]) reversed_path.push_back(node);
+    for (auto it = reversed_path.rbegin(); it != reversed_path.rend(); ++it) {
+        geometry_msgs::Point point;
+        point.x = nodes[*it].x();
+        point.y = nodes[*it].y();
+        point.z = 0.0;
+        _path.push_back(point);
+    }
+    _path.front() = _start;
+    _path.back() = _goal;
+
+    return true;
+}
@@ -19,7 +19,7 @@ struct Candidate{
     // Source from which data has come
     SOURCE source;
 
-    std::string icao_address;
+    uint32_t icao; // ICAO address, as in the MQTT messages
     uint8_t uav_id;
 
     // Location and speed
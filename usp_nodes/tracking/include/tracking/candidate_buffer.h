@@ -0,0 +1,178 @@
+//------------------------------------------------------------------------------
+// GRVC
+//------------------------------------------------------------------------------
+//
+// Copyright (c) 2016 GRVC University of Seville
+//
+//------------------------------------------------------------------------------
+
+#ifndef CANDIDATE_BUFFER_H_
+#define CANDIDATE_BUFFER_H_
+
+#include <tracking/candidate.h>
+
+#include <atomic>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+/** \brief Bounded multi-producer/single-consumer ring buffer of pooled candidates.
+
+Every slot holds a preallocated Candidate, so ingesting a position report never allocates nor
+locks. Producers (the position report callbacks) claim a slot with acquire(), fill it in place
+and publish it with commit(). The consumer (the estimator loop) reads published slots in order
+with front() and gives them back to the pool with pop().
+
+When the buffer is full the incoming candidate is dropped (drop newest policy), so producers
+never wait for the consumer. Drops are counted and can be read with getStats().
+*/
+
+class CandidateBuffer
+{
+public:
+    struct Stats
+    {
+        uint64_t pushed;            /// Candidates committed into the buffer
+        uint64_t dropped;           /// Candidates rejected because the buffer was full
+        uint64_t consumed;          /// Candidates released by the consumer
+        size_t high_watermark;      /// Maximum occupancy observed
+    };
+
+    /** Constructor
+    \param capacity Number of pooled slots. It is rounded up to the next power of two
+    */
+    explicit CandidateBuffer(size_t capacity = 256) : slots_(roundUpToPowerOfTwo(capacity))
+    {
+        mask_ = slots_.size() - 1;
+        for (size_t i = 0; i < slots_.size(); i++)
+            slots_[i].sequence.store(i, std::memory_order_relaxed);
+        enqueue_pos_.store(0, std::memory_order_relaxed);
+        dequeue_pos_ = 0;
+        pushed_.store(0, std::memory_order_relaxed);
+        dropped_.store(0, std::memory_order_relaxed);
+        consumed_.store(0, std::memory_order_relaxed);
+        high_watermark_.store(0, std::memory_order_relaxed);
+    }
+
+    /**
+    \brief Claim a free slot. Safe to call from several threads at once.
+    \return Pointer to the pooled candidate to be filled, or nullptr if the buffer is full
+    */
+    Candidate *acquire()
+    {
+        size_t pos = enqueue_pos_.load(std::memory_order_relaxed);
+        for (;;)
+        {
+            Slot &slot = slots_[pos & mask_];
+            size_t sequence = slot.sequence.load(std::memory_order_acquire);
+            intptr_t diff = (intptr_t)sequence - (intptr_t)pos;
+            if (diff == 0)
+            {
+                if (enqueue_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                {
+                    slot.position = pos;
+                    return &slot.candidate;
+                }
+            }
+            else if (diff < 0)
+            {
+                dropped_.fetch_add(1, std::memory_order_relaxed);
+                return nullptr;
+            }
+            else
+            {
+                pos = enqueue_pos_.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    /**
+    \brief Publish a candidate previously obtained with acquire() to the consumer.
+    \param candidate Pointer returned by acquire()
+    */
+    void commit(Candidate *candidate)
+    {
+        Slot &slot = slots_[slotIndex(candidate)];
+        size_t position = slot.position;
+        slot.sequence.store(position + 1, std::memory_order_release);
+        pushed_.fetch_add(1, std::memory_order_relaxed);
+
+        // Occupancy is only an estimate, the consumer may already be past this position
+        intptr_t occupancy = (intptr_t)(position + 1) - (intptr_t)consumed_.load(std::memory_order_relaxed);
+        size_t high_watermark = high_watermark_.load(std::memory_order_relaxed);
+        while (occupancy > (intptr_t)high_watermark &&
+               !high_watermark_.compare_exchange_weak(high_watermark, (size_t)occupancy, std::memory_order_relaxed));
+    }
+
+    /**
+    \brief Oldest published candidate. Only the consumer thread may call it.
+    \return Pointer to the candidate, or nullptr if there is nothing ready to consume
+    */
+    Candidate *front()
+    {
+        Slot &slot = slots_[dequeue_pos_ & mask_];
+        size_t sequence = slot.sequence.load(std::memory_order_acquire);
+        if (sequence != dequeue_pos_ + 1)
+            return nullptr;
+        return &slot.candidate;
+    }
+
+    /**
+    \brief Give the candidate returned by front() back to the pool. Only the consumer thread may call it.
+    */
+    void pop()
+    {
+        Slot &slot = slots_[dequeue_pos_ & mask_];
+        slot.sequence.store(dequeue_pos_ + mask_ + 1, std::memory_order_release);
+        dequeue_pos_++;
+        consumed_.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    size_t capacity() const { return mask_ + 1; }
+
+    Stats getStats() const
+    {
+        Stats stats;
+        stats.pushed = pushed_.load(std::memory_order_relaxed);
+        stats.dropped = dropped_.load(std::memory_order_relaxed);
+        stats.consumed = consumed_.load(std::memory_order_relaxed);
+        stats.high_watermark = high_watermark_.load(std::memory_order_relaxed);
+        return stats;
+    }
+
+private:
+    struct Slot
+    {
+        Candidate candidate;
+        std::atomic<size_t> sequence;
+        size_t position;
+
+        Slot() : sequence(0), position(0) {}
+    };
+
+    static size_t roundUpToPowerOfTwo(size_t capacity)
+    {
+        size_t size = 2;
+        while (size < capacity)
+            size <<= 1;
+        return size;
+    }
+
+    size_t slotIndex(const Candidate *candidate) const
+    {
+        const char *first = reinterpret_cast<const char *>(&slots_.front().candidate);
+        return (reinterpret_cast<const char *>(candidate) - first) / sizeof(Slot);
+    }
+
+    std::vector<Slot> slots_;
+    size_t mask_;
+    std::atomic<size_t> enqueue_pos_;
+    size_t dequeue_pos_;
+
+    std::atomic<uint64_t> pushed_;
+    std::atomic<uint64_t> dropped_;
+    std::atomic<uint64_t> consumed_;
+    std::atomic<size_t> high_watermark_;
+};
+
+#endif
@@ -0,0 +1,245 @@
+//------------------------------------------------------------------------------
+// GRVC
+//------------------------------------------------------------------------------
+//
+// Copyright (c) 2016 GRVC University of Seville
+//
+//------------------------------------------------------------------------------
+
+#ifndef SEGMENT_LOCATOR_H_
+#define SEGMENT_LOCATOR_H_
+
+#include <gauss_msgs/WaypointList.h>
+
+#include <Eigen/Eigen>
+#include <algorithm>
+#include <limits>
+#include <vector>
+
+/** \brief Finds the flight plan segment an uav is currently flying.
+
+A cursor remembers the segment found in the previous query. Next queries only look at a bounded
+number of segments starting at the cursor, so the cursor advances monotonically along the flight
+plan and the cost does not depend on the flight plan length. If none of those segments is close
+enough to the current position (the uav has jumped, or the flight plan is self-crossing far away
+from the cursor), the closest segment is searched in a bounding volume hierarchy built over all the
+segments when the flight plan is set.
+
+a_index and b_index are the ends of the segment found, or both the index of its closest waypoint if the
+projection of the position falls outside the segment. The fallback search gives the closest segment of
+the whole flight plan, as the exhaustive search. The search around the cursor gives the closest segment
+of its window, which is trusted if it is within max_local_distance: a closer segment out of the window
+(a self-crossing flight plan) is not found, the uav is kept on the part of the flight plan it is flying.
+
+isBuiltFor only compares the waypoint count and the last waypoint, callers that change the flight plan
+must call reset() with the new one.
+*/
+
+class SegmentLocator
+{
+public:
+    /**
+    \param search_window Number of segments checked from the cursor before falling back to the hierarchy
+    */
+    explicit SegmentLocator(int search_window = 8) : search_window_(search_window), cursor_(0), waypoint_count_(0) {}
+
+    /// Set the flight plan to search in. Builds the hierarchy and moves the cursor to the first segment
+    void reset(const gauss_msgs::WaypointList &flight_plan)
+    {
+        waypoint_count_ = flight_plan.waypoints.size();
+        cursor_ = 0;
+        points_.resize(waypoint_count_);
+        for (size_t i = 0; i < waypoint_count_; i++)
+            points_[i] = Eigen::Vector3d(flight_plan.waypoints[i].x, flight_plan.waypoints[i].y, flight_plan.waypoints[i].z);
+
+        nodes_.clear();
+        segment_indices_.clear();
+        if (waypoint_count_ < 2)
+            return;
+        for (int i = 0; i < (int)waypoint_count_ - 1; i++)
+            segment_indices_.push_back(i);
+        nodes_.reserve(2*segment_indices_.size());
+        buildNode(0, segment_indices_.size());
+    }
+
+    /// True if reset() was called with a flight plan like this one. Cheap check, not a full comparison
+    bool isBuiltFor(const gauss_msgs::WaypointList &flight_plan) const
+    {
+        if (flight_plan.waypoints.size() != waypoint_count_ || waypoint_count_ == 0)
+            return false;
+        const gauss_msgs::Waypoint &last = flight_plan.waypoints.back();
+        return points_.back() == Eigen::Vector3d(last.x, last.y, last.z);
+    }
+
+    /**
+    \brief Find the segment of the flight plan closest to the current position
+    \param current_position Current position
+    \param max_local_distance Distance from which the segment found around the cursor is not trusted and the whole flight plan is searched
+    */
+    void find(const gauss_msgs::Waypoint &current_position, double max_local_distance, int &a_index, int &b_index,
+              double &distance_to_segment, double &distance_to_point_a, double &distance_to_point_b)
+    {
+        Eigen::Vector3d position(current_position.x, current_position.y, current_position.z);
+        a_index = 0;
+        b_index = 0;
+        distance_to_segment = std::numeric_limits<double>::max();
+
+        if (waypoint_count_ == 1)
+        {
+            distance_to_segment = (position - points_[0]).norm();
+        }
+        else if (waypoint_count_ > 1)
+        {
+            int segment_count = waypoint_count_ - 1;
+            int best_segment = -1;
+            int last_segment = std::min(cursor_ + search_window_, segment_count);
+            for (int i = cursor_; i < last_segment; i++)
+            {
+                int a, b;
+                double distance = segmentDistance(position, i, a, b);
+                if (distance <= distance_to_segment)
+                {
+                    distance_to_segment = distance;
+                    best_segment = i;
+                    a_index = a;
+                    b_index = b;
+                }
+            }
+
+            if (distance_to_segment > max_local_distance)
+            {
+                // The uav is not around the cursor, search in the whole flight plan
+                distance_to_segment = std::numeric_limits<double>::max();
+                searchNode(0, position, distance_to_segment, best_segment, a_index, b_index);
+            }
+            cursor_ = best_segment;
+        }
+
+        if (waypoint_count_ > 0)
+        {
+            distance_to_point_a = (points_[a_index] - position).norm();
+            distance_to_point_b = (points_[b_index] - position).norm();
+        }
+    }
+
+private:
+    struct Node
+    {
+        Eigen::Vector3d min;
+        Eigen::Vector3d max;
+        int left;       /// Index of the left child, -1 if leaf
+        int right;      /// Index of the right child, -1 if leaf
+        int first;      /// First position in segment_indices_ (leaf only)
+        int count;      /// Number of segments (leaf only)
+    };
+
+    static const int LEAF_SIZE = 4;
+
+    double segmentDistance(const Eigen::Vector3d &position, int segment, int &a_index, int &b_index) const
+    {
+        const Eigen::Vector3d &point_a = points_[segment];
+        const Eigen::Vector3d &point_b = points_[segment+1];
+        Eigen::Vector3d vector_u = point_b - point_a;
+        double squared_norm = vector_u.squaredNorm();
+        // Projection of the position on the line that contains the segment
+        double t = squared_norm > 0 ? vector_u.dot(position - point_a)/squared_norm : -1.0;
+        if (t >= 0 && t <= 1)
+        {
+            a_index = segment;
+            b_index = segment + 1;
+            return (point_a + t*vector_u - position).norm();
+        }
+
+        double distance_to_waypoint_a = (position - point_a).norm();
+        double distance_to_waypoint_b = (position - point_b).norm();
+        if (distance_to_waypoint_a < distance_to_waypoint_b)
+        {
+            a_index = b_index = segment;
+            return distance_to_waypoint_a;
+        }
+        a_index = b_index = segment + 1;
+        return distance_to_waypoint_b;
+    }
+
+    int buildNode(int first, int count)
+    {
+        int node_index = nodes_.size();
+        nodes_.push_back(Node());
+        Eigen::Vector3d min = Eigen::Vector3d::Constant(std::numeric_limits<double>::max());
+        Eigen::Vector3d max = -min;
+        for (int i = first; i < first + count; i++)
+        {
+            int segment = segment_indices_[i];
+            min = min.cwiseMin(points_[segment]).cwiseMin(points_[segment+1]);
+            max = max.cwiseMax(points_[segment]).cwiseMax(points_[segment+1]);
+        }
+        nodes_[node_index].min = min;
+        nodes_[node_index].max = max;
+        nodes_[node_index].first = first;
+        nodes_[node_index].count = count;
+        nodes_[node_index].left = -1;
+        nodes_[node_index].right = -1;
+        if (count <= LEAF_SIZE)
+            return node_index;
+
+        // Split by the median of segment centers along the largest axis
+        int axis;
+        (max - min).maxCoeff(&axis);
+        auto begin = segment_indices_.begin() + first;
+        const std::vector<Eigen::Vector3d> &points = points_;
+        std::nth_element(begin, begin + count/2, begin + count, [&points, axis](int s1, int s2) {
+            return points[s1][axis] + points[s1+1][axis] < points[s2][axis] + points[s2+1][axis];
+        });
+        int left = buildNode(first, count/2);
+        int right = buildNode(first + count/2, count - count/2);
+        nodes_[node_index].left = left;
+        nodes_[node_index].right = right;
+        return node_index;
+    }
+
+    double boxDistance(const Node &node, const Eigen::Vector3d &position) const
+    {
+        Eigen::Vector3d delta = (node.min - position).cwiseMax(position - node.max).cwiseMax(Eigen::Vector3d::Zero());
+        return delta.norm();
+    }
+
+    void searchNode(int node_index, const Eigen::Vector3d &position, double &best_distance, int &best_segment, int &a_index, int &b_index) const
+    {
+        const Node &node = nodes_[node_index];
+        if (boxDistance(node, position) > best_distance)
+            return;
+        if (node.left < 0)
+        {
+            for (int i = node.first; i < node.first + node.count; i++)
+            {
+                int segment = segment_indices_[i];
+                int a, b;
+                double distance = segmentDistance(position, segment, a, b);
+                // On ties keep the latest segment, as the exhaustive search does
+                if (distance < best_distance || (distance == best_distance && segment > best_segment))
+                {
+                    best_distance = distance;
+                    best_segment = segment;
+                    a_index = a;
+                    b_index = b;
+                }
+            }
+            return;
+        }
+        // Visit closest child first to prune more
+        int first_child = node.left, second_child = node.right;
+        if (boxDistance(nodes_[node.right], position) < boxDistance(nodes_[node.left], position))
+            std::swap(first_child, second_child);
+        searchNode(first_child, position, best_distance, best_segment, a_index, b_index);
+        searchNode(second_child, position, best_distance, best_segment, a_index, b_index);
+    }
+
+    int search_window_;
+    int cursor_;                                /// Segment found in the previous query
+    size_t waypoint_count_;
+    std::vector<Eigen::Vector3d> points_;       /// Flight plan waypoints
+    std::vector<int> segment_indices_;          /// Segments ordered by hierarchy leaves
+    std::vector<Node> nodes_;                   /// Bounding volume hierarchy, root at index 0
+};
+
+#endif
@@ -51,7 +51,7 @@ protected:
 	int update_count_;				/// Counter with the number of updates
 	int id_;						/// Target identifier
 
-	std::string icao_address_;
+	uint32_t icao_;
 	uint8_t uav_id_;
 
 	enum InfoSource {ADSB=0, POSITIONREPORT=1, BOTH=2};
@@ -0,0 +1,145 @@
+//------------------------------------------------------------------------------
+// GRVC
+//------------------------------------------------------------------------------
+//
+// Copyright (c) 2016 GRVC University of Seville
+//
+//------------------------------------------------------------------------------
+
+#ifndef TRAJECTORY_WINDOW_H_
+#define TRAJECTORY_WINDOW_H_
+
+#include <gauss_msgs/WaypointList.h>
+
+#include <cmath>
+#include <vector>
+
+/** \brief Cursor that walks a flight plan producing the estimated trajectory waypoints.
+
+Starting from the current position of an uav, the estimated trajectory follows the flight plan with
+a waypoint each dT seconds. Inside every segment the estimated waypoints are aligned with the end of
+the segment, so every flight plan waypoint is part of the estimated trajectory at its arrival time.
+
+The cursor keeps where the last estimated waypoint was generated, so the estimated trajectory can be
+extended with new waypoints at its tail without generating it again from the current position.
+*/
+
+class TrajectoryWindow
+{
+public:
+    TrajectoryWindow() : segment_end_index_(0), steps_to_segment_end_(0), dT_(1.0), valid_(false) {}
+
+    /**
+    \brief Place the cursor at the current position, heading to a flight plan waypoint.
+    \param current_position Current estimated position (including timestamp)
+    \param flight_plan Flight plan followed by the uav
+    \param next_wp_index Index of the flight plan waypoint the uav is heading to
+    \param time_to_next_waypoint Time (seconds) to reach that waypoint
+    \param dT Time (seconds) between estimated waypoints
+    */
+    void start(const gauss_msgs::Waypoint &current_position, const gauss_msgs::WaypointList &flight_plan,
+               int next_wp_index, double time_to_next_waypoint, double dT)
+    {
+        dT_ = dT;
+        segment_start_ = current_position;
+        segment_end_index_ = next_wp_index;
+        segment_end_time_ = current_position.stamp + ros::Duration(std::max(time_to_next_waypoint, 0.0));
+        steps_to_segment_end_ = stepsInSegment(time_to_next_waypoint);
+        valid_ = segment_end_index_ < (int)flight_plan.waypoints.size();
+    }
+
+    /// True once the last flight plan waypoint has been generated
+    bool finished(const gauss_msgs::WaypointList &flight_plan) const
+    {
+        return segment_end_index_ >= (int)flight_plan.waypoints.size();
+    }
+
+    /// Timestamp of the waypoint that next() will generate
+    ros::Time nextStamp() const
+    {
+        return segment_end_time_ - ros::Duration(steps_to_segment_end_*dT_);
+    }
+
+    /// Index of the flight plan waypoint at the end of the current segment
+    int nextFlightPlanIndex() const { return segment_end_index_; }
+
+    /**
+    \brief Generate the next estimated waypoint and advance the cursor.
+    Must not be called once finished() is true.
+    */
+    void next(const gauss_msgs::WaypointList &flight_plan, gauss_msgs::Waypoint &waypoint)
+    {
+        const gauss_msgs::Waypoint &segment_end = flight_plan.waypoints[segment_end_index_];
+        if (steps_to_segment_end_ <= 0)
+        {
+            waypoint = segment_end;
+            waypoint.stamp = segment_end_time_;
+            advanceSegment(flight_plan);
+            return;
+        }
+
+        ros::Time stamp = nextStamp();
+        double segment_time = (segment_end_time_ - segment_start_.stamp).toSec();
+        double alpha = segment_time > 0 ? (stamp - segment_start_.stamp).toSec()/segment_time : 1.0;
+        waypoint = segment_start_;
+        waypoint.x = segment_start_.x + alpha*(segment_end.x - segment_start_.x);
+        waypoint.y = segment_start_.y + alpha*(segment_end.y - segment_start_.y);
+        waypoint.z = segment_start_.z + alpha*(segment_end.z - segment_start_.z);
+        waypoint.stamp = stamp;
+        steps_to_segment_end_--;
+    }
+
+    /**
+    \brief Append the flight plan waypoints not generated yet, keeping the flight plan time between them.
+    The cursor is not modified.
+    */
+    void appendRemainingFlightPlan(const gauss_msgs::WaypointList &flight_plan, std::vector<gauss_msgs::Waypoint> &waypoints) const
+    {
+        ros::Time stamp = segment_end_time_;
+        for (int i = segment_end_index_; i < (int)flight_plan.waypoints.size(); i++)
+        {
+            if (i > segment_end_index_)
+                stamp += flight_plan.waypoints[i].stamp - flight_plan.waypoints[i-1].stamp;
+            waypoints.push_back(flight_plan.waypoints[i]);
+            waypoints.back().stamp = stamp;
+        }
+    }
+
+    bool isValid() const { return valid_; }
+    void invalidate() { valid_ = false; }
+
+private:
+    int stepsInSegment(double segment_time) const
+    {
+        // Number of estimated waypoints strictly after the segment start, not counting the segment end
+        if (segment_time <= 0 || dT_ <= 0)
+            return 0;
+        return std::max((int)std::ceil(segment_time/dT_ - 1e-6) - 1, 0);
+    }
+
+    void advanceSegment(const gauss_msgs::WaypointList &flight_plan)
+    {
+        segment_start_ = flight_plan.waypoints[segment_end_index_];
+        segment_start_.stamp = segment_end_time_;
+        segment_end_index_++;
+        if (segment_end_index_ < (int)flight_plan.waypoints.size())
+        {
+            double segment_time = (flight_plan.waypoints[segment_end_index_].stamp - flight_plan.waypoints[segment_end_index_-1].stamp).toSec();
+            segment_end_time_ += ros::Duration(std::max(segment_time, 0.0));
+            steps_to_segment_end_ = stepsInSegment(segment_time);
+        }
+        else
+        {
+            steps_to_segment_end_ = 0;
+        }
+    }
+
+    gauss_msgs::Waypoint segment_start_;    /// Start of the current segment (timestamp included)
+    ros::Time segment_end_time_;            /// Arrival time at the end of the current segment
+    int segment_end_index_;                 /// Flight plan index of the end of the current segment
+    int steps_to_segment_end_;              /// Estimated waypoints left before reaching the end of the segment
+    double dT_;
+    bool valid_;
+};
+
+#endif
@@ -1,5 +1,6 @@
 #include <ros/ros.h>
 #include <gauss_msgs/PositionReport.h>
+#include <gauss_msgs/PositionReportArray.h>
 #include <gauss_msgs/ReadOperation.h>
 #include <gauss_msgs/WriteOperation.h>
 #include <gauss_msgs/WriteTracking.h>
@@ -8,10 +9,14 @@
 #include <gauss_msgs/ReadIcaoRequest.h>
 #include <gauss_msgs/ReadIcaoResponse.h>
 #include <gauss_msgs/ChangeFlightStatus.h>
+#include <gauss_msgs/icao_address.h>
 #include <boost/thread/mutex.hpp>
 #include <map>
+#include <unordered_map>
 #include <vector>
 #include <tracking/target_tracker.h>
+#include <tracking/candidate_buffer.h>
+#include <tracking/segment_locator.h>
 #include <limits>
 #include <yaml-cpp/yaml.h>
 
@@ -21,9 +26,10 @@
 
 #define COV_SPEED_XY 0.0
 #define VAR_SPEED 1.0
+#define CANDIDATE_BUFFER_SIZE 512
 
-#define pair_uav_id_icao std::pair<uint8_t, std::string>
-#define pair_icao_uav_id std::pair<std::string, uint8_t>
+#define pair_uav_id_icao std::pair<uint8_t, uint32_t>
+#define pair_icao_uav_id std::pair<uint32_t, uint8_t>
 #define pair_wp_index std::pair<int,int>
 
 inline double dotProduct(Eigen::Vector3d vector_1, Eigen::Vector3d vector_2);
@@ -31,6 +37,14 @@ inline double distanceBetweenWaypoints(gauss_msgs::Waypoint &waypoint_a, gauss_m
 inline double distanceFromPointToLine(Eigen::Vector3d point, Eigen::Vector3d inline_point, Eigen::Vector3d line_vector);
 
 enum class FlightStatus {NOT_STARTED, STARTED, ENDED};
+enum class TargetState {TENTATIVE, CONFIRMED, COASTING, ENDED};
+
+struct TargetLifecycle
+{
+    TargetState state;
+    ros::Time last_measurement_time; // Stamp of the last position report used to update the target
+    int measurement_count;
+};
 
 // Class definition
 class Tracking
@@ -43,6 +57,8 @@ public:
 private:
     // Topic Callbacks
     void positionReportCB(const gauss_msgs::PositionReport::ConstPtr& msg);
+    void positionReportArrayCB(const gauss_msgs::PositionReportArray::ConstPtr& msg);
+    void ingestPositionReport(const gauss_msgs::PositionReport &report);
 
     // Service Callbacks
     bool updateFlightPlansCB(gauss_msgs::WritePlans::Request &req, gauss_msgs::WritePlans::Response &res); 
@@ -50,18 +66,22 @@ private:
 
     // Auxilary methods
     void predict(ros::Time &now);
-	bool update(std::vector<Candidate*> &cand_list);
+	bool update(ros::Time &now);
+    void scheduleEstimations(ros::Time &now);
+    void updateTargetLifecycles(ros::Time &now);
+    void reclaimEndedTargets();
 	int getNumTargets();
+	int getNumRetiredTargets();
 	bool getTargetInfo(int target_id, double &x, double &y, double &z);
 	void printTargetsInfo();
-    bool checkTargetAlreadyExist(std::string icao_address);
+    bool checkTargetAlreadyExist(uint32_t icao);
     bool checkTargetAlreadyExist(uint8_t uav_id);
     bool checkCooperativeOperationAlreadyExist(uint8_t uav_id);
     bool writeTrackingInfoToDatabase();
     uint32_t findClosestWaypointIndex(gauss_msgs::WaypointList &waypoint_list, gauss_msgs::Waypoint &current_waypoint, 
                                       double &distance_to_waypoint);
-    void findSegmentWaypointsIndices(gauss_msgs::Waypoint &current_position, gauss_msgs::WaypointList &flight_plan, int &a_index, int &b_index,
-                                     double &distance_to_segment, double &distance_to_point_a, double &distance_to_point_b);                                  
+    void findSegmentWaypointsIndices(uint8_t uav_id, gauss_msgs::Waypoint &current_position, gauss_msgs::WaypointList &flight_plan, double max_local_distance,
+                                     int &a_index, int &b_index, double &distance_to_segment, double &distance_to_point_a, double &distance_to_point_b);                                  
     double distanceBetweenWaypoints(gauss_msgs::Waypoint &waypoint_1, gauss_msgs::Waypoint &waypoint_2);
     void fillTrackingWaypointList();
     void estimateTrajectory();
@@ -73,9 +93,11 @@ private:
     gauss_msgs::WriteOperation write_operation_msg_;
     gauss_msgs::WriteTracking write_tracking_msg_;
     double distance_wp_threshold_margin_; // Threshold from which we'll consider an UAV is not following its flight plan
+    double trajectory_deviation_threshold_; // Distance from the estimated trajectory from which it is shifted in time again
 
     // Subscribers
     ros::Subscriber pos_report_sub_;
+    ros::Subscriber pos_report_array_sub_;
 
     // Publisher
     ros::Publisher new_operation_pub_; //TODO: publish modified operation for debugging purposes
@@ -93,24 +115,32 @@ private:
     ros::ServiceClient read_icao_client_;
 
     // Estimator
-    std::vector<Candidate *> candidates_;
+    CandidateBuffer candidates_; /// Pooled candidates produced by positionReportCB and consumed by the estimator loop
+    uint64_t reported_dropped_candidates_;
 
     double origin_frame_longitude_;
     double origin_frame_latitude_;
 
-    std::map<uint8_t, TargetTracker *> cooperative_targets_; /// Map with cooperative targets
-    std::map<uint8_t, std::string> uav_id_icao_address_map_; // Map relating uav_id and icao_address
-    std::map<std::string, uint8_t> icao_address_uav_id_map_; // Inverse map
+    std::unordered_map<uint8_t, TargetTracker *> cooperative_targets_; /// Map with cooperative targets
+    std::unordered_map<uint8_t, TargetLifecycle> target_lifecycles_; /// Lifecycle of each target in cooperative_targets_
+    int retired_targets_count_;
+    std::map<uint8_t, uint32_t> uav_id_icao_address_map_; // Map relating uav_id and icao_address, parsed once from the database strings
+    std::unordered_map<uint32_t, uint8_t> icao_address_uav_id_map_; // Inverse map
     std::map<uint8_t, FlightStatus> uav_id_flight_status_map_;
-    std::map<std::string, double> cruising_speed_map_;
+    std::map<uint32_t, double> cruising_speed_map_;
     std::map<uint8_t, gauss_msgs::Operation> cooperative_operations_;
     std::map<uint8_t, pair_wp_index> cooperative_operations_flight_plan_segment_wp_indices_;
     std::map<uint8_t, bool> already_tracked_cooperative_operations_;
     std::map<uint8_t, bool> modified_cooperative_operations_flags_;
     std::map<uint8_t, ros::Time> uav_id_last_time_position_update_map_;
-    std::map<std::string, ros::Time> icao_last_time_position_update_map_;
+    std::unordered_map<uint32_t, ros::Time> icao_last_time_position_update_map_;
     std::map<uint8_t,gauss_msgs::WaypointList> uav_id_update_flight_plan_map_;
     std::map<uint8_t,bool> updated_flight_plan_flag_map_;
+    std::map<uint8_t, SegmentLocator> segment_locators_; // Current flight plan segment search of each operation
+    std::map<uint8_t, int> estimated_flight_plan_indices_; // Flight plan index of the next waypoint of each estimated trajectory
+    std::map<uint8_t, ros::Time> last_estimation_time_map_; // Last time each target was estimated
+    std::map<uint8_t, bool> pending_measurement_flags_; // Target updated with measurements not estimated yet
+    std::map<uint8_t, bool> estimation_due_flags_; // Targets to be estimated in the current iteration
 
     // Params
     bool use_position_report_;
@@ -118,15 +148,21 @@ private:
     bool use_speed_info_;
     double time_horizon_;
     double dT_;
+    double min_estimation_interval_; // Minimum time between estimations of a target with new measurements
+    double max_estimation_interval_; // Maximum time between estimations of a target, even without new measurements
+    double db_write_period_; // Period of the batched tracking writes to database
+    int target_confirmation_count_; // Measurements needed to confirm a tentative target
+    double target_coasting_timeout_; // Time without measurements from which a target is coasting
+    double target_end_timeout_; // Time without measurements from which a target is ended and reclaimed
 
     // Mutex
-    boost::mutex candidates_list_mutex_;
     boost::mutex updated_flight_plans_mutex_;
+    boost::mutex position_reports_mutex_; // Ingestion and flight status, written from several spinner threads
 
 };
 
 // tracking Constructor
-Tracking::Tracking()
+Tracking::Tracking() : candidates_(CANDIDATE_BUFFER_SIZE), reported_dropped_candidates_(0), retired_targets_count_(0)
 {
     // Read parameters
     //nh_.param("desired_altitude",desired_altitude,0.5);
@@ -140,6 +176,7 @@ Tracking::Tracking()
 
     // Subscribe
     pos_report_sub_= nh_.subscribe<gauss_msgs::PositionReport>("/gauss/position_report",10,&Tracking::positionReportCB,this);
+    pos_report_array_sub_= nh_.subscribe<gauss_msgs::PositionReportArray>("/gauss/position_report_array",10,&Tracking::positionReportArrayCB,this);
 
     // Server
     update_fligh_plan_server_ = nh_.advertiseService("/gauss/update_flight_plans", &Tracking::updateFlightPlansCB, this);
@@ -158,9 +195,16 @@ Tracking::Tracking()
     nh_.param<bool>("use_position_report", use_position_report_, true);
     nh_.param<bool>("use_adsb_", use_adsb_, true);
     nh_.param<double>("wp_distance_threshold_margin", distance_wp_threshold_margin_, 10.0);
+    nh_.param<double>("trajectory_deviation_threshold", trajectory_deviation_threshold_, 5.0);
     nh_.param<bool>("use_speed_info", use_speed_info_, false);
     nh_.param<double>("time_horizon", time_horizon_, 90.0);
     nh_.param<double>("dT", dT_, 5.0);
+    nh_.param<double>("min_estimation_interval", min_estimation_interval_, 0.5);
+    nh_.param<double>("max_estimation_interval", max_estimation_interval_, 5.0);
+    nh_.param<double>("db_write_period", db_write_period_, 1.0);
+    nh_.param<int>("target_confirmation_count", target_confirmation_count_, 3);
+    nh_.param<double>("target_coasting_timeout", target_coasting_timeout_, 5.0);
+    nh_.param<double>("target_end_timeout", target_end_timeout_, 30.0);
 
     read_icao_client_.waitForExistence();
     gauss_msgs::ReadIcao read_icao;
@@ -171,8 +215,16 @@ Tracking::Tracking()
         std::vector<std::string> &icao_address = read_icao.response.icao_address;
         for(auto it=read_icao.response.uav_id.begin(); it < read_icao.response.uav_id.end(); it++)
         {
-            uav_id_icao_address_map_.insert( std::make_pair((*it),icao_address[index_icao]) );
-            icao_address_uav_id_map_.insert( std::make_pair(icao_address[index_icao], (*it)) );
+            uint32_t icao;
+            if (parseIcaoAddress(icao_address[index_icao], icao))
+            {
+                uav_id_icao_address_map_.insert( std::make_pair((*it),icao) );
+                icao_address_uav_id_map_.insert( std::make_pair(icao, (*it)) );
+            }
+            else
+            {
+                ROS_WARN("[Tracking] Invalid icao address [%s] of uav id %d", icao_address[index_icao].c_str(), (int)(*it));
+            }
             uav_id_flight_status_map_.insert( std::make_pair((*it), FlightStatus::NOT_STARTED) );
             index_icao++;
         }
@@ -225,10 +277,8 @@ Tracking::Tracking()
 
 Tracking::~Tracking()
 {
-    for(int i = 0; i < candidates_.size(); i++)
-		delete candidates_[i];
-    
-    candidates_.clear();
+    for(auto it = cooperative_targets_.begin(); it != cooperative_targets_.end(); ++it)
+        delete it->second;
 }
 
 // Auxilary methods
@@ -236,47 +286,175 @@ void Tracking::predict(ros::Time &prediction_time)
 {
     for(auto it = cooperative_targets_.begin(); it != cooperative_targets_.end(); ++it)
 	{
-        if(uav_id_flight_status_map_[it->first] == FlightStatus::STARTED) 
+        if(uav_id_flight_status_map_[it->first] == FlightStatus::STARTED && estimation_due_flags_[it->first] &&
+           (it->second)->currentPositionTimestamp() != prediction_time)
 		    (it->second)->predict(prediction_time);
 	}
 }
 
-bool Tracking::update(std::vector<Candidate*> &cand_list)
+bool Tracking::update(ros::Time &now)
 {
-    candidates_list_mutex_.lock();
-    // Traverse candidate list, updating those TargetTracker's that already exist,
-    // and initializing those that don't
-    for(auto candidates_it=cand_list.begin(); candidates_it!=cand_list.end(); ++candidates_it)
+    // Drain candidate buffer, updating those TargetTracker's that already exist,
+    // and initializing those that don't. Only targets with measurements are predicted here
+    Candidate *candidate;
+    while((candidate = candidates_.front()) != nullptr)
     {
         // Check if Candidate information comes from a non cooperative uav, in that case the info is discarded
-        if ((*candidates_it)->uav_id != std::numeric_limits<uint8_t>::max() )
+        if (candidate->uav_id != std::numeric_limits<uint8_t>::max() )
         {
-            if(uav_id_flight_status_map_[((*candidates_it)->uav_id)] != FlightStatus::NOT_STARTED)
+            FlightStatus flight_status = uav_id_flight_status_map_[(candidate->uav_id)];
+            auto it_target_tracker = cooperative_targets_.find(candidate->uav_id);
+            if(it_target_tracker != cooperative_targets_.end() && flight_status != FlightStatus::NOT_STARTED)
             {
-                auto it_target_tracker = cooperative_targets_.find((*candidates_it)->uav_id);
-                if(it_target_tracker != cooperative_targets_.end())
-                    it_target_tracker->second->update(*candidates_it);
-                else
+                if(it_target_tracker->second->currentPositionTimestamp() != now)
+                    it_target_tracker->second->predict(now);
+                it_target_tracker->second->update(candidate);
+
+                TargetLifecycle &lifecycle = target_lifecycles_[candidate->uav_id];
+                lifecycle.last_measurement_time = candidate->timestamp;
+                lifecycle.measurement_count++;
+                if(lifecycle.state == TargetState::COASTING)
                 {
-                    cooperative_targets_[(*candidates_it)->uav_id] = new TargetTracker((*candidates_it)->uav_id);
-                    cooperative_targets_[(*candidates_it)->uav_id]->initialize(*candidates_it);
-                    already_tracked_cooperative_operations_[(*candidates_it)->uav_id] = true;
+                    lifecycle.state = TargetState::CONFIRMED;
+                    ROS_INFO("[Tracking] Target of UAV [%d] is receiving position reports again", (int)candidate->uav_id);
                 }
+                else if(lifecycle.state == TargetState::TENTATIVE && lifecycle.measurement_count >= target_confirmation_count_)
+                    lifecycle.state = TargetState::CONFIRMED;
+                pending_measurement_flags_[candidate->uav_id] = true;
+            }
+            else if(it_target_tracker == cooperative_targets_.end() && flight_status == FlightStatus::STARTED)
+            {
+                // Targets are only created for started flights, ended ones are not tracked again once reclaimed
+                TargetTracker *target_tracker = new TargetTracker(candidate->uav_id);
+                target_tracker->initialize(candidate);
+                cooperative_targets_[candidate->uav_id] = target_tracker;
+                TargetLifecycle &lifecycle = target_lifecycles_[candidate->uav_id];
+                lifecycle.state = TargetState::TENTATIVE;
+                lifecycle.last_measurement_time = candidate->timestamp;
+                lifecycle.measurement_count = 1;
+                already_tracked_cooperative_operations_[candidate->uav_id] = true;
+                pending_measurement_flags_[candidate->uav_id] = true;
             }
         }
 
-        delete *candidates_it;
+        candidates_.pop();
     }
-    cand_list.clear();
-    candidates_list_mutex_.unlock();
     return true;
 }
 
+void Tracking::scheduleEstimations(ros::Time &now)
+{
+    // A target is estimated when it has new measurements, but not more often than min_estimation_interval_.
+    // Targets without measurements are estimated again each max_estimation_interval_, and at once if their flight plan changes
+    for(auto it = cooperative_targets_.begin(); it != cooperative_targets_.end(); ++it)
+    {
+        uint8_t uav_id = it->first;
+        bool due = false;
+        if(uav_id_flight_status_map_[uav_id] != FlightStatus::NOT_STARTED)
+        {
+            auto it_last_time = last_estimation_time_map_.find(uav_id);
+            if(it_last_time == last_estimation_time_map_.end() || updated_flight_plan_flag_map_[uav_id])
+                due = true;
+            else
+            {
+                double elapsed = (now - it_last_time->second).toSec();
+                due = elapsed >= max_estimation_interval_ || (pending_measurement_flags_[uav_id] && elapsed >= min_estimation_interval_);
+            }
+        }
+        estimation_due_flags_[uav_id] = due;
+        if(due)
+        {
+            last_estimation_time_map_[uav_id] = now;
+            pending_measurement_flags_[uav_id] = false;
+        }
+    }
+}
+
+void Tracking::updateTargetLifecycles(ros::Time &now)
+{
+    // Targets without position reports coast on their last estimation, and end if reports do not come back
+    for(auto it = target_lifecycles_.begin(); it != target_lifecycles_.end(); ++it)
+    {
+        uint8_t uav_id = it->first;
+        TargetLifecycle &lifecycle = it->second;
+        if(lifecycle.state == TargetState::ENDED)
+            continue;
+
+        double time_without_measurements = (now - lifecycle.last_measurement_time).toSec();
+        if(uav_id_flight_status_map_[uav_id] == FlightStatus::ENDED || time_without_measurements > target_end_timeout_)
+        {
+            lifecycle.state = TargetState::ENDED;
+            modified_cooperative_operations_flags_[uav_id] = true; // Make sure its last state is written before reclaiming it
+            ROS_INFO("[Tracking] Target of UAV [%d] ended", (int)uav_id);
+        }
+        else if(time_without_measurements > target_coasting_timeout_ && lifecycle.state != TargetState::COASTING)
+        {
+            lifecycle.state = TargetState::COASTING;
+            ROS_WARN("[Tracking] No position reports from UAV [%d] for %.1f seconds, target is coasting", (int)uav_id, time_without_measurements);
+        }
+    }
+}
+
+void Tracking::reclaimEndedTargets()
+{
+    // Must be called after writing to database, so the last state of ended targets is already stored
+    for(auto it = target_lifecycles_.begin(); it != target_lifecycles_.end();)
+    {
+        if(it->second.state != TargetState::ENDED)
+        {
+            ++it;
+            continue;
+        }
+        uint8_t uav_id = it->first;
+        auto it_target_tracker = cooperative_targets_.find(uav_id);
+        delete it_target_tracker->second;
+        cooperative_targets_.erase(it_target_tracker);
+        it = target_lifecycles_.erase(it);
+        already_tracked_cooperative_operations_[uav_id] = false;
+        last_estimation_time_map_.erase(uav_id);
+        pending_measurement_flags_.erase(uav_id);
+        estimation_due_flags_.erase(uav_id);
+        bool operation_ended;
+        {
+            // Rate limiting of the reports and flight status, written by the ingestion threads
+            boost::mutex::scoped_lock lock(position_reports_mutex_);
+            uav_id_last_time_position_update_map_.erase(uav_id);
+            auto it_icao = uav_id_icao_address_map_.find(uav_id);
+            if(it_icao != uav_id_icao_address_map_.end())
+                icao_last_time_position_update_map_.erase(it_icao->second);
+            operation_ended = uav_id_flight_status_map_[uav_id] == FlightStatus::ENDED;
+        }
+
+        if(operation_ended)
+        {
+            // The operation is finished and will not be tracked again
+            cooperative_operations_.erase(uav_id);
+            cooperative_operations_flight_plan_segment_wp_indices_.erase(uav_id);
+            already_tracked_cooperative_operations_.erase(uav_id);
+            modified_cooperative_operations_flags_.erase(uav_id);
+            updated_flight_plan_flag_map_.erase(uav_id);
+            segment_locators_.erase(uav_id);
+            estimated_flight_plan_indices_.erase(uav_id);
+            updated_flight_plans_mutex_.lock();
+            uav_id_update_flight_plan_map_.erase(uav_id);
+            updated_flight_plans_mutex_.unlock();
+        }
+        retired_targets_count_++;
+        ROS_INFO("[Tracking] Target of UAV [%d] reclaimed. Live targets: %d, retired targets: %d",
+                 (int)uav_id, getNumTargets(), getNumRetiredTargets());
+    }
+}
+
 int Tracking::getNumTargets()
 {
     return cooperative_targets_.size();
 }
 
+int Tracking::getNumRetiredTargets()
+{
+    return retired_targets_count_;
+}
+
 bool Tracking::getTargetInfo(int target_id, double &x, double &y, double &z)
 {
 	bool found = false;
@@ -314,8 +492,9 @@ bool Tracking::updateFlightPlansCB(gauss_msgs::WritePlans::Request &req, gauss_m
 bool Tracking::changeFlightStatusCB(gauss_msgs::ChangeFlightStatus::Request &req, gauss_msgs::ChangeFlightStatus::Response &res)
 {
     bool result = true;
-    uint8_t uav_id = icao_address_uav_id_map_[std::to_string(req.icao)];
+    uint8_t uav_id = icao_address_uav_id_map_[req.icao];
 
+    boost::mutex::scoped_lock lock(position_reports_mutex_);
     switch (uav_id_flight_status_map_[uav_id])
     {
     case FlightStatus::NOT_STARTED:
@@ -344,103 +523,123 @@ bool Tracking::changeFlightStatusCB(gauss_msgs::ChangeFlightStatus::Request &req
     return result;
 }
 
-// PositionReport callback
+// PositionReport callbacks
 void Tracking::positionReportCB(const gauss_msgs::PositionReport::ConstPtr &msg)
 {
-    gauss_msgs::ReadOperation read_operation_msg;
+    boost::mutex::scoped_lock lock(position_reports_mutex_);
+    ingestPositionReport(*msg);
+}
+
+void Tracking::positionReportArrayCB(const gauss_msgs::PositionReportArray::ConstPtr &msg)
+{
+    boost::mutex::scoped_lock lock(position_reports_mutex_);
+    for (auto &report : msg->reports)
+        ingestPositionReport(report);
+}
 
+// Produce a candidate from a position report, if the rate of its uav allows it. Called with position_reports_mutex_ held
+void Tracking::ingestPositionReport(const gauss_msgs::PositionReport &report)
+{
     /*
-    if (msg->source == msg->SOURCE_RPA)
-        ROS_INFO_STREAM("Received position report from uav_id: " << (int)msg->uav_id);
+    if (report.source == report.SOURCE_RPA)
+        ROS_INFO_STREAM("Received position report from uav_id: " << (int)report.uav_id);
     else
         ROS_INFO_STREAM("Received ADSB message");
     */
     
-    if (msg->header.stamp != ros::Time(0))
+    if (report.header.stamp != ros::Time(0))
     {
-        if(uav_id_flight_status_map_[msg->uav_id] != FlightStatus::NOT_STARTED)
+        // Publishers older than the icao field only fill icao_address
+        uint32_t icao = report.icao;
+        if (icao == 0 && !report.icao_address.empty())
+            parseIcaoAddress(report.icao_address, icao);
+        if(uav_id_flight_status_map_[report.uav_id] != FlightStatus::NOT_STARTED)
         {
             bool create_candidate = false;
-            if (use_position_report_ && msg->source == msg->SOURCE_RPA)
+            if (use_position_report_ && report.source == report.SOURCE_RPA)
             {
                 // Reduce the rate at which the candidates are produced
-                if (uav_id_last_time_position_update_map_.find(msg->uav_id) == uav_id_last_time_position_update_map_.end())
+                if (uav_id_last_time_position_update_map_.find(report.uav_id) == uav_id_last_time_position_update_map_.end())
                 {
-                    uav_id_last_time_position_update_map_.insert(std::make_pair(msg->uav_id, msg->header.stamp));
+                    uav_id_last_time_position_update_map_.insert(std::make_pair(report.uav_id, report.header.stamp));
                     create_candidate = true;
                 }
                 else
                 {
-                    ros::Duration time_delta = msg->header.stamp - uav_id_last_time_position_update_map_[msg->uav_id];
+                    ros::Duration time_delta = report.header.stamp - uav_id_last_time_position_update_map_[report.uav_id];
                     if (time_delta.toSec() > 0.2)
                     {
                         create_candidate = true;
-                        uav_id_last_time_position_update_map_[msg->uav_id] = msg->header.stamp;
+                        uav_id_last_time_position_update_map_[report.uav_id] = report.header.stamp;
                     }
                 }
                 if (create_candidate)
                 {
-                    Candidate *candidate_aux_ptr = new Candidate;
-                    candidate_aux_ptr->uav_id = msg->uav_id;
-                    candidate_aux_ptr->icao_address = msg->icao_address;
-                    candidate_aux_ptr->location(0) = msg->position.x;
-                    candidate_aux_ptr->location(1) = msg->position.y;
-                    candidate_aux_ptr->location(2) = msg->position.z;
+                    // Candidates are taken from the pool, if it is full the report is dropped instead of waiting for the estimator
+                    Candidate *candidate_aux_ptr = candidates_.acquire();
+                    if (candidate_aux_ptr == nullptr)
+                        return;
+                    candidate_aux_ptr->uav_id = report.uav_id;
+                    candidate_aux_ptr->icao = icao;
+                    candidate_aux_ptr->location(0) = report.position.x;
+                    candidate_aux_ptr->location(1) = report.position.y;
+                    candidate_aux_ptr->location(2) = report.position.z;
                     // TODO: Fill covariances properly
-                    candidate_aux_ptr->location_covariance(0,0) = 0.5;//msg->confidence;
-	                candidate_aux_ptr->location_covariance(0,1) = 0.0;//msg->confidence;
-	                candidate_aux_ptr->location_covariance(0,2) = 0.0;//msg->confidence;       	        
-                    candidate_aux_ptr->location_covariance(1,0) = 0.0;//msg->confidence;
-	                candidate_aux_ptr->location_covariance(1,1) = 0.5;//msg->confidence;
-	                candidate_aux_ptr->location_covariance(1,2) = 0.0;//msg->confidence;      	        
-                    candidate_aux_ptr->location_covariance(2,0) = 0.0;//msg->confidence;
-	                candidate_aux_ptr->location_covariance(2,1) = 0.0;//msg->confidence;
-	                candidate_aux_ptr->location_covariance(2,2) = 0.5;//msg->confidence;
-	                candidate_aux_ptr->speed_covariance(0,0) = VAR_SPEED;//msg->confidence;
+                    candidate_aux_ptr->location_covariance(0,0) = 0.5;//report.confidence;
+	                candidate_aux_ptr->location_covariance(0,1) = 0.0;//report.confidence;
+	                candidate_aux_ptr->location_covariance(0,2) = 0.0;//report.confidence;       	        
+                    candidate_aux_ptr->location_covariance(1,0) = 0.0;//report.confidence;
+	                candidate_aux_ptr->location_covariance(1,1) = 0.5;//report.confidence;
+	                candidate_aux_ptr->location_covariance(1,2) = 0.0;//report.confidence;      	        
+                    candidate_aux_ptr->location_covariance(2,0) = 0.0;//report.confidence;
+	                candidate_aux_ptr->location_covariance(2,1) = 0.0;//report.confidence;
+	                candidate_aux_ptr->location_covariance(2,2) = 0.5;//report.confidence;
+	                candidate_aux_ptr->speed_covariance(0,0) = VAR_SPEED;//report.confidence;
                     candidate_aux_ptr->speed_covariance(0,1) = COV_SPEED_XY;
                     candidate_aux_ptr->speed_covariance(0,2) = COV_SPEED_XY;
                     candidate_aux_ptr->speed_covariance(1,0) = COV_SPEED_XY;
-	                candidate_aux_ptr->speed_covariance(1,1) = VAR_SPEED;//msg->confidence;
+	                candidate_aux_ptr->speed_covariance(1,1) = VAR_SPEED;//report.confidence;
                     candidate_aux_ptr->speed_covariance(1,2) = COV_SPEED_XY;
                     candidate_aux_ptr->speed_covariance(2,0) = COV_SPEED_XY;
                     candidate_aux_ptr->speed_covariance(2,1) = COV_SPEED_XY;
-	                candidate_aux_ptr->speed_covariance(2,2) = VAR_SPEED;//msg->confidence;
+	                candidate_aux_ptr->speed_covariance(2,2) = VAR_SPEED;//report.confidence;
                     candidate_aux_ptr->source = Candidate::POSITIONREPORT;
                     candidate_aux_ptr->speed_available = use_speed_info_; // TODO:
                     // TODO: Fill those speed values with real info from uav
-                    candidate_aux_ptr->speed(0) = msg->speed * cos(M_PI_2-(msg->heading)*M_PI/180);
-                    candidate_aux_ptr->speed(1) = msg->speed * sin(M_PI_2-(msg->heading)*M_PI/180);
+                    candidate_aux_ptr->speed(0) = report.speed * cos(M_PI_2-(report.heading)*M_PI/180);
+                    candidate_aux_ptr->speed(1) = report.speed * sin(M_PI_2-(report.heading)*M_PI/180);
                     candidate_aux_ptr->speed(2) = 0.0;
-                    candidate_aux_ptr->timestamp = msg->header.stamp;
+                    candidate_aux_ptr->timestamp = report.header.stamp;
 
                     candidate_aux_ptr->source = candidate_aux_ptr->POSITIONREPORT;
-                    candidates_list_mutex_.lock(); // Necessary because callbacks are going to be executed in separate threads concurrently
-                    candidates_.push_back(candidate_aux_ptr);
-                    candidates_list_mutex_.unlock();
+                    candidates_.commit(candidate_aux_ptr); // Published to the estimator loop, which reads the buffer without taking position_reports_mutex_
                 }
             }
-            if (use_adsb_ && msg->source == msg->SOURCE_ADSB)
+            if (use_adsb_ && report.source == report.SOURCE_ADSB)
             {
                 // Reduce the rate at which the candidates are produced
-                if (icao_last_time_position_update_map_.find(msg->icao_address) == icao_last_time_position_update_map_.end())
+                if (icao_last_time_position_update_map_.find(icao) == icao_last_time_position_update_map_.end())
                 {
-                    icao_last_time_position_update_map_.insert(std::make_pair(msg->icao_address, msg->header.stamp));
+                    icao_last_time_position_update_map_.insert(std::make_pair(icao, report.header.stamp));
                     create_candidate = true;
                 }
                 else
                 {
-                    ros::Duration time_delta = msg->header.stamp - icao_last_time_position_update_map_[msg->icao_address];
+                    ros::Duration time_delta = report.header.stamp - icao_last_time_position_update_map_[icao];
                     if (time_delta.toSec() > 0.2)
                     {
                         create_candidate = true;
-                        icao_last_time_position_update_map_[msg->icao_address] = msg->header.stamp;
+                        icao_last_time_position_update_map_[icao] = report.header.stamp;
                     }
                 }
                 if (create_candidate)
                 {
-                    Candidate *candidate_aux_ptr = new Candidate;
+                    // Candidates are taken from the pool, if it is full the report is dropped instead of waiting for the estimator
+                    Candidate *candidate_aux_ptr = candidates_.acquire();
+                    if (candidate_aux_ptr == nullptr)
+                        return;
                     // Try to find the associated uav_id of the received icao_address
-                    auto it = icao_address_uav_id_map_.find(msg->icao_address);
+                    auto it = icao_address_uav_id_map_.find(icao);
                     if (it != icao_address_uav_id_map_.end()) 
                     {
                         candidate_aux_ptr->uav_id = (*it).second; // The uav_id is known
@@ -450,41 +649,39 @@ void Tracking::positionReportCB(const gauss_msgs::PositionReport::ConstPtr &msg)
                         ROS_INFO("Received position report from UNKNOWN ICAO address");
                         candidate_aux_ptr->uav_id = std::numeric_limits<uint8_t>::max(); // The uav_id is not known, could be a non cooperative one
                     }
-                    candidate_aux_ptr->icao_address = msg->icao_address;
-                    candidate_aux_ptr->location(0) = msg->position.x;
-                    candidate_aux_ptr->location(1) = msg->position.y;
-                    candidate_aux_ptr->location(2) = msg->position.z;
+                    candidate_aux_ptr->icao = icao;
+                    candidate_aux_ptr->location(0) = report.position.x;
+                    candidate_aux_ptr->location(1) = report.position.y;
+                    candidate_aux_ptr->location(2) = report.position.z;
                     // TODO: Fill covariances properly
-                    candidate_aux_ptr->location_covariance(0,0) = 0.5;//msg->confidence;
-	                candidate_aux_ptr->location_covariance(0,1) = 0.0;//msg->confidence;
-	                candidate_aux_ptr->location_covariance(0,2) = 0.0;//msg->confidence;       	        
-                    candidate_aux_ptr->location_covariance(1,0) = 0.0;//msg->confidence;
-	                candidate_aux_ptr->location_covariance(1,1) = 0.5;//msg->confidence;
-	                candidate_aux_ptr->location_covariance(1,2) = 0.0;//msg->confidence;      	        
-                    candidate_aux_ptr->location_covariance(2,0) = 0.0;//msg->confidence;
-	                candidate_aux_ptr->location_covariance(2,1) = 0.0;//msg->confidence;
-	                candidate_aux_ptr->location_covariance(2,2) = 0.5;//msg->confidence;
-	                candidate_aux_ptr->speed_covariance(0,0) = VAR_SPEED;//msg->confidence;
+                    candidate_aux_ptr->location_covariance(0,0) = 0.5;//report.confidence;
+	                candidate_aux_ptr->location_covariance(0,1) = 0.0;//report.confidence;
+	                candidate_aux_ptr->location_covariance(0,2) = 0.0;//report.confidence;       	        
+                    candidate_aux_ptr->location_covariance(1,0) = 0.0;//report.confidence;
+	                candidate_aux_ptr->location_covariance(1,1) = 0.5;//report.confidence;
+	                candidate_aux_ptr->location_covariance(1,2) = 0.0;//report.confidence;      	        
+                    candidate_aux_ptr->location_covariance(2,0) = 0.0;//report.confidence;
+	                candidate_aux_ptr->location_covariance(2,1) = 0.0;//report.confidence;
+	                candidate_aux_ptr->location_covariance(2,2) = 0.5;//report.confidence;
+	                candidate_aux_ptr->speed_covariance(0,0) = VAR_SPEED;//report.confidence;
                     candidate_aux_ptr->speed_covariance(0,1) = COV_SPEED_XY;
                     candidate_aux_ptr->speed_covariance(0,2) = COV_SPEED_XY;
                     candidate_aux_ptr->speed_covariance(1,0) = COV_SPEED_XY;
-	                candidate_aux_ptr->speed_covariance(1,1) = VAR_SPEED;//msg->confidence;
+	                candidate_aux_ptr->speed_covariance(1,1) = VAR_SPEED;//report.confidence;
                     candidate_aux_ptr->speed_covariance(1,2) = COV_SPEED_XY;
                     candidate_aux_ptr->speed_covariance(2,0) = COV_SPEED_XY;
                     candidate_aux_ptr->speed_covariance(2,1) = COV_SPEED_XY;
-	                candidate_aux_ptr->speed_covariance(2,2) = VAR_SPEED;//msg->confidence;
+	                candidate_aux_ptr->speed_covariance(2,2) = VAR_SPEED;//report.confidence;
                     candidate_aux_ptr->source = Candidate::POSITIONREPORT;
                     candidate_aux_ptr->speed_available = use_speed_info_; // TODO:
                     // TODO: Fill those speed values with real info from uav
-                    candidate_aux_ptr->speed(0) = msg->speed * cos(M_PI_2-(msg->heading)*M_PI/180);
-                    candidate_aux_ptr->speed(1) = msg->speed * sin(M_PI_2-(msg->heading)*M_PI/180);
+                    candidate_aux_ptr->speed(0) = report.speed * cos(M_PI_2-(report.heading)*M_PI/180);
+                    candidate_aux_ptr->speed(1) = report.speed * sin(M_PI_2-(report.heading)*M_PI/180);
                     candidate_aux_ptr->speed(2) = 0.0;
-                    candidate_aux_ptr->timestamp = msg->header.stamp;
+                    candidate_aux_ptr->timestamp = report.header.stamp;
 
                     candidate_aux_ptr->source = candidate_aux_ptr->ADSB;
-                    candidates_list_mutex_.lock(); // Necessary because callbacks are going to be executed in separate threads concurrently
-                    candidates_.push_back(candidate_aux_ptr);
-                    candidates_list_mutex_.unlock();
+                    candidates_.commit(candidate_aux_ptr); // Published to the estimator loop, which reads the buffer without taking position_reports_mutex_
                 }
             }
         }
@@ -495,11 +692,11 @@ void Tracking::positionReportCB(const gauss_msgs::PositionReport::ConstPtr &msg)
     }
 }
 
-bool Tracking::checkTargetAlreadyExist(std::string icao_address)
+bool Tracking::checkTargetAlreadyExist(uint32_t icao)
 {
     bool found = false;
 
-    auto it = icao_address_uav_id_map_.find(icao_address);
+    auto it = icao_address_uav_id_map_.find(icao);
     if(it != icao_address_uav_id_map_.end())
         found = true;
     
@@ -686,7 +883,7 @@ void Tracking::fillTrackingWaypointList()
     // First we fill tracking waypoint list of cooperative UAVs
     for(auto it=cooperative_targets_.begin(); it!=cooperative_targets_.end(); ++it)
     {
-        if(uav_id_flight_status_map_[it->first] != FlightStatus::NOT_STARTED)
+        if(uav_id_flight_status_map_[it->first] != FlightStatus::NOT_STARTED && estimation_due_flags_[it->first])
         {
             gauss_msgs::Waypoint waypoint_aux;
             waypoint_aux.stamp = it->second->currentPositionTimestamp();
@@ -733,7 +930,7 @@ void Tracking::estimateTrajectory()
         bool started_flight = false;
         if(uav_id_flight_status_map_[uav_id] != FlightStatus::NOT_STARTED)
             started_flight = true;
-        bool estimate_flag = already_tracked_cooperative_operations_[uav_id] && started_flight;
+        bool estimate_flag = already_tracked_cooperative_operations_[uav_id] && started_flight && estimation_due_flags_[uav_id];
         if ( estimate_flag )
         {
             #ifdef DEBUG
@@ -746,10 +943,6 @@ void Tracking::estimateTrajectory()
             gauss_msgs::WaypointList &flight_plan_updated = operation_aux.flight_plan_updated;
             gauss_msgs::WaypointList &estimated_trajectory = operation_aux.estimated_trajectory;
             int flight_plan_waypoint_count = flight_plan_ref.waypoints.size();
-            // TODO: An efficiency improvement will be to not clear completely the estimated trajectory, but remove
-            // some elements and add others. That will require additional state control mechanism.
-            estimated_trajectory.waypoints.clear();
-            flight_plan_updated.waypoints.clear();
 
             current_position.stamp = cooperative_targets_[uav_id]->currentPositionTimestamp();
             cooperative_targets_[uav_id]->getPose(current_position.x, current_position.y, current_position.z);
@@ -761,7 +954,7 @@ void Tracking::estimateTrajectory()
             double distance_to_point_a = 0;
             double distance_to_point_b = 0;
             // For estimating the trajectory we must take into account that waypoints could be time-separated by a non fixed time interval
-            findSegmentWaypointsIndices(current_position, flight_plan_ref, a_waypoint_index, b_waypoint_index, distance_to_segment, distance_to_point_a, distance_to_point_b);
+            findSegmentWaypointsIndices(uav_id, current_position, flight_plan_ref, operation_aux.operational_volume + distance_wp_threshold_margin_, a_waypoint_index, b_waypoint_index, distance_to_segment, distance_to_point_a, distance_to_point_b);
 
             flight_plan_current_wp_index = b_waypoint_index;
             // Trajectory estimation for cooperative uav
@@ -834,47 +1027,96 @@ void Tracking::estimateTrajectory()
                 time_to_next_waypoint = distance_from_current_pos_to_next_wp/distance_between_waypoints * time_between_waypoints;
                 // If the simulator is using a cruising speed, modify the way tracking estimates the trajectory
                 double mod_v;
-                if (!cruising_speed_map_.empty() && cruising_speed_map_[it->second.icao_address] != 0.0) mod_v = cruising_speed_map_[it->second.icao_address];
+                if (!cruising_speed_map_.empty() && cruising_speed_map_[uav_id_icao_address_map_[uav_id]] != 0.0) mod_v = cruising_speed_map_[uav_id_icao_address_map_[uav_id]];
                 double t_next_wp = distance_from_current_pos_to_next_wp / mod_v;
-                if (!cruising_speed_map_.empty() && cruising_speed_map_[it->second.icao_address] != 0.0) time_to_next_waypoint = t_next_wp;
+                if (!cruising_speed_map_.empty() && cruising_speed_map_[uav_id_icao_address_map_[uav_id]] != 0.0) time_to_next_waypoint = t_next_wp;
 
                 #ifdef DEBUG
                 std::cout << "Time to next waypoint " << time_to_next_waypoint << "\n";
                 #endif
 
-                int flight_plan_wp_index = flight_plan_current_wp_index;
-                flight_plan_updated.waypoints.clear();
-                flight_plan_updated.waypoints.push_back(current_position);
                 last_stamp = current_position.stamp;
                 last_stamp.fromSec(last_stamp.toSec() + time_to_next_waypoint);
-                wp_aux = flight_plan_ref.waypoints[flight_plan_wp_index++];
-                wp_aux.stamp = last_stamp;
-                flight_plan_updated.waypoints.push_back(wp_aux);
 
-                while(flight_plan_wp_index < flight_plan_ref.waypoints.size())
+                // The estimation is the current position followed by the rest of the flight plan, shifted in time. While
+                // the flight plan is the same, the previous estimation is kept: the waypoints already passed are retired.
+                // The rest are only shifted, keeping the time between them, if the uav is further than
+                // trajectory_deviation_threshold_ from where the estimation expected it to be
+                auto estimated_index = estimated_flight_plan_indices_.find(uav_id);
+                int remaining_wp_count = flight_plan_waypoint_count - flight_plan_current_wp_index;
+                bool incremental_estimation = estimated_index != estimated_flight_plan_indices_.end() && estimated_index->second <= flight_plan_current_wp_index &&
+                                              (int)estimated_trajectory.waypoints.size() == flight_plan_waypoint_count - estimated_index->second + 1 &&
+                                              flight_plan_updated.waypoints.size() == estimated_trajectory.waypoints.size();
+                bool estimation_modified = !incremental_estimation;
+                if (incremental_estimation)
+                {
+                    int retired_wp_count = flight_plan_current_wp_index - estimated_index->second;
+                    // Position where the previous estimation expected the uav to be at current time
+                    const gauss_msgs::Waypoint &previous_wp = estimated_trajectory.waypoints[retired_wp_count];
+                    const gauss_msgs::Waypoint &next_wp = estimated_trajectory.waypoints[retired_wp_count + 1];
+                    double time_between_wps = (next_wp.stamp - previous_wp.stamp).toSec();
+                    double alpha = time_between_wps > 0 ? (current_position.stamp - previous_wp.stamp).toSec()/time_between_wps : 1.0;
+                    alpha = std::min(std::max(alpha, 0.0), 1.0);
+                    gauss_msgs::Waypoint expected_position;
+                    expected_position.x = previous_wp.x + alpha*(next_wp.x - previous_wp.x);
+                    expected_position.y = previous_wp.y + alpha*(next_wp.y - previous_wp.y);
+                    expected_position.z = previous_wp.z + alpha*(next_wp.z - previous_wp.z);
+                    bool shift_estimation = distanceBetweenWaypoints(current_position, expected_position) > trajectory_deviation_threshold_;
+                    ros::Duration time_shift = last_stamp - next_wp.stamp;
+                    if (retired_wp_count > 0 || shift_estimation)
+                    {
+                        for (gauss_msgs::WaypointList *waypoint_list : {&flight_plan_updated, &estimated_trajectory})
+                        {
+                            std::vector<gauss_msgs::Waypoint> &waypoints = waypoint_list->waypoints;
+                            waypoints.erase(waypoints.begin() + 1, waypoints.begin() + 1 + retired_wp_count);
+                            waypoints.front() = current_position;
+                            if (shift_estimation)
+                            {
+                                for (size_t i = 1; i < waypoints.size(); i++)
+                                    waypoints[i].stamp += time_shift;
+                            }
+                        }
+                        estimated_index->second = flight_plan_current_wp_index;
+                        estimation_modified = true;
+                    }
+                }
+
+                int flight_plan_wp_index = flight_plan_current_wp_index;
+                if (!incremental_estimation)
                 {
-                    wp_aux = flight_plan_ref.waypoints[flight_plan_wp_index];
-                    ros::Duration delta_time = flight_plan_ref.waypoints[flight_plan_wp_index].stamp - flight_plan_ref.waypoints[flight_plan_wp_index-1].stamp;
-                    // If the simulator is using a cruising speed, modify the way tracking estimates the trajectory
-                    double d_segment = sqrt(pow(flight_plan_ref.waypoints[flight_plan_wp_index].x - flight_plan_ref.waypoints[flight_plan_wp_index-1].x, 2) +
-                                       pow(flight_plan_ref.waypoints[flight_plan_wp_index].y - flight_plan_ref.waypoints[flight_plan_wp_index-1].y, 2) +
-                                       pow(flight_plan_ref.waypoints[flight_plan_wp_index].z - flight_plan_ref.waypoints[flight_plan_wp_index-1].z, 2));
-                    double t_segment = d_segment / mod_v;
-                    if (!cruising_speed_map_.empty() && cruising_speed_map_[it->second.icao_address] != 0.0) delta_time.fromSec(t_segment); 
-                    last_stamp += delta_time;
+                    flight_plan_updated.waypoints.clear();
+                    flight_plan_updated.waypoints.reserve(remaining_wp_count + 1);
+                    flight_plan_updated.waypoints.push_back(current_position);
+                    wp_aux = flight_plan_ref.waypoints[flight_plan_wp_index++];
                     wp_aux.stamp = last_stamp;
                     flight_plan_updated.waypoints.push_back(wp_aux);
-                    flight_plan_wp_index++;
-                }
 
-                estimated_trajectory.waypoints.clear();
-                estimated_trajectory = flight_plan_updated;
+                    while(flight_plan_wp_index < flight_plan_ref.waypoints.size())
+                    {
+                        wp_aux = flight_plan_ref.waypoints[flight_plan_wp_index];
+                        ros::Duration delta_time = flight_plan_ref.waypoints[flight_plan_wp_index].stamp - flight_plan_ref.waypoints[flight_plan_wp_index-1].stamp;
+                        // If the simulator is using a cruising speed, modify the way tracking estimates the trajectory
+                        double d_segment = sqrt(pow(flight_plan_ref.waypoints[flight_plan_wp_index].x - flight_plan_ref.waypoints[flight_plan_wp_index-1].x, 2) +
+                                           pow(flight_plan_ref.waypoints[flight_plan_wp_index].y - flight_plan_ref.waypoints[flight_plan_wp_index-1].y, 2) +
+                                           pow(flight_plan_ref.waypoints[flight_plan_wp_index].z - flight_plan_ref.waypoints[flight_plan_wp_index-1].z, 2));
+                        double t_segment = d_segment / mod_v;
+                        if (!cruising_speed_map_.empty() && cruising_speed_map_[uav_id_icao_address_map_[uav_id]] != 0.0) delta_time.fromSec(t_segment); 
+                        last_stamp += delta_time;
+                        wp_aux.stamp = last_stamp;
+                        flight_plan_updated.waypoints.push_back(wp_aux);
+                        flight_plan_wp_index++;
+                    }
+
+                    estimated_trajectory = flight_plan_updated;
+                    estimated_flight_plan_indices_[uav_id] = flight_plan_current_wp_index;
+                }
 
                 #ifdef DEBUG
                 std::cout << "Estimated trajectory size " << estimated_trajectory.waypoints.size() << std::endl;
                 #endif
 
-                modified_cooperative_operations_flags_[uav_id] = true;
+                if (estimation_modified)
+                    modified_cooperative_operations_flags_[uav_id] = true;
             }
             else
             {
@@ -883,6 +1125,9 @@ void Tracking::estimateTrajectory()
                 #endif
                 // If distance from current estimated position is too far from the flight plan, the estimated trajectory
                 // will be composed of waypoints predicted based on the current estimated speed and position of the uav
+                estimated_flight_plan_indices_.erase(uav_id);
+                estimated_trajectory.waypoints.clear();
+                flight_plan_updated.waypoints.clear();
                 cooperative_targets_[uav_id]->predictNTimes(number_estimated_wps, dT_, estimated_trajectory);
                 // Signal that the operation has been modified to write it on the database
                 modified_cooperative_operations_flags_[uav_id] = true;
@@ -892,134 +1137,15 @@ void Tracking::estimateTrajectory()
     }
 }
 
-void Tracking::findSegmentWaypointsIndices(gauss_msgs::Waypoint &current_position, gauss_msgs::WaypointList &flight_plan, int &a_index, int &b_index, double &distance_to_segment, double &distance_to_point_a, double &distance_to_point_b)
+void Tracking::findSegmentWaypointsIndices(uint8_t uav_id, gauss_msgs::Waypoint &current_position, gauss_msgs::WaypointList &flight_plan, double max_local_distance,
+                                           int &a_index, int &b_index, double &distance_to_segment, double &distance_to_point_a, double &distance_to_point_b)
 {
-    int first_index = 0;
-    int second_index = 0;
-    distance_to_segment = std::numeric_limits<double>::max();
-    double distance_to_waypoint_a = std::numeric_limits<double>::max();
-    bool flag_distance_to_waypoint_a = false;
-    bool flag_distance_to_waypoint_b = false;
-
-    /*
-    std::cout << "###################\n";
-    std::cout << "Finding current wp\n";
-    std::cout << "Current position\n";
-    std::cout << current_position << "\n";
-    */
-    for (int i=0; i < flight_plan.waypoints.size()-1; i++)
-    {
-        gauss_msgs::Waypoint &waypoint_a = flight_plan.waypoints[i];
-        gauss_msgs::Waypoint &waypoint_b = flight_plan.waypoints[i+1];
-        /*
-        std::cout << "--------\n";
-        std::cout << "Segment " << i << "\n";
-        std::cout << "waypoint " << i << "\n";
-        std::cout << waypoint_a << "\n";
-        std::cout << "waypoint " << i+1 << "\n";
-        std::cout << waypoint_b << "\n";
-        */
-        Eigen::Vector3d vector_u;
-        flag_distance_to_waypoint_a = false;
-        flag_distance_to_waypoint_b = false;
-        vector_u.x() = waypoint_b.x - waypoint_a.x;
-        vector_u.y() = waypoint_b.y - waypoint_a.y;
-        vector_u.z() = waypoint_b.z - waypoint_a.z;
-        /*
-        std::cout << "Waypoint " << i <<"\n";
-        std::cout << waypoint_a << "\n";
-        */
-        /*
-
-            Solve this equation
-
-            |alpha_1|     | 1    0    0    u_1|^-1   | a_1 - x_0|
-            |alpha_2|     | 0    1    0    u_2|      | a_2 - y_0|
-            |alpha_3|  =  | 0    0    1    u_3|   *  | a_3 - z_0|
-            |    t  |     | u_1  u_2  u_3  0  |      |     0    |
-
-            b = A^-1*x
-
-        */
-
-        Eigen::Matrix4d A;
-        Eigen::Vector4d b;
-        Eigen::Vector4d x;
-
-        A = Eigen::Matrix4d::Identity();
-        A(3,3) = 0;
-        A(0,3) = vector_u.x();
-        A(1,3) = vector_u.y();
-        A(2,3) = vector_u.z();
-        A(3,0) = vector_u.x();
-        A(3,1) = vector_u.y();
-        A(3,2) = vector_u.z();
-
-        x.x() = current_position.x - waypoint_a.x;
-        x.y() = current_position.y - waypoint_a.y;
-        x.z() = current_position.z - waypoint_a.z;
-
-        b = A.inverse()*x;
-
-        double distance;
-        if (b[3] >= 0 && b[3] <= 1)
-        {
-            distance = sqrt(b[0]*b[0] + b[1]*b[1] + b[2]*b[2]);
-            //std::cout << "Distance to segment " << distance << "\n";
-        }
-        else
-        {
-            double distance_to_waypoint_a = distanceBetweenWaypoints(current_position, waypoint_a);
-            double distance_to_waypoint_b = distanceBetweenWaypoints(current_position, waypoint_b);
-
-            if (distance_to_waypoint_a < distance_to_waypoint_b)
-            {
-                distance = distance_to_waypoint_a;
-                flag_distance_to_waypoint_a = true;
-                //std::cout << "Distance to waypoint_a " << distance << "\n";
-            }
-            else
-            {
-                distance = distance_to_waypoint_b;
-                flag_distance_to_waypoint_b = true;
-                //std::cout << "Distance to waypoint_b " << distance << "\n";
-            }
-        }
-        
-        // Then check the distance to the line that contains the segment
-        // double distance = distanceFromPointToLine(current_position_eigen, point_a, vector_2);
-        if (distance <= distance_to_segment)
-        {
-            distance_to_segment = distance;
-            if(flag_distance_to_waypoint_a)
-            {
-                first_index = i;
-                second_index = i;
-            }
-            else if(flag_distance_to_waypoint_b)
-            {
-                first_index = i+1;
-                second_index = i+1;                
-            }
-            else
-            {
-                first_index = i;
-                second_index = i+1;
-            }
-        }
-    }
-
-    a_index = first_index;
-    b_index = second_index;
-    /*
-    std::cout << "Current waypoint index: " << b_index << "\n";
-    */
-
-    gauss_msgs::Waypoint &waypoint_a = flight_plan.waypoints[first_index];
-    gauss_msgs::Waypoint &waypoint_b = flight_plan.waypoints[second_index];
-
-    distance_to_point_a = distanceBetweenWaypoints(waypoint_a, current_position);
-    distance_to_point_b = distanceBetweenWaypoints(waypoint_b, current_position);
+    // The search starts at the segment found in the previous call, the whole flight plan is only searched
+    // if the current position is farther than max_local_distance from the segments around it
+    SegmentLocator &segment_locator = segment_locators_[uav_id];
+    if (!segment_locator.isBuiltFor(flight_plan))
+        segment_locator.reset(flight_plan);
+    segment_locator.find(current_position, max_local_distance, a_index, b_index, distance_to_segment, distance_to_point_a, distance_to_point_b);
 }
 
 inline double dotProduct(Eigen::Vector3d vector_1, Eigen::Vector3d vector_2)
@@ -1047,14 +1173,21 @@ inline double distanceBetweenWaypoints(gauss_msgs::Waypoint &waypoint_a, gauss_m
 
 void Tracking::main()
 {
-    double estimator_rate;
+    double scheduler_rate;
     ros::NodeHandle pnh("~");
-    nh_.param("estimator_rate", estimator_rate, 1.0); // Each second the estimator gets updated
+    // Rate at which targets are checked for estimation. It replaces estimator_rate, still read if it is the only one set
+    if (!nh_.getParam("scheduler_rate", scheduler_rate))
+    {
+        if (nh_.getParam("estimator_rate", scheduler_rate))
+            ROS_WARN("[Tracking] Param estimator_rate is deprecated, use scheduler_rate instead");
+        else
+            scheduler_rate = 10.0;
+    }
 
     ros::AsyncSpinner spinner(4);
     spinner.start();
 
-    ros::Rate rate(estimator_rate);
+    ros::Rate rate(scheduler_rate);
     ros::Rate sleep_rate(1);
 
     // Load YAML
@@ -1076,7 +1209,7 @@ void Tracking::main()
         ROS_INFO("[Tracking] cruising_speed:");
         for (auto cruising_speed_item: cruising_speed_yaml) {
             ROS_INFO_STREAM("[Tracking] - " << cruising_speed_item);
-            auto icao = cruising_speed_item["icao"].as<std::string>();
+            auto icao = cruising_speed_item["icao"].as<uint32_t>();
             auto speed = cruising_speed_item["speed"].as<double>();
             cruising_speed_map_[icao] = speed;
         }
@@ -1086,49 +1219,28 @@ void Tracking::main()
     {
         sleep_rate.sleep();
     }
-    int counter = 0;
+    ros::Time last_write_time(0);
     while(pnh.ok())
     {
         double start_computational_time = ros::Time::now().toSec();
-        candidates_list_mutex_.lock();
-        bool new_operations_to_download = false;
-        for(auto it=candidates_.begin(); it!=candidates_.end(); ++it)
+        CandidateBuffer::Stats candidates_stats = candidates_.getStats();
+        if (candidates_stats.dropped != reported_dropped_candidates_)
         {
-            //std::cout << "Candidates list traversing on MAIN LOOP" << std::endl;
-            if ( (*it)->source == Candidate::POSITIONREPORT )
-            {
-                // The received candidate data comes from a cooperative uav
-                // Check if we have the associated operation in memory for each uav_id from which position reports have been received
-                if ( !this->checkCooperativeOperationAlreadyExist((*it)->uav_id))
-                {
-                    // TODO: Delete candidate from candidates list
-                }
-                else
-                {
-                    //std::cout << "uav_id : " << (int)(*it)->uav_id << " already tracked" << std::endl;
-                }
-            }
-            else if ( (*it)->source == Candidate::ADSB )
-            {
-                // Check if we have the associated operation in memory for each uav_id from which position reports have been received
-                if( (*it)->uav_id == std::numeric_limits<uint8_t>::max() )
-                {
-                    // The position info is from a non cooperative uav
-                }
-            }
+            ROS_WARN_THROTTLE(5.0, "[Tracking] Candidate buffer full, %lu position reports dropped (%lu accepted, high watermark %lu/%lu)",
+                              (unsigned long)candidates_stats.dropped, (unsigned long)candidates_stats.pushed,
+                              (unsigned long)candidates_stats.high_watermark, (unsigned long)candidates_.capacity());
+            reported_dropped_candidates_ = candidates_stats.dropped;
         }
-        candidates_list_mutex_.unlock();
 
         //std::cout << "Operations size start of the loop: " << operations_.size() << std::endl;
 
         ros::Time now(ros::Time::now());
-        this->predict(now); // Predict the position
-        this->update(candidates_);
+        this->update(now); // Predict and update targets with new measurements
+        this->updateTargetLifecycles(now);
 
         //std::cout << "Operations size after update: " << operations_.size() << std::endl;
 
-        this->fillTrackingWaypointList();
-
+        bool flight_plans_updated = false;
         updated_flight_plans_mutex_.lock();
         for(auto it=cooperative_operations_.begin(); it!=cooperative_operations_.end(); it++)
         {
@@ -1136,29 +1248,32 @@ void Tracking::main()
             {
                 cooperative_operations_[(*it).first].flight_plan = uav_id_update_flight_plan_map_[(*it).first];
                 uav_id_update_flight_plan_map_.erase((*it).first);
+                segment_locators_[(*it).first].reset(cooperative_operations_[(*it).first].flight_plan);
+                estimated_flight_plan_indices_.erase((*it).first);
                 updated_flight_plan_flag_map_[(*it).first] = true;
+                flight_plans_updated = true;
             }
         }
         updated_flight_plans_mutex_.unlock();
 
+        this->scheduleEstimations(now);
+        this->predict(now); // Predict the position of due targets without new measurements
+        this->fillTrackingWaypointList();
+
         //std::cout << "Operations size after fillTracking: " << operations_.size() << std::endl;
         this->estimateTrajectory();
         // TODO: Fill the field flight_plan_updated of every operation
         // 
         //this->fillFlightPlanUpdated();
 
-        for(int i = 0; i < candidates_.size(); i++)
-			delete candidates_[i];
-
-        candidates_.clear();
-
-        // counter++;
-        // Write on database each five iterations of the filter to avoid unnecessary overload
-        // if (counter == 5)
-        // {
-        //     counter = 0;
-            this->writeTrackingInfoToDatabase();
-        // }
+        // Tracking info of every estimated target is written in a single batch each db_write_period_ to avoid
+        // unnecessary overload. Updated flight plans are written at once
+        if (flight_plans_updated || (now - last_write_time).toSec() >= db_write_period_)
+        {
+            if (this->writeTrackingInfoToDatabase())
+                this->reclaimEndedTargets();
+            last_write_time = now;
+        }
         // ROS_INFO("[Tracking] Computational time: %0.4f", ros::Time::now().toSec() - start_computational_time);
         rate.sleep();
         //std::cout << "Cycle time: " << rate.cycleTime() << std::endl;
@@ -43,7 +43,7 @@ void TargetTracker::initialize(Candidate* z)
 	if (z->source == z->ADSB)
 	{
 		this->info_source_ = this->ADSB;
-		this->icao_address_ = z->icao_address;
+		this->icao_ = z->icao;
 	}
 	else if (z->source == z->POSITIONREPORT)
 	{
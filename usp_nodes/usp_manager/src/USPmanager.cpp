@@ -289,6 +289,7 @@ void USPManager::RPAStateCB(const gauss_msgs_mqtt::RPAStateInfo::ConstPtr& msg)
     gauss_msgs::PositionReport position_report_msg;
 
     position_report_msg.header.stamp = ros::Time().fromSec(msg->timestamp/1000.0);
+    position_report_msg.icao = msg->icao;
     position_report_msg.icao_address = std::to_string(msg->icao);
     // TODO: Get uav_id from db_manager knowing its icao address
     // Consider the posibility that an RPAStateInfo message could be received from an UAV which hasn't a registered flight plan yet 
@@ -344,6 +345,7 @@ void USPManager::ADSBSurveillanceCB(const gauss_msgs_mqtt::ADSBSurveillance::Con
     gauss_msgs::PositionReport position_report_msg;
 
     position_report_msg.header.stamp = ros::Time().fromSec(msg->timestamp/1000.0);
+    position_report_msg.icao = msg->icao;
     position_report_msg.icao_address = std::to_string(msg->icao);
 
     // TODO: Fill uav_id field
@@ -9,15 +9,18 @@
 #include <gauss_msgs_mqtt/RPAStateInfo.h>
 #include <gauss_msgs_mqtt/UTMAlert.h>
 #include <gauss_msgs_mqtt/AirspaceUpdate.h>
+#include <gauss_msgs_mqtt/AirspaceUpdateArray.h>
 #include <gauss_msgs_mqtt/UTMAlternativeFlightPlan.h>
 #include <gauss_msgs_mqtt/RPSFlightPlanAccept.h>
 #include <gauss_msgs_mqtt/RPSChangeFlightStatus.h>
 #include <gauss_msgs_mqtt/Waypoint.h>
 
 #include <gauss_msgs/PositionReport.h>
+#include <gauss_msgs/PositionReportArray.h>
 #include <gauss_msgs/Notifications.h>
 // #include <gauss_msgs/Alert.h>
 #include <gauss_msgs/AirspaceUpdate.h>
+#include <gauss_msgs/AirspaceUpdateArray.h>
 #include <gauss_msgs/Operation.h>
 #include <gauss_msgs/Waypoint.h>
 #include <gauss_msgs/WaypointList.h>
@@ -32,11 +35,22 @@
 #include <gauss_msgs/PilotAnswer.h>
 #include <gauss_msgs/WritePlans.h>
 #include <gauss_msgs/ChangeFlightStatus.h>
+#include <gauss_msgs/icao_address.h>
+
+#include <usp_manager/health_threat_registry.h>
+#include <usp_manager/local_cartesian_batch.h>
 
 #include <GeographicLib/Geocentric.hpp>
 #include <GeographicLib/LocalCartesian.hpp>
 
+#include <algorithm>
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <mutex>
 #include <sstream>
+#include <thread>
+#include <unordered_map>
 
 #define ARENOSILLO_LATITUDE 37.094784
 #define ARENOSILLO_LONGITUDE -6.735478
@@ -53,6 +67,9 @@
 #define YES std::string("yes")
 #define NO std::string("no")
 
+// Alternative flight plans of a notification burst are encoded in parallel from this number of waypoints
+#define PARALLEL_ENCODING_MIN_WAYPOINTS 256
+
 struct ThreatFlightPlan {
    uint8_t threat_id;
    gauss_msgs::WaypointList new_flight_plan; 
@@ -63,6 +80,7 @@ class USPManager
 {
 public:
     USPManager(double origin_latitude, double origin_longitude, double origin_ellipsoidal_height);
+    ~USPManager();
 
 private:
     // Topic Callbacks
@@ -72,6 +90,7 @@ private:
     bool notificationsCB(gauss_msgs::Notifications::Request &req, gauss_msgs::Notifications::Response &res); // UTM -> RPS
     void RPSChangeFlightStatusCB(const gauss_msgs_mqtt::RPSChangeFlightStatus::ConstPtr& msg); // RPS -> UTM
     void airspaceUpdateCB(const gauss_msgs_mqtt::AirspaceUpdate::ConstPtr& msg); // RPS -> UTM
+    void airspaceUpdatesCB(const gauss_msgs_mqtt::AirspaceUpdateArray::ConstPtr& msg); // RPS -> UTM
 
     // TODO: Think how to implement this
     void RPSFlightPlanAcceptCB(const gauss_msgs_mqtt::RPSFlightPlanAccept::ConstPtr& msg); // RPS -> UTM
@@ -79,12 +98,21 @@ private:
     // Auxiliary methods
     bool checkRPAHealth(const gauss_msgs_mqtt::RPAStateInfo::ConstPtr &rpa_state, gauss_msgs::NewThreat &threat, const gauss_msgs::PositionReport &pos_report);
     gauss_msgs::NewThreats manageThreatList(const bool &_flag_new_threat, gauss_msgs::NewThreat &_in_threat);
+    void queueThreats(const gauss_msgs::NewThreats &_threats);
+    void threatsSender();
+    void publishPositionReport(const gauss_msgs::PositionReport &_position_report);
+    void flushPositionReports();
+    bool convertAirspaceUpdate(const gauss_msgs_mqtt::AirspaceUpdate &_update, gauss_msgs::AirspaceUpdate &_alert) const;
+    void encodeAlternativeFlightPlan(const gauss_msgs::Notification &_notification, gauss_msgs_mqtt::UTMAlternativeFlightPlan &_alternative_flight_plan) const;
+    void storeAlternativeFlightPlan(uint8_t _uav_id, uint8_t _threat_id, gauss_msgs::WaypointList &_flight_plan);
 
     bool initializeICAOIDMap();
     bool initializeIDOperationMap();
 
-    /*
     // Timer Callbacks
+    void positionReportFlushCB(const ros::TimerEvent&);
+    void icaoAddressSweepCB(const ros::TimerEvent&);
+    /*
     void timerCallback(const ros::TimerEvent&);
     */
 
@@ -92,18 +120,36 @@ private:
     ros::NodeHandle nh_;
 
     std::map<uint8_t, uint32_t> id_icao_map_;
-    std::map<uint32_t, uint8_t> icao_id_map_;
+    std::unordered_map<uint32_t, uint8_t> icao_id_map_;
+    IcaoAddressTable icao_addresses_;
 
     std::map<uint8_t, gauss_msgs::Operation> id_operation_map_;
 
     std::vector<int8_t> initial_uav_ids_;
 
-    std::map<uint8_t, std::vector<ThreatFlightPlan>> id_threat_flight_plan_map_;
+    // Alternative flight plans waiting for the pilot answer, oldest first. One per threat, at most max_alternative_plans_
+    std::map<uint8_t, std::deque<ThreatFlightPlan>> id_threat_flight_plan_map_;
+    int max_alternative_plans_;
+    int notification_encoding_workers_;
 
-    std::vector<gauss_msgs::NewThreat> threat_list_;
+    HealthThreatRegistry health_threats_;
+
+    // Threats waiting to be sent to emergency management by threatsSender, so ingestion never waits for it
+    std::deque<gauss_msgs::NewThreat> pending_threats_;
+    std::mutex pending_threats_mutex_;
+    std::condition_variable pending_threats_cv_;
+    size_t max_pending_threats_;
+    bool stop_sender_;
+    std::thread threats_sender_;
+
+    // Position reports waiting to be published together, flushed when full or by the timer
+    gauss_msgs::PositionReportArray position_report_batch_;
+    size_t position_report_batch_size_; // 0 if reports are not batched
 
     // Timer
     //ros::Timer timer_sub_;
+    ros::Timer position_report_flush_timer_;
+    ros::Timer icao_address_sweep_timer_;
 
     // Subscribers
     ros::Subscriber rpaState_sub_;
@@ -111,6 +157,7 @@ private:
     ros::Subscriber flight_plan_accept_sub_;
     ros::Subscriber flight_status_sub_;
     ros::Subscriber airspace_update_sub_;
+    ros::Subscriber airspace_updates_sub_;
 
     // Server 
     ros::ServiceServer notification_server_;
@@ -126,9 +173,11 @@ private:
     // Publisher
     ros::Publisher rpacommands_pub_;       //TBD message to UAVs
     ros::Publisher position_report_pub_;
+    ros::Publisher position_report_array_pub_;
     ros::Publisher alternative_flight_plan_pub_;
     ros::Publisher alert_pub_;
     ros::Publisher airspace_alert_pub_;
+    ros::Publisher airspace_alerts_pub_;
     ros::Publisher flight_status_pub_;
 
 
@@ -136,6 +185,7 @@ private:
     double lat0_, lon0_, ellipsoidal_height_;
     GeographicLib::Geocentric earth_;
     GeographicLib::LocalCartesian proj_;
+    LocalCartesianBatch geodesy_;
 };
 
 // USPManager Constructor
@@ -144,16 +194,54 @@ lat0_(origin_latitude),
 lon0_(origin_longitude),
 ellipsoidal_height_(origin_ellipsoidal_height),
 earth_(GeographicLib::Constants::WGS84_a(), GeographicLib::Constants::WGS84_f()),
-proj_(lat0_, lon0_, ellipsoidal_height_, earth_)
+proj_(lat0_, lon0_, ellipsoidal_height_, earth_),
+geodesy_(proj_)
 {
     // Initialization
+    // Health threats not reported again within this time are resolved, and a new report is a new threat [s]
+    double threat_resolve_timeout;
+    nh_.param("threat_resolve_timeout", threat_resolve_timeout, 2.0);
+    health_threats_.setTimeout(threat_resolve_timeout);
+    // Health threats still reported are sent again after this time, so emergency management retries them [s]
+    double threat_resend_period;
+    nh_.param("threat_resend_period", threat_resend_period, 5.0);
+    health_threats_.setResendPeriod(threat_resend_period);
+    int max_pending_threats;
+    nh_.param("max_pending_threats", max_pending_threats, 100);
+    max_pending_threats_ = std::max(max_pending_threats, 1);
+    // Positions within this distance of the origin use the tangent plane approximation, 0 for exact conversions [m]
+    double fast_geodesy_radius;
+    nh_.param("fast_geodesy_radius", fast_geodesy_radius, 0.0);
+    geodesy_.setFastRadius(fast_geodesy_radius);
+    // Position reports are published in batches on position_report_array, 0 to publish each one on position_report
+    double position_report_batch_period;
+    int position_report_batch_size;
+    nh_.param("position_report_batch_size", position_report_batch_size, 50);
+    nh_.param("position_report_batch_period", position_report_batch_period, 0.1);
+    position_report_batch_size_ = std::max(position_report_batch_size, 0);
+    if (position_report_batch_size_ > 0)
+    {
+        position_report_batch_.reports.reserve(position_report_batch_size_);
+        position_report_flush_timer_ = nh_.createTimer(ros::Duration(position_report_batch_period), &USPManager::positionReportFlushCB, this);
+    }
+    // Strings of the icaos of traffic not reported for this time are dropped, between one and two periods after [s]
+    double icao_address_sweep_period;
+    nh_.param("icao_address_sweep_period", icao_address_sweep_period, 60.0);
+    if (icao_address_sweep_period > 0)
+        icao_address_sweep_timer_ = nh_.createTimer(ros::Duration(icao_address_sweep_period), &USPManager::icaoAddressSweepCB, this);
+    nh_.param("max_alternative_plans", max_alternative_plans_, 5);
+    nh_.param("notification_encoding_workers", notification_encoding_workers_, 4);
+    stop_sender_ = false;
 
     // Publish
     rpacommands_pub_ = nh_.advertise<gauss_msgs::Notification>("/gauss/commands",1);  //TBD message to UAVs
     position_report_pub_ = nh_.advertise<gauss_msgs::PositionReport>("/gauss/position_report", 10);
-    alternative_flight_plan_pub_ = nh_.advertise<gauss_msgs_mqtt::UTMAlternativeFlightPlan>("/gauss/alternative_flight_plan", 10);
+    position_report_array_pub_ = nh_.advertise<gauss_msgs::PositionReportArray>("/gauss/position_report_array", 10);
+    // Large enough for a whole replanning burst
+    alternative_flight_plan_pub_ = nh_.advertise<gauss_msgs_mqtt::UTMAlternativeFlightPlan>("/gauss/alternative_flight_plan", 100);
     alert_pub_ = nh_.advertise<gauss_msgs_mqtt::UTMAlert>("/gauss/alert", 1);
     airspace_alert_pub_ = nh_.advertise<gauss_msgs::AirspaceUpdate>("/gauss/airspace_alert", 1);
+    airspace_alerts_pub_ = nh_.advertise<gauss_msgs::AirspaceUpdateArray>("/gauss/airspace_alerts", 1);
     flight_status_pub_ = nh_.advertise<gauss_msgs_mqtt::RPSChangeFlightStatus>("/gauss/change_flight_status", 10);
 
     rpaState_sub_= nh_.subscribe<gauss_msgs_mqtt::RPAStateInfo>("/gauss/rpa_state_info",10,&USPManager::RPAStateCB,this);
@@ -161,6 +249,7 @@ proj_(lat0_, lon0_, ellipsoidal_height_, earth_)
     flight_plan_accept_sub_ = nh_.subscribe<gauss_msgs_mqtt::RPSFlightPlanAccept>("/gauss/flight_acceptance", 10, &USPManager::RPSFlightPlanAcceptCB, this);
     flight_status_sub_ = nh_.subscribe<gauss_msgs_mqtt::RPSChangeFlightStatus>("/gauss/change_flight_status", 10, &USPManager::RPSChangeFlightStatusCB, this);
     airspace_update_sub_ = nh_.subscribe<gauss_msgs_mqtt::AirspaceUpdate>("/gauss/airspace_update", 10, &USPManager::airspaceUpdateCB, this);
+    airspace_updates_sub_ = nh_.subscribe<gauss_msgs_mqtt::AirspaceUpdateArray>("/gauss/airspace_updates", 1, &USPManager::airspaceUpdatesCB, this);
     // Server 
     notification_server_ = nh_.advertiseService("/gauss/notifications", &USPManager::notificationsCB, this);
 
@@ -172,54 +261,71 @@ proj_(lat0_, lon0_, ellipsoidal_height_, earth_)
     write_plans_client_ = nh_.serviceClient<gauss_msgs::WritePlans>("/gauss/update_flight_plans");
     change_flight_status_client_ = nh_.serviceClient<gauss_msgs::ChangeFlightStatus>("/gauss/change_flight_status");
 
+    threats_sender_ = std::thread(&USPManager::threatsSender, this);
+
     ROS_INFO("[USPM] Started USPManager node!");
     ROS_INFO_STREAM("[USPM] Origin (Latitude, Longitude): (" << lat0_ << "," << lon0_ << ")");
 
     this->initializeICAOIDMap();
 }
 
+USPManager::~USPManager()
+{
+    {
+        std::lock_guard<std::mutex> lock(pending_threats_mutex_);
+        stop_sender_ = true;
+    }
+    pending_threats_cv_.notify_all();
+    if (threats_sender_.joinable()) threats_sender_.join();
+}
+
+// Alternative flight plans are proposed for these threats
+static bool hasAlternativeFlightPlan(const gauss_msgs::Notification &_notification)
+{
+    uint8_t threat_type = _notification.threat.threat_type;
+    return threat_type == gauss_msgs::NewThreat::LOSS_OF_SEPARATION || threat_type == gauss_msgs::NewThreat::GEOFENCE_CONFLICT || threat_type == gauss_msgs::NewThreat::GEOFENCE_INTRUSION;
+}
+
 // Notification callback
 bool USPManager::notificationsCB(gauss_msgs::Notifications::Request &req, gauss_msgs::Notifications::Response &res)
 {
-    for (auto msg : req.notifications){
-        // TODO: Treat all possible notifications properly
-        if(msg.threat.threat_type == gauss_msgs::NewThreat::LOSS_OF_SEPARATION || msg.threat.threat_type == gauss_msgs::NewThreat::GEOFENCE_CONFLICT || msg.threat.threat_type == gauss_msgs::NewThreat::GEOFENCE_INTRUSION)
+    // Alternative flight plans are encoded first, in parallel for large bursts, then everything is sent in order
+    std::vector<size_t> plan_indices;
+    size_t plan_waypoints = 0;
+    for (size_t i = 0; i < req.notifications.size(); i++)
+    {
+        if (hasAlternativeFlightPlan(req.notifications[i]))
         {
-            gauss_msgs_mqtt::UTMAlternativeFlightPlan alternative_flight_plan_msg;
-            std::string uav_id_string = std::to_string(msg.uav_id);
-            int n_zeros = 0;
-            if(uav_id_string.length() == 1)
-                n_zeros = 1;
-            alternative_flight_plan_msg.flight_plan_id = std::string("MISSION") + std::string(n_zeros, '0') + uav_id_string;
-            alternative_flight_plan_msg.icao = id_icao_map_[msg.uav_id];
-
-            for(auto it=msg.new_flight_plan.waypoints.begin(); it!=msg.new_flight_plan.waypoints.end(); it++)
-            {
-                gauss_msgs_mqtt::Waypoint waypoint_mqtt;
-                double lat,lon,h;
-                proj_.Reverse(it->x,it->y,it->z,lat,lon,h);
-                waypoint_mqtt.waypoint_elements[0] = lon;
-                waypoint_mqtt.waypoint_elements[1] = lat;
-                waypoint_mqtt.waypoint_elements[2] = h;
-                waypoint_mqtt.waypoint_elements[3] = it->stamp.toSec();
-                alternative_flight_plan_msg.new_flight_plan.push_back(waypoint_mqtt);
-            }
-
-            alternative_flight_plan_pub_.publish(alternative_flight_plan_msg);
-            ROS_INFO("[USPM] Alternative flight plan proposed.");
+            plan_indices.push_back(i);
+            plan_waypoints += req.notifications[i].new_flight_plan.waypoints.size();
+        }
+    }
+    std::vector<gauss_msgs_mqtt::UTMAlternativeFlightPlan> alternative_flight_plans(plan_indices.size());
+    auto encode = [&](size_t _begin, size_t _end) {
+        for (size_t i = _begin; i < _end; i++) encodeAlternativeFlightPlan(req.notifications[plan_indices[i]], alternative_flight_plans[i]);
+    };
+    size_t workers = std::min((size_t)std::max(notification_encoding_workers_, 1), plan_indices.size());
+    if (workers > 1 && plan_waypoints >= PARALLEL_ENCODING_MIN_WAYPOINTS)
+    {
+        size_t chunk = (plan_indices.size() + workers - 1) / workers;
+        std::vector<std::thread> encoders;
+        for (size_t begin = chunk; begin < plan_indices.size(); begin += chunk)
+            encoders.emplace_back(encode, begin, std::min(begin + chunk, plan_indices.size()));
+        encode(0, chunk);
+        for (auto &encoder : encoders) encoder.join();
+    }
+    else
+    {
+        encode(0, plan_indices.size());
+    }
 
-            ThreatFlightPlan threat_flight_plan;
-            threat_flight_plan.threat_id = msg.threat.threat_id;
-            threat_flight_plan.new_flight_plan = msg.new_flight_plan;
-            if(id_threat_flight_plan_map_.find(msg.uav_id) != id_threat_flight_plan_map_.end())
-            {
-                id_threat_flight_plan_map_[msg.uav_id].push_back(threat_flight_plan);
-            }
-            else
-            {
-                id_threat_flight_plan_map_[msg.uav_id] = std::vector<ThreatFlightPlan>();
-                id_threat_flight_plan_map_[msg.uav_id].push_back(threat_flight_plan);
-            } 
+    size_t plan_index = 0;
+    for (auto &msg : req.notifications){
+        // TODO: Treat all possible notifications properly
+        if(hasAlternativeFlightPlan(msg))
+        {
+            alternative_flight_plan_pub_.publish(alternative_flight_plans[plan_index++]);
+            storeAlternativeFlightPlan(msg.uav_id, msg.threat.threat_id, msg.new_flight_plan);
         }
         else if(msg.threat.threat_type == gauss_msgs::NewThreat::JAMMING_ATTACK)
         {
@@ -240,10 +346,52 @@ bool USPManager::notificationsCB(gauss_msgs::Notifications::Request &req, gauss_
             // change_flight_status_client_.call(change_flight_status_msg);
         }
     }
+    if (!alternative_flight_plans.empty()) ROS_INFO("[USPM] %zu alternative flight plans proposed.", alternative_flight_plans.size());
     res.success = true;
     return res.success;
 }
 
+void USPManager::encodeAlternativeFlightPlan(const gauss_msgs::Notification &_notification, gauss_msgs_mqtt::UTMAlternativeFlightPlan &_alternative_flight_plan) const
+{
+    char flight_plan_id[16];
+    snprintf(flight_plan_id, sizeof(flight_plan_id), "MISSION%02u", (unsigned)(uint8_t)_notification.uav_id);
+    _alternative_flight_plan.flight_plan_id = flight_plan_id;
+    auto it = id_icao_map_.find(_notification.uav_id);
+    _alternative_flight_plan.icao = it != id_icao_map_.end() ? it->second : 0;
+
+    const std::vector<gauss_msgs::Waypoint> &waypoints = _notification.new_flight_plan.waypoints;
+    _alternative_flight_plan.new_flight_plan.resize(waypoints.size());
+    for (size_t i = 0; i < waypoints.size(); i++)
+    {
+        auto &elements = _alternative_flight_plan.new_flight_plan[i].waypoint_elements;
+        geodesy_.reverse(waypoints[i].x, waypoints[i].y, waypoints[i].z, elements[1], elements[0], elements[2]);
+        elements[3] = waypoints[i].stamp.toSec();
+    }
+}
+
+// Pilot answers are matched to the pending threats in the order they were first proposed. A new plan for a threat
+// already pending replaces the stored plan but keeps its place, so the answer taken for that threat applies its newest plan
+void USPManager::storeAlternativeFlightPlan(uint8_t _uav_id, uint8_t _threat_id, gauss_msgs::WaypointList &_flight_plan)
+{
+    std::deque<ThreatFlightPlan> &plans = id_threat_flight_plan_map_[_uav_id];
+    for (auto &plan : plans)
+    {
+        if (plan.threat_id == _threat_id)
+        {
+            plan.new_flight_plan = std::move(_flight_plan);
+            return;
+        }
+    }
+    plans.emplace_back();
+    plans.back().threat_id = _threat_id;
+    plans.back().new_flight_plan = std::move(_flight_plan);
+    while (plans.size() > (size_t)std::max(max_alternative_plans_, 1))
+    {
+        ROS_WARN("[USPM] Discarding alternative flight plan of uav %d for threat %d, not answered", (int)_uav_id, (int)plans.front().threat_id);
+        plans.pop_front();
+    }
+}
+
 void USPManager::RPSFlightPlanAcceptCB(const gauss_msgs_mqtt::RPSFlightPlanAccept::ConstPtr& msg)
 {
     gauss_msgs::WritePlans write_plans_msg;
@@ -251,25 +399,22 @@ void USPManager::RPSFlightPlanAcceptCB(const gauss_msgs_mqtt::RPSFlightPlanAccep
     std::string flight_plan_id_aux = msg->flight_plan_id;
     flight_plan_id_aux.erase((size_t)0,(size_t)7);
     uint8_t flight_plan_id = std::atoi(flight_plan_id_aux.c_str());
+    // The answer is for the oldest pending threat and applies the newest plan proposed for it. Accepted or not, the
+    // threat is no longer pending
+    auto plans = id_threat_flight_plan_map_.find(flight_plan_id);
+    if (plans == id_threat_flight_plan_map_.end() || plans->second.empty())
+        return;
+    threat_flight_plan = std::move(plans->second.front());
+    plans->second.pop_front();
     if(msg->accept)
     {
-        if(id_threat_flight_plan_map_.find(flight_plan_id) != id_threat_flight_plan_map_.end())
-        {
-            if(!id_threat_flight_plan_map_[flight_plan_id].empty())
-            {
-                threat_flight_plan = id_threat_flight_plan_map_[flight_plan_id].front();
-                id_threat_flight_plan_map_[flight_plan_id].erase(id_threat_flight_plan_map_[flight_plan_id].begin());
-                auto it = icao_id_map_.find(msg->icao);
-                if (it != icao_id_map_.end()){
-                    write_plans_msg.request.flight_plans.push_back(threat_flight_plan.new_flight_plan);
-                    write_plans_msg.request.uav_ids.push_back((*it).second);
-                } else {
-                    ROS_WARN("[USPM] Can not find the uav id associated with icao address %06x", msg->icao);
-                }
-            }
+        auto it = icao_id_map_.find(msg->icao);
+        if (it != icao_id_map_.end()){
+            write_plans_msg.request.flight_plans.push_back(threat_flight_plan.new_flight_plan);
+            write_plans_msg.request.uav_ids.push_back((*it).second);
+        } else {
+            ROS_WARN("[USPM] Can not find the uav id associated with icao address %06x", msg->icao);
         }
-        else
-            return;
 
         if (!write_plans_client_.call(write_plans_msg) || !write_plans_msg.response.success)
         {
@@ -289,7 +434,8 @@ void USPManager::RPAStateCB(const gauss_msgs_mqtt::RPAStateInfo::ConstPtr& msg)
     gauss_msgs::PositionReport position_report_msg;
 
     position_report_msg.header.stamp = ros::Time().fromSec(msg->timestamp/1000.0);
-    position_report_msg.icao_address = std::to_string(msg->icao);
+    position_report_msg.icao = msg->icao;
+    position_report_msg.icao_address = icao_addresses_.toString(msg->icao);
     // TODO: Get uav_id from db_manager knowing its icao address
     // Consider the posibility that an RPAStateInfo message could be received from an UAV which hasn't a registered flight plan yet 
     // position_report_msg.uav_id;
@@ -308,7 +454,7 @@ void USPManager::RPAStateCB(const gauss_msgs_mqtt::RPAStateInfo::ConstPtr& msg)
 
         geometry_msgs::Point cartesian_translation;
 
-        proj_.Forward(msg->latitude, msg->longitude, msg->altitude, cartesian_translation.x, cartesian_translation.y, cartesian_translation.z);
+        geodesy_.forward(msg->latitude, msg->longitude, msg->altitude, cartesian_translation.x, cartesian_translation.y, cartesian_translation.z);
 
         //float uav_heading = msg->yaw;
         //tf2::Quaternion aux_quaternion_tf2;
@@ -325,16 +471,16 @@ void USPManager::RPAStateCB(const gauss_msgs_mqtt::RPAStateInfo::ConstPtr& msg)
         // std::cout << "x: " << position_report_msg.position.x << "\n";  
         // std::cout << "y: " << position_report_msg.position.y << "\n";
         // std::cout << "z: " << position_report_msg.position.z << "\n";
-        position_report_pub_.publish(position_report_msg);
+        publishPositionReport(position_report_msg);
 
         gauss_msgs::NewThreat temp_threat;
         bool flag_new_threat = checkRPAHealth(msg, temp_threat, position_report_msg);
         gauss_msgs::NewThreats new_threats_msgs = manageThreatList(flag_new_threat, temp_threat);
-        if (flag_new_threat) threats_client_.call(new_threats_msgs);
+        if (new_threats_msgs.request.threats.size() > 0) queueThreats(new_threats_msgs);
     }
     else
     {
-        ROS_WARN("[USPM] Can not find the uav id associated with icao address %s", position_report_msg.icao_address.c_str());
+        ROS_WARN("[USPM] Can not find the uav id associated with icao address %u", msg->icao);
     }
     
 }
@@ -344,7 +490,8 @@ void USPManager::ADSBSurveillanceCB(const gauss_msgs_mqtt::ADSBSurveillance::Con
     gauss_msgs::PositionReport position_report_msg;
 
     position_report_msg.header.stamp = ros::Time().fromSec(msg->timestamp/1000.0);
-    position_report_msg.icao_address = std::to_string(msg->icao);
+    position_report_msg.icao = msg->icao;
+    position_report_msg.icao_address = icao_addresses_.toString(msg->icao);
 
     // TODO: Fill uav_id field
 
@@ -358,7 +505,7 @@ void USPManager::ADSBSurveillanceCB(const gauss_msgs_mqtt::ADSBSurveillance::Con
 
     geometry_msgs::Point cartesian_translation;
 
-    proj_.Forward(msg->latitude, msg->longitude, msg->altitude, cartesian_translation.x, cartesian_translation.y, cartesian_translation.z);
+    geodesy_.forward(msg->latitude, msg->longitude, msg->altitude, cartesian_translation.x, cartesian_translation.y, cartesian_translation.z);
 
     //float uav_heading = msg->heading;
     //tf2::Quaternion aux_quaternion_tf2;
@@ -371,7 +518,7 @@ void USPManager::ADSBSurveillanceCB(const gauss_msgs_mqtt::ADSBSurveillance::Con
     position_report_msg.heading = msg->heading;
     position_report_msg.speed = msg->speed;
 
-    position_report_pub_.publish(position_report_msg);
+    publishPositionReport(position_report_msg);
 }
 
 void USPManager::RPSChangeFlightStatusCB(const gauss_msgs_mqtt::RPSChangeFlightStatus::ConstPtr& msg)
@@ -382,28 +529,67 @@ void USPManager::RPSChangeFlightStatusCB(const gauss_msgs_mqtt::RPSChangeFlightS
     if(msg->status == "start")
         change_flight_status_msg.request.is_started = true;
     else if(msg->status == "stop")
+    {
         change_flight_status_msg.request.is_started = false;
+        // The flight is over. Registered uavs keep the string read from the database
+        if (icao_id_map_.find(msg->icao) == icao_id_map_.end())
+            icao_addresses_.erase(msg->icao);
+    }
     change_flight_status_client_.call(change_flight_status_msg);
 }
 
 void USPManager::airspaceUpdateCB(const gauss_msgs_mqtt::AirspaceUpdate::ConstPtr& msg) 
 {
     gauss_msgs::AirspaceUpdate alert_msg;
+    if (!convertAirspaceUpdate(*msg, alert_msg))
+    {
+        ROS_WARN("[USPM] Discarding airspace %s with unknown geometry", msg->id.c_str());
+        return;
+    }
+    airspace_alert_pub_.publish(alert_msg);
+}
+
+// A whole airspace set goes to emergency management in a single message, so it is written to the database at once
+void USPManager::airspaceUpdatesCB(const gauss_msgs_mqtt::AirspaceUpdateArray::ConstPtr& msg)
+{
+    gauss_msgs::AirspaceUpdateArray alerts_msg;
+    alerts_msg.updates.resize(msg->updates.size());
+    size_t n_alerts = 0;
+    for (auto &update : msg->updates)
+    {
+        if (convertAirspaceUpdate(update, alerts_msg.updates[n_alerts]))
+            n_alerts++;
+        else
+        {
+            ROS_WARN("[USPM] Discarding airspace %s with unknown geometry", update.id.c_str());
+            alerts_msg.updates[n_alerts] = gauss_msgs::AirspaceUpdate();
+        }
+    }
+    alerts_msg.updates.resize(n_alerts);
+    ROS_INFO("[USPM] Received %zu airspaces", n_alerts);
+    airspace_alerts_pub_.publish(alerts_msg);
+}
+
+// False if the geometry is neither a circle nor a polygon
+bool USPManager::convertAirspaceUpdate(const gauss_msgs_mqtt::AirspaceUpdate &_update, gauss_msgs::AirspaceUpdate &_alert) const
+{
     // Convert
-    alert_msg.id = msg->id;
-    alert_msg.name = msg->name;
-    alert_msg.type = msg->type;
-    alert_msg.country = msg->country;
-    alert_msg.state = msg->state;
-    alert_msg.city = msg->city;
-    alert_msg.last_updated = msg->last_updated;
-    alert_msg.date_effective = msg->date_effective;
+    _alert.id = _update.id;
+    _alert.name = _update.name;
+    _alert.type = _update.type;
+    _alert.country = _update.country;
+    _alert.state = _update.state;
+    _alert.city = _update.city;
+    _alert.last_updated = _update.last_updated;
+    _alert.date_effective = _update.date_effective;
 
     geometry_msgs::Point cartesian_translation;
     double latitude, longitude;
 
     std::string geometry;
-    geometry = msg->geometry;
+    geometry = _update.geometry;
+    if (geometry.empty())
+        return false;
     geometry.pop_back();
     std::stringstream reading_strstream;
 
@@ -413,11 +599,11 @@ void USPManager::airspaceUpdateCB(const gauss_msgs_mqtt::AirspaceUpdate::ConstPt
         reading_strstream << geometry;
         double latitude, longitude, radius;
         sscanf(geometry.c_str(), "%lf,%lf,%lf", &latitude, &longitude, &radius);
-        proj_.Forward(latitude, longitude, ellipsoidal_height_, cartesian_translation.x, cartesian_translation.y, cartesian_translation.z);
-        alert_msg.circle.radius = radius;
-        alert_msg.circle.x_center = cartesian_translation.x;
-        alert_msg.circle.y_center = cartesian_translation.y;
-        alert_msg.cylinder_shape = true;
+        geodesy_.forward(latitude, longitude, ellipsoidal_height_, cartesian_translation.x, cartesian_translation.y, cartesian_translation.z);
+        _alert.circle.radius = radius;
+        _alert.circle.x_center = cartesian_translation.x;
+        _alert.circle.y_center = cartesian_translation.y;
+        _alert.cylinder_shape = true;
     }
     else if(geometry.substr(0, std::string("POLYGON").size()) == "POLYGON")
     {
@@ -441,27 +627,33 @@ void USPManager::airspaceUpdateCB(const gauss_msgs_mqtt::AirspaceUpdate::ConstPt
         }
 
         uint8_t pair_counter = 0;
-        double vertex_latitude, vertex_longitude;
+        std::vector<double> vertex_latitudes, vertex_longitudes;
         for(auto it = comma_separated_strings.begin(); it != comma_separated_strings.end(); it++)
         {
             if(pair_counter == 0)
             {
-                vertex_latitude = atof((*it).c_str());
+                vertex_latitudes.push_back(atof((*it).c_str()));
                 pair_counter++;
             }
             else
             {
-                vertex_longitude = atof((*it).c_str());
+                vertex_longitudes.push_back(atof((*it).c_str()));
                 pair_counter = 0;
-                proj_.Forward(vertex_latitude, vertex_longitude, ellipsoidal_height_, cartesian_translation.x, cartesian_translation.y, cartesian_translation.z);
-                alert_msg.polygon.x.push_back(cartesian_translation.x);
-                alert_msg.polygon.y.push_back(cartesian_translation.y);
             }
         }
-        alert_msg.cylinder_shape = false;
+        // All vertices converted at once, a trailing latitude without longitude is discarded
+        size_t n_vertices = vertex_longitudes.size();
+        std::vector<double> heights(n_vertices, ellipsoidal_height_), z(n_vertices);
+        _alert.polygon.x.resize(n_vertices);
+        _alert.polygon.y.resize(n_vertices);
+        geodesy_.forward(n_vertices, vertex_latitudes.data(), vertex_longitudes.data(), heights.data(), _alert.polygon.x.data(), _alert.polygon.y.data(), z.data());
+        _alert.cylinder_shape = false;
     }
- 
-    airspace_alert_pub_.publish(alert_msg);
+    else
+    {
+        return false;
+    }
+    return true;
 }
 
 bool USPManager::checkRPAHealth(const gauss_msgs_mqtt::RPAStateInfo::ConstPtr &rpa_state, gauss_msgs::NewThreat &threat, const gauss_msgs::PositionReport &pos_report){
@@ -496,57 +688,19 @@ bool USPManager::checkRPAHealth(const gauss_msgs_mqtt::RPAStateInfo::ConstPtr &r
 
 gauss_msgs::NewThreats USPManager::manageThreatList(const bool &_flag_new_threat, gauss_msgs::NewThreat &_in_threat){
     gauss_msgs::NewThreats out_threats;
-    static int threat_list_id_ = 0;
+    ros::Time now = ros::Time::now();
     if (_flag_new_threat){
-        if (threat_list_.size() == 0) {
-            _in_threat.times.front() = ros::Time::now();
-            threat_list_.push_back(_in_threat);
-            threat_list_.front().threat_id = threat_list_id_;
-            out_threats.request.threats.push_back(threat_list_.front());
-            out_threats.request.uav_ids.push_back(threat_list_.front().uav_ids.front());
-            threat_list_id_++;
+        _in_threat.times.front() = now;
+        ThreatUpdate update = health_threats_.update(_in_threat.threat_type, _in_threat.uav_ids.front(), now);
+        // Reports of a threat already sent only keep it alive, but for the periodic resend
+        if (update.transition != ThreatTransition::UNCHANGED){
+            _in_threat.threat_id = update.threat_id;
+            out_threats.request.threats.push_back(_in_threat);
+            out_threats.request.uav_ids.push_back(_in_threat.uav_ids.front());
         }
-        if (threat_list_.size() > 0){
-            bool save_threat = false;
-            // Using lambda, check if threat_type of in_threat is in threat_list
-            std::vector<gauss_msgs::NewThreat>::iterator it = std::find_if(threat_list_.begin(), threat_list_.end(), 
-                                                                        [_in_threat](gauss_msgs::NewThreat threat){return (threat.threat_type == _in_threat.threat_type);});
-            if (it != threat_list_.end()){
-                // Type found!
-                if (_in_threat.uav_ids.front() != it->uav_ids.front()){
-                        save_threat = true;
-                } else {
-                    // ID Found! Update time
-                    it->times.front() = ros::Time::now();
-                }
-            } else {
-                // Type not found!
-                save_threat = true;
-            }
-            if (save_threat){
-                _in_threat.threat_id = threat_list_id_;
-                _in_threat.times.front() = ros::Time::now();
-                threat_list_.push_back(_in_threat);
-                out_threats.request.threats.push_back(_in_threat);
-                out_threats.request.uav_ids.push_back(_in_threat.uav_ids.front());
-                threat_list_id_++;
-            }
-        } 
     }
-    // Delete non-updated threats from threat_list
-    for (auto saved_threat = threat_list_.begin(); saved_threat != threat_list_.end();){
-        std::vector<gauss_msgs::NewThreat>::iterator it = std::find_if(threat_list_.begin(), threat_list_.end(), 
-                                                                    [](gauss_msgs::NewThreat threat){
-                                                                        double time_to_delete = 2.0;
-                                                                        return (ros::Time::now().toSec() - threat.times.front().toSec()) >= time_to_delete;
-                                                                        });
-        if (it != threat_list_.end()){
-            // Time difference too big, the threat should be deleted. 
-            saved_threat = threat_list_.erase(saved_threat);
-        } else {
-            // Threat should not be deleted, it has been updated 
-            saved_threat++;
-        }
+    else {
+        health_threats_.advance(now);
     }
 
     std::string cout_threats;
@@ -556,8 +710,68 @@ gauss_msgs::NewThreats USPManager::manageThreatList(const bool &_flag_new_threat
 
     return out_threats;
 }
+void USPManager::queueThreats(const gauss_msgs::NewThreats &_threats){
+    std::lock_guard<std::mutex> lock(pending_threats_mutex_);
+    for (auto threat : _threats.request.threats) pending_threats_.push_back(threat);
+    int dropped = 0;
+    while (pending_threats_.size() > max_pending_threats_){
+        // Forgotten, so the next report of the threat is sent again
+        const gauss_msgs::NewThreat &oldest = pending_threats_.front();
+        health_threats_.erase(oldest.threat_type, oldest.uav_ids.front(), oldest.threat_id);
+        pending_threats_.pop_front();
+        dropped++;
+    }
+    ROS_WARN_COND(dropped > 0, "[USPM] Emergency management is not keeping up, %d oldest threats dropped and forgotten", dropped);
+    pending_threats_cv_.notify_one();
+}
+
+void USPManager::threatsSender(){
+    while (true){
+        // Everything queued while the previous call was running goes in the same call
+        gauss_msgs::NewThreats new_threats_msgs;
+        {
+            std::unique_lock<std::mutex> lock(pending_threats_mutex_);
+            pending_threats_cv_.wait(lock, [this] { return stop_sender_ || !pending_threats_.empty(); });
+            if (stop_sender_) return;
+            for (auto threat : pending_threats_){
+                new_threats_msgs.request.threats.push_back(threat);
+                new_threats_msgs.request.uav_ids.push_back(threat.uav_ids.front());
+            }
+            pending_threats_.clear();
+        }
+        if (!threats_client_.call(new_threats_msgs)) ROS_WARN("[USPM] Failed to call service: [/gauss/new_threats]");
+    }
+}
+
+void USPManager::publishPositionReport(const gauss_msgs::PositionReport &_position_report){
+    if (position_report_batch_size_ == 0){
+        position_report_pub_.publish(_position_report);
+        return;
+    }
+    position_report_batch_.reports.push_back(_position_report);
+    if (position_report_batch_.reports.size() >= position_report_batch_size_) flushPositionReports();
+}
+
+void USPManager::flushPositionReports(){
+    if (position_report_batch_.reports.empty()) return;
+    position_report_batch_.header.stamp = ros::Time::now();
+    position_report_array_pub_.publish(position_report_batch_);
+    position_report_batch_.reports.clear();
+}
+
+// Timer Callbacks
+void USPManager::positionReportFlushCB(const ros::TimerEvent &)
+{
+    flushPositionReports();
+}
+
+void USPManager::icaoAddressSweepCB(const ros::TimerEvent &)
+{
+    size_t dropped = icao_addresses_.sweep();
+    ROS_INFO_COND(dropped > 0, "[USPM] %zu icao addresses no longer reported dropped, %zu kept", dropped, icao_addresses_.size());
+}
+
 /*
-// Timer Callback
 void USPManager::timerCallback(const ros::TimerEvent &)
 {
     ROS_INFO("GAUSS USP running");
@@ -582,8 +796,14 @@ bool USPManager::initializeICAOIDMap()
         auto it_icao = read_icao_res.icao_address.begin();
         for(auto it_id = read_icao_res.uav_id.begin(); it_id != read_icao_res.uav_id.end(); it_id++, it_icao++)
         {
-            id_icao_map_[*it_id] = std::atoi((*it_icao).c_str());
-            icao_id_map_[std::atoi((*it_icao).c_str())] = *it_id;
+            uint32_t icao;
+            if (!icao_addresses_.intern(*it_icao, icao))
+            {
+                ROS_WARN("[USPM] Ignoring invalid icao address [%s] of uav id %d", (*it_icao).c_str(), (int)*it_id);
+                continue;
+            }
+            id_icao_map_[*it_id] = icao;
+            icao_id_map_[icao] = *it_id;
         }
     }
 
@@ -628,4 +848,5 @@ int main(int argc, char *argv[])
     USPManager *usp_manager = new USPManager(origin_latitude, origin_longitude, origin_ellipsoidal_height);
 
     ros::spin();
+    delete usp_manager;
 }
@@ -0,0 +1,119 @@
+#include <usp_manager/local_cartesian_batch.h>
+
+#include <GeographicLib/Geocentric.hpp>
+#include <GeographicLib/LocalCartesian.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <limits>
+#include <random>
+#include <string>
+#include <vector>
+
+// Offline benchmark of LocalCartesianBatch against GeographicLib::LocalCartesian: time per point of the forward and
+// reverse conversions, and error of the tangent plane approximation, over random points around the origin.
+
+#define ARENOSILLO_LATITUDE 37.094784
+#define ARENOSILLO_LONGITUDE -6.735478
+
+void printUsage() {
+    printf("Usage: geodesy_benchmark [options]\n");
+    printf("  --points N          Random points per run (default 100000)\n");
+    printf("  --radius M          Horizontal distance of the points to the origin [m] (default 5000)\n");
+    printf("  --fast-radius M     Radius of the tangent plane approximation [m] (default: --radius)\n");
+    printf("  --latitude D        Origin latitude [deg] (default Arenosillo)\n");
+    printf("  --longitude D       Origin longitude [deg] (default Arenosillo)\n");
+    printf("  --seed S            Random seed (default 0)\n");
+    printf("  --repeat R          Runs of every conversion, the fastest is reported (default 5)\n");
+    printf("  --max-error M       Exit with 1 if the approximation error goes over M [m]\n");
+}
+
+template <typename Function>
+double nanosecondsPerPoint(Function _function, int _repeat, size_t _points) {
+    double best = std::numeric_limits<double>::max();
+    for (int run = 0; run < _repeat; run++) {
+        auto start = std::chrono::steady_clock::now();
+        _function();
+        best = std::min(best, std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count());
+    }
+    return best / _points;
+}
+
+int main(int argc, char **argv) {
+    int points = 100000, seed = 0, repeat = 5;
+    double radius = 5000, fast_radius = -1, max_error = -1;
+    double latitude = ARENOSILLO_LATITUDE, longitude = ARENOSILLO_LONGITUDE;
+    for (int i = 1; i < argc; i++) {
+        std::string option = argv[i];
+        if (option == "--help" || option == "-h") {
+            printUsage();
+            return 0;
+        }
+        if (i + 1 >= argc) {
+            printUsage();
+            return 2;
+        }
+        std::string value = argv[++i];
+        if (option == "--points") points = std::max(1, std::atoi(value.c_str()));
+        else if (option == "--radius") radius = std::atof(value.c_str());
+        else if (option == "--fast-radius") fast_radius = std::atof(value.c_str());
+        else if (option == "--latitude") latitude = std::atof(value.c_str());
+        else if (option == "--longitude") longitude = std::atof(value.c_str());
+        else if (option == "--seed") seed = std::atoi(value.c_str());
+        else if (option == "--repeat") repeat = std::max(1, std::atoi(value.c_str()));
+        else if (option == "--max-error") max_error = std::atof(value.c_str());
+        else {
+            printUsage();
+            return 2;
+        }
+    }
+    if (fast_radius < 0) fast_radius = radius;
+
+    GeographicLib::Geocentric earth(GeographicLib::Constants::WGS84_a(), GeographicLib::Constants::WGS84_f());
+    GeographicLib::LocalCartesian proj(latitude, longitude, 0, earth);
+    LocalCartesianBatch exact_batch(proj);
+    LocalCartesianBatch fast_batch(proj, fast_radius);
+
+    // Points uniform in the disc, heights as flown by the uavs
+    std::mt19937 generator(seed);
+    std::uniform_real_distribution<double> unit(0.0, 1.0);
+    std::vector<double> x(points), y(points), z(points), lat(points), lon(points), h(points);
+    for (int i = 0; i < points; i++) {
+        double distance = radius * std::sqrt(unit(generator));
+        double angle = 2 * M_PI * unit(generator);
+        proj.Reverse(distance * std::cos(angle), distance * std::sin(angle), 500 * unit(generator), lat[i], lon[i], h[i]);
+    }
+    std::vector<double> out_x(points), out_y(points), out_z(points), out_lat(points), out_lon(points), out_h(points);
+
+    double geographiclib_forward = nanosecondsPerPoint([&] { for (int i = 0; i < points; i++) proj.Forward(lat[i], lon[i], h[i], x[i], y[i], z[i]); }, repeat, points);
+    double geographiclib_reverse = nanosecondsPerPoint([&] { for (int i = 0; i < points; i++) proj.Reverse(x[i], y[i], z[i], out_lat[i], out_lon[i], out_h[i]); }, repeat, points);
+    double exact_forward = nanosecondsPerPoint([&] { exact_batch.forward(points, lat.data(), lon.data(), h.data(), out_x.data(), out_y.data(), out_z.data()); }, repeat, points);
+    double exact_reverse = nanosecondsPerPoint([&] { exact_batch.reverse(points, x.data(), y.data(), z.data(), out_lat.data(), out_lon.data(), out_h.data()); }, repeat, points);
+    double fast_forward = nanosecondsPerPoint([&] { fast_batch.forward(points, lat.data(), lon.data(), h.data(), out_x.data(), out_y.data(), out_z.data()); }, repeat, points);
+    double fast_reverse = nanosecondsPerPoint([&] { fast_batch.reverse(points, x.data(), y.data(), z.data(), out_lat.data(), out_lon.data(), out_h.data()); }, repeat, points);
+
+    // Errors of the tangent plane (the last conversions run) against GeographicLib. The reverse is mapped back to ENU
+    double forward_error = 0, reverse_error = 0;
+    for (int i = 0; i < points; i++) {
+        forward_error = std::max(forward_error, std::sqrt(std::pow(out_x[i] - x[i], 2) + std::pow(out_y[i] - y[i], 2) + std::pow(out_z[i] - z[i], 2)));
+        double back_x, back_y, back_z;
+        proj.Forward(out_lat[i], out_lon[i], out_h[i], back_x, back_y, back_z);
+        reverse_error = std::max(reverse_error, std::sqrt(std::pow(back_x - x[i], 2) + std::pow(back_y - y[i], 2) + std::pow(back_z - z[i], 2)));
+    }
+
+    printf("%d points within %.0f m of (%.6f, %.6f), fast radius %.0f m\n", points, radius, latitude, longitude, fast_radius);
+    printf("%-22s %12s %12s\n", "[ns/point]", "forward", "reverse");
+    printf("%-22s %12.1f %12.1f\n", "GeographicLib", geographiclib_forward, geographiclib_reverse);
+    printf("%-22s %12.1f %12.1f\n", "batch exact", exact_forward, exact_reverse);
+    printf("%-22s %12.1f %12.1f\n", "batch tangent plane", fast_forward, fast_reverse);
+    printf("Tangent plane max error [m]: forward %.4f, reverse %.4f\n", forward_error, reverse_error);
+
+    if (max_error >= 0 && std::max(forward_error, reverse_error) > max_error) {
+        printf("Max error over %.4f m\n", max_error);
+        return 1;
+    }
+    return 0;
+}